@@ -0,0 +1,273 @@
+// Copyright 2013 Cygnus Software
+// Benchmarks for pdbinfo's PDB reading, run against synthetic PDBs so that
+// results are comparable between machines and over time:
+//   header decode   ns per PDB to open the MSF and read the GUID and age,
+//                   from memory and through ReadPdbIdentityFromFile, for a
+//                   range of block sizes and directory sizes.
+//   stream walks    MB/s to copy every stream, to read every stream through
+//                   MsfStreamReader and to walk the TPI records, with the
+//                   blocks contiguous and scattered, plus the time to decode
+//                   the publics for the symbolizer.
+// Each figure is the best of several repetitions.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include "msf.h"
+#include "pdb.h"
+#include "place.h"
+#include "platform.h"
+#include "scan.h"
+#include "symbols.h"
+#include "synthpdb.h"
+
+namespace
+{
+
+// Keeps the compiler from discarding the work being timed.
+volatile uint64_t g_sink;
+
+const int kRepetitions = 5;
+
+// Best of kRepetitions runs of work, in seconds.
+double BestSeconds(const std::function<void()>& work)
+{
+    double best = 1e30;
+    for (int i = 0; i < kRepetitions; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        work();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (seconds < best)
+            best = seconds;
+    }
+    return best;
+}
+
+void BenchHeaderDecode(uint32_t fileCount, const std::string& directory)
+{
+    printf("Header decode (ns per pdb)\n");
+    printf("  %8s %8s %10s %10s %10s\n", "block", "streams", "dir bytes", "memory", "file");
+    const uint32_t blockSizes[] = { 512, 4096, 16384 };
+    const uint32_t streamCounts[] = { 0, 1000, 10000 };
+    for (size_t b = 0; b < sizeof(blockSizes) / sizeof(blockSizes[0]); ++b)
+    {
+        for (size_t s = 0; s < sizeof(streamCounts) / sizeof(streamCounts[0]); ++s)
+        {
+            SyntheticPdbOptions options;
+            options.blockSize = blockSizes[b];
+            options.extraStreams = streamCounts[s];
+            options.extraStreamBytes = 64;
+            std::vector<uint8_t> file;
+            const char* error = nullptr;
+            if (!BuildSyntheticPdb(options, &file, &error))
+            {
+                printf("  %8u %8u %s\n", options.blockSize, options.extraStreams, error);
+                continue;
+            }
+            MsfFile msf;
+            msf.Open(file.data(), file.size());
+            uint32_t directoryBytes = msf.DirectoryBytes();
+
+            const uint32_t kIterations = 20000;
+            double memorySeconds = BestSeconds([&]()
+            {
+                uint64_t total = 0;
+                for (uint32_t i = 0; i < kIterations; ++i)
+                {
+                    MsfFile decoded;
+                    PdbIdentity identity;
+                    if (decoded.Open(file.data(), file.size()) && ReadPdbIdentity(decoded, &identity))
+                        total += identity.age;
+                }
+                g_sink = total;
+            });
+
+            // The same thing through the file system, with a warm cache, so
+            // the difference is the cost of open, map and unmap.
+            std::vector<std::string> paths;
+            for (uint32_t i = 0; i < fileCount; ++i)
+            {
+                char name[32];
+                sprintf(name, "bench%05u.pdb", i);
+                paths.push_back(JoinPath(directory, name));
+                FILE* fp = fopen(paths.back().c_str(), "wb");
+                if (!fp || fwrite(file.data(), 1, file.size(), fp) != file.size())
+                {
+                    printf("Could not write %s.\n", paths.back().c_str());
+                    if (fp)
+                        fclose(fp);
+                    return;
+                }
+                fclose(fp);
+            }
+            double fileSeconds = BestSeconds([&]()
+            {
+                uint64_t total = 0;
+                for (size_t i = 0; i < paths.size(); ++i)
+                {
+                    PdbIdentity identity;
+                    const char* readError = nullptr;
+                    if (ReadPdbIdentityFromFile(paths[i], &identity, nullptr, &readError))
+                        total += identity.age;
+                }
+                g_sink = total;
+            });
+            for (size_t i = 0; i < paths.size(); ++i)
+                remove(paths[i].c_str());
+
+            printf("  %8u %8u %10u %10.0f %10.0f\n", options.blockSize, options.extraStreams, directoryBytes,
+                   memorySeconds * 1e9 / kIterations, fileSeconds * 1e9 / fileCount);
+        }
+    }
+}
+
+void BenchStreamWalks(uint32_t typeRecords)
+{
+    printf("\nStream walks (%u type records, MB/s unless noted)\n", typeRecords);
+    printf("  %8s %9s %8s %8s %8s %8s %12s\n", "block", "layout", "file MB", "copy", "reader", "records",
+           "publics ms");
+    const uint32_t blockSizes[] = { 1024, 4096, 65536 };
+    for (size_t b = 0; b < sizeof(blockSizes) / sizeof(blockSizes[0]); ++b)
+    {
+        for (uint32_t scatter = 0; scatter < 2; ++scatter)
+        {
+            SyntheticPdbOptions options;
+            options.blockSize = blockSizes[b];
+            options.typeRecords = typeRecords;
+            options.publicSymbols = typeRecords / 4;
+            options.modules = 256;
+            options.scatterSeed = scatter ? 12345 : 0;
+            std::vector<uint8_t> file;
+            const char* error = nullptr;
+            if (!BuildSyntheticPdb(options, &file, &error))
+            {
+                printf("  %8u %s\n", options.blockSize, error);
+                continue;
+            }
+            MsfFile msf;
+            if (!msf.Open(file.data(), file.size()))
+            {
+                printf("  %8u %s\n", options.blockSize, msf.Error());
+                continue;
+            }
+            uint64_t streamBytes = 0;
+            for (uint32_t s = 0; s < msf.StreamCount(); ++s)
+                streamBytes += msf.StreamSize(s);
+
+            double copySeconds = BestSeconds([&]()
+            {
+                std::vector<uint8_t> data;
+                uint64_t total = 0;
+                for (uint32_t s = 0; s < msf.StreamCount(); ++s)
+                {
+                    if (msf.ReadStream(s, &data) && !data.empty())
+                        total += data[data.size() / 2];
+                }
+                g_sink = total;
+            });
+            double readerSeconds = BestSeconds([&]()
+            {
+                uint64_t total = 0;
+                for (uint32_t s = 0; s < msf.StreamCount(); ++s)
+                {
+                    MsfStreamReader reader(msf, s);
+                    while (reader.Remaining())
+                    {
+                        uint32_t bytes = reader.Remaining() < 256 ? reader.Remaining() : 256;
+                        const uint8_t* p = reader.Read(bytes);
+                        if (!p)
+                            break;
+                        total += p[0];
+                    }
+                }
+                g_sink = total;
+            });
+            TpiHeader tpi;
+            ReadTpiHeader(msf, kMsfStreamTpi, &tpi);
+            double recordSeconds = BestSeconds([&]()
+            {
+                MsfStreamReader reader(msf, kMsfStreamTpi, tpi.headerSize);
+                uint64_t total = 0;
+                while (reader.Remaining() >= 4)
+                {
+                    const uint8_t* prefix = reader.Read(2);
+                    const uint8_t* record = prefix ? reader.Read(LoadU16(prefix)) : nullptr;
+                    if (!record)
+                        break;
+                    total += LoadU16(record);
+                }
+                g_sink = total;
+            });
+            double publicSeconds = BestSeconds([&]()
+            {
+                SymbolTable table;
+                table.Build(msf);
+                g_sink = table.SymbolCount();
+            });
+
+            printf("  %8u %9s %8.1f %8.0f %8.0f %8.0f %12.2f\n", options.blockSize,
+                   scatter ? "scattered" : "linear", file.size() / 1e6, streamBytes / copySeconds / 1e6,
+                   streamBytes / readerSeconds / 1e6, tpi.typeRecordBytes / recordSeconds / 1e6,
+                   publicSeconds * 1e3);
+        }
+    }
+}
+
+void PrintUsage()
+{
+    printf("Benchmarks pdb decoding on synthetic pdbs.\n\n");
+    printf("usage: pdbbench [-quick] [-files count] [-types count] [-dir tempdir]\n");
+    printf("  -quick   Small sizes, for a smoke test.\n");
+    printf("  -files   Files per configuration for the file based decode. Default 200.\n");
+    printf("  -types   Type records for the stream walks. Default 2000000.\n");
+    printf("  -dir     Where to write the temporary files. Default pdbbench.tmp.\n");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    uint32_t fileCount = 200;
+    uint32_t typeRecords = 2000000;
+    std::string directory = "pdbbench.tmp";
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-quick") == 0)
+        {
+            fileCount = 20;
+            typeRecords = 50000;
+        }
+        else if (strcmp(argv[i], "-files") == 0 && i + 1 < argc)
+            fileCount = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (strcmp(argv[i], "-types") == 0 && i + 1 < argc)
+            typeRecords = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (strcmp(argv[i], "-dir") == 0 && i + 1 < argc)
+            directory = argv[++i];
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (fileCount == 0)
+    {
+        PrintUsage();
+        return 1;
+    }
+    if (!MakeDirectories(directory))
+    {
+        printf("Could not create %s.\n", directory.c_str());
+        return 1;
+    }
+
+    BenchHeaderDecode(fileCount, directory);
+    BenchStreamWalks(typeRecords);
+    RemoveEmptyDirectory(directory);
+    return 0;
+}
@@ -0,0 +1,450 @@
+// Copyright 2013 Cygnus Software
+// Fuzz target for pdbinfo's readers of untrusted files. LLVMFuzzerTestOneInput
+// hands the input to each of them, and each rejects what isn't its format:
+//   PDB           Opened as an MSF file, then everything that pdbinfo decodes:
+//                 the info stream, the named stream map, every stream through
+//                 both read paths, the TPI and IPI records through the
+//                 reader and record parsing of -bloat (typerecords.h), the
+//                 DBI substreams and the symbolizer's tables.
+//   PE            The CodeView record reader of -match and -ingest (pe.h).
+//   Index         PdbIndex, then its lookups by path and by GUID.
+//   Symbol cache  SymbolTable::Load, then lookups.
+//
+// Built with PDBINFO_LIBFUZZER this is a plain libFuzzer target. Otherwise it
+// has its own driver, which needs nothing beyond the C++ runtime. The driver
+// starts from valid synthetic files of each kind and applies mutations aimed
+// at the parts of the formats that are easy to get wrong: superblock fields,
+// the block map, directory words, stream headers, header words and
+// truncation. Files named on the command line are run as-is, for replaying a
+// corpus or a crash.
+//
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "dbi.h"
+#include "mappedfile.h"
+#include "msf.h"
+#include "pdb.h"
+#include "pdbindex.h"
+#include "pe.h"
+#include "symbols.h"
+#include "synthpdb.h"
+#include "typerecords.h"
+
+// Keeps the compiler from discarding reads of what the parsers return.
+static volatile size_t g_sink;
+
+static void WalkTypeStream(const MsfFile& msf, uint32_t stream)
+{
+    TpiHeader header;
+    if (!ReadTpiHeader(msf, stream, &header))
+        return;
+    TypeRecordReader reader(msf, stream, header);
+    std::vector<TypeIndexRef> refs;
+    uint16_t kind;
+    const uint8_t* data;
+    uint32_t size;
+    while (reader.Next(&kind, &data, &size))
+    {
+        const char* name;
+        size_t length;
+        if (RecordName(kind, data, size, &name, &length) && length)
+            g_sink += name[length - 1];
+        g_sink += LeafKindName(kind) != nullptr;
+        FindTypeIndices(kind, data, size, &refs);
+        for (size_t i = 0; i < refs.size(); ++i)
+            g_sink += LoadU32(data + refs[i].offset) + refs[i].isItem;
+    }
+}
+
+static void FuzzPdb(const uint8_t* data, size_t size)
+{
+    MsfFile msf;
+    if (!msf.Open(data, size))
+        return;
+
+    PdbIdentity identity;
+    ReadPdbIdentity(msf, &identity);
+    std::vector<PdbNamedStream> named;
+    ReadNamedStreams(msf, &named);
+    for (uint32_t block = 0; block < msf.BlockCount(); ++block)
+        msf.IsBlockFree(block);
+
+    std::vector<uint8_t> copy;
+    for (uint32_t stream = 0; stream < msf.StreamCount(); ++stream)
+    {
+        msf.ReadStream(stream, &copy);
+        // Odd sized reads so that many of them straddle blocks.
+        MsfStreamReader reader(msf, stream);
+        while (reader.Remaining() && reader.Read(reader.Remaining() < 333 ? reader.Remaining() : 333))
+        {
+        }
+    }
+    WalkTypeStream(msf, kMsfStreamTpi);
+    WalkTypeStream(msf, kMsfStreamIpi);
+
+    DbiStream dbi;
+    if (dbi.Open(msf))
+    {
+        std::vector<DbiModule> modules;
+        dbi.ReadModules(&modules);
+        std::vector<DbiSectionContribution> contributions;
+        dbi.ReadSectionContributions(&contributions);
+        std::vector<DbiSectionHeader> sections;
+        dbi.ReadSectionHeaders(msf, &sections);
+    }
+    SymbolTable table;
+    if (table.Build(msf))
+    {
+        uint32_t rvas[64];
+        SymbolLookup results[64];
+        for (uint32_t i = 0; i < 64; ++i)
+            rvas[i] = i * 0x1000 + i;
+        table.Lookup(rvas, 64, results);
+    }
+}
+
+static void FuzzPe(const uint8_t* data, size_t size)
+{
+    CodeViewInfo info;
+    const char* error;
+    if (ReadCodeViewInfo(data, size, &info, &error))
+        g_sink += PathFileName(info.pdbPath).size();
+}
+
+// Index and symbol cache files are used in place, so the input must be as
+// aligned as a mapping would be. libFuzzer's and the driver's buffers are.
+static void FuzzIndex(const uint8_t* data, size_t size)
+{
+    PdbIndex index;
+    if (!index.Open(data, size))
+        return;
+    std::vector<uint32_t> matches;
+    for (uint32_t i = 0; i < index.RecordCount() && i < 64; ++i)
+    {
+        const IndexRecord& record = index.Record(i);
+        std::string path = index.RecordPath(i);
+        if (index.FindPath(path))
+            g_sink += 1;
+        index.FindGuidAge(record.guid, record.age, &matches);
+    }
+    g_sink += matches.size();
+}
+
+static void FuzzSymbolCache(const uint8_t* data, size_t size)
+{
+    // Take the GUID and age from the input, so that it gets past that check.
+    SymbolCacheHeader header;
+    if (size < sizeof(header))
+        return;
+    memcpy(&header, data, sizeof(header));
+    SymbolTable table;
+    if (!table.Load(data, size, header.guid, header.age))
+        return;
+    uint32_t rvas[64];
+    SymbolLookup results[64];
+    for (uint32_t i = 0; i < 64; ++i)
+        rvas[i] = i * 0x1000 + i;
+    table.Lookup(rvas, 64, results);
+    for (uint32_t i = 0; i < 64; ++i)
+        g_sink += (results[i].name ? strlen(results[i].name) : 0) + (results[i].module ? strlen(results[i].module) : 0);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    FuzzPdb(data, size);
+    FuzzPe(data, size);
+    FuzzIndex(data, size);
+    FuzzSymbolCache(data, size);
+    return 0;
+}
+
+#ifndef PDBINFO_LIBFUZZER
+
+namespace
+{
+
+// The input being run, so that a crash can be saved for replay.
+const uint8_t* g_input;
+size_t g_inputSize;
+const char kCrashPath[] = "pdbfuzz-crash.pdb";
+
+void SaveInputAndDie(int signal)
+{
+    // stdio isn't async-signal-safe, but the process is going down anyway
+    // and this is only best effort.
+    FILE* fp = fopen(kCrashPath, "wb");
+    if (fp)
+    {
+        fwrite(g_input, 1, g_inputSize, fp);
+        fclose(fp);
+    }
+    static const char message[] = "pdbfuzz: crashed, input saved to pdbfuzz-crash.pdb\n";
+    fwrite(message, 1, sizeof(message) - 1, stderr);
+    ::signal(signal, SIG_DFL);
+    raise(signal);
+}
+
+class Random
+{
+public:
+    explicit Random(uint64_t seed) : state_(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+
+    uint32_t Next()
+    {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        return static_cast<uint32_t>(state_ >> 16);
+    }
+    uint32_t Below(uint32_t limit) { return limit ? Next() % limit : 0; }
+
+private:
+    uint64_t state_;
+};
+
+void StoreU32(uint8_t* p, uint32_t value)
+{
+    memcpy(p, &value, 4);
+}
+
+// A value that is likely to hit a boundary in the reader.
+uint32_t InterestingValue(Random& random, uint32_t current)
+{
+    switch (random.Below(8))
+    {
+    case 0: return 0;
+    case 1: return 1;
+    case 2: return 0xFFFFFFFF;
+    case 3: return 0x7FFFFFFF;
+    case 4: return current + 1;
+    case 5: return current - 1;
+    case 6: return current * 2;
+    default: return random.Next();
+    }
+}
+
+void Mutate(Random& random, std::vector<uint8_t>* pFile)
+{
+    std::vector<uint8_t>& file = *pFile;
+    uint32_t blockSize = LoadU32(&file[32]);
+    uint32_t blockMapBlock = LoadU32(&file[52]);
+    switch (random.Below(7))
+    {
+    case 0:
+    {
+        // A superblock field.
+        uint8_t* p = &file[32 + random.Below(6) * 4];
+        StoreU32(p, InterestingValue(random, LoadU32(p)));
+        break;
+    }
+    case 1:
+    case 2:
+    {
+        // A block map entry, or a word of the directory that it points at.
+        if ((static_cast<uint64_t>(blockMapBlock) + 1) * blockSize > file.size())
+            break;
+        uint8_t* map = &file[static_cast<size_t>(blockMapBlock) * blockSize];
+        uint32_t directoryBlock = LoadU32(map);
+        uint8_t* p = map + random.Below(4) * 4;
+        if (random.Below(2) && (static_cast<uint64_t>(directoryBlock) + 1) * blockSize <= file.size())
+            p = &file[static_cast<size_t>(directoryBlock) * blockSize + random.Below(blockSize / 4) * 4];
+        StoreU32(p, InterestingValue(random, LoadU32(p)));
+        break;
+    }
+    case 3:
+    {
+        // A word in the first block of a stream, where the headers are.
+        MsfFile msf;
+        if (!msf.Open(file.data(), file.size()) || msf.StreamCount() < 2)
+            break;
+        uint32_t stream = 1 + random.Below(msf.StreamCount() < 9 ? msf.StreamCount() - 1 : 8);
+        if (msf.StreamBlockCount(stream) == 0)
+            break;
+        const uint8_t* block = msf.StreamBlockData(stream, 0);
+        if (!block)
+            break;
+        uint8_t* p = &file[block - file.data()] + random.Below(32) * 4;
+        StoreU32(p, InterestingValue(random, LoadU32(p)));
+        break;
+    }
+    case 4:
+    {
+        // Any word, which is where the headers of the other formats are.
+        uint8_t* p = &file[random.Below(static_cast<uint32_t>(file.size() / 4)) * 4];
+        StoreU32(p, InterestingValue(random, LoadU32(p)));
+        break;
+    }
+    case 5:
+        for (uint32_t flips = 1 + random.Below(16); flips > 0; --flips)
+            file[random.Below(static_cast<uint32_t>(file.size()))] ^= static_cast<uint8_t>(1 << random.Below(8));
+        break;
+    default:
+        file.resize(random.Below(static_cast<uint32_t>(file.size())));
+        break;
+    }
+}
+
+bool RunFile(const char* path)
+{
+    MappedFile input;
+    if (!input.Open(path))
+    {
+        printf("Could not open %s: %s.\n", path, input.Error());
+        return false;
+    }
+    LLVMFuzzerTestOneInput(input.Data(), input.Size());
+    printf("%s: ok\n", path);
+    return true;
+}
+
+// The index and the symbol cache are only written to files, so seeds of
+// those go through one that is read back and removed.
+const char kSeedPath[] = "pdbfuzz-seed.tmp";
+
+bool ReadSeed(std::vector<uint8_t>* pFile)
+{
+    bool ok = false;
+    {
+        MappedFile seed;
+        if (seed.Open(kSeedPath))
+        {
+            pFile->assign(seed.Data(), seed.Data() + seed.Size());
+            ok = true;
+        }
+    }
+    remove(kSeedPath);
+    return ok;
+}
+
+void PrintUsage()
+{
+    printf("Fuzzes the pdb, PE, index and symbol cache readers with mutated synthetic files.\n\n");
+    printf("usage: pdbfuzz [-iterations count] [-seed seed]\n");
+    printf("       pdbfuzz <file>...\n");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    uint64_t iterations = 100000;
+    uint64_t seed = 1;
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-iterations") == 0 && i + 1 < argc)
+            iterations = strtoull(argv[++i], nullptr, 0);
+        else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc)
+            seed = strtoull(argv[++i], nullptr, 0);
+        else if (argv[i][0] == '-')
+        {
+            PrintUsage();
+            return 1;
+        }
+        else
+            files.push_back(argv[i]);
+    }
+
+    // Replays run without the crash handler so that a debugger or sanitizer
+    // sees the fault first.
+    if (!files.empty())
+    {
+        bool ok = true;
+        for (size_t i = 0; i < files.size(); ++i)
+            ok = RunFile(files[i]) && ok;
+        return ok ? 0 : 1;
+    }
+
+    signal(SIGSEGV, SaveInputAndDie);
+    signal(SIGABRT, SaveInputAndDie);
+    signal(SIGFPE, SaveInputAndDie);
+#ifdef SIGBUS
+    signal(SIGBUS, SaveInputAndDie);
+#endif
+
+    // A few differently shaped starting points: small and large blocks, a
+    // scattered layout with an old directory in stream 0 and a directory that
+    // spans several blocks.
+    std::vector<std::vector<uint8_t>> bases(4);
+    for (size_t i = 0; i < bases.size(); ++i)
+    {
+        SyntheticPdbOptions options;
+        options.blockSize = i % 2 ? 4096 : 512;
+        options.typeRecords = 200;
+        options.publicSymbols = 100;
+        options.modules = 4;
+        options.scatterSeed = i >= 2 ? 7 : 0;
+        options.oldDirectory = i >= 2 ? 1 : 0;
+        options.extraStreams = i == 3 ? 40 : 2;
+        options.extraStreamBytes = 700;
+        const char* error = nullptr;
+        if (!BuildSyntheticPdb(options, &bases[i], &error))
+        {
+            printf("Could not build a base pdb: %s.\n", error);
+            return 1;
+        }
+    }
+
+    // And one of each of the other formats.
+    SyntheticPdbOptions options;
+    bases.emplace_back();
+    BuildSyntheticPe(options, "d:\\src\\out\\synth.pdb", &bases.back());
+
+    std::vector<IndexEntry> entries(20);
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        IndexEntry& entry = entries[i];
+        entry.path = "d:\\symbols\\module" + std::to_string(i) + ".pdb";
+        memset(&entry.record, 0, sizeof(entry.record));
+        entry.record.size = 4096 * (i + 1);
+        entry.record.age = 1 + i % 3;
+        entry.record.guid.Data1 = static_cast<uint32_t>(i / 2);
+    }
+    bases.emplace_back();
+    if (!WritePdbIndex(kSeedPath, &entries) || !ReadSeed(&bases.back()))
+    {
+        printf("Could not build a base index.\n");
+        return 1;
+    }
+
+    MsfFile msf;
+    SymbolTable table;
+    PdbGuid guid = { 0x12345678, 1, 2, { 3, 4, 5, 6, 7, 8, 9, 10 } };
+    bases.emplace_back();
+    if (!msf.Open(bases[0].data(), bases[0].size()) || !table.Build(msf) || !table.Save(kSeedPath, guid, 1) ||
+        !ReadSeed(&bases.back()))
+    {
+        printf("Could not build a base symbol cache.\n");
+        return 1;
+    }
+
+    Random random(seed);
+    std::vector<uint8_t> file;
+    uint64_t opened = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; ++i)
+    {
+        file = bases[random.Below(static_cast<uint32_t>(bases.size()))];
+        for (uint32_t m = 1 + random.Below(3); m > 0 && file.size() >= kMsfSuperBlockSize; --m)
+            Mutate(random, &file);
+        g_input = file.data();
+        g_inputSize = file.size();
+        MsfFile msf;
+        if (msf.Open(file.data(), file.size()))
+            ++opened;
+        LLVMFuzzerTestOneInput(file.data(), file.size());
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%llu inputs (%llu opened as MSF) in %.2f s, %.0f per second.\n",
+           static_cast<unsigned long long>(iterations), static_cast<unsigned long long>(opened), elapsed,
+           iterations / (elapsed > 0 ? elapsed : 1e-9));
+    return 0;
+}
+
+#endif  // PDBINFO_LIBFUZZER
@@ -0,0 +1,119 @@
+// Copyright 2013 Cygnus Software
+// Writes synthetic PDBs for testing and benchmarking pdbinfo without a VC++
+// toolchain. With -count the files are written to a directory, each with its
+// own GUID, which makes a tree for pdbinfo -r, -index and -ingest.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "place.h"
+#include "platform.h"
+#include "synthpdb.h"
+
+static void PrintUsage()
+{
+    printf("Writes synthetic pdbs.\n\n");
+    printf("usage: pdbgen [options] <out.pdb | outdir>\n");
+    printf("  -block bytes     Block size, a power of two from 512 to 65536. Default 4096.\n");
+    printf("  -types count     TPI type records. Default 1000.\n");
+    printf("  -publics count   Public symbols. Default 1000.\n");
+    printf("  -modules count   Modules in the DBI stream. Default 16.\n");
+    printf("  -streams count   Extra streams, to make the directory bigger. Default 0.\n");
+    printf("  -streambytes n   Size of each extra stream. Default 0.\n");
+    printf("  -scatter seed    Shuffle the data blocks, like an incremental link.\n");
+    printf("  -olddir          Keep the directory of an earlier layout in stream 0,\n");
+    printf("                   as link.exe does.\n");
+    printf("  -seed seed       Seed for the GUID. Default 1.\n");
+    printf("  -age age         Default 1.\n");
+    printf("  -infoage age     Age in the info stream, as source indexing leaves it.\n");
+    printf("                   Default the same as -age.\n");
+    printf("  -count files     Write this many files, with seeds seed..seed+files-1,\n");
+    printf("                   into the output directory.\n");
+}
+
+int main(int argc, char* argv[])
+{
+    SyntheticPdbOptions options;
+    uint32_t count = 0;
+    const char* output = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        uint32_t* pValue = nullptr;
+        if (strcmp(argv[i], "-olddir") == 0)
+        {
+            options.oldDirectory = 1;
+            continue;
+        }
+        else if (strcmp(argv[i], "-block") == 0)
+            pValue = &options.blockSize;
+        else if (strcmp(argv[i], "-types") == 0)
+            pValue = &options.typeRecords;
+        else if (strcmp(argv[i], "-publics") == 0)
+            pValue = &options.publicSymbols;
+        else if (strcmp(argv[i], "-modules") == 0)
+            pValue = &options.modules;
+        else if (strcmp(argv[i], "-streams") == 0)
+            pValue = &options.extraStreams;
+        else if (strcmp(argv[i], "-streambytes") == 0)
+            pValue = &options.extraStreamBytes;
+        else if (strcmp(argv[i], "-scatter") == 0)
+            pValue = &options.scatterSeed;
+        else if (strcmp(argv[i], "-seed") == 0)
+            pValue = &options.seed;
+        else if (strcmp(argv[i], "-age") == 0)
+            pValue = &options.age;
+        else if (strcmp(argv[i], "-infoage") == 0)
+            pValue = &options.infoAge;
+        else if (strcmp(argv[i], "-count") == 0)
+            pValue = &count;
+        else if (argv[i][0] != '-' && !output)
+        {
+            output = argv[i];
+            continue;
+        }
+        if (!pValue || i + 1 >= argc)
+        {
+            PrintUsage();
+            return 1;
+        }
+        *pValue = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 0));
+    }
+    if (!output)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    const char* error = nullptr;
+    if (count == 0)
+    {
+        if (!WriteSyntheticPdb(options, output, &error))
+        {
+            printf("Could not write %s: %s.\n", output, error);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!MakeDirectories(output))
+    {
+        printf("Could not create %s.\n", output);
+        return 1;
+    }
+    uint32_t firstSeed = options.seed;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        options.seed = firstSeed + i;
+        char name[32];
+        sprintf(name, "synth%05u.pdb", i);
+        std::string path = JoinPath(output, name);
+        if (!WriteSyntheticPdb(options, path.c_str(), &error))
+        {
+            printf("Could not write %s: %s.\n", path.c_str(), error);
+            return 1;
+        }
+    }
+    return 0;
+}
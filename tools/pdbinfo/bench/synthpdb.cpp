@@ -0,0 +1,478 @@
+// Copyright 2013 Cygnus Software
+
+#include "synthpdb.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "msfwriter.h"
+
+namespace
+{
+
+class ByteBuffer
+{
+public:
+    void U8(uint32_t value) { data_.push_back(static_cast<uint8_t>(value)); }
+    void U16(uint32_t value)
+    {
+        U8(value);
+        U8(value >> 8);
+    }
+    void U32(uint32_t value)
+    {
+        U16(value);
+        U16(value >> 16);
+    }
+    void String(const char* text) { data_.insert(data_.end(), text, text + strlen(text) + 1); }
+    void Bytes(const void* data, size_t size)
+    {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        data_.insert(data_.end(), p, p + size);
+    }
+    // Zero pad up to an offset.
+    void PadTo(size_t size)
+    {
+        data_.resize(size);
+    }
+    void Align4(uint8_t fill = 0)
+    {
+        while (data_.size() % 4)
+            U8(fill);
+    }
+    size_t Size() const { return data_.size(); }
+    std::vector<uint8_t>& Data() { return data_; }
+
+private:
+    std::vector<uint8_t> data_;
+};
+
+// A CodeView record: length, kind, body, padded with LF_PAD bytes so that the
+// next record starts on a four byte boundary.
+void AppendRecord(ByteBuffer* pOut, uint16_t kind, ByteBuffer& body)
+{
+    std::vector<uint8_t>& data = body.Data();
+    size_t padded = (data.size() + 4 + 3) & ~static_cast<size_t>(3);
+    for (size_t pad = padded - 4 - data.size(); pad > 0; --pad)
+        data.push_back(static_cast<uint8_t>(0xF0 + pad));
+    pOut->U16(static_cast<uint32_t>(data.size() + 2));
+    pOut->U16(kind);
+    pOut->Bytes(data.data(), data.size());
+}
+
+void AppendTpiHeader(ByteBuffer* pOut, uint32_t recordCount, uint32_t recordBytes)
+{
+    pOut->U32(20040203);        // V80
+    pOut->U32(56);
+    pOut->U32(0x1000);
+    pOut->U32(0x1000 + recordCount);
+    pOut->U32(recordBytes);
+    pOut->U16(0xFFFF);          // No hash streams.
+    pOut->U16(0xFFFF);
+    pOut->U32(4);
+    pOut->U32(0x3FFFF);
+    for (int i = 0; i < 6; ++i)
+        pOut->U32(0);
+}
+
+void BuildTpi(uint32_t recordCount, ByteBuffer* pOut)
+{
+    ByteBuffer records;
+    char name[64];
+    for (uint32_t i = 0; i < recordCount; ++i)
+    {
+        uint32_t typeIndex = 0x1000 + i;
+        uint32_t previous = i ? typeIndex - 1 : 0x74;
+        ByteBuffer body;
+        uint16_t kind;
+        switch (i % 8)
+        {
+        case 0:
+            kind = 0x1203;      // LF_FIELDLIST with one LF_MEMBER.
+            body.U16(0x150d);
+            body.U16(3);
+            body.U32(0x74);
+            body.U16(0);
+            body.String("value");
+            break;
+        case 1:
+        case 7:
+            kind = 0x1505;      // LF_STRUCTURE, a definition or a forward reference.
+            body.U16(i % 8 == 1 ? 1 : 0);
+            body.U16(i % 8 == 1 ? 0 : 0x80);
+            body.U32(i % 8 == 1 ? previous : 0);
+            body.U32(0);
+            body.U32(0);
+            body.U16(i % 8 == 1 ? 4 : 0);
+            sprintf(name, "Synth_t<%u>", i / 8);
+            body.String(name);
+            break;
+        case 2:
+        case 3:
+            kind = 0x1002;      // LF_POINTER
+            body.U32(previous);
+            body.U32(0x1000C);
+            break;
+        case 4:
+            kind = 0x1201;      // LF_ARGLIST
+            body.U32(2);
+            body.U32(0x74);
+            body.U32(previous);
+            break;
+        case 5:
+            kind = 0x1008;      // LF_PROCEDURE
+            body.U32(0x74);
+            body.U8(0);
+            body.U8(0);
+            body.U16(2);
+            body.U32(previous);
+            break;
+        default:
+            kind = 0x1001;      // LF_MODIFIER, const.
+            body.U32(previous);
+            body.U16(1);
+            break;
+        }
+        AppendRecord(&records, kind, body);
+    }
+    AppendTpiHeader(pOut, recordCount, static_cast<uint32_t>(records.Size()));
+    pOut->Bytes(records.Data().data(), records.Size());
+}
+
+void BuildIpi(uint32_t modules, ByteBuffer* pOut)
+{
+    ByteBuffer records;
+    char name[64];
+    for (uint32_t m = 0; m < modules; ++m)
+    {
+        ByteBuffer body;
+        body.U32(0);
+        body.U32(0x1005);
+        sprintf(name, "Synth_t<%u>::Run", m);
+        body.String(name);
+        AppendRecord(&records, 0x1601, body);   // LF_FUNC_ID
+    }
+    AppendTpiHeader(pOut, modules, static_cast<uint32_t>(records.Size()));
+    pOut->Bytes(records.Data().data(), records.Size());
+}
+
+void AppendGsiHashHeader(ByteBuffer* pOut)
+{
+    pOut->U32(0xFFFFFFFF);
+    pOut->U32(0xeffe0000 + 19990810);
+    pOut->U32(0);
+    pOut->U32(0);
+}
+
+// Every fourth filler stream, after the nine fixed ones, is nil.
+bool IsNilStream(size_t stream)
+{
+    return stream >= 9 && (stream - 9) % 4 == 3;
+}
+
+const uint32_t kTextRva = 0x1000;
+const uint32_t kFunctionSize = 16;
+
+}  // namespace
+
+SyntheticPdbOptions::SyntheticPdbOptions()
+    : blockSize(4096)
+    , typeRecords(1000)
+    , publicSymbols(1000)
+    , modules(16)
+    , extraStreams(0)
+    , extraStreamBytes(0)
+    , scatterSeed(0)
+    , oldDirectory(0)
+    , seed(1)
+    , age(1)
+    , infoAge(0)
+{
+}
+
+PdbGuid SyntheticPdbGuid(uint32_t seed)
+{
+    PdbGuid guid;
+    guid.Data1 = 0x5EED0000 ^ seed;
+    guid.Data2 = 0x1234;
+    guid.Data3 = static_cast<uint16_t>(seed * 2654435761u >> 16);
+    for (int i = 0; i < 8; ++i)
+        guid.Data4[i] = static_cast<uint8_t>(seed >> (i % 4 * 8)) ^ static_cast<uint8_t>(0xA5 + i);
+    return guid;
+}
+
+static bool LayOutSyntheticPdb(const SyntheticPdbOptions& options, std::vector<ByteBuffer>* pStreams,
+                               MsfWriter* pWriter, const char** pError)
+{
+    if (options.modules == 0)
+    {
+        *pError = "a synthetic PDB needs at least one module";
+        return false;
+    }
+    std::vector<ByteBuffer>& streams = *pStreams;
+    streams.resize(9);
+
+    // PDB info: header, an empty named stream map and the VC140 feature code.
+    PdbGuid guid = SyntheticPdbGuid(options.seed);
+    ByteBuffer& info = streams[kMsfStreamPdbInfo];
+    info.U32(kPdbImplVC70);
+    info.U32(0x5EED0000 ^ options.seed);
+    info.U32(options.infoAge ? options.infoAge : options.age);
+    info.Bytes(&guid, sizeof(guid));
+    info.U32(0);
+    info.U32(0);
+    info.U32(1);
+    info.U32(1);
+    info.U32(0);
+    info.U32(0);
+    info.U32(20140508);
+
+    BuildTpi(options.typeRecords, &streams[kMsfStreamTpi]);
+    BuildIpi(options.modules, &streams[kMsfStreamIpi]);
+
+    // Section headers: code, then data.
+    uint32_t textSize = std::max(options.publicSymbols, options.modules) * kFunctionSize;
+    ByteBuffer& sections = streams[5];
+    const char* const sectionNames[] = { ".text\0\0\0", ".data\0\0\0" };
+    uint32_t sectionRvas[] = { kTextRva, (kTextRva + textSize + 0xFFF) & ~0xFFFu };
+    for (int s = 0; s < 2; ++s)
+    {
+        sections.Bytes(sectionNames[s], 8);
+        sections.U32(s == 0 ? textSize : 0x1000);
+        sections.U32(sectionRvas[s]);
+        sections.U32(s == 0 ? textSize : 0x1000);
+        sections.U32(0x400);
+        sections.U32(0);
+        sections.U32(0);
+        sections.U32(0);
+        sections.U32(s == 0 ? 0x60000020 : 0xC0000040);
+    }
+
+    // Publics, sorted by address, and their records.
+    ByteBuffer& symbols = streams[7];
+    ByteBuffer addressMap;
+    char name[64];
+    for (uint32_t i = 0; i < options.publicSymbols; ++i)
+    {
+        addressMap.U32(static_cast<uint32_t>(symbols.Size()));
+        ByteBuffer body;
+        body.U32(2);            // Function.
+        body.U32(i * kFunctionSize);
+        body.U16(1);
+        sprintf(name, "?SynthFn%u@@YAXXZ", i);
+        body.String(name);
+        AppendRecord(&symbols, 0x110E, body);   // S_PUB32
+    }
+    ByteBuffer& publics = streams[6];
+    publics.U32(16);            // Size of the (empty) hash table that follows.
+    publics.U32(static_cast<uint32_t>(addressMap.Size()));
+    publics.U32(0);
+    publics.U32(0);
+    publics.U16(0);
+    publics.U16(0);
+    publics.U32(0);
+    publics.U32(2);
+    AppendGsiHashHeader(&publics);
+    publics.Bytes(addressMap.Data().data(), addressMap.Size());
+    AppendGsiHashHeader(&streams[8]);
+
+    // DBI: one code contribution per module, splitting .text evenly.
+    ByteBuffer moduleInfo;
+    ByteBuffer contributions;
+    contributions.U32(0xeffe0000 + 19970605);
+    uint32_t moduleSize = textSize / options.modules;
+    for (uint32_t m = 0; m < options.modules; ++m)
+    {
+        ByteBuffer contribution;
+        contribution.U16(1);
+        contribution.U16(0);
+        contribution.U32(m * moduleSize);
+        contribution.U32(m + 1 == options.modules ? textSize - m * moduleSize : moduleSize);
+        contribution.U32(0x60000020);
+        contribution.U16(m);
+        contribution.U16(0);
+        contribution.U32(0);
+        contribution.U32(0);
+        contributions.Bytes(contribution.Data().data(), contribution.Size());
+
+        moduleInfo.U32(0);
+        moduleInfo.Bytes(contribution.Data().data(), contribution.Size());
+        moduleInfo.U16(0);
+        moduleInfo.U16(0xFFFF);     // No module symbol stream.
+        for (int i = 0; i < 3; ++i)
+            moduleInfo.U32(0);
+        moduleInfo.U16(0);
+        moduleInfo.U16(0);
+        for (int i = 0; i < 3; ++i)
+            moduleInfo.U32(0);
+        sprintf(name, "C:\\synth\\mod%u.obj", m);
+        moduleInfo.String(name);
+        moduleInfo.String(name);
+        moduleInfo.Align4();
+    }
+    ByteBuffer debugHeader;
+    for (uint32_t i = 0; i < 11; ++i)
+        debugHeader.U16(i == 5 ? 5 : 0xFFFF);
+    ByteBuffer& dbi = streams[kMsfStreamDbi];
+    dbi.U32(0xFFFFFFFF);
+    dbi.U32(19990903);
+    dbi.U32(options.age);
+    dbi.U16(8);                 // Globals.
+    dbi.U16(0x8E00);
+    dbi.U16(6);                 // Publics.
+    dbi.U16(0);
+    dbi.U16(7);                 // Symbol records.
+    dbi.U16(0);
+    dbi.U32(static_cast<uint32_t>(moduleInfo.Size()));
+    dbi.U32(static_cast<uint32_t>(contributions.Size()));
+    for (int i = 0; i < 4; ++i)
+        dbi.U32(0);
+    dbi.U32(static_cast<uint32_t>(debugHeader.Size()));
+    dbi.U32(0);
+    dbi.U16(0);
+    dbi.U16(0x8664);
+    dbi.U32(0);
+    dbi.Bytes(moduleInfo.Data().data(), moduleInfo.Size());
+    dbi.Bytes(contributions.Data().data(), contributions.Size());
+    dbi.Bytes(debugHeader.Data().data(), debugHeader.Size());
+
+    // Filler streams. The contents don't matter, but make them incompressible.
+    uint32_t state = options.seed * 2654435761u + 1;
+    for (uint32_t i = 0; i < options.extraStreams; ++i)
+    {
+        streams.push_back(ByteBuffer());
+        if (i % 4 == 3)
+            continue;
+        std::vector<uint8_t>& data = streams.back().Data();
+        data.resize(options.extraStreamBytes);
+        for (size_t b = 0; b < data.size(); ++b)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            data[b] = static_cast<uint8_t>(state);
+        }
+    }
+
+    pWriter->SetScatterSeed(options.scatterSeed);
+    for (size_t i = 0; i < streams.size(); ++i)
+    {
+        uint32_t stream = IsNilStream(i) ? pWriter->AddNilStream() : pWriter->AddStream();
+        pWriter->AppendToStream(stream, streams[i].Data().data(), static_cast<uint32_t>(streams[i].Size()));
+    }
+    if (options.oldDirectory)
+    {
+        // Lay the file out once without stream 0 and keep that directory, the
+        // way a relink leaves the directory of the previous link behind.
+        if (!pWriter->Write([](const void*, size_t) { return true; }))
+        {
+            *pError = pWriter->Error();
+            return false;
+        }
+        ByteBuffer& old = streams[kMsfStreamOldDirectory];
+        old.U32(static_cast<uint32_t>(streams.size()));
+        for (size_t i = 0; i < streams.size(); ++i)
+            old.U32(IsNilStream(i) ? kMsfNilStreamSize : static_cast<uint32_t>(streams[i].Size()));
+        for (size_t i = 0; i < streams.size(); ++i)
+        {
+            const std::vector<uint32_t>& blocks = pWriter->StreamBlocks(static_cast<uint32_t>(i));
+            for (size_t b = 0; b < blocks.size(); ++b)
+                old.U32(blocks[b]);
+        }
+        pWriter->AppendToStream(kMsfStreamOldDirectory, old.Data().data(), static_cast<uint32_t>(old.Size()));
+    }
+    return true;
+}
+
+bool BuildSyntheticPdb(const SyntheticPdbOptions& options, std::vector<uint8_t>* pFile, const char** pError)
+{
+    std::vector<ByteBuffer> streams;
+    MsfWriter writer(options.blockSize);
+    if (!LayOutSyntheticPdb(options, &streams, &writer, pError))
+        return false;
+    if (!writer.WriteToBuffer(pFile))
+    {
+        *pError = writer.Error();
+        return false;
+    }
+    return true;
+}
+
+bool WriteSyntheticPdb(const SyntheticPdbOptions& options, const char* path, const char** pError)
+{
+    std::vector<ByteBuffer> streams;
+    MsfWriter writer(options.blockSize);
+    if (!LayOutSyntheticPdb(options, &streams, &writer, pError))
+        return false;
+    if (!writer.WriteFile(path))
+    {
+        *pError = writer.Error();
+        return false;
+    }
+    return true;
+}
+
+void BuildSyntheticPe(const SyntheticPdbOptions& options, const char* pdbPath, std::vector<uint8_t>* pFile)
+{
+    const uint32_t kPeOffset = 0x40;
+    const uint32_t kOptionalHeaderSize = 240;
+    const uint32_t kSectionRva = 0x1000;
+    const uint32_t kSectionOffset = 0x200;
+    const uint32_t kDebugEntrySize = 28;
+
+    ByteBuffer record;
+    PdbGuid guid = SyntheticPdbGuid(options.seed);
+    record.U32(0x53445352);     // RSDS
+    record.Bytes(&guid, sizeof(guid));
+    record.U32(options.age);
+    record.String(pdbPath);
+    uint32_t sectionSize = (kDebugEntrySize + static_cast<uint32_t>(record.Size()) + 0x1FF) & ~0x1FFu;
+
+    ByteBuffer pe;
+    pe.U16(0x5A4D);             // MZ
+    pe.PadTo(0x3C);
+    pe.U32(kPeOffset);
+    pe.U32(0x00004550);         // PE\0\0
+    pe.U16(0x8664);
+    pe.U16(1);                  // Sections.
+    pe.U32(0x5EED0000 ^ options.seed);
+    pe.U32(0);
+    pe.U32(0);
+    pe.U16(kOptionalHeaderSize);
+    pe.U16(0x22);               // Executable, large address aware.
+
+    // PE32+ optional header, with only the fields that matter here set.
+    size_t optional = pe.Size();
+    pe.U16(0x20B);
+    pe.PadTo(optional + 56);
+    pe.U32(kSectionRva + sectionSize);      // SizeOfImage
+    pe.PadTo(optional + 108);
+    pe.U32(16);                             // NumberOfRvaAndSizes
+    pe.PadTo(optional + 112 + 6 * 8);
+    pe.U32(kSectionRva);                    // Debug directory.
+    pe.U32(kDebugEntrySize);
+    pe.PadTo(optional + kOptionalHeaderSize);
+
+    pe.Bytes(".rdata\0\0", 8);
+    pe.U32(sectionSize);
+    pe.U32(kSectionRva);
+    pe.U32(sectionSize);
+    pe.U32(kSectionOffset);
+    pe.U32(0);
+    pe.U32(0);
+    pe.U32(0);
+    pe.U32(0x40000040);
+    pe.PadTo(kSectionOffset);
+
+    // The debug directory entry, then the record it points at.
+    pe.U32(0);
+    pe.U32(0x5EED0000 ^ options.seed);
+    pe.U32(0);
+    pe.U32(2);                  // IMAGE_DEBUG_TYPE_CODEVIEW
+    pe.U32(static_cast<uint32_t>(record.Size()));
+    pe.U32(kSectionRva + kDebugEntrySize);
+    pe.U32(kSectionOffset + kDebugEntrySize);
+    pe.Bytes(record.Data().data(), record.Size());
+    pe.PadTo(kSectionOffset + sectionSize);
+    pFile->swap(pe.Data());
+}
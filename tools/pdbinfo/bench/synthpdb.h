@@ -0,0 +1,54 @@
+// Copyright 2013 Cygnus Software
+// Generator for synthetic but well formed PDBs, used by the benchmark and
+// the fuzzer so that neither needs real VC++ output. A generated PDB has:
+//   stream 1    PDB info, with a GUID derived from the seed.
+//   stream 2    TPI with typeRecords records: a mix of structures named
+//               Synth_t<N>, field lists, pointers, argument lists and
+//               procedures, in the proportions a template heavy build has.
+//   stream 3    DBI with modules, section contributions and an optional
+//               debug header.
+//   stream 4    IPI with one LF_FUNC_ID per module.
+//   streams 5-8 Section headers, publics, symbol records and globals.
+// followed by extraStreams streams of extraStreamBytes each, every fourth
+// one nil, which is how to make the stream directory big. Stream 0 is empty
+// unless oldDirectory is set, in which case it holds the directory of an
+// earlier layout of the same streams, as link.exe leaves there, so that its
+// contents depend on the block placement.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "pdb.h"
+
+struct SyntheticPdbOptions
+{
+    SyntheticPdbOptions();
+
+    uint32_t blockSize;
+    uint32_t typeRecords;
+    uint32_t publicSymbols;
+    uint32_t modules;
+    uint32_t extraStreams;
+    uint32_t extraStreamBytes;
+    // Nonzero to shuffle the data blocks, like an incrementally linked PDB.
+    uint32_t scatterSeed;
+    // Nonzero to fill stream 0 with an old directory.
+    uint32_t oldDirectory;
+    uint32_t seed;
+    uint32_t age;
+    // The info stream's age, which source indexing increments, or 0 for age.
+    uint32_t infoAge;
+};
+
+// The GUID that a generated PDB will have for a given seed.
+PdbGuid SyntheticPdbGuid(uint32_t seed);
+
+bool BuildSyntheticPdb(const SyntheticPdbOptions& options, std::vector<uint8_t>* pFile, const char** pError);
+bool WriteSyntheticPdb(const SyntheticPdbOptions& options, const char* path, const char** pError);
+
+// A minimal PE32+ image whose RSDS CodeView record matches the PDB that the
+// same options generate: one section holding the debug directory and the
+// record, which names pdbPath.
+void BuildSyntheticPe(const SyntheticPdbOptions& options, const char* pdbPath, std::vector<uint8_t>* pFile);
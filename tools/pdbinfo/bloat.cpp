@@ -0,0 +1,429 @@
+// Copyright 2013 Cygnus Software
+// Size analysis: pdbinfo -bloat reports where the bytes in a PDB go. It lists
+// the streams by size, with names taken from the DBI stream and the named
+// stream map, and then walks the TPI and IPI type records in one pass to
+// break them down by leaf kind. Two summaries point at the usual causes of
+// type bloat:
+//   Template families   Type and function id records grouped by the name
+//                       before the first '<', so FibSlow_t<1> through
+//                       FibSlow_t<40> count as one family.
+//   Duplicate records   Records grouped by a structural hash, as in the
+//                       GHASH scheme that lld uses: the hash of a record's
+//                       bytes with each index of another record replaced by
+//                       that record's hash. Records land in one group only
+//                       if they and everything they refer to are the same,
+//                       whatever the indices, so a group is copies of one
+//                       type that were never merged. Every record of a
+//                       group but one is counted as wasted.
+//
+// The type streams are read block by block and both summaries are bounded.
+// Beyond that, memory use grows only by the 8 byte hash of each record.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "commands.h"
+#include "dbi.h"
+#include "hash.h"
+#include "mappedfile.h"
+#include "msf.h"
+#include "pdb.h"
+#include "typerecords.h"
+
+namespace
+{
+
+// A bounded summary of the keys with the most records. When the table fills
+// up the less frequent half is discarded and the largest discarded count is
+// remembered, so any key that is missing from the report, or was re-added
+// after being discarded, is known to be undercounted by at most Floor().
+class HeavyHitters
+{
+public:
+    struct Entry
+    {
+        std::string label;
+        uint64_t count;
+        uint64_t bytes;
+    };
+
+    explicit HeavyHitters(size_t capacity)
+        : capacity_(capacity)
+        , floor_(0)
+    {
+    }
+
+    void Add(const char* label, size_t length, uint64_t bytes)
+    {
+        Add(Fnv1a64(label, length), nullptr, label, length, bytes);
+    }
+
+    // Add under a key of the caller's choosing. The label, prefix then
+    // label, is only built when the key is new.
+    void Add(uint64_t key, const char* prefix, const char* label, size_t length, uint64_t bytes)
+    {
+        auto it = entries_.find(key);
+        if (it == entries_.end())
+        {
+            if (entries_.size() >= capacity_)
+                Prune();
+            Entry entry;
+            if (prefix)
+            {
+                entry.label = prefix;
+                if (length)
+                    entry.label += ' ';
+            }
+            entry.label.append(label, length);
+            entry.count = 0;
+            entry.bytes = 0;
+            it = entries_.insert(std::make_pair(key, entry)).first;
+        }
+        ++it->second.count;
+        it->second.bytes += bytes;
+    }
+
+    uint64_t Floor() const { return floor_; }
+
+    // The n entries with the highest counts that have at least minCount.
+    std::vector<const Entry*> Top(size_t n, uint64_t minCount) const
+    {
+        std::vector<const Entry*> top;
+        for (auto it = entries_.begin(); it != entries_.end(); ++it)
+        {
+            if (it->second.count >= minCount)
+                top.push_back(&it->second);
+        }
+        n = std::min(n, top.size());
+        std::partial_sort(top.begin(), top.begin() + n, top.end(), EntryMore);
+        top.resize(n);
+        return top;
+    }
+
+private:
+    static bool EntryMore(const Entry* lhs, const Entry* rhs)
+    {
+        if (lhs->count != rhs->count)
+            return lhs->count > rhs->count;
+        return lhs->label < rhs->label;
+    }
+
+    void Prune()
+    {
+        std::vector<uint64_t> counts;
+        counts.reserve(entries_.size());
+        for (auto it = entries_.begin(); it != entries_.end(); ++it)
+            counts.push_back(it->second.count);
+        std::nth_element(counts.begin(), counts.begin() + counts.size() / 2, counts.end());
+        uint64_t median = counts[counts.size() / 2];
+        for (auto it = entries_.begin(); it != entries_.end();)
+        {
+            if (it->second.count <= median)
+                it = entries_.erase(it);
+            else
+                ++it;
+        }
+        floor_ = std::max(floor_, median);
+    }
+
+    size_t capacity_;
+    uint64_t floor_;
+    std::unordered_map<uint64_t, Entry> entries_;
+};
+
+struct LeafStats
+{
+    uint64_t count;
+    uint64_t bytes;
+};
+
+struct TypeStreamStats
+{
+    TypeStreamStats() : records(0), bytes(0), truncated(false), leaves(65536) {}
+
+    uint64_t records;
+    uint64_t bytes;
+    bool truncated;
+    std::vector<LeafStats> leaves;      // Indexed by leaf kind.
+};
+
+// The structural hashes of the records of one type stream, by type index.
+struct RecordHashes
+{
+    RecordHashes() : firstIndex(kFirstRecordTypeIndex) {}
+
+    // What stands for an index in the hash of a record that refers to it.
+    // Simple types, and indices of records that haven't been seen, which
+    // only a malformed stream has, stand for themselves.
+    uint64_t Resolve(uint32_t index) const
+    {
+        if (index >= firstIndex && index - firstIndex < hashes.size())
+            return hashes[index - firstIndex];
+        return index;
+    }
+
+    uint32_t firstIndex;
+    std::vector<uint64_t> hashes;
+};
+
+// Records refer only to records before them, and IPI records to TPI ones, so
+// one pass over TPI and then IPI knows the hash of everything a record
+// refers to. types is the TPI hashes, which are *pHashes for the TPI itself.
+void WalkTypeRecords(const MsfFile& msf, uint32_t stream, const TpiHeader& header, const RecordHashes& types,
+                     RecordHashes* pHashes, TypeStreamStats* pStats, HeavyHitters* pFamilies,
+                     HeavyHitters* pDuplicates)
+{
+    TypeRecordReader reader(msf, stream, header);
+    pHashes->firstIndex = header.typeIndexBegin;
+    pHashes->hashes.clear();
+    std::vector<TypeIndexRef> refs;
+    std::vector<uint8_t> hashed;
+    uint16_t kind;
+    const uint8_t* data;
+    uint32_t size;
+    while (reader.Next(&kind, &data, &size))
+    {
+        uint32_t bytes = size + 4;
+        ++pStats->records;
+        pStats->bytes += bytes;
+        ++pStats->leaves[kind].count;
+        pStats->leaves[kind].bytes += bytes;
+
+        const char* name = "";
+        size_t nameLength = 0;
+        if (RecordName(kind, data, size, &name, &nameLength))
+        {
+            const void* angle = memchr(name, '<', nameLength);
+            if (angle && angle != name)
+                pFamilies->Add(name, static_cast<const char*>(angle) - name, bytes);
+        }
+
+        // The kind seeds the hash, and the length is implied, so the records
+        // of a group are all one kind and size.
+        FindTypeIndices(kind, data, size, &refs);
+        hashed.clear();
+        uint32_t copied = 0;
+        for (size_t i = 0; i < refs.size(); ++i)
+        {
+            const RecordHashes& target = refs[i].isItem ? *pHashes : types;
+            uint64_t referenced = target.Resolve(LoadU32(data + refs[i].offset));
+            hashed.insert(hashed.end(), data + copied, data + refs[i].offset);
+            hashed.insert(hashed.end(), reinterpret_cast<const uint8_t*>(&referenced),
+                          reinterpret_cast<const uint8_t*>(&referenced) + sizeof(referenced));
+            copied = refs[i].offset + 4;
+        }
+        hashed.insert(hashed.end(), data + copied, data + size);
+        uint64_t hash = XxHash64(hashed.data(), hashed.size(), kind);
+        pHashes->hashes.push_back(hash);
+        const char* kindName = LeafKindName(kind);
+        pDuplicates->Add(hash, kindName ? kindName : "unknown leaf", name, nameLength, bytes);
+    }
+    if (reader.Truncated())
+        pStats->truncated = true;
+}
+
+void PrintTypeStreamStats(const char* label, const TypeStreamStats& stats)
+{
+    printf("\n%s: %llu records, %.1f MB%s\n", label, static_cast<unsigned long long>(stats.records),
+           stats.bytes / 1e6, stats.truncated ? " (stream is truncated or corrupt)" : "");
+    if (stats.records == 0)
+        return;
+    std::vector<uint32_t> kinds;
+    for (uint32_t kind = 0; kind < stats.leaves.size(); ++kind)
+    {
+        if (stats.leaves[kind].count)
+            kinds.push_back(kind);
+    }
+    std::sort(kinds.begin(), kinds.end(), [&stats](uint32_t lhs, uint32_t rhs)
+    {
+        return stats.leaves[lhs].bytes > stats.leaves[rhs].bytes;
+    });
+    printf("  %-22s %10s %12s %6s %8s\n", "leaf", "records", "bytes", "%", "average");
+    for (size_t i = 0; i < kinds.size(); ++i)
+    {
+        const LeafStats& leaf = stats.leaves[kinds[i]];
+        const char* name = LeafKindName(static_cast<uint16_t>(kinds[i]));
+        char unknown[16];
+        if (!name)
+        {
+            sprintf(unknown, "0x%04X", kinds[i]);
+            name = unknown;
+        }
+        printf("  %-22s %10llu %12llu %5.1f%% %8.1f\n", name, static_cast<unsigned long long>(leaf.count),
+               static_cast<unsigned long long>(leaf.bytes), 100.0 * leaf.bytes / stats.bytes,
+               static_cast<double>(leaf.bytes) / leaf.count);
+    }
+}
+
+void PrintHeavyHitters(const char* title, const HeavyHitters& summary, size_t top, uint64_t minCount)
+{
+    std::vector<const HeavyHitters::Entry*> entries = summary.Top(top, minCount);
+    printf("\n%s\n", title);
+    if (summary.Floor())
+        printf("  (summary was pruned; counts may be low by up to %llu)\n",
+               static_cast<unsigned long long>(summary.Floor()));
+    if (entries.empty())
+    {
+        printf("  none\n");
+        return;
+    }
+    printf("  %10s %12s  %s\n", "records", "bytes", "name");
+    for (size_t i = 0; i < entries.size(); ++i)
+        printf("  %10llu %12llu  %s\n", static_cast<unsigned long long>(entries[i]->count),
+               static_cast<unsigned long long>(entries[i]->bytes), entries[i]->label.c_str());
+}
+
+// Groups of records that are the same apart from their type indices, by
+// the bytes that all but one of each group waste.
+void PrintDuplicates(const HeavyHitters& duplicates, size_t top)
+{
+    std::vector<const HeavyHitters::Entry*> entries = duplicates.Top(static_cast<size_t>(-1), 2);
+    auto wasted = [](const HeavyHitters::Entry* entry)
+    {
+        return entry->bytes - entry->bytes / entry->count;
+    };
+    uint64_t totalWasted = 0;
+    for (size_t i = 0; i < entries.size(); ++i)
+        totalWasted += wasted(entries[i]);
+    std::stable_sort(entries.begin(), entries.end(), [&wasted](const HeavyHitters::Entry* lhs,
+                                                              const HeavyHitters::Entry* rhs)
+    {
+        return wasted(lhs) > wasted(rhs);
+    });
+
+    printf("\nDuplicate records, the same down to everything they refer to:\n");
+    if (duplicates.Floor())
+        printf("  (summary was pruned; counts may be low by up to %llu)\n",
+               static_cast<unsigned long long>(duplicates.Floor()));
+    if (entries.empty())
+    {
+        printf("  none\n");
+        return;
+    }
+    printf("  %u groups waste %llu bytes.\n", static_cast<unsigned>(entries.size()),
+           static_cast<unsigned long long>(totalWasted));
+    printf("  %10s %12s %12s  %s\n", "records", "bytes", "wasted", "first record");
+    for (size_t i = 0; i < entries.size() && i < top; ++i)
+        printf("  %10llu %12llu %12llu  %s\n", static_cast<unsigned long long>(entries[i]->count),
+               static_cast<unsigned long long>(entries[i]->bytes), static_cast<unsigned long long>(wasted(entries[i])),
+               entries[i]->label.c_str());
+}
+
+void PrintBloatUsage()
+{
+    printf("Reports where the space in a pdb goes.\n\n");
+    printf("usage: pdbinfo -bloat [-top count] <pdb>\n");
+    printf("  -top   How many streams, families and names to list. Defaults to 20.\n");
+}
+
+}  // namespace
+
+int BloatMain(int argc, char* argv[])
+{
+    size_t top = 20;
+    const char* pdbPath = nullptr;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-top") == 0 && i + 1 < argc)
+            top = static_cast<size_t>(atoi(argv[++i]));
+        else if (argv[i][0] == '-' || pdbPath)
+        {
+            PrintBloatUsage();
+            return 1;
+        }
+        else
+            pdbPath = argv[i];
+    }
+    if (!pdbPath || top == 0)
+    {
+        PrintBloatUsage();
+        return 1;
+    }
+
+    MappedFile file;
+    if (!file.Open(pdbPath))
+    {
+        printf("Could not open %s: %s.\n", pdbPath, file.Error());
+        return 1;
+    }
+    MsfFile msf;
+    if (!msf.Open(file.Data(), file.Size()))
+    {
+        printf("%s is not a valid PDB file: %s.\n", pdbPath, msf.Error());
+        return 1;
+    }
+
+    // Stream sizes, and the space lost to rounding up to whole blocks.
+    std::vector<std::string> names;
+    NamePdbStreams(msf, &names);
+    std::vector<uint32_t> order;
+    uint64_t streamBytes = 0;
+    uint64_t slackBytes = 0;
+    for (uint32_t stream = 0; stream < msf.StreamCount(); ++stream)
+    {
+        if (!msf.StreamExists(stream))
+            continue;
+        order.push_back(stream);
+        streamBytes += msf.StreamSize(stream);
+        slackBytes += static_cast<uint64_t>(msf.StreamBlockCount(stream)) * msf.BlockSize() - msf.StreamSize(stream);
+    }
+    std::sort(order.begin(), order.end(), [&msf](uint32_t lhs, uint32_t rhs)
+    {
+        return msf.StreamSize(lhs) > msf.StreamSize(rhs);
+    });
+    uint32_t freeBlocks = 0;
+    for (uint32_t block = 0; block < msf.BlockCount(); ++block)
+        freeBlocks += msf.IsBlockFree(block) ? 1 : 0;
+
+    printf("%s: %.1f MB, %u blocks of %u bytes, %u streams.\n", pdbPath, file.Size() / 1e6,
+           msf.BlockCount(), msf.BlockSize(), msf.StreamCount());
+    printf("  %.1f MB of stream data, %.1f MB of block padding, %u free blocks (%.1f MB).\n",
+           streamBytes / 1e6, slackBytes / 1e6, freeBlocks,
+           static_cast<double>(freeBlocks) * msf.BlockSize() / 1e6);
+    printf("\n  %6s %12s %6s  %s\n", "stream", "bytes", "%", "name");
+    for (size_t i = 0; i < order.size() && i < top; ++i)
+    {
+        uint32_t stream = order[i];
+        printf("  %6u %12u %5.1f%%  %s\n", stream, msf.StreamSize(stream),
+               streamBytes ? 100.0 * msf.StreamSize(stream) / streamBytes : 0.0, names[stream].c_str());
+    }
+    if (order.size() > top)
+    {
+        uint64_t rest = 0;
+        for (size_t i = top; i < order.size(); ++i)
+            rest += msf.StreamSize(order[i]);
+        printf("  %llu more streams, %llu bytes.\n", static_cast<unsigned long long>(order.size() - top),
+               static_cast<unsigned long long>(rest));
+    }
+
+    // One pass over each type stream feeds all of the summaries.
+    const size_t kSummaryCapacity = 1 << 16;
+    HeavyHitters families(kSummaryCapacity);
+    // Most records are unique, so duplicates need a bigger table to be
+    // seen before their first copy is pruned.
+    HeavyHitters duplicates(kSummaryCapacity * 4);
+    const uint32_t typeStreams[] = { kMsfStreamTpi, kMsfStreamIpi };
+    const char* const typeStreamNames[] = { "TPI", "IPI" };
+    RecordHashes hashes[2];
+    for (size_t i = 0; i < 2; ++i)
+    {
+        TpiHeader header;
+        TypeStreamStats stats;
+        if (!ReadTpiHeader(msf, typeStreams[i], &header))
+        {
+            printf("\n%s: missing or malformed.\n", typeStreamNames[i]);
+            continue;
+        }
+        WalkTypeRecords(msf, typeStreams[i], header, hashes[0], &hashes[i], &stats, &families, &duplicates);
+        PrintTypeStreamStats(typeStreamNames[i], stats);
+    }
+    PrintHeavyHitters("Template families with the most records:", families, top, 1);
+    PrintDuplicates(duplicates, top);
+
+    return 0;
+}
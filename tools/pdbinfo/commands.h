@@ -0,0 +1,33 @@
+// Copyright 2013 Cygnus Software
+// Entry points for pdbinfo's sub-commands. Each one receives the arguments
+// that follow the command switch.
+//
+
+#pragma once
+
+// pdbinfo -r [-json] [-j threads] <dir|pdb>...
+int ScanMain(int argc, char* argv[]);
+
+// pdbinfo -index <indexfile> [-j threads] <dir|pdb>...
+int IndexMain(int argc, char* argv[]);
+
+// pdbinfo -lookup <indexfile> <guid> <age>
+int LookupMain(int argc, char* argv[]);
+
+// pdbinfo -match [-j threads] -bin <dir|binary>... [-pdb <dir|pdb>...] [-index <indexfile>...]
+int MatchMain(int argc, char* argv[]);
+
+// pdbinfo -ingest <store> [-j threads] [-hardlink] <dir|pdb>...
+int IngestMain(int argc, char* argv[]);
+
+// pdbinfo -symbolize [-cache <dir>] <pdb> [rva...]
+int SymbolizeMain(int argc, char* argv[]);
+
+// pdbinfo -bloat [-top count] <pdb>
+int BloatMain(int argc, char* argv[]);
+
+// pdbinfo -diff [-top count] [-j threads] <pdb> <pdb>
+int DiffMain(int argc, char* argv[]);
+
+// pdbinfo -repack [-block bytes] <in.pdb> <out.pdb>
+int RepackMain(int argc, char* argv[]);
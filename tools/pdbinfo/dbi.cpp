@@ -0,0 +1,257 @@
+// Copyright 2013 Cygnus Software
+
+#include "dbi.h"
+
+#include <string.h>
+#include "msf.h"
+#include "pdb.h"
+
+// Section contribution substream versions.
+const uint32_t kDbiSectionContribVer60 = 0xeffe0000 + 19970605;
+const uint32_t kDbiSectionContribV2 = 0xeffe0000 + 20140516;
+
+// Fixed part of a module info record, before the two names.
+const uint32_t kDbiModuleInfoFixedSize = 64;
+
+const uint32_t kIMAGE_SIZEOF_SECTION_HEADER = 40;
+
+DbiStream::DbiStream()
+    : error_(nullptr)
+    , moduleInfoOffset_(0)
+    , sectionContributionOffset_(0)
+    , optionalDebugHeaderOffset_(0)
+{
+    memset(&header_, 0, sizeof(header_));
+}
+
+bool ReadDbiAge(const MsfFile& msf, uint32_t* pAge)
+{
+    // The same header that DbiStream::Open decodes: the version signature,
+    // the version and then the age.
+    uint8_t header[12];
+    if (!msf.StreamExists(kMsfStreamDbi) || msf.StreamSize(kMsfStreamDbi) < kDbiHeaderSize ||
+        !msf.ReadStream(kMsfStreamDbi, 0, header, sizeof(header)) || LoadU32(header) != 0xFFFFFFFF)
+        return false;
+    *pAge = LoadU32(header + 8);
+    return true;
+}
+
+bool DbiStream::Open(const MsfFile& msf)
+{
+    if (!msf.StreamExists(kMsfStreamDbi) || msf.StreamSize(kMsfStreamDbi) < kDbiHeaderSize)
+    {
+        error_ = "missing or truncated DBI stream";
+        return false;
+    }
+    if (!msf.ReadStream(kMsfStreamDbi, &data_))
+    {
+        error_ = "DBI stream lists blocks outside the file";
+        return false;
+    }
+
+    const uint8_t* p = data_.data();
+    if (LoadU32(p) != 0xFFFFFFFF)
+    {
+        error_ = "DBI stream is in the pre-VC41 format";
+        return false;
+    }
+    header_.version = LoadU32(p + 4);
+    header_.age = LoadU32(p + 8);
+    header_.globalStream = LoadU16(p + 12);
+    header_.buildNumber = LoadU16(p + 14);
+    header_.publicStream = LoadU16(p + 16);
+    header_.pdbDllVersion = LoadU16(p + 18);
+    header_.symRecordStream = LoadU16(p + 20);
+    header_.pdbDllRebuild = LoadU16(p + 22);
+    header_.moduleInfoSize = LoadU32(p + 24);
+    header_.sectionContributionSize = LoadU32(p + 28);
+    header_.sectionMapSize = LoadU32(p + 32);
+    header_.sourceInfoSize = LoadU32(p + 36);
+    header_.typeServerMapSize = LoadU32(p + 40);
+    header_.mfcTypeServerIndex = LoadU32(p + 44);
+    header_.optionalDebugHeaderSize = LoadU32(p + 48);
+    header_.ecSubstreamSize = LoadU32(p + 52);
+    header_.flags = LoadU16(p + 56);
+    header_.machine = LoadU16(p + 58);
+
+    // The substreams follow the header back to back. Add the sizes up in 64
+    // bits so that garbage sizes can't wrap around.
+    const uint32_t sizes[] =
+    {
+        header_.moduleInfoSize, header_.sectionContributionSize, header_.sectionMapSize,
+        header_.sourceInfoSize, header_.typeServerMapSize, header_.ecSubstreamSize,
+        header_.optionalDebugHeaderSize,
+    };
+    uint64_t total = kDbiHeaderSize;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+        total += sizes[i];
+    if (total > data_.size())
+    {
+        error_ = "DBI substream sizes exceed the stream size";
+        return false;
+    }
+    moduleInfoOffset_ = kDbiHeaderSize;
+    sectionContributionOffset_ = moduleInfoOffset_ + header_.moduleInfoSize;
+    optionalDebugHeaderOffset_ = static_cast<uint32_t>(total - header_.optionalDebugHeaderSize);
+    return true;
+}
+
+bool DbiStream::ReadModules(std::vector<DbiModule>* pModules) const
+{
+    pModules->clear();
+    const uint8_t* p = data_.data() + moduleInfoOffset_;
+    const uint8_t* end = p + header_.moduleInfoSize;
+    while (p < end)
+    {
+        if (static_cast<size_t>(end - p) < kDbiModuleInfoFixedSize)
+            return false;
+        DbiModule module;
+        module.symStream = LoadU16(p + 34);
+        module.symBytes = LoadU32(p + 36);
+        module.c11Bytes = LoadU32(p + 40);
+        module.c13Bytes = LoadU32(p + 44);
+        module.sourceFileCount = LoadU16(p + 48);
+
+        // Two null terminated names follow, then padding to a multiple of 4.
+        const char* name = reinterpret_cast<const char*>(p + kDbiModuleInfoFixedSize);
+        const char* nameEnd = static_cast<const char*>(memchr(name, 0, end - p - kDbiModuleInfoFixedSize));
+        if (!nameEnd)
+            return false;
+        const char* obj = nameEnd + 1;
+        const char* objEnd = static_cast<const char*>(memchr(obj, 0, reinterpret_cast<const char*>(end) - obj));
+        if (!objEnd)
+            return false;
+        module.moduleName.assign(name, nameEnd);
+        module.objFileName.assign(obj, objEnd);
+        pModules->push_back(module);
+
+        size_t recordSize = reinterpret_cast<const uint8_t*>(objEnd + 1) - p;
+        recordSize = (recordSize + 3) & ~static_cast<size_t>(3);
+        if (recordSize > static_cast<size_t>(end - p))
+            break;
+        p += recordSize;
+    }
+    return true;
+}
+
+bool DbiStream::ReadSectionContributions(std::vector<DbiSectionContribution>* pContributions) const
+{
+    pContributions->clear();
+    uint32_t size = header_.sectionContributionSize;
+    if (size == 0)
+        return true;
+    if (size < 4)
+        return false;
+    const uint8_t* p = data_.data() + sectionContributionOffset_;
+    uint32_t version = LoadU32(p);
+    uint32_t entrySize;
+    if (version == kDbiSectionContribVer60)
+        entrySize = 28;
+    else if (version == kDbiSectionContribV2)
+        entrySize = 32;
+    else
+        return false;
+
+    uint32_t count = (size - 4) / entrySize;
+    pContributions->resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const uint8_t* e = p + 4 + i * entrySize;
+        DbiSectionContribution& c = (*pContributions)[i];
+        c.section = LoadU16(e);
+        c.offset = LoadU32(e + 4);
+        c.size = LoadU32(e + 8);
+        c.characteristics = LoadU32(e + 12);
+        c.module = LoadU16(e + 16);
+        c.dataCrc = LoadU32(e + 20);
+        c.relocCrc = LoadU32(e + 24);
+    }
+    return true;
+}
+
+uint16_t DbiStream::DebugStream(uint32_t index) const
+{
+    if ((index + 1) * 2 > header_.optionalDebugHeaderSize)
+        return kDbiNoStream;
+    return LoadU16(data_.data() + optionalDebugHeaderOffset_ + index * 2);
+}
+
+bool DbiStream::ReadSectionHeaders(const MsfFile& msf, std::vector<DbiSectionHeader>* pSections) const
+{
+    pSections->clear();
+    uint16_t stream = DebugStream(kDbiDebugSectionHeader);
+    if (stream == kDbiNoStream || !msf.StreamExists(stream))
+        return false;
+    std::vector<uint8_t> raw;
+    if (!msf.ReadStream(stream, &raw))
+        return false;
+    size_t count = raw.size() / kIMAGE_SIZEOF_SECTION_HEADER;
+    pSections->resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint8_t* s = raw.data() + i * kIMAGE_SIZEOF_SECTION_HEADER;
+        DbiSectionHeader& section = (*pSections)[i];
+        memcpy(section.name, s, 8);
+        section.name[8] = 0;
+        section.virtualSize = LoadU32(s + 8);
+        section.virtualAddress = LoadU32(s + 12);
+        section.rawDataSize = LoadU32(s + 16);
+        section.rawDataPointer = LoadU32(s + 20);
+        section.characteristics = LoadU32(s + 36);
+    }
+    return true;
+}
+
+static const char* const kDebugStreamNames[] =
+{
+    "FPO data", "exception data", "fixup data", "OMAP to source", "OMAP from source",
+    "section headers", "token/RID map", "xdata", "pdata", "new FPO data", "original section headers",
+};
+
+void NamePdbStreams(const MsfFile& msf, std::vector<std::string>* pNames)
+{
+    std::vector<std::string>& names = *pNames;
+    names.assign(msf.StreamCount(), std::string());
+    const char* const fixedNames[] = { "old directory", "PDB info", "TPI", "DBI", "IPI" };
+    for (uint32_t i = 0; i < 5 && i < names.size(); ++i)
+        names[i] = fixedNames[i];
+    auto setName = [&names](uint32_t stream, const std::string& name)
+    {
+        if (stream < names.size() && stream != kDbiNoStream)
+            names[stream] = name;
+    };
+
+    TpiHeader tpi;
+    if (ReadTpiHeader(msf, kMsfStreamTpi, &tpi))
+    {
+        setName(tpi.hashStream, "TPI hash");
+        setName(tpi.hashAuxStream, "TPI hash aux");
+    }
+    if (ReadTpiHeader(msf, kMsfStreamIpi, &tpi))
+    {
+        setName(tpi.hashStream, "IPI hash");
+        setName(tpi.hashAuxStream, "IPI hash aux");
+    }
+
+    std::vector<PdbNamedStream> named;
+    if (ReadNamedStreams(msf, &named))
+    {
+        for (size_t i = 0; i < named.size(); ++i)
+            setName(named[i].stream, named[i].name);
+    }
+
+    DbiStream dbi;
+    if (!dbi.Open(msf))
+        return;
+    setName(dbi.Header().globalStream, "globals");
+    setName(dbi.Header().publicStream, "publics");
+    setName(dbi.Header().symRecordStream, "symbol records");
+    for (uint32_t i = 0; i < sizeof(kDebugStreamNames) / sizeof(kDebugStreamNames[0]); ++i)
+        setName(dbi.DebugStream(i), kDebugStreamNames[i]);
+    std::vector<DbiModule> modules;
+    if (dbi.ReadModules(&modules))
+    {
+        for (size_t i = 0; i < modules.size(); ++i)
+            setName(modules[i].symStream, "module " + modules[i].moduleName);
+    }
+}
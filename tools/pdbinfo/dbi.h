@@ -0,0 +1,139 @@
+// Copyright 2013 Cygnus Software
+// Reader for the DBI (debug information) stream, stream 3 of a PDB. The DBI
+// stream is a fixed header followed by a sequence of substreams: module info,
+// section contributions, the section map, source file info, the type server
+// map, the EC names and finally the optional debug header, which is an array
+// of stream numbers for things like the original section headers.
+//
+// The DBI stream is small compared to the symbol and type streams (a few MB
+// even for very large binaries) so it is copied out of the MSF in one go and
+// the substreams are decoded on demand.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class MsfFile;
+
+// Size of the fixed header at the start of the DBI stream.
+const uint32_t kDbiHeaderSize = 64;
+
+// Stream numbers of 0xFFFF mean "no such stream" in the DBI header and the
+// optional debug header.
+const uint16_t kDbiNoStream = 0xFFFF;
+
+// Indices into the optional debug header.
+const uint32_t kDbiDebugFpo = 0;
+const uint32_t kDbiDebugException = 1;
+const uint32_t kDbiDebugFixup = 2;
+const uint32_t kDbiDebugOmapToSrc = 3;
+const uint32_t kDbiDebugOmapFromSrc = 4;
+const uint32_t kDbiDebugSectionHeader = 5;
+const uint32_t kDbiDebugTokenRidMap = 6;
+const uint32_t kDbiDebugXdata = 7;
+const uint32_t kDbiDebugPdata = 8;
+const uint32_t kDbiDebugNewFpo = 9;
+const uint32_t kDbiDebugSectionHeaderOrig = 10;
+
+struct DbiHeader
+{
+    uint32_t version;
+    uint32_t age;
+    uint16_t globalStream;
+    uint16_t buildNumber;
+    uint16_t publicStream;
+    uint16_t pdbDllVersion;
+    uint16_t symRecordStream;
+    uint16_t pdbDllRebuild;
+    uint32_t moduleInfoSize;
+    uint32_t sectionContributionSize;
+    uint32_t sectionMapSize;
+    uint32_t sourceInfoSize;
+    uint32_t typeServerMapSize;
+    uint32_t mfcTypeServerIndex;
+    uint32_t optionalDebugHeaderSize;
+    uint32_t ecSubstreamSize;
+    uint16_t flags;
+    uint16_t machine;
+};
+
+struct DbiModule
+{
+    std::string moduleName;
+    std::string objFileName;
+    uint16_t symStream;
+    uint32_t symBytes;
+    uint32_t c11Bytes;
+    uint32_t c13Bytes;
+    uint16_t sourceFileCount;
+};
+
+struct DbiSectionContribution
+{
+    uint16_t section;  // One based.
+    uint32_t offset;
+    uint32_t size;
+    uint32_t characteristics;
+    uint16_t module;
+    uint32_t dataCrc;
+    uint32_t relocCrc;
+};
+
+// IMAGE_SECTION_HEADER, as stored in the section header debug stream.
+struct DbiSectionHeader
+{
+    char name[9];
+    uint32_t virtualSize;
+    uint32_t virtualAddress;
+    uint32_t rawDataSize;
+    uint32_t rawDataPointer;
+    uint32_t characteristics;
+};
+
+// Read just the age from the DBI header, without copying the stream out.
+// Returns false if there is no DBI stream or it is in the pre-VC41 format.
+bool ReadDbiAge(const MsfFile& msf, uint32_t* pAge);
+
+class DbiStream
+{
+public:
+    DbiStream();
+
+    // Copy the DBI stream out of the MSF and check that the substream sizes
+    // in the header add up. Returns false and sets Error() on failure.
+    bool Open(const MsfFile& msf);
+
+    const char* Error() const { return error_; }
+    const DbiHeader& Header() const { return header_; }
+    const std::vector<uint8_t>& Data() const { return data_; }
+
+    // Decode the module info substream, in module index order.
+    bool ReadModules(std::vector<DbiModule>* pModules) const;
+    // Decode the section contribution substream. Both the original and the V2
+    // (with COFF section index) layouts are understood.
+    bool ReadSectionContributions(std::vector<DbiSectionContribution>* pContributions) const;
+    // Stream number for an entry of the optional debug header, or kDbiNoStream.
+    uint16_t DebugStream(uint32_t index) const;
+    // Read the section headers that the debug header points at. These map
+    // section numbers to RVAs.
+    bool ReadSectionHeaders(const MsfFile& msf, std::vector<DbiSectionHeader>* pSections) const;
+
+private:
+    std::vector<uint8_t> data_;
+    DbiHeader header_;
+    const char* error_;
+
+    // Offsets of the substreams within data_.
+    uint32_t moduleInfoOffset_;
+    uint32_t sectionContributionOffset_;
+    uint32_t optionalDebugHeaderOffset_;
+};
+
+// Describe every stream that something in the PDB points at: the fixed
+// streams, the TPI and IPI hash streams, the named streams, the streams the
+// DBI header and debug header list, and each module's symbol stream. Streams
+// that nothing points at get an empty name.
+void NamePdbStreams(const MsfFile& msf, std::vector<std::string>* pNames);
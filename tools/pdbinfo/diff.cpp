@@ -0,0 +1,578 @@
+// Copyright 2013 Cygnus Software
+// Determinism checking: pdbinfo -diff compares two PDBs stream by stream.
+// cmp can only say that two PDBs differ, which they nearly always do, even
+// when the debug information is the same. The linker places blocks wherever
+// its allocator finds room and every link writes a new GUID, age and
+// timestamp. This reports which streams differ and how:
+//   PDB info   Version, timestamp, age, GUID and the named stream map.
+//   DBI        Header fields, and the module list: modules added, removed
+//              or reordered.
+//   Streams    Every stream whose contents differ, with its size in each
+//              file, how many 4 KB pages differ and the first differing
+//              byte. Stream 0, the old directory, is left out: link.exe
+//              keeps a copy of an earlier stream directory there, which
+//              lists block numbers and so differs whenever the layout does.
+//              Only its size is shown, as layout metadata.
+// and ends with a verdict: byte identical, same streams with a different
+// block layout, differing only in the PDB identity, or differing streams.
+//
+// Streams are hashed in 4 KB pages of stream data with XXH64, so the result
+// doesn't depend on the block size or where the blocks are. The pages of both
+// files are hashed on a thread pool in runs of a few MB, which keeps all the
+// cores busy on a 2 GB PDB whose size is mostly in a handful of streams.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+#include "commands.h"
+#include "dbi.h"
+#include "hash.h"
+#include "mappedfile.h"
+#include "msf.h"
+#include "pdb.h"
+#include "platform.h"
+#include "threadpool.h"
+
+namespace
+{
+
+const uint32_t kPageBytes = 4096;
+// Pages hashed per task. Small streams are batched up to this size too.
+const uint32_t kPagesPerTask = 1024;
+
+struct PdbSide
+{
+    const char* path;
+    MappedFile file;
+    MsfFile msf;
+    std::vector<std::string> names;
+    // Hashes of every stream's pages, stream after stream. The pages of a
+    // stream start at firstPage[stream].
+    std::vector<uint64_t> pageHashes;
+    std::vector<size_t> firstPage;
+    std::vector<uint64_t> streamHashes;
+    std::atomic<bool> readFailed;
+
+    PdbSide() : path(nullptr), readFailed(false) {}
+
+    uint32_t PageCount(uint32_t stream) const
+    {
+        return static_cast<uint32_t>(firstPage[stream + 1] - firstPage[stream]);
+    }
+    const uint64_t* Pages(uint32_t stream) const { return pageHashes.data() + firstPage[stream]; }
+    std::string Name(uint32_t stream) const
+    {
+        return stream < names.size() ? names[stream] : std::string();
+    }
+};
+
+struct PageRun
+{
+    PdbSide* side;
+    uint32_t stream;
+    uint32_t begin;
+    uint32_t end;
+};
+
+bool OpenSide(const char* path, PdbSide* pSide)
+{
+    pSide->path = path;
+    if (!pSide->file.Open(path))
+    {
+        printf("Could not open %s: %s.\n", path, pSide->file.Error());
+        return false;
+    }
+    if (!pSide->msf.Open(pSide->file.Data(), pSide->file.Size()))
+    {
+        printf("%s is not a valid PDB file: %s.\n", path, pSide->msf.Error());
+        return false;
+    }
+    NamePdbStreams(pSide->msf, &pSide->names);
+
+    const MsfFile& msf = pSide->msf;
+    pSide->firstPage.resize(msf.StreamCount() + 1);
+    size_t pages = 0;
+    for (uint32_t stream = 0; stream < msf.StreamCount(); ++stream)
+    {
+        pSide->firstPage[stream] = pages;
+        pages += MsfBlocksForBytes(msf.StreamSize(stream), kPageBytes);
+    }
+    pSide->firstPage[msf.StreamCount()] = pages;
+    pSide->pageHashes.resize(pages);
+    pSide->streamHashes.resize(msf.StreamCount());
+    return true;
+}
+
+void HashRun(const PageRun& run)
+{
+    PdbSide& side = *run.side;
+    MsfStreamReader reader(side.msf, run.stream, run.begin * kPageBytes);
+    uint64_t* hashes = side.pageHashes.data() + side.firstPage[run.stream];
+    for (uint32_t page = run.begin; page < run.end; ++page)
+    {
+        uint32_t bytes = std::min(kPageBytes, reader.Remaining());
+        const uint8_t* data = reader.Read(bytes);
+        if (!data)
+        {
+            side.readFailed = true;
+            return;
+        }
+        hashes[page] = XxHash64(data, bytes);
+    }
+}
+
+// Hash the pages of every stream of both files, then fold each stream's
+// page hashes into a stream hash.
+void HashStreams(PdbSide* sides[2], unsigned threads)
+{
+    std::vector<std::vector<PageRun>> batches(1);
+    uint32_t batchPages = 0;
+    for (int s = 0; s < 2; ++s)
+    {
+        PdbSide& side = *sides[s];
+        for (uint32_t stream = 0; stream < side.msf.StreamCount(); ++stream)
+        {
+            if (stream == kMsfStreamOldDirectory)
+                continue;
+            uint32_t pages = side.PageCount(stream);
+            for (uint32_t begin = 0; begin < pages; begin += kPagesPerTask)
+            {
+                PageRun run = { &side, stream, begin, std::min(pages, begin + kPagesPerTask) };
+                batches.back().push_back(run);
+                batchPages += run.end - run.begin;
+                if (batchPages >= kPagesPerTask)
+                {
+                    batches.push_back(std::vector<PageRun>());
+                    batchPages = 0;
+                }
+            }
+        }
+    }
+
+    {
+        WorkStealingPool pool(threads);
+        for (size_t i = 0; i < batches.size(); ++i)
+        {
+            const std::vector<PageRun>* batch = &batches[i];
+            pool.Submit([batch]()
+            {
+                for (size_t r = 0; r < batch->size(); ++r)
+                    HashRun((*batch)[r]);
+            });
+        }
+        pool.Wait();
+    }
+
+    for (int s = 0; s < 2; ++s)
+    {
+        PdbSide& side = *sides[s];
+        for (uint32_t stream = 0; stream < side.msf.StreamCount(); ++stream)
+            side.streamHashes[stream] = XxHash64(side.Pages(stream), side.PageCount(stream) * sizeof(uint64_t),
+                                                 side.msf.StreamSize(stream));
+    }
+}
+
+bool StreamsMatch(const PdbSide& a, const PdbSide& b, uint32_t stream)
+{
+    // The old directory is layout, not content, and isn't hashed.
+    if (stream == kMsfStreamOldDirectory)
+        return true;
+    bool inA = stream < a.msf.StreamCount();
+    bool inB = stream < b.msf.StreamCount();
+    if (!inA || !inB)
+        return false;
+    return a.msf.StreamExists(stream) == b.msf.StreamExists(stream) &&
+           a.msf.StreamSize(stream) == b.msf.StreamSize(stream) &&
+           a.streamHashes[stream] == b.streamHashes[stream];
+}
+
+// Compare the whole files, in parallel. Only worth doing once every stream
+// is known to match.
+bool FilesIdentical(const MappedFile& a, const MappedFile& b, unsigned threads)
+{
+    if (a.Size() != b.Size())
+        return false;
+    const size_t kChunk = 16 << 20;
+    std::atomic<bool> same(true);
+    WorkStealingPool pool(threads);
+    for (size_t offset = 0; offset < a.Size(); offset += kChunk)
+    {
+        size_t bytes = std::min(kChunk, a.Size() - offset);
+        pool.Submit([&a, &b, &same, offset, bytes]()
+        {
+            if (same && memcmp(a.Data() + offset, b.Data() + offset, bytes) != 0)
+                same = false;
+        });
+    }
+    pool.Wait();
+    return same;
+}
+
+// Offset of the first byte that differs between two streams, given the
+// index of the first page whose hash differs.
+uint32_t FirstDifference(const PdbSide& a, const PdbSide& b, uint32_t stream, uint32_t page)
+{
+    MsfStreamReader readerA(a.msf, stream, page * kPageBytes);
+    MsfStreamReader readerB(b.msf, stream, page * kPageBytes);
+    uint32_t bytes = std::min(kPageBytes, std::min(readerA.Remaining(), readerB.Remaining()));
+    const uint8_t* pA = readerA.Read(bytes);
+    const uint8_t* pB = readerB.Read(bytes);
+    uint32_t i = 0;
+    if (pA && pB)
+    {
+        while (i < bytes && pA[i] == pB[i])
+            ++i;
+    }
+    return page * kPageBytes + i;
+}
+
+// Tracks whether the differences found so far are only in the fields that
+// identify a PDB, which change on every link.
+struct Verdict
+{
+    bool identityOnly;
+    Verdict() : identityOnly(true) {}
+};
+
+// Print a field if it differs. Identity fields don't clear identityOnly.
+void CompareField(const char* name, uint64_t a, uint64_t b, bool hex, bool identity, Verdict* pVerdict)
+{
+    if (a == b)
+        return;
+    if (hex)
+        printf("  %-22s %-18llX %llX\n", name, static_cast<unsigned long long>(a), static_cast<unsigned long long>(b));
+    else
+        printf("  %-22s %-18llu %llu\n", name, static_cast<unsigned long long>(a), static_cast<unsigned long long>(b));
+    if (!identity)
+        pVerdict->identityOnly = false;
+}
+
+// Copy a stream and blank out a byte range, for checking whether two
+// streams differ only in that range.
+bool ReadStreamWithout(const MsfFile& msf, uint32_t stream, uint32_t begin, uint32_t end, std::vector<uint8_t>* pData)
+{
+    if (!msf.ReadStream(stream, pData) || pData->size() < end)
+        return false;
+    memset(pData->data() + begin, 0, end - begin);
+    return true;
+}
+
+void CompareInfo(const PdbSide& a, const PdbSide& b, Verdict* pVerdict)
+{
+    printf("PDB info:\n");
+    PdbIdentity idA, idB;
+    if (!ReadPdbIdentity(a.msf, &idA) || !ReadPdbIdentity(b.msf, &idB))
+    {
+        printf("  missing or malformed.\n");
+        pVerdict->identityOnly = false;
+        return;
+    }
+    bool same = StreamsMatch(a, b, kMsfStreamPdbInfo);
+    CompareField("version", idA.version, idB.version, false, false, pVerdict);
+    CompareField("timestamp", idA.timeStamp, idB.timeStamp, true, true, pVerdict);
+    CompareField("age", idA.infoAge, idB.infoAge, false, true, pVerdict);
+    if (memcmp(&idA.guid, &idB.guid, sizeof(idA.guid)) != 0)
+    {
+        char guidA[kGuidStringSize], guidB[kGuidStringSize];
+        FormatGuid(idA.guid, guidA);
+        FormatGuid(idB.guid, guidB);
+        printf("  %-22s %s\n  %-22s %s\n", "GUID", guidA, "", guidB);
+    }
+
+    std::vector<PdbNamedStream> namedA, namedB;
+    ReadNamedStreams(a.msf, &namedA);
+    ReadNamedStreams(b.msf, &namedB);
+    std::map<std::string, uint32_t> mapB;
+    for (size_t i = 0; i < namedB.size(); ++i)
+        mapB[namedB[i].name] = namedB[i].stream;
+    for (size_t i = 0; i < namedA.size(); ++i)
+    {
+        auto found = mapB.find(namedA[i].name);
+        if (found == mapB.end())
+            printf("  named stream %s only in the first file.\n", namedA[i].name.c_str());
+        else
+        {
+            if (found->second != namedA[i].stream)
+                printf("  named stream %s is stream %u, then %u.\n", namedA[i].name.c_str(), namedA[i].stream,
+                       found->second);
+            mapB.erase(found);
+        }
+    }
+    for (auto i = mapB.begin(); i != mapB.end(); ++i)
+        printf("  named stream %s only in the second file.\n", i->first.c_str());
+
+    if (same)
+    {
+        printf("  identical.\n");
+        return;
+    }
+    // The stream is the 28 byte header followed by the named stream map and
+    // feature codes. Bytes 4 to 28 are the timestamp, age and GUID.
+    std::vector<uint8_t> dataA, dataB;
+    if (!ReadStreamWithout(a.msf, kMsfStreamPdbInfo, 4, 28, &dataA) ||
+        !ReadStreamWithout(b.msf, kMsfStreamPdbInfo, 4, 28, &dataB) || dataA != dataB)
+    {
+        printf("  differs beyond the identity fields.\n");
+        pVerdict->identityOnly = false;
+    }
+}
+
+void CompareModules(const std::vector<DbiModule>& a, const std::vector<DbiModule>& b, Verdict* pVerdict)
+{
+    bool sameOrder = a.size() == b.size();
+    for (size_t i = 0; sameOrder && i < a.size(); ++i)
+        sameOrder = a[i].moduleName == b[i].moduleName && a[i].objFileName == b[i].objFileName;
+    if (sameOrder)
+        return;
+    pVerdict->identityOnly = false;
+    printf("  modules                %-18u %u\n", static_cast<unsigned>(a.size()), static_cast<unsigned>(b.size()));
+
+    // Module names repeat (every import library contributes several modules
+    // with the same name), so compare them as multisets.
+    std::vector<std::string> sortedA, sortedB;
+    for (size_t i = 0; i < a.size(); ++i)
+        sortedA.push_back(a[i].moduleName);
+    for (size_t i = 0; i < b.size(); ++i)
+        sortedB.push_back(b[i].moduleName);
+    std::sort(sortedA.begin(), sortedA.end());
+    std::sort(sortedB.begin(), sortedB.end());
+    std::vector<std::string> onlyA, onlyB;
+    std::set_difference(sortedA.begin(), sortedA.end(), sortedB.begin(), sortedB.end(), std::back_inserter(onlyA));
+    std::set_difference(sortedB.begin(), sortedB.end(), sortedA.begin(), sortedA.end(), std::back_inserter(onlyB));
+    const size_t kListed = 5;
+    for (size_t i = 0; i < onlyA.size() && i < kListed; ++i)
+        printf("  only in the first file:  %s\n", onlyA[i].c_str());
+    if (onlyA.size() > kListed)
+        printf("  and %u more only in the first file.\n", static_cast<unsigned>(onlyA.size() - kListed));
+    for (size_t i = 0; i < onlyB.size() && i < kListed; ++i)
+        printf("  only in the second file: %s\n", onlyB[i].c_str());
+    if (onlyB.size() > kListed)
+        printf("  and %u more only in the second file.\n", static_cast<unsigned>(onlyB.size() - kListed));
+
+    if (onlyA.empty() && onlyB.empty())
+    {
+        size_t i = 0;
+        while (i < a.size() && a[i].moduleName == b[i].moduleName)
+            ++i;
+        if (i < a.size())
+            printf("  same modules in a different order, from module %u: %s, then %s\n", static_cast<unsigned>(i),
+                   a[i].moduleName.c_str(), b[i].moduleName.c_str());
+        else
+            printf("  same modules in the same order, with different object files.\n");
+    }
+}
+
+void CompareDbi(const PdbSide& a, const PdbSide& b, Verdict* pVerdict)
+{
+    printf("\nDBI:\n");
+    DbiStream dbiA, dbiB;
+    if (!dbiA.Open(a.msf) || !dbiB.Open(b.msf))
+    {
+        printf("  missing or malformed.\n");
+        if (!StreamsMatch(a, b, kMsfStreamDbi))
+            pVerdict->identityOnly = false;
+        return;
+    }
+    if (StreamsMatch(a, b, kMsfStreamDbi))
+    {
+        printf("  identical.\n");
+        return;
+    }
+    const DbiHeader& hA = dbiA.Header();
+    const DbiHeader& hB = dbiB.Header();
+    CompareField("version", hA.version, hB.version, false, false, pVerdict);
+    CompareField("age", hA.age, hB.age, false, true, pVerdict);
+    CompareField("machine", hA.machine, hB.machine, true, false, pVerdict);
+    CompareField("flags", hA.flags, hB.flags, true, false, pVerdict);
+    CompareField("build number", hA.buildNumber, hB.buildNumber, true, false, pVerdict);
+    CompareField("pdb dll version", hA.pdbDllVersion, hB.pdbDllVersion, false, false, pVerdict);
+    CompareField("pdb dll rebuild", hA.pdbDllRebuild, hB.pdbDllRebuild, false, false, pVerdict);
+    CompareField("globals stream", hA.globalStream, hB.globalStream, false, false, pVerdict);
+    CompareField("publics stream", hA.publicStream, hB.publicStream, false, false, pVerdict);
+    CompareField("symbol records stream", hA.symRecordStream, hB.symRecordStream, false, false, pVerdict);
+    CompareField("module info bytes", hA.moduleInfoSize, hB.moduleInfoSize, false, false, pVerdict);
+    CompareField("contribution bytes", hA.sectionContributionSize, hB.sectionContributionSize, false, false,
+                 pVerdict);
+    CompareField("section map bytes", hA.sectionMapSize, hB.sectionMapSize, false, false, pVerdict);
+    CompareField("source info bytes", hA.sourceInfoSize, hB.sourceInfoSize, false, false, pVerdict);
+    CompareField("EC bytes", hA.ecSubstreamSize, hB.ecSubstreamSize, false, false, pVerdict);
+
+    std::vector<DbiModule> modulesA, modulesB;
+    if (dbiA.ReadModules(&modulesA) && dbiB.ReadModules(&modulesB))
+        CompareModules(modulesA, modulesB, pVerdict);
+    std::vector<DbiSectionContribution> contributionsA, contributionsB;
+    if (dbiA.ReadSectionContributions(&contributionsA) && dbiB.ReadSectionContributions(&contributionsB))
+        CompareField("contributions", contributionsA.size(), contributionsB.size(), false, false, pVerdict);
+
+    // The age at offset 8 is the only identity field in the DBI stream.
+    std::vector<uint8_t> dataA = dbiA.Data();
+    std::vector<uint8_t> dataB = dbiB.Data();
+    if (dataA.size() >= kDbiHeaderSize && dataB.size() >= kDbiHeaderSize)
+    {
+        memset(&dataA[8], 0, 4);
+        memset(&dataB[8], 0, 4);
+    }
+    if (dataA != dataB)
+    {
+        printf("  differs beyond the age.\n");
+        pVerdict->identityOnly = false;
+    }
+}
+
+void PrintDiffUsage()
+{
+    printf("Compares two pdbs stream by stream.\n\n");
+    printf("usage: pdbinfo -diff [-top count] [-j threads] <pdb> <pdb>\n");
+    printf("  -top count   How many differing streams to list. Defaults to 50.\n");
+    printf("  -j threads   Worker thread count. Defaults to the number of cores.\n");
+    printf("Exits with 0 if every stream matches, 1 if any differ and 2 on errors.\n");
+}
+
+}  // namespace
+
+int DiffMain(int argc, char* argv[])
+{
+    unsigned threads = HardwareThreadCount();
+    size_t top = 50;
+    std::vector<const char*> paths;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = static_cast<unsigned>(atoi(argv[++i]));
+        else if (strcmp(argv[i], "-top") == 0 && i + 1 < argc)
+            top = static_cast<size_t>(atoi(argv[++i]));
+        else if (argv[i][0] == '-')
+        {
+            PrintDiffUsage();
+            return 2;
+        }
+        else
+            paths.push_back(argv[i]);
+    }
+    if (paths.size() != 2 || threads == 0)
+    {
+        PrintDiffUsage();
+        return 2;
+    }
+
+    PdbSide a, b;
+    if (!OpenSide(paths[0], &a) || !OpenSide(paths[1], &b))
+        return 2;
+
+    auto start = std::chrono::steady_clock::now();
+    PdbSide* sides[2] = { &a, &b };
+    HashStreams(sides, threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t hashedBytes = 0;
+    for (int s = 0; s < 2; ++s)
+    {
+        for (uint32_t stream = kMsfStreamOldDirectory + 1; stream < sides[s]->msf.StreamCount(); ++stream)
+            hashedBytes += sides[s]->msf.StreamSize(stream);
+    }
+    fprintf(stderr, "Hashed %.1f MB of streams in %.3f s with %u threads (%.0f MB/s).\n", hashedBytes / 1e6,
+            seconds, threads, hashedBytes / 1e6 / (seconds > 0 ? seconds : 1e-9));
+    for (int s = 0; s < 2; ++s)
+    {
+        if (sides[s]->readFailed)
+        {
+            printf("%s has a stream with blocks outside the file.\n", sides[s]->path);
+            return 2;
+        }
+    }
+
+    for (int s = 0; s < 2; ++s)
+        printf("%s: %.1f MB, %u blocks of %u bytes, %u streams.\n", sides[s]->path, sides[s]->file.Size() / 1e6,
+               sides[s]->msf.BlockCount(), sides[s]->msf.BlockSize(), sides[s]->msf.StreamCount());
+    printf("\n");
+
+    Verdict verdict;
+    CompareInfo(a, b, &verdict);
+    CompareDbi(a, b, &verdict);
+
+    uint32_t streamCount = std::max(a.msf.StreamCount(), b.msf.StreamCount());
+    std::vector<uint32_t> differing;
+    for (uint32_t stream = kMsfStreamOldDirectory + 1; stream < streamCount; ++stream)
+    {
+        if (!StreamsMatch(a, b, stream))
+            differing.push_back(stream);
+    }
+
+    uint32_t compared = streamCount > kMsfStreamOldDirectory + 1 ? streamCount - 1 : 0;
+    printf("\nStreams: %u of %u differ.\n", static_cast<unsigned>(differing.size()), compared);
+    printf("  old directory (stream 0), not compared: %u and %u bytes.\n", a.msf.StreamSize(kMsfStreamOldDirectory),
+           b.msf.StreamSize(kMsfStreamOldDirectory));
+    if (!differing.empty())
+    {
+        printf("  %6s %12s %12s %12s %12s  %s\n", "stream", "bytes", "bytes", "pages differ", "first diff", "name");
+        for (size_t i = 0; i < differing.size() && i < top; ++i)
+        {
+            uint32_t stream = differing[i];
+            bool inA = stream < a.msf.StreamCount() && a.msf.StreamExists(stream);
+            bool inB = stream < b.msf.StreamCount() && b.msf.StreamExists(stream);
+            std::string name = a.Name(stream);
+            if (b.Name(stream) != name)
+                name = (name.empty() ? "-" : name) + " / " + (b.Name(stream).empty() ? "-" : b.Name(stream));
+            char sizeA[16] = "-", sizeB[16] = "-";
+            if (inA)
+                sprintf(sizeA, "%u", a.msf.StreamSize(stream));
+            if (inB)
+                sprintf(sizeB, "%u", b.msf.StreamSize(stream));
+            if (!inA || !inB)
+            {
+                printf("  %6u %12s %12s %12s %12s  %s\n", stream, sizeA, sizeB, "", "", name.c_str());
+                continue;
+            }
+            uint32_t pagesA = a.PageCount(stream);
+            uint32_t pagesB = b.PageCount(stream);
+            uint32_t common = std::min(pagesA, pagesB);
+            uint32_t differ = std::max(pagesA, pagesB) - common;
+            uint32_t firstPage = common;
+            for (uint32_t page = 0; page < common; ++page)
+            {
+                if (a.Pages(stream)[page] != b.Pages(stream)[page])
+                {
+                    firstPage = std::min(firstPage, page);
+                    ++differ;
+                }
+            }
+            char first[16] = "-";
+            if (firstPage < common)
+                sprintf(first, "0x%X", FirstDifference(a, b, stream, firstPage));
+            else
+                sprintf(first, "0x%X", std::min(a.msf.StreamSize(stream), b.msf.StreamSize(stream)));
+            printf("  %6u %12s %12s %12u %12s  %s\n", stream, sizeA, sizeB, differ, first, name.c_str());
+        }
+        if (differing.size() > top)
+            printf("  and %u more.\n", static_cast<unsigned>(differing.size() - top));
+    }
+
+    printf("\n");
+    if (differing.empty())
+    {
+        if (FilesIdentical(a.file, b.file, threads))
+            printf("The files are byte for byte identical.\n");
+        else
+            printf("Every stream matches; only the MSF layout (block placement, free blocks and the old "
+                   "directory) differs.\n");
+        return 0;
+    }
+    bool identityOnly = verdict.identityOnly;
+    for (size_t i = 0; i < differing.size(); ++i)
+    {
+        if (differing[i] != kMsfStreamPdbInfo && differing[i] != kMsfStreamDbi)
+            identityOnly = false;
+    }
+    if (identityOnly)
+        printf("The pdbs differ only in their identity (timestamp, GUID and age).\n");
+    else
+        printf("The pdbs differ in %u of %u streams.\n", static_cast<unsigned>(differing.size()), compared);
+    return 1;
+}
@@ -0,0 +1,130 @@
+// Copyright 2013 Cygnus Software
+// Small non-cryptographic hash functions shared by the index and analysis
+// code.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+inline uint64_t Fnv1a64(const void* data, size_t size, uint64_t hash = 0xCBF29CE484222325ULL)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= p[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// Finalizer from splitmix64. Spreads the bits of a value that may have
+// poor low bits, such as a GUID fragment, across the whole word.
+inline uint64_t Mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// XXH64, for hashing bulk data such as whole streams. It consumes 32 bytes
+// per step in four independent lanes, so the multiplies overlap and it runs
+// at several GB/s per core, where FNV manages about one byte per cycle.
+namespace xxh64_detail
+{
+const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t Rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t Read64(const uint8_t* p)
+{
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t Round(uint64_t acc, uint64_t input)
+{
+    acc += input * kPrime2;
+    acc = Rotl(acc, 31);
+    return acc * kPrime1;
+}
+
+inline uint64_t Merge(uint64_t acc, uint64_t value)
+{
+    acc ^= Round(0, value);
+    return acc * kPrime1 + kPrime4;
+}
+}  // namespace xxh64_detail
+
+inline uint64_t XxHash64(const void* data, size_t size, uint64_t seed = 0)
+{
+    using namespace xxh64_detail;
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const uint8_t* end = p + size;
+    uint64_t hash;
+    if (size >= 32)
+    {
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        const uint8_t* limit = end - 32;
+        do
+        {
+            v1 = Round(v1, Read64(p));
+            v2 = Round(v2, Read64(p + 8));
+            v3 = Round(v3, Read64(p + 16));
+            v4 = Round(v4, Read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        hash = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+        hash = Merge(hash, v1);
+        hash = Merge(hash, v2);
+        hash = Merge(hash, v3);
+        hash = Merge(hash, v4);
+    }
+    else
+    {
+        hash = seed + kPrime5;
+    }
+    hash += size;
+
+    for (; p + 8 <= end; p += 8)
+    {
+        hash ^= Round(0, Read64(p));
+        hash = Rotl(hash, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end)
+    {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        hash ^= value * kPrime1;
+        hash = Rotl(hash, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+    {
+        hash ^= *p * kPrime5;
+        hash = Rotl(hash, 11) * kPrime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
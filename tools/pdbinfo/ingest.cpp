@@ -0,0 +1,168 @@
+// Copyright 2013 Cygnus Software
+// Symbol store ingestion. Every PDB found is published at
+//   <store>/<name.pdb>/<GUID><age>/<name.pdb>
+// which is the layout that symstore.exe creates and that symbol servers and
+// debuggers look for. Files whose identity is already in the store, or that
+// appear twice in one run, are skipped without copying a byte. Everything
+// else is placed with the cheapest method the file system supports.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <unordered_set>
+#include "commands.h"
+#include "pdb.h"
+#include "pe.h"
+#include "place.h"
+#include "platform.h"
+#include "scan.h"
+#include "threadpool.h"
+
+static void PrintIngestUsage()
+{
+    printf("Publishes pdbs into a symstore style symbol store.\n\n");
+    printf("usage: pdbinfo -ingest <store> [-j threads] [-hardlink] <dir|pdb>...\n");
+    printf("  -hardlink  Allow hard links to the source files. Only use this when\n");
+    printf("             the sources will never be modified in place.\n");
+}
+
+static bool SameIdentity(const PdbIdentity& lhs, const PdbIdentity& rhs)
+{
+    return lhs.age == rhs.age && memcmp(&lhs.guid, &rhs.guid, sizeof(lhs.guid)) == 0;
+}
+
+int IngestMain(int argc, char* argv[])
+{
+    unsigned threads = HardwareThreadCount();
+    bool allowHardLink = false;
+    const char* store = nullptr;
+    std::vector<std::string> roots;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = static_cast<unsigned>(atoi(argv[++i]));
+        else if (strcmp(argv[i], "-hardlink") == 0)
+            allowHardLink = true;
+        else if (argv[i][0] == '-')
+        {
+            PrintIngestUsage();
+            return 1;
+        }
+        else if (!store)
+            store = argv[i];
+        else
+            roots.push_back(argv[i]);
+    }
+    if (!store || roots.empty() || threads == 0)
+    {
+        PrintIngestUsage();
+        return 1;
+    }
+    if (!MakeDirectories(store))
+    {
+        printf("Could not create store directory %s.\n", store);
+        return 1;
+    }
+
+    std::mutex claimLock;
+    std::unordered_set<std::string> claimed;
+    std::mutex outputLock;
+    std::atomic<uint64_t> placedCount[kPlaceMethodCount];
+    std::atomic<uint64_t> placedBytes[kPlaceMethodCount];
+    for (int i = 0; i < kPlaceMethodCount; ++i)
+    {
+        placedCount[i] = 0;
+        placedBytes[i] = 0;
+    }
+    std::atomic<uint64_t> presentCount(0);
+    std::atomic<uint64_t> presentBytes(0);
+    std::atomic<uint64_t> duplicateCount(0);
+    std::atomic<uint64_t> errorCount(0);
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        WorkStealingPool pool(threads);
+        WalkTree(pool, roots, std::vector<const char*>(1, ".pdb"), [&](const std::string& path)
+        {
+            PdbIdentity identity;
+            const char* error = nullptr;
+            FileStat st;
+            if (!GetFileStat(path, &st) || !ReadPdbIdentityFromFile(path, &identity, nullptr, &error))
+            {
+                ++errorCount;
+                std::lock_guard<std::mutex> guard(outputLock);
+                printf("%s: %s.\n", path.c_str(), error ? error : "could not stat file");
+                return;
+            }
+
+            std::string name = PathFileName(path);
+            char key[kSymbolStoreKeySize];
+            FormatSymbolStoreKey(identity.guid, identity.age, key);
+            std::string dest = JoinPath(JoinPath(JoinPath(store, name), key), name);
+
+            // The same PDB is often found in several output directories. Only
+            // the first thread to claim an identity does any work.
+            {
+                std::lock_guard<std::mutex> guard(claimLock);
+                if (!claimed.insert(dest).second)
+                {
+                    ++duplicateCount;
+                    return;
+                }
+            }
+
+            // Already published by an earlier run? Checking costs a stat and
+            // a few block reads of the stored copy.
+            FileStat destStat;
+            PdbIdentity destIdentity;
+            const char* destError = nullptr;
+            if (GetFileStat(dest, &destStat) && destStat.size == st.size &&
+                ReadPdbIdentityFromFile(dest, &destIdentity, nullptr, &destError) &&
+                SameIdentity(identity, destIdentity))
+            {
+                ++presentCount;
+                presentBytes += st.size;
+                return;
+            }
+
+            PlaceMethod method;
+            if (!PlaceFile(path, dest, allowHardLink, &method, &error))
+            {
+                ++errorCount;
+                std::lock_guard<std::mutex> guard(outputLock);
+                printf("%s: %s.\n", path.c_str(), error);
+                return;
+            }
+            ++placedCount[method];
+            placedBytes[method] += st.size;
+        });
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t totalPlaced = 0;
+    uint64_t totalBytes = 0;
+    for (int i = 0; i < kPlaceMethodCount; ++i)
+    {
+        totalPlaced += placedCount[i];
+        totalBytes += placedBytes[i];
+    }
+    printf("Ingested %llu pdbs (%.1f MB) into %s in %.3f s.\n",
+           static_cast<unsigned long long>(totalPlaced), totalBytes / 1e6, store, elapsed);
+    for (int i = 0; i < kPlaceMethodCount; ++i)
+    {
+        if (placedCount[i])
+            printf("  %-14s %8llu files %10.1f MB\n", PlaceMethodName(static_cast<PlaceMethod>(i)),
+                   static_cast<unsigned long long>(placedCount[i].load()), placedBytes[i] / 1e6);
+    }
+    printf("  Skipped %llu already in the store (%.1f MB) and %llu duplicates.\n",
+           static_cast<unsigned long long>(presentCount.load()), presentBytes / 1e6,
+           static_cast<unsigned long long>(duplicateCount.load()));
+    if (errorCount)
+        printf("  %llu errors.\n", static_cast<unsigned long long>(errorCount.load()));
+
+    return errorCount ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+// Copyright 2013 Cygnus Software
+
+#include "mappedfile.h"
+
+#include "platform.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : data_(nullptr)
+    , size_(0)
+    , error_("no file mapped")
+#ifdef _WIN32
+    , hFile_(INVALID_HANDLE_VALUE)
+    , hMapping_(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const char* path)
+{
+    Close();
+
+    HANDLE hFile = CreateFileW(WidePath(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        error_ = "could not open file";
+        return false;
+    }
+    hFile_ = hFile;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(hFile, &fileSize))
+    {
+        error_ = "could not get file size";
+        Close();
+        return false;
+    }
+    // Mapping a zero-length file fails, so treat it as an empty buffer.
+    if (fileSize.QuadPart == 0)
+    {
+        error_ = nullptr;
+        return true;
+    }
+    if (sizeof(size_t) < 8 && fileSize.HighPart != 0)
+    {
+        error_ = "file too large to map";
+        Close();
+        return false;
+    }
+
+    HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!hMapping)
+    {
+        error_ = "CreateFileMapping failed";
+        Close();
+        return false;
+    }
+    hMapping_ = hMapping;
+
+    data_ = static_cast<const uint8_t*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+    if (!data_)
+    {
+        error_ = "MapViewOfFile failed";
+        Close();
+        return false;
+    }
+    size_ = static_cast<size_t>(fileSize.QuadPart);
+    error_ = nullptr;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data_)
+        UnmapViewOfFile(data_);
+    if (hMapping_)
+        CloseHandle(hMapping_);
+    if (hFile_ != INVALID_HANDLE_VALUE)
+        CloseHandle(hFile_);
+    data_ = nullptr;
+    size_ = 0;
+    hMapping_ = nullptr;
+    hFile_ = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::Open(const char* path)
+{
+    Close();
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        error_ = "could not open file";
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        error_ = "could not get file size";
+        return false;
+    }
+    if (!S_ISREG(st.st_mode))
+    {
+        close(fd);
+        error_ = "not a regular file";
+        return false;
+    }
+    // mmap of a zero-length file fails, so treat it as an empty buffer.
+    if (st.st_size == 0)
+    {
+        close(fd);
+        error_ = nullptr;
+        return true;
+    }
+
+    void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps its own reference to the file.
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+        error_ = "mmap failed";
+        return false;
+    }
+    data_ = static_cast<const uint8_t*>(p);
+    size_ = static_cast<size_t>(st.st_size);
+    error_ = nullptr;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (data_)
+        munmap(const_cast<uint8_t*>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+}
+
+#endif
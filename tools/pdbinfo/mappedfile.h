@@ -0,0 +1,38 @@
+// Copyright 2013 Cygnus Software
+// Read-only memory mapping of a whole file. This lets the PDB parsing code
+// treat the file as one big byte array and only touch the pages that it
+// actually needs, which for the PDB header is just a handful of blocks.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // Map the specified file. Returns false and sets Error() on failure.
+    // Any previously mapped file is unmapped first.
+    bool Open(const char* path);
+    void Close();
+
+    const uint8_t* Data() const { return data_; }
+    size_t Size() const { return size_; }
+    const char* Error() const { return error_; }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const uint8_t* data_;
+    size_t size_;
+    const char* error_;
+#ifdef _WIN32
+    void* hFile_;
+    void* hMapping_;
+#endif
+};
@@ -0,0 +1,261 @@
+// Copyright 2013 Cygnus Software
+// Bulk matching of executables against PDBs. The PDB side is the build side
+// of a hash join: every PDB's GUID and age (and file name, for diagnosing
+// mismatches) goes into hash tables. The binaries are then probed in
+// parallel. Each binary is reported as one of:
+//   match      A PDB with the same GUID and age was found.
+//   mismatch   PDBs with the right name exist but none has the right GUID
+//              and age, which usually means they came from another build.
+//   missing    No PDB with the right name exists at all.
+//   nodebug    The binary has no RSDS CodeView record.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include "commands.h"
+#include "pdbindex.h"
+#include "pe.h"
+#include "platform.h"
+#include "scan.h"
+#include "threadpool.h"
+
+namespace
+{
+
+struct PdbRecord
+{
+    std::string path;
+    PdbGuid guid;
+    uint32_t age;
+};
+
+struct GuidAgeKey
+{
+    PdbGuid guid;
+    uint32_t age;
+
+    bool operator==(const GuidAgeKey& rhs) const
+    {
+        return age == rhs.age && memcmp(&guid, &rhs.guid, sizeof(guid)) == 0;
+    }
+};
+
+struct GuidAgeKeyHash
+{
+    size_t operator()(const GuidAgeKey& key) const
+    {
+        return static_cast<size_t>(HashGuidAge(key.guid, key.age));
+    }
+};
+
+struct MatchRow
+{
+    std::string binary;
+    std::string line;
+};
+
+bool MatchRowLess(const MatchRow& lhs, const MatchRow& rhs)
+{
+    return lhs.binary < rhs.binary;
+}
+
+std::string LowerCase(std::string text)
+{
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        if (text[i] >= 'A' && text[i] <= 'Z')
+            text[i] = static_cast<char>(text[i] - 'A' + 'a');
+    }
+    return text;
+}
+
+void PrintMatchUsage()
+{
+    printf("Matches executables to pdbs using their CodeView (RSDS) records.\n\n");
+    printf("usage: pdbinfo -match [-j threads] -bin <dir|binary>... [-pdb <dir|pdb>...] [-index <indexfile>...]\n");
+    printf("  -bin     Executables to check: .exe, .dll and .sys files, or any named file.\n");
+    printf("  -pdb     Pdbs to match against.\n");
+    printf("  -index   Pdb indices created by pdbinfo -index to match against.\n");
+}
+
+}  // namespace
+
+int MatchMain(int argc, char* argv[])
+{
+    unsigned threads = HardwareThreadCount();
+    std::vector<std::string> binRoots;
+    std::vector<std::string> pdbRoots;
+    std::vector<std::string> indexPaths;
+    std::vector<std::string>* pCurrent = nullptr;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = static_cast<unsigned>(atoi(argv[++i]));
+        else if (strcmp(argv[i], "-bin") == 0)
+            pCurrent = &binRoots;
+        else if (strcmp(argv[i], "-pdb") == 0)
+            pCurrent = &pdbRoots;
+        else if (strcmp(argv[i], "-index") == 0)
+            pCurrent = &indexPaths;
+        else if (argv[i][0] == '-' || !pCurrent)
+        {
+            PrintMatchUsage();
+            return 1;
+        }
+        else
+            pCurrent->push_back(argv[i]);
+    }
+    if (binRoots.empty() || (pdbRoots.empty() && indexPaths.empty()) || threads == 0)
+    {
+        PrintMatchUsage();
+        return 1;
+    }
+
+    WorkStealingPool pool(threads);
+
+    // Build side: gather every PDB identity, from indices and from scanning.
+    std::vector<PdbRecord> pdbs;
+    for (size_t i = 0; i < indexPaths.size(); ++i)
+    {
+        PdbIndex index;
+        if (!index.Open(indexPaths[i].c_str()))
+        {
+            printf("Could not open index %s.\n", indexPaths[i].c_str());
+            return 1;
+        }
+        for (uint32_t r = 0; r < index.RecordCount(); ++r)
+        {
+            const IndexRecord& record = index.Record(r);
+            if (record.flags & kIndexRecordInvalid)
+                continue;
+            PdbRecord pdb;
+            pdb.path = index.RecordPath(r);
+            pdb.guid = record.guid;
+            pdb.age = record.age;
+            pdbs.push_back(pdb);
+        }
+    }
+    std::vector<std::vector<PdbRecord>> scanned(pool.ThreadCount());
+    WalkTree(pool, pdbRoots, std::vector<const char*>(1, ".pdb"), [&](const std::string& path)
+    {
+        PdbIdentity identity;
+        const char* error = nullptr;
+        if (!ReadPdbIdentityFromFile(path, &identity, nullptr, &error))
+            return;
+        PdbRecord pdb;
+        pdb.path = path;
+        pdb.guid = identity.guid;
+        pdb.age = identity.age;
+        scanned[pool.CurrentWorker()].push_back(pdb);
+    });
+    for (size_t i = 0; i < scanned.size(); ++i)
+        pdbs.insert(pdbs.end(), scanned[i].begin(), scanned[i].end());
+
+    std::unordered_multimap<GuidAgeKey, uint32_t, GuidAgeKeyHash> byIdentity(pdbs.size());
+    std::unordered_multimap<std::string, uint32_t> byName(pdbs.size());
+    for (uint32_t i = 0; i < pdbs.size(); ++i)
+    {
+        GuidAgeKey key = { pdbs[i].guid, pdbs[i].age };
+        byIdentity.insert(std::make_pair(key, i));
+        byName.insert(std::make_pair(LowerCase(PathFileName(pdbs[i].path)), i));
+    }
+
+    // Probe side: the tables are read-only from here on so workers share
+    // them without locking.
+    std::vector<std::vector<MatchRow>> rows(pool.ThreadCount());
+    std::vector<const char*> binSuffixes;
+    binSuffixes.push_back(".exe");
+    binSuffixes.push_back(".dll");
+    binSuffixes.push_back(".sys");
+    uint64_t counts[4] = {};
+    std::mutex countLock;
+    WalkTree(pool, binRoots, binSuffixes, [&](const std::string& path)
+    {
+        MatchRow row;
+        row.binary = path;
+        CodeViewInfo info;
+        const char* error = nullptr;
+        int status;
+        if (!ReadCodeViewInfoFromFile(path, &info, &error))
+        {
+            status = 3;
+            row.line = "nodebug\t" + path + "\t\t\t\t" + error;
+        }
+        else
+        {
+            char szGuid[kGuidStringSize];
+            FormatGuid(info.guid, szGuid);
+            char szAge[16];
+            sprintf(szAge, "%u", info.age);
+            std::string pdbName = PathFileName(info.pdbPath);
+            std::string prefix = path + "\t" + szGuid + "\t" + szAge + "\t" + pdbName + "\t";
+
+            // Copies of a PDB share an identity, so prefer one whose name
+            // matches what the linker recorded.
+            GuidAgeKey key = { info.guid, info.age };
+            auto hits = byIdentity.equal_range(key);
+            if (hits.first != hits.second)
+            {
+                uint32_t best = hits.first->second;
+                std::string lowerName = LowerCase(pdbName);
+                for (auto it = hits.first; it != hits.second; ++it)
+                {
+                    if (LowerCase(PathFileName(pdbs[it->second].path)) == lowerName)
+                    {
+                        best = it->second;
+                        break;
+                    }
+                }
+                status = 0;
+                row.line = "match\t" + prefix + pdbs[best].path;
+            }
+            else
+            {
+                auto range = byName.equal_range(LowerCase(pdbName));
+                if (range.first == range.second)
+                {
+                    status = 2;
+                    row.line = "missing\t" + prefix;
+                }
+                else
+                {
+                    // List every candidate with its identity so the reason
+                    // for the mismatch is visible.
+                    status = 1;
+                    row.line = "mismatch\t" + prefix;
+                    for (auto it = range.first; it != range.second; ++it)
+                    {
+                        const PdbRecord& pdb = pdbs[it->second];
+                        FormatGuid(pdb.guid, szGuid);
+                        sprintf(szAge, "%u", pdb.age);
+                        if (it != range.first)
+                            row.line += ";";
+                        row.line += pdb.path + " " + szGuid + " " + szAge;
+                    }
+                }
+            }
+        }
+        rows[pool.CurrentWorker()].push_back(row);
+        std::lock_guard<std::mutex> guard(countLock);
+        ++counts[status];
+    });
+
+    std::vector<MatchRow> allRows;
+    for (size_t i = 0; i < rows.size(); ++i)
+        allRows.insert(allRows.end(), rows[i].begin(), rows[i].end());
+    std::sort(allRows.begin(), allRows.end(), MatchRowLess);
+
+    printf("status\tbinary\tguid\tage\tpdbname\tpdb\n");
+    for (size_t i = 0; i < allRows.size(); ++i)
+        printf("%s\n", allRows[i].line.c_str());
+    fprintf(stderr, "%llu pdbs, %llu binaries: %llu matched, %llu mismatched, %llu missing, %llu without debug info.\n",
+            static_cast<unsigned long long>(pdbs.size()), static_cast<unsigned long long>(allRows.size()),
+            static_cast<unsigned long long>(counts[0]), static_cast<unsigned long long>(counts[1]),
+            static_cast<unsigned long long>(counts[2]), static_cast<unsigned long long>(counts[3]));
+
+    return (counts[1] || counts[2]) ? 1 : 0;
+}
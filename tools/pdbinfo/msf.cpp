@@ -0,0 +1,258 @@
+// Copyright 2013 Cygnus Software
+
+#include "msf.h"
+
+#include <string.h>
+
+// The MSF 7.00 superblock looks like this:
+//   char     magic[32];         "Microsoft C/C++ MSF 7.00\r\n\x1a" "DS\0\0\0"
+//   uint32_t blockSize;
+//   uint32_t freeBlockMapBlock;
+//   uint32_t numBlocks;
+//   uint32_t numDirectoryBytes;
+//   uint32_t unknown;
+//   uint32_t blockMapAddr;      Block holding the directory's block numbers.
+static const char kMsfMagic[32] = "Microsoft C/C++ MSF 7.00\r\n\x1a" "DS\0\0";
+
+MsfFile::MsfFile()
+    : data_(nullptr)
+    , size_(0)
+    , error_("not opened")
+    , blockSize_(0)
+    , blockCount_(0)
+    , freeBlockMapBlock_(0)
+    , directoryBytes_(0)
+    , streamCount_(0)
+    , blockMap_(nullptr)
+{
+}
+
+bool MsfFile::Open(const uint8_t* data, size_t size)
+{
+    data_ = data;
+    size_ = size;
+    streamCount_ = 0;
+    streamBlockStart_.clear();
+
+    if (size < kMsfSuperBlockSize)
+    {
+        error_ = "file too small for an MSF superblock";
+        return false;
+    }
+    if (memcmp(data, kMsfMagic, sizeof(kMsfMagic)) != 0)
+    {
+        if (memcmp(data, "Microsoft C/C++ program database 2.00", 37) == 0)
+            error_ = "MSF 2.00 (VC++ 6.0 era) PDBs are not supported";
+        else
+            error_ = "bad MSF magic";
+        return false;
+    }
+
+    blockSize_ = LoadU32(data + 32);
+    freeBlockMapBlock_ = LoadU32(data + 36);
+    blockCount_ = LoadU32(data + 40);
+    directoryBytes_ = LoadU32(data + 44);
+    uint32_t blockMapAddr = LoadU32(data + 52);
+
+    // /PDBPAGESIZE allows block sizes above 4 KB, but they are always powers
+    // of two.
+    if (blockSize_ < 512 || blockSize_ > 65536 || (blockSize_ & (blockSize_ - 1)) != 0)
+    {
+        error_ = "bad MSF block size";
+        return false;
+    }
+    if (blockCount_ == 0 || static_cast<uint64_t>(blockCount_) * blockSize_ > size)
+    {
+        error_ = "MSF block count exceeds file size";
+        return false;
+    }
+    if (blockMapAddr == 0 || blockMapAddr >= blockCount_)
+    {
+        error_ = "bad MSF block map address";
+        return false;
+    }
+    if (directoryBytes_ < 4 || (directoryBytes_ & 3) != 0)
+    {
+        error_ = "bad MSF directory size";
+        return false;
+    }
+
+    // The block map is a single block so it limits how big the directory can be.
+    uint32_t directoryBlocks = MsfBlocksForBytes(directoryBytes_, blockSize_);
+    if (static_cast<uint64_t>(directoryBlocks) * 4 > blockSize_)
+    {
+        error_ = "MSF directory too large for its block map";
+        return false;
+    }
+    blockMap_ = data + static_cast<size_t>(blockMapAddr) * blockSize_;
+    for (uint32_t i = 0; i < directoryBlocks; ++i)
+    {
+        uint32_t block = LoadU32(blockMap_ + i * 4);
+        if (block == 0 || block >= blockCount_)
+        {
+            error_ = "bad MSF directory block number";
+            return false;
+        }
+    }
+
+    uint32_t directoryWords = directoryBytes_ / 4;
+    uint32_t streamCount = DirectoryWord(0);
+    if (streamCount > directoryWords - 1)
+    {
+        error_ = "MSF stream count exceeds directory size";
+        return false;
+    }
+
+    // Walk the stream sizes once to find where each stream's block list
+    // starts. This is the only per-stream work that Open does. The block
+    // lists themselves are only checked when a stream is read so that
+    // opening a large PDB doesn't touch its whole directory.
+    streamBlockStart_.resize(streamCount);
+    uint64_t next = 1 + static_cast<uint64_t>(streamCount);
+    for (uint32_t stream = 0; stream < streamCount; ++stream)
+    {
+        streamBlockStart_[stream] = static_cast<uint32_t>(next);
+        next += MsfBlocksForBytes(DirectoryWord(1 + stream), blockSize_);
+        if (next > directoryWords)
+        {
+            error_ = "MSF stream block lists exceed directory size";
+            streamBlockStart_.clear();
+            return false;
+        }
+    }
+    streamCount_ = streamCount;
+
+    error_ = nullptr;
+    return true;
+}
+
+uint32_t MsfFile::DirectoryWord(uint32_t index) const
+{
+    // Block sizes are multiples of four so words never straddle blocks.
+    uint32_t byteOffset = index * 4;
+    uint32_t block = LoadU32(blockMap_ + (byteOffset / blockSize_) * 4);
+    return LoadU32(data_ + static_cast<size_t>(block) * blockSize_ + byteOffset % blockSize_);
+}
+
+bool MsfFile::StreamExists(uint32_t stream) const
+{
+    return stream < streamCount_ && DirectoryWord(1 + stream) != kMsfNilStreamSize;
+}
+
+uint32_t MsfFile::StreamSize(uint32_t stream) const
+{
+    if (stream >= streamCount_)
+        return 0;
+    uint32_t size = DirectoryWord(1 + stream);
+    return size == kMsfNilStreamSize ? 0 : size;
+}
+
+uint32_t MsfFile::StreamBlockCount(uint32_t stream) const
+{
+    return MsfBlocksForBytes(StreamSize(stream), blockSize_);
+}
+
+uint32_t MsfFile::StreamBlock(uint32_t stream, uint32_t index) const
+{
+    return DirectoryWord(streamBlockStart_[stream] + index);
+}
+
+const uint8_t* MsfFile::StreamBlockData(uint32_t stream, uint32_t index) const
+{
+    uint32_t block = StreamBlock(stream, index);
+    if (block >= blockCount_)
+        return nullptr;
+    return data_ + static_cast<size_t>(block) * blockSize_;
+}
+
+bool MsfFile::IsBlockFree(uint32_t block) const
+{
+    uint32_t bitsPerBlock = blockSize_ * 8;
+    uint64_t mapBlock = static_cast<uint64_t>(block / bitsPerBlock) * blockSize_ + freeBlockMapBlock_;
+    if (mapBlock >= blockCount_)
+        return false;
+    uint32_t bit = block % bitsPerBlock;
+    return (data_[mapBlock * blockSize_ + bit / 8] & (1 << (bit % 8))) != 0;
+}
+
+bool MsfFile::ReadStream(uint32_t stream, uint32_t offset, void* dest, uint32_t bytes) const
+{
+    uint32_t streamSize = StreamSize(stream);
+    if (offset > streamSize || bytes > streamSize - offset)
+        return false;
+
+    uint8_t* out = static_cast<uint8_t*>(dest);
+    while (bytes > 0)
+    {
+        uint32_t index = offset / blockSize_;
+        uint32_t blockOffset = offset % blockSize_;
+        uint32_t chunk = blockSize_ - blockOffset;
+        if (chunk > bytes)
+            chunk = bytes;
+        const uint8_t* block = StreamBlockData(stream, index);
+        if (!block)
+            return false;
+        memcpy(out, block + blockOffset, chunk);
+        out += chunk;
+        offset += chunk;
+        bytes -= chunk;
+    }
+    return true;
+}
+
+bool MsfFile::ReadStream(uint32_t stream, std::vector<uint8_t>* pData) const
+{
+    // Block lists may repeat blocks, so a corrupt directory can claim a
+    // stream far bigger than the file. A real stream never is.
+    uint32_t size = StreamSize(stream);
+    if (size > size_)
+        return false;
+    pData->resize(size);
+    return size == 0 || ReadStream(stream, 0, pData->data(), size);
+}
+
+MsfStreamReader::MsfStreamReader(const MsfFile& msf, uint32_t stream, uint32_t offset)
+    : msf_(msf)
+    , stream_(stream)
+    , size_(msf.StreamSize(stream))
+    , offset_(offset < size_ ? offset : size_)
+{
+}
+
+const uint8_t* MsfStreamReader::Read(uint32_t bytes)
+{
+    if (bytes > size_ - offset_)
+        return nullptr;
+    // Any non-null pointer will do for an empty read, and offset_ may be at
+    // the very end of the last block.
+    if (bytes == 0)
+        return msf_.Data();
+    uint32_t blockSize = msf_.BlockSize();
+    uint32_t inBlock = offset_ % blockSize;
+    const uint8_t* result;
+    if (inBlock + bytes <= blockSize)
+    {
+        const uint8_t* block = msf_.StreamBlockData(stream_, offset_ / blockSize);
+        if (!block)
+            return nullptr;
+        result = block + inBlock;
+    }
+    else
+    {
+        if (scratch_.size() < bytes)
+            scratch_.resize(bytes);
+        if (!msf_.ReadStream(stream_, offset_, scratch_.data(), bytes))
+            return nullptr;
+        result = scratch_.data();
+    }
+    offset_ += bytes;
+    return result;
+}
+
+bool MsfStreamReader::Skip(uint32_t bytes)
+{
+    if (bytes > size_ - offset_)
+        return false;
+    offset_ += bytes;
+    return true;
+}
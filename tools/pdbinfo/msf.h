@@ -0,0 +1,139 @@
+// Copyright 2013 Cygnus Software
+// Reader for MSF 7.00 multi-stream files, the container format used by PDBs.
+//
+// An MSF file is an array of fixed size blocks. Block 0 holds the superblock,
+// which points at a block map, which lists the blocks that make up the stream
+// directory. The directory gives the size of each stream followed by the list
+// of blocks for each stream. Nothing here copies the directory; all lookups go
+// straight to the underlying (normally memory mapped) bytes so that opening a
+// PDB costs a few page touches regardless of how large the file is.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Stream sizes of 0xFFFFFFFF mark deleted (nil) streams.
+const uint32_t kMsfNilStreamSize = 0xFFFFFFFF;
+
+// Well known stream numbers.
+const uint32_t kMsfStreamOldDirectory = 0;
+const uint32_t kMsfStreamPdbInfo = 1;
+const uint32_t kMsfStreamTpi = 2;
+const uint32_t kMsfStreamDbi = 3;
+const uint32_t kMsfStreamIpi = 4;
+
+// Size of the superblock at the start of block 0.
+const size_t kMsfSuperBlockSize = 56;
+
+// Little-endian loads that don't care about alignment. MSF and PDB data is
+// always little-endian.
+inline uint16_t LoadU16(const uint8_t* p)
+{
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline uint32_t LoadU32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+class MsfFile
+{
+public:
+    MsfFile();
+
+    // Parse the superblock and validate the stream directory. The data must
+    // remain valid for as long as this object is used. Returns false and sets
+    // Error() if the data is not a well formed MSF 7.00 file.
+    bool Open(const uint8_t* data, size_t size);
+
+    const char* Error() const { return error_; }
+
+    const uint8_t* Data() const { return data_; }
+    size_t Size() const { return size_; }
+    uint32_t BlockSize() const { return blockSize_; }
+    uint32_t BlockCount() const { return blockCount_; }
+    uint32_t FreeBlockMapBlock() const { return freeBlockMapBlock_; }
+    uint32_t DirectoryBytes() const { return directoryBytes_; }
+    uint32_t StreamCount() const { return streamCount_; }
+
+    // Returns true if the stream number is in range and not a nil stream.
+    bool StreamExists(uint32_t stream) const;
+    // Size in bytes of the stream. Nil and out of range streams have size zero.
+    uint32_t StreamSize(uint32_t stream) const;
+    // Number of blocks used by the stream.
+    uint32_t StreamBlockCount(uint32_t stream) const;
+    // File block number of the index'th block of the stream. The caller must
+    // ensure that index < StreamBlockCount(stream).
+    uint32_t StreamBlock(uint32_t stream, uint32_t index) const;
+    // Pointer to the file data of the index'th block of the stream, or null if
+    // the directory lists a block number that is outside the file.
+    const uint8_t* StreamBlockData(uint32_t stream, uint32_t index) const;
+
+    // Returns true if the free block map marks the block as free. The map is
+    // a bit vector spread over one block (block 1 or 2, whichever
+    // FreeBlockMapBlock says is current) in each interval of BlockSize()
+    // blocks.
+    bool IsBlockFree(uint32_t block) const;
+
+    // Copy bytes out of a stream, crossing block boundaries as needed. Returns
+    // false if the requested range extends past the end of the stream.
+    bool ReadStream(uint32_t stream, uint32_t offset, void* dest, uint32_t bytes) const;
+    // Copy a whole stream. Only use this for streams that are known to be of
+    // modest size, such as the DBI stream; walk big ones block by block.
+    bool ReadStream(uint32_t stream, std::vector<uint8_t>* pData) const;
+
+private:
+    uint32_t DirectoryWord(uint32_t index) const;
+
+    const uint8_t* data_;
+    size_t size_;
+    const char* error_;
+
+    uint32_t blockSize_;
+    uint32_t blockCount_;
+    uint32_t freeBlockMapBlock_;
+    uint32_t directoryBytes_;
+    uint32_t streamCount_;
+    // Pointer to the array of block numbers that hold the stream directory.
+    const uint8_t* blockMap_;
+    // Index, in directory words, of the first block number of each stream.
+    std::vector<uint32_t> streamBlockStart_;
+};
+
+// Sequential reader over one stream, for walking streams that are too big to
+// copy. Reads that fall within one block return a pointer straight into the
+// file data; only reads that straddle a block boundary are copied, into a
+// scratch buffer that is reused.
+class MsfStreamReader
+{
+public:
+    MsfStreamReader(const MsfFile& msf, uint32_t stream, uint32_t offset = 0);
+
+    uint32_t Offset() const { return offset_; }
+    uint32_t Remaining() const { return size_ - offset_; }
+
+    // Returns a pointer to the next bytes of the stream, valid until the next
+    // call, and advances past them. Returns null if fewer than bytes remain
+    // or the directory lists a block outside the file.
+    const uint8_t* Read(uint32_t bytes);
+    bool Skip(uint32_t bytes);
+
+private:
+    const MsfFile& msf_;
+    uint32_t stream_;
+    uint32_t size_;
+    uint32_t offset_;
+    std::vector<uint8_t> scratch_;
+};
+
+// Number of blocks needed to hold bytes, for the given block size.
+inline uint32_t MsfBlocksForBytes(uint32_t bytes, uint32_t blockSize)
+{
+    if (bytes == kMsfNilStreamSize)
+        return 0;
+    return static_cast<uint32_t>((static_cast<uint64_t>(bytes) + blockSize - 1) / blockSize);
+}
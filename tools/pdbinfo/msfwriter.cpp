@@ -0,0 +1,291 @@
+// Copyright 2013 Cygnus Software
+
+#include "msfwriter.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "msf.h"
+#include "platform.h"
+
+static const char kMsfMagic[32] = "Microsoft C/C++ MSF 7.00\r\n\x1a" "DS\0\0";
+
+static void StoreU32(uint8_t* p, uint32_t value)
+{
+    p[0] = static_cast<uint8_t>(value);
+    p[1] = static_cast<uint8_t>(value >> 8);
+    p[2] = static_cast<uint8_t>(value >> 16);
+    p[3] = static_cast<uint8_t>(value >> 24);
+}
+
+MsfWriter::MsfWriter(uint32_t blockSize)
+    : blockSize_(blockSize)
+    , blockCount_(0)
+    , scatterSeed_(0)
+    , error_(nullptr)
+{
+}
+
+uint32_t MsfWriter::AddStream()
+{
+    Stream stream;
+    stream.nil = false;
+    stream.size = 0;
+    streams_.push_back(stream);
+    return static_cast<uint32_t>(streams_.size() - 1);
+}
+
+uint32_t MsfWriter::AddNilStream()
+{
+    uint32_t stream = AddStream();
+    streams_[stream].nil = true;
+    return stream;
+}
+
+void MsfWriter::AppendToStream(uint32_t stream, const void* data, uint32_t size)
+{
+    if (size == 0)
+        return;
+    Chunk chunk = { static_cast<const uint8_t*>(data), size };
+    streams_[stream].chunks.push_back(chunk);
+    streams_[stream].chunkOffsets.push_back(streams_[stream].size);
+    streams_[stream].size += size;
+}
+
+void MsfWriter::SetLayoutOrder(const std::vector<uint32_t>& streams)
+{
+    layoutOrder_ = streams;
+}
+
+void MsfWriter::SetScatterSeed(uint32_t seed)
+{
+    scatterSeed_ = seed;
+}
+
+uint32_t MsfWriter::AllocateBlock()
+{
+    // The second and third block of every interval belong to the free block
+    // maps.
+    while (blockCount_ % blockSize_ == 1 || blockCount_ % blockSize_ == 2)
+        ++blockCount_;
+    return blockCount_++;
+}
+
+bool MsfWriter::Write(const std::function<bool(const void* data, size_t size)>& sink)
+{
+    if (blockSize_ < 512 || blockSize_ > 65536 || (blockSize_ & (blockSize_ - 1)) != 0)
+    {
+        error_ = "block size must be a power of two from 512 to 65536";
+        return false;
+    }
+    error_ = nullptr;
+    blockCount_ = 3;
+
+    // Data blocks, in layout order.
+    std::vector<bool> placed(streams_.size());
+    std::vector<uint32_t> order;
+    for (size_t i = 0; i < layoutOrder_.size(); ++i)
+    {
+        uint32_t stream = layoutOrder_[i];
+        if (stream < streams_.size() && !placed[stream])
+        {
+            placed[stream] = true;
+            order.push_back(stream);
+        }
+    }
+    for (uint32_t stream = 0; stream < streams_.size(); ++stream)
+    {
+        if (!placed[stream])
+            order.push_back(stream);
+    }
+    std::vector<uint32_t> dataBlocks;
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        Stream& stream = streams_[order[i]];
+        stream.blocks.clear();
+        if (stream.nil)
+            continue;
+        if (stream.size >= kMsfNilStreamSize)
+        {
+            error_ = "stream is too large for MSF";
+            return false;
+        }
+        uint32_t blocks = MsfBlocksForBytes(static_cast<uint32_t>(stream.size), blockSize_);
+        for (uint32_t b = 0; b < blocks; ++b)
+        {
+            stream.blocks.push_back(AllocateBlock());
+            dataBlocks.push_back(stream.blocks.back());
+        }
+    }
+    if (scatterSeed_)
+    {
+        // A private xorshift so that a seed means the same file everywhere.
+        uint32_t state = scatterSeed_;
+        for (size_t i = dataBlocks.size(); i > 1; --i)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            std::swap(dataBlocks[i - 1], dataBlocks[state % i]);
+        }
+        size_t next = 0;
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            std::vector<uint32_t>& blocks = streams_[order[i]].blocks;
+            for (size_t b = 0; b < blocks.size(); ++b)
+                blocks[b] = dataBlocks[next++];
+        }
+    }
+
+    // The directory: stream count, stream sizes, then each block list.
+    std::vector<uint8_t> directory;
+    directory.resize(4 + streams_.size() * 4);
+    StoreU32(&directory[0], static_cast<uint32_t>(streams_.size()));
+    for (size_t i = 0; i < streams_.size(); ++i)
+    {
+        const Stream& stream = streams_[i];
+        StoreU32(&directory[4 + i * 4], stream.nil ? kMsfNilStreamSize : static_cast<uint32_t>(stream.size));
+        for (size_t b = 0; b < stream.blocks.size(); ++b)
+        {
+            uint8_t word[4];
+            StoreU32(word, stream.blocks[b]);
+            directory.insert(directory.end(), word, word + 4);
+        }
+    }
+    uint32_t directoryBlockCount = MsfBlocksForBytes(static_cast<uint32_t>(directory.size()), blockSize_);
+    if (directoryBlockCount * 4 > blockSize_)
+    {
+        error_ = "stream directory is too large for a single block map block";
+        return false;
+    }
+    std::vector<uint32_t> directoryBlocks;
+    for (uint32_t b = 0; b < directoryBlockCount; ++b)
+        directoryBlocks.push_back(AllocateBlock());
+    uint32_t blockMapBlock = AllocateBlock();
+
+    // What goes in each block: the owning stream and block index, or one of
+    // the fixed structures.
+    const uint32_t kOwnerNone = 0xFFFFFFFF;
+    const uint32_t kOwnerDirectory = 0xFFFFFFFE;
+    std::vector<uint32_t> owner(blockCount_, kOwnerNone);
+    std::vector<uint32_t> ownerIndex(blockCount_, 0);
+    for (uint32_t s = 0; s < streams_.size(); ++s)
+    {
+        for (uint32_t b = 0; b < streams_[s].blocks.size(); ++b)
+        {
+            owner[streams_[s].blocks[b]] = s;
+            ownerIndex[streams_[s].blocks[b]] = b;
+        }
+    }
+    for (uint32_t b = 0; b < directoryBlockCount; ++b)
+    {
+        owner[directoryBlocks[b]] = kOwnerDirectory;
+        ownerIndex[directoryBlocks[b]] = b;
+    }
+
+    // Free block map: one bit per block, set for free blocks. Every block
+    // in the file is in use; bits past the end are marked free.
+    uint32_t bitsPerMapBlock = blockSize_ * 8;
+    uint32_t mapBlockCount = (blockCount_ + bitsPerMapBlock - 1) / bitsPerMapBlock;
+    std::vector<uint8_t> freeMap(static_cast<size_t>(mapBlockCount) * blockSize_, 0);
+    for (uint64_t bit = blockCount_; bit < freeMap.size() * 8; ++bit)
+        freeMap[bit / 8] |= static_cast<uint8_t>(1 << (bit % 8));
+
+    std::vector<uint8_t> buffer(blockSize_);
+    for (uint32_t block = 0; block < blockCount_; ++block)
+    {
+        const uint8_t* out = buffer.data();
+        memset(buffer.data(), 0, blockSize_);
+        uint32_t interval = block / blockSize_;
+        uint32_t position = block % blockSize_;
+        if (block == 0)
+        {
+            memcpy(buffer.data(), kMsfMagic, sizeof(kMsfMagic));
+            StoreU32(&buffer[32], blockSize_);
+            StoreU32(&buffer[36], 1);
+            StoreU32(&buffer[40], blockCount_);
+            StoreU32(&buffer[44], static_cast<uint32_t>(directory.size()));
+            StoreU32(&buffer[48], 0);
+            StoreU32(&buffer[52], blockMapBlock);
+        }
+        else if (position == 1 || position == 2)
+        {
+            if (interval < mapBlockCount)
+                out = &freeMap[static_cast<size_t>(interval) * blockSize_];
+            else
+                memset(buffer.data(), 0xFF, blockSize_);
+        }
+        else if (block == blockMapBlock)
+        {
+            for (uint32_t b = 0; b < directoryBlockCount; ++b)
+                StoreU32(&buffer[b * 4], directoryBlocks[b]);
+        }
+        else if (owner[block] == kOwnerDirectory)
+        {
+            size_t offset = static_cast<size_t>(ownerIndex[block]) * blockSize_;
+            memcpy(buffer.data(), &directory[offset], std::min<size_t>(blockSize_, directory.size() - offset));
+        }
+        else if (owner[block] != kOwnerNone)
+        {
+            // Gather the block from the stream's chunks. When a chunk covers
+            // the whole block, as it does when copying a PDB block by block,
+            // it is passed through without a copy.
+            const Stream& stream = streams_[owner[block]];
+            uint64_t start = static_cast<uint64_t>(ownerIndex[block]) * blockSize_;
+            uint64_t end = std::min<uint64_t>(start + blockSize_, stream.size);
+            size_t c = std::upper_bound(stream.chunkOffsets.begin(), stream.chunkOffsets.end(), start) -
+                       stream.chunkOffsets.begin() - 1;
+            for (uint64_t chunkStart = stream.chunkOffsets[c]; c < stream.chunks.size() && chunkStart < end; ++c)
+            {
+                const Chunk& chunk = stream.chunks[c];
+                uint64_t chunkEnd = chunkStart + chunk.size;
+                if (chunkEnd > start)
+                {
+                    if (chunkStart <= start && chunkEnd >= start + blockSize_)
+                    {
+                        out = chunk.data + (start - chunkStart);
+                        break;
+                    }
+                    uint64_t from = std::max(start, chunkStart);
+                    uint64_t to = std::min(end, chunkEnd);
+                    memcpy(&buffer[from - start], chunk.data + (from - chunkStart), static_cast<size_t>(to - from));
+                }
+                chunkStart = chunkEnd;
+            }
+        }
+        if (!sink(out, blockSize_))
+        {
+            error_ = "could not write the output";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MsfWriter::WriteFile(const char* path)
+{
+    FILE* fp = OpenFile(path, "wb");
+    if (!fp)
+    {
+        error_ = "could not create the output file";
+        return false;
+    }
+    bool ok = Write([fp](const void* data, size_t size) { return fwrite(data, 1, size, fp) == size; });
+    if (fclose(fp) != 0 && ok)
+    {
+        error_ = "could not write the output";
+        ok = false;
+    }
+    return ok;
+}
+
+bool MsfWriter::WriteToBuffer(std::vector<uint8_t>* pData)
+{
+    pData->clear();
+    return Write([pData](const void* data, size_t size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        pData->insert(pData->end(), bytes, bytes + size);
+        return true;
+    });
+}
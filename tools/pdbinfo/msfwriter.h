@@ -0,0 +1,77 @@
+// Copyright 2013 Cygnus Software
+// Writer for MSF 7.00 files. Streams are described as lists of chunks that
+// point at data owned by the caller (for example the blocks of a mapped
+// source PDB), so a file of any size can be written without staging a copy
+// of it in memory.
+//
+// Blocks are laid out as follows: the superblock, the two free block map
+// blocks, then each stream's blocks in layout order, then the directory and
+// the block map. Every interval of BlockSize() blocks starts with its own
+// pair of free block map blocks, and those are skipped when allocating.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+class MsfWriter
+{
+public:
+    explicit MsfWriter(uint32_t blockSize);
+
+    // Append a stream and return its number. The chunks are concatenated to
+    // form the stream and must stay valid until Write returns.
+    uint32_t AddStream();
+    uint32_t AddNilStream();
+    void AppendToStream(uint32_t stream, const void* data, uint32_t size);
+
+    // Order in which stream data is placed in the file. Streams that aren't
+    // listed follow in stream number order. By default streams are placed
+    // in stream number order.
+    void SetLayoutOrder(const std::vector<uint32_t>& streams);
+    // Shuffle the data blocks, to mimic the fragmentation that incremental
+    // linking produces. Zero, the default, keeps each stream contiguous.
+    void SetScatterSeed(uint32_t seed);
+
+    // Lay the file out and hand it to sink one block at a time. Returns
+    // false and sets Error() if the file can't be represented, or if sink
+    // returns false.
+    bool Write(const std::function<bool(const void* data, size_t size)>& sink);
+    bool WriteFile(const char* path);
+    bool WriteToBuffer(std::vector<uint8_t>* pData);
+
+    const char* Error() const { return error_; }
+    uint32_t BlockSize() const { return blockSize_; }
+    // Valid after a successful Write.
+    uint32_t BlockCount() const { return blockCount_; }
+    // File block numbers of a stream's blocks, valid after a successful Write.
+    const std::vector<uint32_t>& StreamBlocks(uint32_t stream) const { return streams_[stream].blocks; }
+
+private:
+    struct Chunk
+    {
+        const uint8_t* data;
+        uint32_t size;
+    };
+
+    struct Stream
+    {
+        bool nil;
+        uint64_t size;
+        std::vector<Chunk> chunks;
+        std::vector<uint64_t> chunkOffsets;
+        std::vector<uint32_t> blocks;
+    };
+
+    uint32_t AllocateBlock();
+
+    uint32_t blockSize_;
+    uint32_t blockCount_;
+    uint32_t scatterSeed_;
+    const char* error_;
+    std::vector<Stream> streams_;
+    std::vector<uint32_t> layoutOrder_;
+};
@@ -0,0 +1,135 @@
+// Copyright 2013 Cygnus Software
+
+#include "pdb.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "dbi.h"
+
+bool ReadPdbIdentity(const MsfFile& msf, PdbIdentity* pIdentity)
+{
+    // The PDB info stream starts with this header:
+    //   uint32_t version;
+    //   uint32_t signature;   Timestamp, which DIA returns from get_signature.
+    //   uint32_t age;
+    //   GUID     guid;        Only present for VC70 and later.
+    uint8_t header[28];
+    uint32_t streamSize = msf.StreamSize(kMsfStreamPdbInfo);
+    if (streamSize < 12)
+        return false;
+    uint32_t headerSize = streamSize < sizeof(header) ? 12 : sizeof(header);
+    if (!msf.ReadStream(kMsfStreamPdbInfo, 0, header, headerSize))
+        return false;
+
+    memset(pIdentity, 0, sizeof(*pIdentity));
+    pIdentity->version = LoadU32(header);
+    pIdentity->timeStamp = LoadU32(header + 4);
+    pIdentity->infoAge = LoadU32(header + 8);
+    if (!ReadDbiAge(msf, &pIdentity->age))
+        pIdentity->age = pIdentity->infoAge;
+    if (pIdentity->version >= kPdbImplVC70)
+    {
+        if (headerSize < sizeof(header))
+            return false;
+        const uint8_t* g = header + 12;
+        pIdentity->guid.Data1 = LoadU32(g);
+        pIdentity->guid.Data2 = LoadU16(g + 4);
+        pIdentity->guid.Data3 = LoadU16(g + 6);
+        memcpy(pIdentity->guid.Data4, g + 8, 8);
+    }
+    return true;
+}
+
+bool ReadNamedStreams(const MsfFile& msf, std::vector<PdbNamedStream>* pStreams)
+{
+    // After the header, for VC70 and later:
+    //   uint32_t stringsSize;
+    //   char     strings[stringsSize];
+    //   uint32_t size, capacity;
+    //   uint32_t presentWords, present[presentWords];    Bit vector.
+    //   uint32_t deletedWords, deleted[deletedWords];
+    //   { uint32_t nameOffset, stream; } for each bit set in present.
+    pStreams->clear();
+    std::vector<uint8_t> info;
+    if (!msf.ReadStream(kMsfStreamPdbInfo, &info) || info.size() < 32 ||
+        LoadU32(info.data()) < kPdbImplVC70)
+        return false;
+    const uint8_t* p = info.data() + 28;
+    const uint8_t* end = info.data() + info.size();
+    uint32_t stringsSize = LoadU32(p);
+    p += 4;
+    if (stringsSize > static_cast<size_t>(end - p))
+        return false;
+    const char* strings = reinterpret_cast<const char*>(p);
+    p += stringsSize;
+    if (end - p < 12)
+        return false;
+    uint32_t capacity = LoadU32(p + 4);
+    uint32_t presentWords = LoadU32(p + 8);
+    p += 12;
+    if (presentWords > static_cast<size_t>(end - p) / 4)
+        return false;
+    const uint8_t* present = p;
+    p += presentWords * 4;
+    if (end - p < 4)
+        return false;
+    uint32_t deletedWords = LoadU32(p);
+    p += 4;
+    if (deletedWords > static_cast<size_t>(end - p) / 4)
+        return false;
+    p += deletedWords * 4;
+    for (uint32_t i = 0; i < capacity && i / 32 < presentWords; ++i)
+    {
+        if (!(LoadU32(present + (i / 32) * 4) & (1u << (i % 32))))
+            continue;
+        if (end - p < 8)
+            return false;
+        uint32_t nameOffset = LoadU32(p);
+        PdbNamedStream named;
+        named.stream = LoadU32(p + 4);
+        p += 8;
+        if (nameOffset >= stringsSize)
+            return false;
+        const char* name = strings + nameOffset;
+        const void* nameEnd = memchr(name, 0, stringsSize - nameOffset);
+        if (!nameEnd)
+            return false;
+        named.name.assign(name, static_cast<const char*>(nameEnd));
+        pStreams->push_back(named);
+    }
+    return true;
+}
+
+bool ReadTpiHeader(const MsfFile& msf, uint32_t stream, TpiHeader* pHeader)
+{
+    uint8_t header[kTpiHeaderSize];
+    if (!msf.ReadStream(stream, 0, header, sizeof(header)))
+        return false;
+    pHeader->version = LoadU32(header);
+    pHeader->headerSize = LoadU32(header + 4);
+    pHeader->typeIndexBegin = LoadU32(header + 8);
+    pHeader->typeIndexEnd = LoadU32(header + 12);
+    pHeader->typeRecordBytes = LoadU32(header + 16);
+    pHeader->hashStream = LoadU16(header + 20);
+    pHeader->hashAuxStream = LoadU16(header + 22);
+    pHeader->hashKeySize = LoadU32(header + 24);
+    pHeader->hashBucketCount = LoadU32(header + 28);
+    return pHeader->headerSize >= kTpiHeaderSize &&
+           static_cast<uint64_t>(pHeader->headerSize) + pHeader->typeRecordBytes <= msf.StreamSize(stream);
+}
+
+void FormatGuid(const PdbGuid& guid, char* buffer)
+{
+    sprintf(buffer, "{%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X}",
+             guid.Data1, guid.Data2, guid.Data3,
+             guid.Data4[0], guid.Data4[1], guid.Data4[2], guid.Data4[3],
+             guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7]);
+}
+
+void FormatSymbolStoreKey(const PdbGuid& guid, uint32_t age, char* buffer)
+{
+    sprintf(buffer, "%08X%04X%04X%02X%02X%02X%02X%02X%02X%02X%02X%X",
+            guid.Data1, guid.Data2, guid.Data3,
+            guid.Data4[0], guid.Data4[1], guid.Data4[2], guid.Data4[3],
+            guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7], age);
+}
@@ -0,0 +1,93 @@
+// Copyright 2013 Cygnus Software
+// Decoding of the PDB-specific streams that live inside an MSF container.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "msf.h"
+
+// Same layout as the Windows GUID structure.
+struct PdbGuid
+{
+    uint32_t Data1;
+    uint16_t Data2;
+    uint16_t Data3;
+    uint8_t Data4[8];
+};
+
+// The values that identify a PDB. The GUID and age are what debuggers use
+// to match a PDB to an executable or crash dump. The timestamp is what DIA
+// calls the signature.
+//
+// The info stream has an age too, but the one that matches the executable's
+// RSDS record, and that DIA's get_age returns, is the DBI stream's. Source
+// indexing with pdbstr rewrites the info stream and increments its age, so
+// the two differ in source indexed PDBs.
+struct PdbIdentity
+{
+    uint32_t version;
+    uint32_t timeStamp;
+    uint32_t age;           // From the DBI header, or the info stream if there is no DBI stream.
+    uint32_t infoAge;       // From the info stream.
+    PdbGuid guid;
+};
+
+// PDB info stream versions. Only VC70 and later store a GUID.
+const uint32_t kPdbImplVC70 = 20000404;
+
+// Decode the PDB info stream (stream 1) and the age in the DBI header (stream
+// 3). Returns false if the info stream is missing or truncated.
+bool ReadPdbIdentity(const MsfFile& msf, PdbIdentity* pIdentity);
+
+// An entry in the info stream's map of named streams, such as /names and
+// /LinkInfo.
+struct PdbNamedStream
+{
+    std::string name;
+    uint32_t stream;
+};
+
+// Decode the named stream map that follows the info stream header. Returns
+// false if it is missing or malformed.
+bool ReadNamedStreams(const MsfFile& msf, std::vector<PdbNamedStream>* pStreams);
+
+// Header of the TPI (stream 2) and IPI (stream 4) streams. The type records
+// start at headerSize and take up typeRecordBytes; each one is a uint16_t
+// length (not counting itself), a uint16_t leaf kind and the leaf data.
+struct TpiHeader
+{
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t typeIndexBegin;
+    uint32_t typeIndexEnd;
+    uint32_t typeRecordBytes;
+    uint16_t hashStream;
+    uint16_t hashAuxStream;
+    uint32_t hashKeySize;
+    uint32_t hashBucketCount;
+};
+
+const uint32_t kTpiHeaderSize = 56;
+
+// Decode the header of a TPI or IPI stream and check that the records fit
+// in the stream.
+bool ReadTpiHeader(const MsfFile& msf, uint32_t stream, TpiHeader* pHeader);
+
+// Size needed for a formatted GUID, including the braces and terminator.
+const int kGuidStringSize = 39;
+
+// Format a GUID the way StringFromGUID2 does:
+// {XXXXXXXX-XXXX-XXXX-XXXX-XXXXXXXXXXXX}
+void FormatGuid(const PdbGuid& guid, char* buffer);
+
+// Size needed for a symbol store key: 32 GUID digits, up to 8 age digits and
+// the terminator.
+const int kSymbolStoreKeySize = 41;
+
+// Format the directory name that symstore and symbol servers use for a PDB:
+// the GUID as 32 hex digits followed by the age in hex, e.g.
+// 123456789ABCDEF01122334455667788 + 7 -> 123456789ABCDEF011223344556677887
+void FormatSymbolStoreKey(const PdbGuid& guid, uint32_t age, char* buffer);
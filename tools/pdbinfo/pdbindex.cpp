@@ -0,0 +1,428 @@
+// Copyright 2013 Cygnus Software
+
+#include "pdbindex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <unordered_set>
+#include "commands.h"
+#include "hash.h"
+#include "place.h"
+#include "platform.h"
+#include "scan.h"
+#include "threadpool.h"
+
+static const char kIndexMagic[8] = "PDBIDX\0";
+
+uint64_t HashGuidAge(const PdbGuid& guid, uint32_t age)
+{
+    uint64_t lo;
+    uint64_t hi;
+    memcpy(&lo, &guid, 8);
+    memcpy(&hi, reinterpret_cast<const uint8_t*>(&guid) + 8, 8);
+    return Mix64(lo ^ Mix64(hi ^ age));
+}
+
+static uint64_t HashPath(const char* path, size_t length)
+{
+    return Mix64(Fnv1a64(path, length));
+}
+
+PdbIndex::PdbIndex()
+    : header_(nullptr)
+    , records_(nullptr)
+    , guidSlots_(nullptr)
+    , pathSlots_(nullptr)
+    , strings_(nullptr)
+{
+}
+
+bool PdbIndex::Open(const char* path)
+{
+    header_ = nullptr;
+    if (!file_.Open(path))
+        return false;
+    if (!Open(file_.Data(), file_.Size()))
+    {
+        file_.Close();
+        return false;
+    }
+    return true;
+}
+
+bool PdbIndex::Open(const uint8_t* data, size_t size)
+{
+    header_ = nullptr;
+    if (size < sizeof(IndexHeader))
+        return false;
+    const IndexHeader* header = reinterpret_cast<const IndexHeader*>(data);
+    if (memcmp(header->magic, kIndexMagic, sizeof(kIndexMagic)) != 0 || header->version != kIndexVersion)
+        return false;
+    uint64_t slotCount = header->slotCount;
+    if (slotCount == 0 || (slotCount & (slotCount - 1)) != 0 || slotCount < header->recordCount)
+        return false;
+    if (header->recordsOffset > size ||
+        (size - header->recordsOffset) / sizeof(IndexRecord) < header->recordCount ||
+        header->guidSlotsOffset > size || (size - header->guidSlotsOffset) / 4 < slotCount ||
+        header->pathSlotsOffset > size || (size - header->pathSlotsOffset) / 4 < slotCount ||
+        header->stringsOffset > size || size - header->stringsOffset < header->stringsSize)
+        return false;
+    if ((header->recordsOffset | header->guidSlotsOffset | header->pathSlotsOffset) & 7)
+        return false;
+
+    records_ = reinterpret_cast<const IndexRecord*>(data + header->recordsOffset);
+    guidSlots_ = reinterpret_cast<const uint32_t*>(data + header->guidSlotsOffset);
+    pathSlots_ = reinterpret_cast<const uint32_t*>(data + header->pathSlotsOffset);
+    strings_ = reinterpret_cast<const char*>(data + header->stringsOffset);
+    header_ = header;
+    return true;
+}
+
+void PdbIndex::Close()
+{
+    header_ = nullptr;
+    file_.Close();
+}
+
+std::string PdbIndex::RecordPath(uint32_t index) const
+{
+    const IndexRecord& record = records_[index];
+    if (record.pathOffset > header_->stringsSize ||
+        record.pathLength > header_->stringsSize - record.pathOffset)
+        return std::string();
+    return std::string(strings_ + record.pathOffset, record.pathLength);
+}
+
+const IndexRecord* PdbIndex::FindPath(const std::string& path) const
+{
+    if (!header_)
+        return nullptr;
+    uint32_t mask = header_->slotCount - 1;
+    uint32_t slot = static_cast<uint32_t>(HashPath(path.data(), path.size())) & mask;
+    // The table is at most half full so probing always reaches an empty slot,
+    // but a corrupt file might not be, hence the probe limit.
+    for (uint32_t probe = 0; probe <= mask; ++probe, slot = (slot + 1) & mask)
+    {
+        uint32_t entry = pathSlots_[slot];
+        if (entry == 0 || entry > header_->recordCount)
+            return nullptr;
+        const IndexRecord& record = records_[entry - 1];
+        if (record.pathLength == path.size() && record.pathOffset <= header_->stringsSize &&
+            record.pathLength <= header_->stringsSize - record.pathOffset &&
+            memcmp(strings_ + record.pathOffset, path.data(), path.size()) == 0)
+            return &record;
+    }
+    return nullptr;
+}
+
+void PdbIndex::FindGuidAge(const PdbGuid& guid, uint32_t age, std::vector<uint32_t>* pMatches) const
+{
+    if (!header_)
+        return;
+    uint32_t mask = header_->slotCount - 1;
+    uint32_t slot = static_cast<uint32_t>(HashGuidAge(guid, age)) & mask;
+    for (uint32_t probe = 0; probe <= mask; ++probe, slot = (slot + 1) & mask)
+    {
+        uint32_t entry = guidSlots_[slot];
+        if (entry == 0 || entry > header_->recordCount)
+            return;
+        const IndexRecord& record = records_[entry - 1];
+        if (record.age == age && memcmp(&record.guid, &guid, sizeof(guid)) == 0)
+            pMatches->push_back(entry - 1);
+    }
+}
+
+static void InsertSlot(std::vector<uint32_t>* pSlots, uint64_t hash, uint32_t recordIndex)
+{
+    uint32_t mask = static_cast<uint32_t>(pSlots->size() - 1);
+    uint32_t slot = static_cast<uint32_t>(hash) & mask;
+    while ((*pSlots)[slot] != 0)
+        slot = (slot + 1) & mask;
+    (*pSlots)[slot] = recordIndex + 1;
+}
+
+static bool EntryPathLess(const IndexEntry& lhs, const IndexEntry& rhs)
+{
+    return lhs.path < rhs.path;
+}
+
+bool WritePdbIndex(const char* path, std::vector<IndexEntry>* pEntries)
+{
+    std::vector<IndexEntry>& entries = *pEntries;
+    std::sort(entries.begin(), entries.end(), EntryPathLess);
+    uint32_t count = static_cast<uint32_t>(entries.size());
+
+    uint32_t slotCount = 16;
+    while (slotCount < count * 2ULL)
+        slotCount *= 2;
+
+    std::vector<uint32_t> guidSlots(slotCount);
+    std::vector<uint32_t> pathSlots(slotCount);
+    std::string strings;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        IndexRecord& record = entries[i].record;
+        record.pathOffset = strings.size();
+        record.pathLength = static_cast<uint32_t>(entries[i].path.size());
+        strings += entries[i].path;
+        InsertSlot(&pathSlots, HashPath(entries[i].path.data(), entries[i].path.size()), i);
+        if (!(record.flags & kIndexRecordInvalid))
+            InsertSlot(&guidSlots, HashGuidAge(record.guid, record.age), i);
+    }
+
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.version = kIndexVersion;
+    header.recordCount = count;
+    header.slotCount = slotCount;
+    header.recordsOffset = sizeof(IndexHeader);
+    header.guidSlotsOffset = header.recordsOffset + static_cast<uint64_t>(count) * sizeof(IndexRecord);
+    header.pathSlotsOffset = header.guidSlotsOffset + slotCount * 4ULL;
+    header.stringsOffset = header.pathSlotsOffset + slotCount * 4ULL;
+    header.stringsSize = strings.size();
+
+    std::string tempPath = TempPathFor(path);
+    FILE* fp = OpenFile(tempPath, "wb");
+    if (!fp)
+        return false;
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    for (uint32_t i = 0; ok && i < count; ++i)
+        ok = fwrite(&entries[i].record, sizeof(IndexRecord), 1, fp) == 1;
+    ok = ok && fwrite(guidSlots.data(), 4, slotCount, fp) == slotCount;
+    ok = ok && fwrite(pathSlots.data(), 4, slotCount, fp) == slotCount;
+    ok = ok && (strings.empty() || fwrite(strings.data(), 1, strings.size(), fp) == strings.size());
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || !RenameReplace(tempPath, path))
+    {
+        RemoveFile(tempPath);
+        return false;
+    }
+    return true;
+}
+
+static int HexDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+bool ParseGuid(const char* text, PdbGuid* pGuid)
+{
+    uint8_t bytes[16];
+    int nibbles = 0;
+    for (const char* p = text; *p; ++p)
+    {
+        if (*p == '{' || *p == '}' || *p == '-')
+            continue;
+        int digit = HexDigit(*p);
+        if (digit < 0 || nibbles == 32)
+            return false;
+        if (nibbles % 2 == 0)
+            bytes[nibbles / 2] = static_cast<uint8_t>(digit << 4);
+        else
+            bytes[nibbles / 2] |= static_cast<uint8_t>(digit);
+        ++nibbles;
+    }
+    if (nibbles != 32)
+        return false;
+    // The text form is big-endian for the first three fields.
+    pGuid->Data1 = (bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+    pGuid->Data2 = static_cast<uint16_t>((bytes[4] << 8) | bytes[5]);
+    pGuid->Data3 = static_cast<uint16_t>((bytes[6] << 8) | bytes[7]);
+    memcpy(pGuid->Data4, bytes + 8, 8);
+    return true;
+}
+
+static void PrintIndexUsage()
+{
+    printf("Builds or incrementally updates an index of pdb identities.\n\n");
+    printf("usage: pdbinfo -index <indexfile> [-j threads] <dir|pdb>...\n");
+    printf("  Files whose size and modification time match the existing index\n");
+    printf("  are not opened. Paths are stored absolute, and roots that repeat or\n");
+    printf("  lie inside another root are scanned once. Runs that update the same\n");
+    printf("  index wait for each other.\n");
+}
+
+int IndexMain(int argc, char* argv[])
+{
+    unsigned threads = HardwareThreadCount();
+    const char* indexPath = nullptr;
+    std::vector<std::string> roots;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = static_cast<unsigned>(atoi(argv[++i]));
+        else if (argv[i][0] == '-')
+        {
+            PrintIndexUsage();
+            return 1;
+        }
+        else if (!indexPath)
+            indexPath = argv[i];
+        else
+            roots.push_back(AbsolutePath(argv[i]));
+    }
+    if (!indexPath || roots.empty() || threads == 0)
+    {
+        PrintIndexUsage();
+        return 1;
+    }
+    // A root that repeats or lies inside another would be walked twice and
+    // store the same PDBs twice.
+    std::sort(roots.begin(), roots.end());
+    roots.erase(std::unique(roots.begin(), roots.end()), roots.end());
+    std::vector<std::string> outerRoots;
+    for (size_t i = 0; i < roots.size(); ++i)
+    {
+        bool nested = false;
+        for (size_t j = 0; j < outerRoots.size() && !nested; ++j)
+            nested = IsWithinDirectory(roots[i], outerRoots[j]);
+        if (!nested)
+            outerRoots.push_back(roots[i]);
+    }
+    roots.swap(outerRoots);
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Two scans that update the same index at once would each start from the
+    // old one, and the last to finish would drop what the other found. The
+    // lock is on a file beside the index, since the index is replaced.
+    FileLock lock;
+    if (!lock.Lock(std::string(indexPath) + ".lock"))
+    {
+        printf("Could not lock %s.lock.\n", indexPath);
+        return 1;
+    }
+
+    PdbIndex oldIndex;
+    if (oldIndex.Open(indexPath))
+        printf("Loaded %u records from %s.\n", oldIndex.RecordCount(), indexPath);
+
+    // One result vector per worker so that the visit callback never locks.
+    std::vector<std::vector<IndexEntry>> results(threads);
+    std::vector<const char*> suffixes(1, ".pdb");
+    {
+        WorkStealingPool pool(threads);
+        WalkTree(pool, roots, suffixes, [&](const std::string& path)
+        {
+            FileStat st;
+            if (!GetFileStat(path, &st))
+                return;
+            IndexEntry entry;
+            entry.path = path;
+            const IndexRecord* pOld = oldIndex.FindPath(path);
+            if (pOld && pOld->size == st.size && pOld->mtime == st.mtime)
+                entry.record = *pOld;
+            else
+            {
+                memset(&entry.record, 0, sizeof(entry.record));
+                entry.record.size = st.size;
+                entry.record.mtime = st.mtime;
+                PdbIdentity identity;
+                const char* error = nullptr;
+                if (ReadPdbIdentityFromFile(path, &identity, nullptr, &error))
+                {
+                    entry.record.timeStamp = identity.timeStamp;
+                    entry.record.age = identity.age;
+                    entry.record.guid = identity.guid;
+                }
+                else
+                    entry.record.flags = kIndexRecordInvalid;
+            }
+            results[pool.CurrentWorker()].push_back(entry);
+        });
+    }
+
+    std::vector<IndexEntry> entries;
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        entries.insert(entries.end(), results[i].begin(), results[i].end());
+        std::vector<IndexEntry>().swap(results[i]);
+    }
+    // Links can still lead to the same file by two routes, so keep one entry
+    // per path and count only after that.
+    std::sort(entries.begin(), entries.end(), [](const IndexEntry& a, const IndexEntry& b)
+    {
+        return a.path < b.path;
+    });
+    entries.erase(std::unique(entries.begin(), entries.end(), [](const IndexEntry& a, const IndexEntry& b)
+    {
+        return a.path == b.path;
+    }), entries.end());
+
+    uint64_t reused = 0;
+    uint64_t changed = 0;
+    uint64_t added = 0;
+    uint64_t invalid = 0;
+    std::unordered_set<std::string> seen;
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        const IndexEntry& entry = entries[i];
+        seen.insert(entry.path);
+        const IndexRecord* pOld = oldIndex.FindPath(entry.path);
+        if (pOld && pOld->size == entry.record.size && pOld->mtime == entry.record.mtime)
+            ++reused;
+        else
+        {
+            ++(pOld ? changed : added);
+            if (entry.record.flags & kIndexRecordInvalid)
+                ++invalid;
+        }
+    }
+    uint64_t removed = 0;
+    for (uint32_t i = 0; i < oldIndex.RecordCount(); ++i)
+    {
+        if (!seen.count(oldIndex.RecordPath(i)))
+            ++removed;
+    }
+    // Drop the mapping before the new file is renamed over it.
+    oldIndex.Close();
+
+    if (!WritePdbIndex(indexPath, &entries))
+    {
+        printf("Could not write %s.\n", indexPath);
+        return 1;
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("Indexed %llu files in %.3f s: %llu unchanged, %llu changed, %llu new, %llu removed.\n",
+           static_cast<unsigned long long>(entries.size()), elapsed,
+           static_cast<unsigned long long>(reused), static_cast<unsigned long long>(changed),
+           static_cast<unsigned long long>(added), static_cast<unsigned long long>(removed));
+    if (invalid)
+        printf("%llu changed or new files were not valid PDBs.\n", static_cast<unsigned long long>(invalid));
+    return 0;
+}
+
+int LookupMain(int argc, char* argv[])
+{
+    PdbGuid guid;
+    if (argc != 3 || !ParseGuid(argv[1], &guid))
+    {
+        printf("Finds pdbs in an index by GUID and age.\n\n");
+        printf("usage: pdbinfo -lookup <indexfile> <guid> <age>\n");
+        return 1;
+    }
+    uint32_t age = static_cast<uint32_t>(strtoul(argv[2], nullptr, 0));
+
+    PdbIndex index;
+    if (!index.Open(argv[0]))
+    {
+        printf("Could not open index %s.\n", argv[0]);
+        return 1;
+    }
+    std::vector<uint32_t> matches;
+    index.FindGuidAge(guid, age, &matches);
+    for (size_t i = 0; i < matches.size(); ++i)
+        printf("%s\n", index.RecordPath(matches[i]).c_str());
+    return matches.empty() ? 1 : 0;
+}
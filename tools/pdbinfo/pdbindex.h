@@ -0,0 +1,105 @@
+// Copyright 2013 Cygnus Software
+// A persistent index of PDB identities, keyed by (path, size, mtime). The
+// index is a single file that is memory mapped for use, so loading it costs
+// nothing beyond the pages that a lookup touches. It contains two open
+// addressing hash tables, one keyed by path for incremental rescans and one
+// keyed by GUID and age for symbol lookups.
+//
+// File layout, all little-endian and 8-byte aligned:
+//   IndexHeader
+//   IndexRecord records[recordCount]      Sorted by path.
+//   uint32_t    guidSlots[slotCount]      Record index + 1, 0 when empty.
+//   uint32_t    pathSlots[slotCount]      Record index + 1, 0 when empty.
+//   char        strings[stringsSize]      Paths, not null terminated.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "mappedfile.h"
+#include "pdb.h"
+
+// Version 2 stores the DBI age. Version 1 indexes stored the info stream's
+// age, so they are rebuilt rather than reused.
+const uint32_t kIndexVersion = 2;
+
+struct IndexHeader
+{
+    char magic[8];              // "PDBIDX\0\0"
+    uint32_t version;
+    uint32_t recordCount;
+    uint32_t slotCount;         // Power of two, at least twice recordCount.
+    uint32_t reserved;
+    uint64_t recordsOffset;
+    uint64_t guidSlotsOffset;
+    uint64_t pathSlotsOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+};
+
+// Set on records for files that exist but could not be decoded, so that an
+// unchanged bad file isn't reopened on every rescan.
+const uint32_t kIndexRecordInvalid = 1;
+
+struct IndexRecord
+{
+    uint64_t size;
+    int64_t mtime;
+    uint64_t pathOffset;
+    uint32_t pathLength;
+    uint32_t flags;
+    uint32_t timeStamp;
+    uint32_t age;
+    PdbGuid guid;
+};
+
+// An in-memory record used while building an index.
+struct IndexEntry
+{
+    std::string path;
+    IndexRecord record;
+};
+
+uint64_t HashGuidAge(const PdbGuid& guid, uint32_t age);
+
+class PdbIndex
+{
+public:
+    PdbIndex();
+
+    // Map an index file. Returns false if it is missing or malformed.
+    bool Open(const char* path);
+    // Use an index that is already in memory. The data must be 8 byte
+    // aligned and remain valid for as long as this object is used.
+    bool Open(const uint8_t* data, size_t size);
+    void Close();
+
+    uint32_t RecordCount() const { return header_ ? header_->recordCount : 0; }
+    const IndexRecord& Record(uint32_t index) const { return records_[index]; }
+    std::string RecordPath(uint32_t index) const;
+
+    // Returns the record for path, or null if it isn't in the index.
+    const IndexRecord* FindPath(const std::string& path) const;
+
+    // Append the indices of all valid records with this GUID and age. There
+    // can be more than one when the same PDB is stored in several places.
+    void FindGuidAge(const PdbGuid& guid, uint32_t age, std::vector<uint32_t>* pMatches) const;
+
+private:
+    MappedFile file_;
+    const IndexHeader* header_;
+    const IndexRecord* records_;
+    const uint32_t* guidSlots_;
+    const uint32_t* pathSlots_;
+    const char* strings_;
+};
+
+// Write an index containing the entries, which are sorted by path first.
+// The file is written beside the destination and renamed over it, so a
+// concurrent reader sees either the old or the new index.
+bool WritePdbIndex(const char* path, std::vector<IndexEntry>* pEntries);
+
+// Parse a GUID with or without braces and dashes.
+bool ParseGuid(const char* text, PdbGuid* pGuid);
@@ -4,97 +4,123 @@
 // are all that matters for matching a PDB file to an executable, crash
 // dump, etc.
 //
+// The PDB is read directly rather than through DIA. The file is memory
+// mapped and only the MSF superblock, the stream directory and the PDB
+// info stream are touched, so this works on any OS and doesn't require
+// msdia*.dll to be registered.
+//
 
 #include <stdio.h>
-#include <tchar.h>
-#include <atlbase.h>
-#include "dia2.h"
-
-#pragma comment(lib, "diaguids.lib")
-
-bool DumpAgeAndSignature(_TCHAR* sFile);
-
-int _tmain(int argc, _TCHAR* argv[])
+#include <string.h>
+#include <string>
+#include <vector>
+#include "commands.h"
+#include "mappedfile.h"
+#include "msf.h"
+#include "pdb.h"
+#include "platform.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+bool DumpAgeAndSignature(const char* sFile);
+
+static int Main(int argc, char* argv[])
 {
-    if (argc != 2)
+    if (argc >= 2 && strcmp(argv[1], "-r") == 0)
+        return ScanMain(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "-index") == 0)
+        return IndexMain(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "-lookup") == 0)
+        return LookupMain(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "-match") == 0)
+        return MatchMain(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "-ingest") == 0)
+        return IngestMain(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "-symbolize") == 0)
+        return SymbolizeMain(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "-bloat") == 0)
+        return BloatMain(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "-diff") == 0)
+        return DiffMain(argc - 2, argv + 2);
+    if (argc >= 2 && strcmp(argv[1], "-repack") == 0)
+        return RepackMain(argc - 2, argv + 2);
+
+    if (argc != 2 || argv[1][0] == '-')
     {
         printf("Displays pdb file age and guid.\n\n");
-        printf("usage: %S <pdb>\n", argv[0]);
-        return 1;
-    }
-
-    if (FAILED(CoInitialize(NULL)))
-    {
-        printf("CoInitialize failed.\n");
+        printf("usage: %s <pdb>\n", argv[0]);
+        printf("       %s -r [-json] [-j threads] <dir|pdb>...\n", argv[0]);
+        printf("       %s -index <indexfile> [-j threads] <dir|pdb>...\n", argv[0]);
+        printf("       %s -lookup <indexfile> <guid> <age>\n", argv[0]);
+        printf("       %s -match [-j threads] -bin <dir|binary>... [-pdb <dir|pdb>...] [-index <indexfile>...]\n", argv[0]);
+        printf("       %s -ingest <store> [-j threads] [-hardlink] <dir|pdb>...\n", argv[0]);
+        printf("       %s -symbolize [-cache <dir>] <pdb> [rva...]\n", argv[0]);
+        printf("       %s -bloat [-top count] <pdb>\n", argv[0]);
+        printf("       %s -diff [-top count] [-j threads] <pdb> <pdb>\n", argv[0]);
+        printf("       %s -repack [-block bytes] <in.pdb> <out.pdb>\n", argv[0]);
         return 1;
     }
 
-    int iResult = (DumpAgeAndSignature(argv[1]) == true) ? 0 : 1;
-
-    CoUninitialize();
-
-    return iResult;
+    return (DumpAgeAndSignature(argv[1]) == true) ? 0 : 1;
 }
 
-bool DumpAgeAndSignature(_TCHAR* sFile)
-{
-    CComPtr<IDiaDataSource> pSource;
-    if (FAILED(CoCreateInstance(CLSID_DiaSource, NULL, CLSCTX_INPROC_SERVER, __uuidof( IDiaDataSource ), (void **) &pSource)))
-    {   
-        printf("Could not CoCreate CLSID_DiaSource. Please register msdia120.dll or other msdia version.\n");
-        return false;
-    }
-
-    CComBSTR sPdbFile(sFile);
+#ifdef _WIN32
 
-    if (FAILED(pSource->loadDataFromPdb(sPdbFile)))
+// Windows passes the arguments as UTF-16. The rest of pdbinfo takes UTF-8,
+// which unlike the ANSI code page can name any file, and the console is told
+// to expect it in the output.
+int wmain(int argc, wchar_t* wargv[])
+{
+    SetConsoleOutputCP(CP_UTF8);
+    std::vector<std::string> args(argc);
+    std::vector<char*> argv(argc + 1, nullptr);
+    for (int i = 0; i < argc; ++i)
     {
-        printf("loadDataFromPdb failed.\n");
-        return false;
+        args[i] = Utf8FromWide(wargv[i]);
+        argv[i] = &args[i][0];
     }
+    return Main(argc, argv.data());
+}
 
-    CComPtr<IDiaSession> pSession;
-    if (FAILED(pSource->openSession(&pSession))) 
-    {
-        printf("openSession failed.\n");
-        return false;
-    }
+#else
 
-    CComPtr<IDiaSymbol> pGlobal;
-    if (FAILED(pSession->get_globalScope(&pGlobal)))
-    {
-        printf("get_globalScope failed.\n");
-        return false;
-    }
+int main(int argc, char* argv[])
+{
+    return Main(argc, argv);
+}
+
+#endif
 
-    // Initialize to zero so that if get_age returns S_FALSE (indicating
-    // no value available) we're guaranteed to have a valid value.
-    DWORD dwAge = 0;
-    if (FAILED(pGlobal->get_age(&dwAge)))
+bool DumpAgeAndSignature(const char* sFile)
+{
+    MappedFile file;
+    if (!file.Open(sFile))
     {
-        printf("get_age failed.\n");
+        printf("Could not open %s: %s.\n", sFile, file.Error());
         return false;
     }
 
-    GUID guid = {};
-    if (FAILED(pGlobal->get_guid(&guid)))
+    MsfFile msf;
+    if (!msf.Open(file.Data(), file.Size()))
     {
-        printf("get_guid failed.\n");
+        printf("%s is not a valid PDB file: %s.\n", sFile, msf.Error());
         return false;
     }
 
-    DWORD timeStamp = 0;
-    // Yes, you use get_signature to get the timestamp, not get_timestamp
-    if (FAILED(pGlobal->get_signature(&timeStamp)))
+    PdbIdentity identity;
+    if (!ReadPdbIdentity(msf, &identity))
     {
-        printf("get_signature failed.\n");
+        printf("Could not read the PDB info stream.\n");
         return false;
     }
 
-    wchar_t wszGuid[64];
-    StringFromGUID2(guid, wszGuid, 64);
+    char szGuid[kGuidStringSize];
+    FormatGuid(identity.guid, szGuid);
     printf("Timestamp            GUID                        age\n");
-    printf("%08X, %ws, %d\n", timeStamp, wszGuid, dwAge);
+    printf("%08X, %s, %u\n", identity.timeStamp, szGuid, identity.age);
 
     return true;
 }
@@ -0,0 +1,153 @@
+// Copyright 2013 Cygnus Software
+
+#include "pe.h"
+
+#include <string.h>
+#include "mappedfile.h"
+#include "msf.h"
+
+static const uint16_t kDosMagic = 0x5A4D;               // "MZ"
+static const uint32_t kPeSignature = 0x00004550;        // "PE\0\0"
+static const uint16_t kOptionalHeader32Magic = 0x10B;
+static const uint16_t kOptionalHeader64Magic = 0x20B;
+static const uint32_t kDebugDirectoryIndex = 6;
+static const uint32_t kDebugTypeCodeView = 2;
+static const uint32_t kCodeViewRsdsSignature = 0x53445352;  // "RSDS"
+static const uint32_t kCodeViewNb10Signature = 0x3031424E;  // "NB10"
+static const size_t kDebugDirectoryEntrySize = 28;
+static const size_t kSectionHeaderSize = 40;
+
+// Convert an RVA to a file offset using the section table. Returns false if
+// the RVA isn't backed by file data.
+static bool RvaToOffset(const uint8_t* sections, uint32_t sectionCount, uint32_t rva, uint32_t* pOffset)
+{
+    for (uint32_t i = 0; i < sectionCount; ++i)
+    {
+        const uint8_t* section = sections + i * kSectionHeaderSize;
+        uint32_t virtualSize = LoadU32(section + 8);
+        uint32_t virtualAddress = LoadU32(section + 12);
+        uint32_t rawSize = LoadU32(section + 16);
+        uint32_t rawPointer = LoadU32(section + 20);
+        uint32_t extent = virtualSize > rawSize ? virtualSize : rawSize;
+        if (rva >= virtualAddress && rva - virtualAddress < extent)
+        {
+            if (rva - virtualAddress >= rawSize)
+                return false;
+            *pOffset = rawPointer + (rva - virtualAddress);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ReadCodeViewInfo(const uint8_t* data, size_t size, CodeViewInfo* pInfo, const char** pError)
+{
+    if (size < 0x40 || LoadU16(data) != kDosMagic)
+    {
+        *pError = "not a PE file";
+        return false;
+    }
+    uint32_t peOffset = LoadU32(data + 0x3C);
+    // Signature plus the 20 byte COFF file header.
+    if (peOffset > size || size - peOffset < 24 || LoadU32(data + peOffset) != kPeSignature)
+    {
+        *pError = "not a PE file";
+        return false;
+    }
+    const uint8_t* fileHeader = data + peOffset + 4;
+    uint32_t sectionCount = LoadU16(fileHeader + 2);
+    pInfo->timeDateStamp = LoadU32(fileHeader + 4);
+    uint32_t optionalHeaderSize = LoadU16(fileHeader + 16);
+    const uint8_t* optionalHeader = fileHeader + 20;
+    size_t optionalOffset = optionalHeader - data;
+    if (size - optionalOffset < optionalHeaderSize ||
+        (size - optionalOffset - optionalHeaderSize) / kSectionHeaderSize < sectionCount)
+    {
+        *pError = "truncated PE headers";
+        return false;
+    }
+
+    // The data directories are at a different offset for PE32 and PE32+.
+    uint32_t directoryCountOffset;
+    uint16_t magic = optionalHeaderSize >= 2 ? LoadU16(optionalHeader) : 0;
+    if (magic == kOptionalHeader32Magic)
+        directoryCountOffset = 92;
+    else if (magic == kOptionalHeader64Magic)
+        directoryCountOffset = 108;
+    else
+    {
+        *pError = "unknown optional header type";
+        return false;
+    }
+    if (optionalHeaderSize < directoryCountOffset + 4)
+    {
+        *pError = "truncated optional header";
+        return false;
+    }
+    pInfo->sizeOfImage = LoadU32(optionalHeader + 56);
+    uint32_t directoryCount = LoadU32(optionalHeader + directoryCountOffset);
+    uint32_t debugEntryOffset = directoryCountOffset + 4 + kDebugDirectoryIndex * 8;
+    if (directoryCount <= kDebugDirectoryIndex || optionalHeaderSize < debugEntryOffset + 8)
+    {
+        *pError = "no debug directory";
+        return false;
+    }
+    uint32_t debugRva = LoadU32(optionalHeader + debugEntryOffset);
+    uint32_t debugSize = LoadU32(optionalHeader + debugEntryOffset + 4);
+    const uint8_t* sections = optionalHeader + optionalHeaderSize;
+    uint32_t debugOffset;
+    if (debugRva == 0 || !RvaToOffset(sections, sectionCount, debugRva, &debugOffset) ||
+        debugOffset > size || size - debugOffset < debugSize)
+    {
+        *pError = "no debug directory";
+        return false;
+    }
+
+    bool sawNb10 = false;
+    for (uint32_t entry = 0; entry < debugSize / kDebugDirectoryEntrySize; ++entry)
+    {
+        const uint8_t* debugEntry = data + debugOffset + entry * kDebugDirectoryEntrySize;
+        if (LoadU32(debugEntry + 12) != kDebugTypeCodeView)
+            continue;
+        uint32_t cvSize = LoadU32(debugEntry + 16);
+        uint32_t cvOffset = LoadU32(debugEntry + 24);
+        if (cvOffset > size || size - cvOffset < cvSize || cvSize < 4)
+            continue;
+        const uint8_t* cv = data + cvOffset;
+        uint32_t signature = LoadU32(cv);
+        if (signature == kCodeViewNb10Signature)
+            sawNb10 = true;
+        // RSDS header: signature, GUID, age, then a null terminated path.
+        if (signature != kCodeViewRsdsSignature || cvSize < 24)
+            continue;
+        pInfo->guid.Data1 = LoadU32(cv + 4);
+        pInfo->guid.Data2 = LoadU16(cv + 8);
+        pInfo->guid.Data3 = LoadU16(cv + 10);
+        memcpy(pInfo->guid.Data4, cv + 12, 8);
+        pInfo->age = LoadU32(cv + 20);
+        const char* path = reinterpret_cast<const char*>(cv + 24);
+        const void* terminator = memchr(path, 0, cvSize - 24);
+        size_t pathLength = terminator ? static_cast<const char*>(terminator) - path : cvSize - 24;
+        pInfo->pdbPath.assign(path, pathLength);
+        return true;
+    }
+    *pError = sawNb10 ? "NB10 (pre-VC 7.0) CodeView records are not supported" : "no RSDS CodeView record";
+    return false;
+}
+
+bool ReadCodeViewInfoFromFile(const std::string& path, CodeViewInfo* pInfo, const char** pError)
+{
+    MappedFile file;
+    if (!file.Open(path.c_str()))
+    {
+        *pError = file.Error();
+        return false;
+    }
+    return ReadCodeViewInfo(file.Data(), file.Size(), pInfo, pError);
+}
+
+std::string PathFileName(const std::string& path)
+{
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
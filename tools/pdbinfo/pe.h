@@ -0,0 +1,38 @@
+// Copyright 2013 Cygnus Software
+// Just enough of a PE/COFF reader to pull the CodeView debug record out of
+// an executable or DLL. The RSDS record holds the GUID, age and PDB path
+// that the linker wrote, which is exactly what is needed to find the
+// matching PDB. Only the headers and the debug data are read, so a mapped
+// multi-megabyte DLL costs a couple of page faults.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include "pdb.h"
+
+struct CodeViewInfo
+{
+    // TimeDateStamp from the COFF file header. Together with SizeOfImage it
+    // is the symbol server key for the binary itself.
+    uint32_t timeDateStamp;
+    uint32_t sizeOfImage;
+    PdbGuid guid;
+    uint32_t age;
+    // PDB path as recorded by the linker, usually a full path on the build
+    // machine.
+    std::string pdbPath;
+};
+
+// Returns false and sets pError if the data isn't a PE file or has no
+// RSDS CodeView debug record.
+bool ReadCodeViewInfo(const uint8_t* data, size_t size, CodeViewInfo* pInfo, const char** pError);
+
+// Map a binary and read its CodeView record.
+bool ReadCodeViewInfoFromFile(const std::string& path, CodeViewInfo* pInfo, const char** pError);
+
+// The file name part of a path, accepting either kind of slash since PDB
+// paths recorded on Windows are often examined elsewhere.
+std::string PathFileName(const std::string& path);
@@ -0,0 +1,245 @@
+// Copyright 2013 Cygnus Software
+
+#include "place.h"
+
+#include <stdio.h>
+#include <atomic>
+#include <vector>
+#include "platform.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+#endif
+
+const char* PlaceMethodName(PlaceMethod method)
+{
+    switch (method)
+    {
+    case kPlaceHardLink:
+        return "hard link";
+    case kPlaceReflink:
+        return "reflink";
+    case kPlaceCopyRange:
+        return "kernel copy";
+    case kPlaceBufferedCopy:
+        return "buffered copy";
+    default:
+        return "unknown";
+    }
+}
+
+static std::string ParentDirectory(const std::string& path)
+{
+    size_t slash = path.find_last_of("/\\");
+    if (slash == std::string::npos)
+        return std::string();
+    return path.substr(0, slash);
+}
+
+std::string TempPathFor(const std::string& dest)
+{
+    static std::atomic<unsigned> s_counter(0);
+    char suffix[64];
+#ifdef _WIN32
+    unsigned long pid = GetCurrentProcessId();
+#else
+    unsigned long pid = static_cast<unsigned long>(getpid());
+#endif
+    sprintf(suffix, ".%lu.%u.tmp", pid, s_counter++);
+    return dest + suffix;
+}
+
+#ifdef _WIN32
+
+bool MakeDirectories(const std::string& path)
+{
+    if (path.empty())
+        return true;
+    DWORD attributes = GetFileAttributesW(WidePath(path).c_str());
+    if (attributes != INVALID_FILE_ATTRIBUTES)
+        return (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    if (!MakeDirectories(ParentDirectory(path)))
+        return false;
+    return CreateDirectoryW(WidePath(path).c_str(), NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+bool PlaceFile(const std::string& source, const std::string& dest, bool allowHardLink,
+               PlaceMethod* pMethod, const char** pError)
+{
+    if (!MakeDirectories(ParentDirectory(dest)))
+    {
+        *pError = "could not create destination directory";
+        return false;
+    }
+    std::string temp = TempPathFor(dest);
+    if (allowHardLink && CreateHardLinkW(WidePath(temp).c_str(), WidePath(source).c_str(), NULL))
+    {
+        *pMethod = kPlaceHardLink;
+    }
+    else
+    {
+        // CopyFileEx uses block cloning on ReFS and server side copies on
+        // SMB, so it covers the reflink and copy offload cases.
+        if (!CopyFileExW(WidePath(source).c_str(), WidePath(temp).c_str(), NULL, NULL, NULL, COPY_FILE_FAIL_IF_EXISTS))
+        {
+            *pError = "copy failed";
+            return false;
+        }
+        *pMethod = kPlaceCopyRange;
+    }
+    if (!RenameReplace(temp, dest))
+    {
+        DeleteFileW(WidePath(temp).c_str());
+        *pError = "could not rename into place";
+        return false;
+    }
+    return true;
+}
+
+#else
+
+bool MakeDirectories(const std::string& path)
+{
+    if (path.empty())
+        return true;
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0)
+        return S_ISDIR(st.st_mode);
+    if (!MakeDirectories(ParentDirectory(path)))
+        return false;
+    return mkdir(path.c_str(), 0777) == 0 || errno == EEXIST;
+}
+
+static bool BufferedCopy(int in, int out)
+{
+    std::vector<char> buffer(1 << 20);
+    for (;;)
+    {
+        ssize_t bytesRead = read(in, buffer.data(), buffer.size());
+        if (bytesRead == 0)
+            return true;
+        if (bytesRead < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        for (ssize_t written = 0; written < bytesRead;)
+        {
+            ssize_t result = write(out, buffer.data() + written, bytesRead - written);
+            if (result < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            written += result;
+        }
+    }
+}
+
+// Copy the file contents from in to out using the cheapest available method.
+static bool CloneOrCopy(int in, int out, uint64_t size, PlaceMethod* pMethod)
+{
+#if defined(__linux__) && defined(FICLONE)
+    if (ioctl(out, FICLONE, in) == 0)
+    {
+        *pMethod = kPlaceReflink;
+        return true;
+    }
+#endif
+
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+    uint64_t copied = 0;
+    while (copied < size)
+    {
+        ssize_t result = copy_file_range(in, nullptr, out, nullptr, size - copied, 0);
+        if (result <= 0)
+        {
+            if (result < 0 && errno == EINTR)
+                continue;
+            break;
+        }
+        copied += result;
+    }
+    if (copied == size)
+    {
+        *pMethod = kPlaceCopyRange;
+        return true;
+    }
+    // Unsupported (EXDEV on older kernels, ENOSYS, EINVAL on some file
+    // systems). Start over with a plain copy.
+    if (lseek(in, 0, SEEK_SET) != 0 || lseek(out, 0, SEEK_SET) != 0 || ftruncate(out, 0) != 0)
+        return false;
+#else
+    (void)size;
+#endif
+
+    *pMethod = kPlaceBufferedCopy;
+    return BufferedCopy(in, out);
+}
+
+bool PlaceFile(const std::string& source, const std::string& dest, bool allowHardLink,
+               PlaceMethod* pMethod, const char** pError)
+{
+    if (!MakeDirectories(ParentDirectory(dest)))
+    {
+        *pError = "could not create destination directory";
+        return false;
+    }
+    std::string temp = TempPathFor(dest);
+    if (allowHardLink && link(source.c_str(), temp.c_str()) == 0)
+    {
+        *pMethod = kPlaceHardLink;
+    }
+    else
+    {
+        int in = open(source.c_str(), O_RDONLY | O_CLOEXEC);
+        if (in < 0)
+        {
+            *pError = "could not open source";
+            return false;
+        }
+        struct stat st;
+        if (fstat(in, &st) != 0)
+        {
+            close(in);
+            *pError = "could not stat source";
+            return false;
+        }
+        int out = open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (out < 0)
+        {
+            close(in);
+            *pError = "could not create temporary file";
+            return false;
+        }
+        bool copied = CloneOrCopy(in, out, static_cast<uint64_t>(st.st_size), pMethod);
+        close(in);
+        if (close(out) != 0 || !copied)
+        {
+            unlink(temp.c_str());
+            *pError = "copy failed";
+            return false;
+        }
+    }
+    if (!RenameReplace(temp, dest))
+    {
+        unlink(temp.c_str());
+        *pError = "could not rename into place";
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,43 @@
+// Copyright 2013 Cygnus Software
+// Publishing a file at a new path while copying as few bytes as possible.
+// The cheapest method that the file system supports is used:
+//   hard link        Only when allowed, since the store then aliases the
+//                    source and an in-place rewrite (incremental linking
+//                    updates PDBs in place) would change the stored copy.
+//   reflink          Copy-on-write clone (FICLONE on btrfs/XFS, block
+//                    cloning on ReFS through CopyFileEx).
+//   kernel copy      copy_file_range or CopyFileEx, which NFS and SMB
+//                    servers can offload.
+//   buffered copy    Plain read/write as a last resort.
+// The data is always written to a temporary file beside the destination
+// and renamed into place, so readers never see a partial file.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+enum PlaceMethod
+{
+    kPlaceHardLink,
+    kPlaceReflink,
+    kPlaceCopyRange,
+    kPlaceBufferedCopy,
+    kPlaceMethodCount
+};
+
+const char* PlaceMethodName(PlaceMethod method);
+
+// Publish source at dest, creating dest's directory if needed. On success
+// pMethod says which method worked. On failure pError describes the step
+// that failed.
+bool PlaceFile(const std::string& source, const std::string& dest, bool allowHardLink,
+               PlaceMethod* pMethod, const char** pError);
+
+// A name beside dest that no other thread or process will pick, for writing
+// a file that is then renamed over dest.
+std::string TempPathFor(const std::string& dest);
+
+// Create a directory and any missing parents. Succeeds if it already exists.
+bool MakeDirectories(const std::string& path);
@@ -0,0 +1,337 @@
+// Copyright 2013 Cygnus Software
+
+#include "platform.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/file.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+static const char kPathSeparator = '\\';
+
+// FILETIME is in 100 ns units since 1601.
+static int64_t FileTimeToUnixNs(const FILETIME& ft)
+{
+    uint64_t ticks = (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+    return (static_cast<int64_t>(ticks) - 116444736000000000LL) * 100;
+}
+
+std::wstring WidePath(const std::string& path)
+{
+    if (path.empty())
+        return std::wstring();
+    int length = MultiByteToWideChar(CP_UTF8, 0, path.data(), static_cast<int>(path.size()), NULL, 0);
+    std::wstring wide(length, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, path.data(), static_cast<int>(path.size()), &wide[0], length);
+    return wide;
+}
+
+std::string Utf8FromWide(const wchar_t* text)
+{
+    int length = WideCharToMultiByte(CP_UTF8, 0, text, -1, NULL, 0, NULL, NULL);
+    if (length <= 1)
+        return std::string();
+    std::string utf8(length, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, text, -1, &utf8[0], length, NULL, NULL);
+    utf8.resize(length - 1);
+    return utf8;
+}
+
+bool ListDirectory(const std::string& directory, std::vector<DirEntry>* pEntries)
+{
+    pEntries->clear();
+    WIN32_FIND_DATAW findData;
+    HANDLE hFind = FindFirstFileExW(WidePath(JoinPath(directory, "*")).c_str(), FindExInfoBasic, &findData,
+                                    FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+    if (hFind == INVALID_HANDLE_VALUE)
+        return false;
+    do
+    {
+        if (wcscmp(findData.cFileName, L".") == 0 || wcscmp(findData.cFileName, L"..") == 0)
+            continue;
+        DirEntry entry;
+        entry.name = Utf8FromWide(findData.cFileName);
+        entry.isDirectory = (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0 &&
+                            (findData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0;
+        pEntries->push_back(entry);
+    } while (FindNextFileW(hFind, &findData));
+    FindClose(hFind);
+    return true;
+}
+
+bool GetFileStat(const std::string& path, FileStat* pStat)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(WidePath(path).c_str(), GetFileExInfoStandard, &data))
+        return false;
+    pStat->size = (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    pStat->mtime = FileTimeToUnixNs(data.ftLastWriteTime);
+    pStat->isDirectory = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    return true;
+}
+
+FILE* OpenFile(const std::string& path, const char* mode)
+{
+    return _wfopen(WidePath(path).c_str(), WidePath(mode).c_str());
+}
+
+bool RemoveFile(const std::string& path)
+{
+    return _wremove(WidePath(path).c_str()) == 0;
+}
+
+std::string AbsolutePath(const std::string& path)
+{
+    std::wstring wide = WidePath(path);
+    DWORD length = GetFullPathNameW(wide.c_str(), 0, NULL, NULL);
+    if (length == 0)
+        return path;
+    std::wstring full(length, L'\0');
+    length = GetFullPathNameW(wide.c_str(), length, &full[0], NULL);
+    if (length == 0 || length >= full.size())
+        return path;
+    full.resize(length);
+    return Utf8FromWide(full.c_str());
+}
+
+bool RenameReplace(const std::string& from, const std::string& to)
+{
+    return MoveFileExW(WidePath(from).c_str(), WidePath(to).c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+FileLock::FileLock() : handle_(reinterpret_cast<intptr_t>(INVALID_HANDLE_VALUE)) {}
+
+FileLock::~FileLock()
+{
+    // Closing the handle releases the lock.
+    if (handle_ != reinterpret_cast<intptr_t>(INVALID_HANDLE_VALUE))
+        CloseHandle(reinterpret_cast<HANDLE>(handle_));
+}
+
+bool FileLock::Lock(const std::string& path)
+{
+    HANDLE hFile = CreateFileW(WidePath(path).c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                               NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+    handle_ = reinterpret_cast<intptr_t>(hFile);
+    OVERLAPPED overlapped = {};
+    return LockFileEx(hFile, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped) != 0;
+}
+
+bool RemoveEmptyDirectory(const std::string& path)
+{
+    return RemoveDirectoryW(WidePath(path).c_str()) != 0;
+}
+
+bool DropFileCache(const std::string& path)
+{
+    // Opening a file without buffering makes the cache manager flush and
+    // purge the pages it has cached for it.
+    HANDLE hFile = CreateFileW(WidePath(path).c_str(), GENERIC_READ,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+                               FILE_FLAG_NO_BUFFERING, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+    CloseHandle(hFile);
+    return true;
+}
+
+double ProcessCpuSeconds()
+{
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        return 0.0;
+    uint64_t k = (static_cast<uint64_t>(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+    uint64_t u = (static_cast<uint64_t>(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+    return (k + u) * 1e-7;
+}
+
+#else
+
+static const char kPathSeparator = '/';
+
+bool ListDirectory(const std::string& directory, std::vector<DirEntry>* pEntries)
+{
+    pEntries->clear();
+    DIR* dir = opendir(directory.c_str());
+    if (!dir)
+        return false;
+    while (struct dirent* ent = readdir(dir))
+    {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+            continue;
+        DirEntry entry;
+        entry.name = ent->d_name;
+#ifdef _DIRENT_HAVE_D_TYPE
+        if (ent->d_type != DT_UNKNOWN)
+        {
+            entry.isDirectory = ent->d_type == DT_DIR;
+            pEntries->push_back(entry);
+            continue;
+        }
+#endif
+        // Some file systems don't fill in d_type, so fall back to lstat.
+        struct stat st;
+        entry.isDirectory = lstat(JoinPath(directory, entry.name).c_str(), &st) == 0 &&
+                            S_ISDIR(st.st_mode);
+        pEntries->push_back(entry);
+    }
+    closedir(dir);
+    return true;
+}
+
+bool GetFileStat(const std::string& path, FileStat* pStat)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+    pStat->size = static_cast<uint64_t>(st.st_size);
+#if defined(__APPLE__)
+    pStat->mtime = st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+    pStat->mtime = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+    pStat->isDirectory = S_ISDIR(st.st_mode);
+    return true;
+}
+
+FILE* OpenFile(const std::string& path, const char* mode)
+{
+    return fopen(path.c_str(), mode);
+}
+
+bool RemoveFile(const std::string& path)
+{
+    return remove(path.c_str()) == 0;
+}
+
+std::string AbsolutePath(const std::string& path)
+{
+    char* resolved = realpath(path.c_str(), nullptr);
+    if (!resolved)
+        return path;
+    std::string absolute = resolved;
+    free(resolved);
+    return absolute;
+}
+
+bool RenameReplace(const std::string& from, const std::string& to)
+{
+    return rename(from.c_str(), to.c_str()) == 0;
+}
+
+FileLock::FileLock() : handle_(-1) {}
+
+FileLock::~FileLock()
+{
+    if (handle_ >= 0)
+        close(static_cast<int>(handle_));
+}
+
+bool FileLock::Lock(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (fd < 0)
+        return false;
+    handle_ = fd;
+    while (flock(fd, LOCK_EX) != 0)
+    {
+        if (errno != EINTR)
+            return false;
+    }
+    return true;
+}
+
+bool RemoveEmptyDirectory(const std::string& path)
+{
+    return rmdir(path.c_str()) == 0;
+}
+
+bool DropFileCache(const std::string& path)
+{
+#ifdef POSIX_FADV_DONTNEED
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    // Dirty pages can't be dropped, so write them back first.
+    fsync(fd);
+    bool dropped = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return dropped;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+double ProcessCpuSeconds()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0.0;
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}
+
+#endif
+
+bool IsWithinDirectory(const std::string& path, const std::string& directory)
+{
+    if (directory.empty() || path.size() <= directory.size() || path.compare(0, directory.size(), directory) != 0)
+        return false;
+    char last = directory[directory.size() - 1];
+    char next = path[directory.size()];
+    return last == '/' || last == kPathSeparator || next == '/' || next == kPathSeparator;
+}
+
+std::string JoinPath(const std::string& directory, const std::string& name)
+{
+    if (directory.empty())
+        return name;
+    char last = directory[directory.size() - 1];
+    if (last == '/' || last == kPathSeparator)
+        return directory + name;
+    return directory + kPathSeparator + name;
+}
+
+bool EndsWithNoCase(const std::string& name, const char* suffix)
+{
+    size_t suffixLength = strlen(suffix);
+    if (name.size() < suffixLength)
+        return false;
+    const char* tail = name.c_str() + name.size() - suffixLength;
+    for (size_t i = 0; i < suffixLength; ++i)
+    {
+        char c = tail[i];
+        if (c >= 'A' && c <= 'Z')
+            c = static_cast<char>(c - 'A' + 'a');
+        char s = suffix[i];
+        if (s >= 'A' && s <= 'Z')
+            s = static_cast<char>(s - 'A' + 'a');
+        if (c != s)
+            return false;
+    }
+    return true;
+}
+
+unsigned HardwareThreadCount()
+{
+    unsigned count = std::thread::hardware_concurrency();
+    return count ? count : 1;
+}
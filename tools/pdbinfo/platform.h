@@ -0,0 +1,95 @@
+// Copyright 2013 Cygnus Software
+// Thin wrappers around the few OS services that pdbinfo needs beyond the
+// C runtime, so that the rest of the code is the same on Windows and POSIX.
+//
+// Paths are UTF-8 everywhere. On Windows the wrappers convert them for the
+// wide file APIs, so that names outside the ANSI code page work.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+struct DirEntry
+{
+    std::string name;
+    bool isDirectory;
+};
+
+// List the entries of a directory, excluding "." and "..". Symbolic links
+// and junctions to directories are reported as files so that recursive
+// walks can't loop.
+bool ListDirectory(const std::string& directory, std::vector<DirEntry>* pEntries);
+
+struct FileStat
+{
+    uint64_t size;
+    // Modification time in nanoseconds since the Unix epoch.
+    int64_t mtime;
+    bool isDirectory;
+};
+
+bool GetFileStat(const std::string& path, FileStat* pStat);
+
+// fopen and remove, for UTF-8 paths.
+FILE* OpenFile(const std::string& path, const char* mode);
+bool RemoveFile(const std::string& path);
+
+#ifdef _WIN32
+// Conversions between UTF-8 and the UTF-16 of the wide Windows APIs.
+std::wstring WidePath(const std::string& path);
+std::string Utf8FromWide(const wchar_t* text);
+#endif
+
+// Rename from over to, replacing to if it exists.
+bool RenameReplace(const std::string& from, const std::string& to);
+
+// An exclusive lock on a file, which is created if it doesn't exist. Other
+// processes that lock the same file wait until this one is destroyed. The
+// lock is advisory: it only keeps out those that take it too.
+class FileLock
+{
+public:
+    FileLock();
+    ~FileLock();
+
+    // Blocks until the lock is held. Returns false if the file can't be
+    // opened or locked.
+    bool Lock(const std::string& path);
+
+private:
+    FileLock(const FileLock&);
+    FileLock& operator=(const FileLock&);
+
+    intptr_t handle_;
+};
+
+// Remove a directory, which must be empty.
+bool RemoveEmptyDirectory(const std::string& path);
+
+// Ask the OS to evict a file from the page cache, so that the next read
+// comes from the disk. Best effort: returns false where that isn't possible.
+bool DropFileCache(const std::string& path);
+
+// The absolute form of a path, with . and .. resolved, or the path as it is
+// if that fails, for instance because it doesn't exist. On POSIX symbolic
+// links are resolved too.
+std::string AbsolutePath(const std::string& path);
+
+// Returns true if path is below directory, by their text alone.
+bool IsWithinDirectory(const std::string& path, const std::string& directory);
+
+// Join two path components with the native separator.
+std::string JoinPath(const std::string& directory, const std::string& name);
+
+// Returns true if name ends with suffix, ignoring ASCII case.
+bool EndsWithNoCase(const std::string& name, const char* suffix);
+
+// Total user plus kernel CPU time consumed by this process, in seconds.
+double ProcessCpuSeconds();
+
+// Number of hardware threads, never less than one.
+unsigned HardwareThreadCount();
@@ -0,0 +1,414 @@
+// Copyright 2013 Cygnus Software
+// pdbinfo -repack rewrites a PDB with every stream stored contiguously.
+// Incremental linking rewrites PDBs in place. Each update allocates
+// new blocks wherever the free block map has room and frees the old ones,
+// so after a few links a stream's blocks are scattered over the file, which
+// also carries every block that was ever freed. Loading such a PDB from a
+// cold cache is a long run of random reads.
+//
+// The repacked file holds the same streams with the same stream numbers,
+// byte for byte, so the GUID and age are unchanged and the PDB still
+// matches its executable. The streams are laid out in the order that a
+// debugger or symbolizer touches them:
+//   1. The PDB info stream, the DBI stream, the named streams (/names and
+//      friends), the debug streams that the DBI header points at (section
+//      headers, FPO and OMAP data) and the publics, globals and symbol
+//      records. This is what has to be read to load the PDB and resolve an
+//      address to a function name.
+//   2. The TPI and IPI streams and their hash streams, which are read when
+//      types are needed.
+//   3. The module symbol streams, in module order, read per module on
+//      demand.
+//   4. Everything else.
+// Free blocks and orphaned blocks (marked used but not in any stream) are
+// dropped, and so is the old directory in stream 0, which only describes
+// the layout that the file had before the last incremental link. Stream 0
+// is written empty. pdbinfo -diff doesn't compare stream 0, so a repacked
+// file diffs as a layout change.
+//
+// The report compares fragmentation before and after (extents are maximal
+// runs of consecutive blocks within a stream) and the time to load the
+// streams in step 1 from a cold cache.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "commands.h"
+#include "dbi.h"
+#include "mappedfile.h"
+#include "msf.h"
+#include "msfwriter.h"
+#include "pdb.h"
+#include "place.h"
+#include "platform.h"
+
+namespace
+{
+
+const uint32_t kDebugStreams[] =
+{
+    kDbiDebugSectionHeader, kDbiDebugSectionHeaderOrig, kDbiDebugFpo, kDbiDebugNewFpo,
+    kDbiDebugOmapToSrc, kDbiDebugOmapFromSrc, kDbiDebugException, kDbiDebugFixup,
+    kDbiDebugTokenRidMap, kDbiDebugXdata, kDbiDebugPdata,
+};
+
+// Appends streams to an order, skipping ones that are already in it, don't
+// exist or are out of range.
+class StreamOrder
+{
+public:
+    explicit StreamOrder(const MsfFile& msf) : msf_(msf), added_(msf.StreamCount()) {}
+
+    void Add(uint32_t stream)
+    {
+        if (stream < added_.size() && !added_[stream] && msf_.StreamExists(stream))
+        {
+            added_[stream] = true;
+            order_.push_back(stream);
+        }
+    }
+
+    const std::vector<uint32_t>& Order() const { return order_; }
+
+private:
+    const MsfFile& msf_;
+    std::vector<bool> added_;
+    std::vector<uint32_t> order_;
+};
+
+// The streams that loading a PDB and symbolizing an address read.
+void AddHotStreams(const MsfFile& msf, StreamOrder* pOrder)
+{
+    pOrder->Add(kMsfStreamPdbInfo);
+    pOrder->Add(kMsfStreamDbi);
+    std::vector<PdbNamedStream> named;
+    if (ReadNamedStreams(msf, &named))
+    {
+        for (size_t i = 0; i < named.size(); ++i)
+            pOrder->Add(named[i].stream);
+    }
+    DbiStream dbi;
+    if (dbi.Open(msf))
+    {
+        for (size_t i = 0; i < sizeof(kDebugStreams) / sizeof(kDebugStreams[0]); ++i)
+            pOrder->Add(dbi.DebugStream(kDebugStreams[i]));
+        pOrder->Add(dbi.Header().publicStream);
+        pOrder->Add(dbi.Header().globalStream);
+        pOrder->Add(dbi.Header().symRecordStream);
+    }
+}
+
+void LayoutOrder(const MsfFile& msf, std::vector<uint32_t>* pOrder)
+{
+    StreamOrder order(msf);
+    AddHotStreams(msf, &order);
+    const uint32_t typeStreams[] = { kMsfStreamTpi, kMsfStreamIpi };
+    for (size_t i = 0; i < 2; ++i)
+    {
+        order.Add(typeStreams[i]);
+        TpiHeader header;
+        if (ReadTpiHeader(msf, typeStreams[i], &header))
+        {
+            order.Add(header.hashStream);
+            order.Add(header.hashAuxStream);
+        }
+    }
+    DbiStream dbi;
+    std::vector<DbiModule> modules;
+    if (dbi.Open(msf) && dbi.ReadModules(&modules))
+    {
+        for (size_t i = 0; i < modules.size(); ++i)
+            order.Add(modules[i].symStream);
+    }
+    for (uint32_t stream = 0; stream < msf.StreamCount(); ++stream)
+        order.Add(stream);
+    *pOrder = order.Order();
+}
+
+struct LayoutStats
+{
+    uint64_t fileBytes;
+    uint32_t blocks;
+    uint32_t freeBlocks;
+    uint32_t orphanedBlocks;
+    uint32_t streamBlocks;
+    uint32_t extents;
+    uint32_t hotBlocks;
+    uint32_t hotExtents;
+    uint32_t oldDirectoryBytes;
+};
+
+// Number of maximal runs of consecutive blocks in a stream. Stepping over
+// free block map blocks, which sit at fixed positions, doesn't end a run.
+uint32_t CountExtents(const MsfFile& msf, uint32_t stream)
+{
+    uint32_t blocks = msf.StreamBlockCount(stream);
+    uint32_t extents = blocks ? 1 : 0;
+    for (uint32_t i = 1; i < blocks; ++i)
+    {
+        uint32_t expected = msf.StreamBlock(stream, i - 1) + 1;
+        while (expected % msf.BlockSize() == 1 || expected % msf.BlockSize() == 2)
+            ++expected;
+        if (msf.StreamBlock(stream, i) != expected)
+            ++extents;
+    }
+    return extents;
+}
+
+void MeasureLayout(const MsfFile& msf, LayoutStats* pStats)
+{
+    LayoutStats& stats = *pStats;
+    memset(&stats, 0, sizeof(stats));
+    stats.fileBytes = msf.Size();
+    stats.blocks = msf.BlockCount();
+    stats.oldDirectoryBytes = msf.StreamSize(kMsfStreamOldDirectory);
+
+    // Everything that a well formed file uses: the superblock, the free
+    // block maps, the block map, the directory and the stream blocks.
+    std::vector<bool> used(msf.BlockCount());
+    used[0] = true;
+    for (uint32_t block = 1; block < msf.BlockCount(); block += msf.BlockSize())
+    {
+        used[block] = true;
+        if (block + 1 < msf.BlockCount())
+            used[block + 1] = true;
+    }
+    const uint8_t* superBlock = msf.Data();
+    uint32_t blockMapBlock = LoadU32(superBlock + 52);
+    used[blockMapBlock] = true;
+    const uint8_t* blockMap = msf.Data() + static_cast<size_t>(blockMapBlock) * msf.BlockSize();
+    for (uint32_t i = 0; i < MsfBlocksForBytes(msf.DirectoryBytes(), msf.BlockSize()); ++i)
+        used[LoadU32(blockMap + i * 4)] = true;
+    for (uint32_t stream = 0; stream < msf.StreamCount(); ++stream)
+    {
+        // Block lists are only checked when a stream is read, so a block
+        // number may be out of range here. Copying the stream will fail.
+        for (uint32_t i = 0; i < msf.StreamBlockCount(stream); ++i)
+        {
+            uint32_t block = msf.StreamBlock(stream, i);
+            if (block < used.size())
+                used[block] = true;
+        }
+        stats.streamBlocks += msf.StreamBlockCount(stream);
+        stats.extents += CountExtents(msf, stream);
+    }
+    for (uint32_t block = 0; block < msf.BlockCount(); ++block)
+    {
+        if (msf.IsBlockFree(block))
+            ++stats.freeBlocks;
+        else if (!used[block])
+            ++stats.orphanedBlocks;
+    }
+
+    StreamOrder hot(msf);
+    AddHotStreams(msf, &hot);
+    for (size_t i = 0; i < hot.Order().size(); ++i)
+    {
+        stats.hotBlocks += msf.StreamBlockCount(hot.Order()[i]);
+        stats.hotExtents += CountExtents(msf, hot.Order()[i]);
+    }
+}
+
+// Time to map a PDB and read the streams needed to load it, touching every
+// page. With cold set, the file is evicted from the cache first and
+// pCold says whether that worked. Returns a negative time on failure.
+double TimeLoad(const char* path, bool cold, bool* pCold)
+{
+    if (cold)
+        *pCold = DropFileCache(path);
+    auto start = std::chrono::steady_clock::now();
+    MappedFile file;
+    MsfFile msf;
+    if (!file.Open(path) || !msf.Open(file.Data(), file.Size()))
+        return -1.0;
+    StreamOrder hot(msf);
+    AddHotStreams(msf, &hot);
+    volatile uint8_t sink = 0;
+    for (size_t i = 0; i < hot.Order().size(); ++i)
+    {
+        uint32_t stream = hot.Order()[i];
+        for (uint32_t b = 0; b < msf.StreamBlockCount(stream); ++b)
+        {
+            const uint8_t* block = msf.StreamBlockData(stream, b);
+            if (!block)
+                return -1.0;
+            for (uint32_t offset = 0; offset < msf.BlockSize(); offset += 4096)
+                sink = sink + block[offset];
+        }
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Best of a few loads with the file cached.
+double TimeWarmLoad(const char* path)
+{
+    double best = TimeLoad(path, false, nullptr);
+    for (int i = 0; i < 2 && best >= 0; ++i)
+    {
+        double seconds = TimeLoad(path, false, nullptr);
+        if (seconds < best)
+            best = seconds;
+    }
+    return best;
+}
+
+void PrintRow(const char* label, uint64_t before, uint64_t after)
+{
+    printf("  %-26s %12llu %12llu\n", label, static_cast<unsigned long long>(before),
+           static_cast<unsigned long long>(after));
+}
+
+void PrintLoadRow(const char* label, double before, double after)
+{
+    if (before < 0 || after < 0)
+        printf("  %-26s %12s %12s\n", label, "-", "-");
+    else
+        printf("  %-26s %12.2f %12.2f\n", label, before * 1e3, after * 1e3);
+}
+
+void PrintRepackUsage()
+{
+    printf("Rewrites a pdb with each stream stored contiguously, hot streams first.\n\n");
+    printf("usage: pdbinfo -repack [-block bytes] <in.pdb> <out.pdb>\n");
+    printf("  -block bytes   Block size of the output. Defaults to that of the input.\n");
+}
+
+}  // namespace
+
+int RepackMain(int argc, char* argv[])
+{
+    uint32_t blockSize = 0;
+    std::vector<const char*> paths;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-block") == 0 && i + 1 < argc)
+            blockSize = static_cast<uint32_t>(atoi(argv[++i]));
+        else if (argv[i][0] == '-')
+        {
+            PrintRepackUsage();
+            return 1;
+        }
+        else
+            paths.push_back(argv[i]);
+    }
+    if (paths.size() != 2)
+    {
+        PrintRepackUsage();
+        return 1;
+    }
+    const char* inPath = paths[0];
+    const char* outPath = paths[1];
+
+    // Time the input first, since the output may replace it.
+    bool coldBefore = false;
+    double coldLoadBefore = TimeLoad(inPath, true, &coldBefore);
+    double warmLoadBefore = TimeWarmLoad(inPath);
+
+    LayoutStats before, after;
+    PdbIdentity identity;
+    std::string tempPath = TempPathFor(outPath);
+    {
+        MappedFile file;
+        if (!file.Open(inPath))
+        {
+            printf("Could not open %s: %s.\n", inPath, file.Error());
+            return 1;
+        }
+        MsfFile msf;
+        if (!msf.Open(file.Data(), file.Size()))
+        {
+            printf("%s is not a valid PDB file: %s.\n", inPath, msf.Error());
+            return 1;
+        }
+        if (!ReadPdbIdentity(msf, &identity))
+        {
+            printf("Could not read the PDB info stream of %s.\n", inPath);
+            return 1;
+        }
+        MeasureLayout(msf, &before);
+
+        // Each stream is a list of the source blocks, so the writer copies
+        // straight from the mapping. Stream numbers are kept.
+        MsfWriter writer(blockSize ? blockSize : msf.BlockSize());
+        for (uint32_t stream = 0; stream < msf.StreamCount(); ++stream)
+        {
+            if (!msf.StreamExists(stream))
+            {
+                writer.AddNilStream();
+                continue;
+            }
+            writer.AddStream();
+            if (stream == kMsfStreamOldDirectory)
+                continue;
+            uint32_t remaining = msf.StreamSize(stream);
+            for (uint32_t b = 0; b < msf.StreamBlockCount(stream); ++b)
+            {
+                const uint8_t* block = msf.StreamBlockData(stream, b);
+                if (!block)
+                {
+                    printf("Stream %u of %s has blocks outside the file.\n", stream, inPath);
+                    return 1;
+                }
+                uint32_t bytes = remaining < msf.BlockSize() ? remaining : msf.BlockSize();
+                writer.AppendToStream(stream, block, bytes);
+                remaining -= bytes;
+            }
+        }
+        std::vector<uint32_t> order;
+        LayoutOrder(msf, &order);
+        writer.SetLayoutOrder(order);
+        if (!writer.WriteFile(tempPath.c_str()))
+        {
+            printf("Could not write %s: %s.\n", outPath, writer.Error());
+            RemoveFile(tempPath);
+            return 1;
+        }
+    }
+
+    // Check the result before putting it in place.
+    {
+        MappedFile file;
+        MsfFile msf;
+        PdbIdentity newIdentity;
+        if (!file.Open(tempPath.c_str()) || !msf.Open(file.Data(), file.Size()) ||
+            !ReadPdbIdentity(msf, &newIdentity) || newIdentity.age != identity.age ||
+            newIdentity.infoAge != identity.infoAge ||
+            memcmp(&newIdentity.guid, &identity.guid, sizeof(identity.guid)) != 0)
+        {
+            printf("The repacked file failed verification.\n");
+            RemoveFile(tempPath);
+            return 1;
+        }
+        MeasureLayout(msf, &after);
+    }
+    if (!RenameReplace(tempPath, outPath))
+    {
+        printf("Could not rename %s to %s.\n", tempPath.c_str(), outPath);
+        RemoveFile(tempPath);
+        return 1;
+    }
+
+    bool coldAfter = false;
+    double coldLoadAfter = TimeLoad(outPath, true, &coldAfter);
+    double warmLoadAfter = TimeWarmLoad(outPath);
+
+    printf("%s -> %s\n", inPath, outPath);
+    printf("  %-26s %12s %12s\n", "", "before", "after");
+    PrintRow("file bytes", before.fileBytes, after.fileBytes);
+    PrintRow("blocks", before.blocks, after.blocks);
+    PrintRow("free blocks", before.freeBlocks, after.freeBlocks);
+    PrintRow("orphaned blocks", before.orphanedBlocks, after.orphanedBlocks);
+    PrintRow("old directory bytes", before.oldDirectoryBytes, after.oldDirectoryBytes);
+    PrintRow("stream blocks", before.streamBlocks, after.streamBlocks);
+    PrintRow("stream extents", before.extents, after.extents);
+    PrintRow("load set blocks", before.hotBlocks, after.hotBlocks);
+    PrintRow("load set extents", before.hotExtents, after.hotExtents);
+    PrintLoadRow(coldBefore && coldAfter ? "cold load ms" : "load ms (cache not dropped)", coldLoadBefore,
+                 coldLoadAfter);
+    PrintLoadRow("warm load ms", warmLoadBefore, warmLoadAfter);
+    return 0;
+}
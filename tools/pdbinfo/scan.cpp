@@ -0,0 +1,246 @@
+// Copyright 2013 Cygnus Software
+// Batch mode: walk one or more directory trees and print the identity of
+// every PDB found, one row per file, as tab separated values or JSON lines.
+// Directory listing and header decoding are spread over a work-stealing
+// pool. Since each PDB only needs a few blocks read, a scan should be bound
+// by file system metadata and I/O latency, and the summary printed at the
+// end reports CPU time against wall time so that can be checked.
+//
+
+#include "scan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include "commands.h"
+#include "mappedfile.h"
+#include "msf.h"
+#include "platform.h"
+#include "threadpool.h"
+
+// Estimate how much of the file ReadPdbIdentity had to look at: the
+// superblock, the block map, the directory up to and including the block
+// list of the DBI stream, and the first blocks of the info and DBI streams.
+static uint64_t EstimateIdentityBytesTouched(const MsfFile& msf)
+{
+    uint64_t directoryWords = 2 + static_cast<uint64_t>(msf.StreamCount()) +
+                              msf.StreamBlockCount(kMsfStreamOldDirectory) +
+                              msf.StreamBlockCount(kMsfStreamPdbInfo) + msf.StreamBlockCount(kMsfStreamTpi);
+    uint64_t blocks = 4 + (directoryWords * 4 + msf.BlockSize() - 1) / msf.BlockSize();
+    return blocks * msf.BlockSize();
+}
+
+bool ReadPdbIdentityFromFile(const std::string& path, PdbIdentity* pIdentity,
+                             uint64_t* pBytesTouched, const char** pError)
+{
+    MappedFile file;
+    if (!file.Open(path.c_str()))
+    {
+        *pError = file.Error();
+        return false;
+    }
+    MsfFile msf;
+    if (!msf.Open(file.Data(), file.Size()))
+    {
+        *pError = msf.Error();
+        return false;
+    }
+    if (!ReadPdbIdentity(msf, pIdentity))
+    {
+        *pError = "could not read the PDB info stream";
+        return false;
+    }
+    if (pBytesTouched)
+        *pBytesTouched = EstimateIdentityBytesTouched(msf);
+    return true;
+}
+
+static bool MatchesSuffix(const std::string& name, const std::vector<const char*>& suffixes)
+{
+    for (size_t i = 0; i < suffixes.size(); ++i)
+    {
+        if (EndsWithNoCase(name, suffixes[i]))
+            return true;
+    }
+    return false;
+}
+
+// Each directory is listed by its own task. Subdirectories become new tasks
+// on the same worker's deque and are stolen by idle workers, so wide and
+// deep trees both spread out.
+static void WalkDirectory(WorkStealingPool& pool, const std::string& directory,
+                          const std::vector<const char*>& suffixes,
+                          const std::function<void(const std::string& path)>& visit)
+{
+    std::vector<DirEntry> entries;
+    if (!ListDirectory(directory, &entries))
+    {
+        fprintf(stderr, "Could not list directory %s.\n", directory.c_str());
+        return;
+    }
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        std::string path = JoinPath(directory, entries[i].name);
+        if (entries[i].isDirectory)
+            pool.Submit([&pool, path, &suffixes, &visit]() { WalkDirectory(pool, path, suffixes, visit); });
+        else if (MatchesSuffix(entries[i].name, suffixes))
+            visit(path);
+    }
+}
+
+void WalkTree(WorkStealingPool& pool, const std::vector<std::string>& roots,
+              const std::vector<const char*>& suffixes,
+              const std::function<void(const std::string& path)>& visit)
+{
+    for (size_t i = 0; i < roots.size(); ++i)
+    {
+        const std::string& root = roots[i];
+        FileStat st;
+        if (!GetFileStat(root, &st))
+        {
+            fprintf(stderr, "Could not find %s.\n", root.c_str());
+            continue;
+        }
+        if (st.isDirectory)
+            pool.Submit([&pool, root, &suffixes, &visit]() { WalkDirectory(pool, root, suffixes, visit); });
+        else
+            pool.Submit([root, &visit]() { visit(root); });
+    }
+    pool.Wait();
+}
+
+void AppendJsonString(std::string* out, const std::string& value)
+{
+    out->push_back('"');
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(value[i]);
+        if (c == '"' || c == '\\')
+        {
+            out->push_back('\\');
+            out->push_back(static_cast<char>(c));
+        }
+        else if (c < 0x20)
+        {
+            char escape[8];
+            sprintf(escape, "\\u%04x", c);
+            out->append(escape);
+        }
+        else
+        {
+            out->push_back(static_cast<char>(c));
+        }
+    }
+    out->push_back('"');
+}
+
+static void PrintScanUsage()
+{
+    printf("Recursively displays the age and guid of every pdb in a tree.\n\n");
+    printf("usage: pdbinfo -r [-json] [-j threads] <dir|pdb>...\n");
+    printf("  -json        Write JSON lines instead of tab separated values.\n");
+    printf("  -j threads   Worker thread count. Defaults to the number of cores.\n");
+}
+
+int ScanMain(int argc, char* argv[])
+{
+    bool json = false;
+    unsigned threads = HardwareThreadCount();
+    std::vector<std::string> roots;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-json") == 0)
+            json = true;
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = static_cast<unsigned>(atoi(argv[++i]));
+        else if (argv[i][0] == '-')
+        {
+            PrintScanUsage();
+            return 1;
+        }
+        else
+            roots.push_back(argv[i]);
+    }
+    if (roots.empty() || threads == 0)
+    {
+        PrintScanUsage();
+        return 1;
+    }
+
+    if (!json)
+        printf("path\ttimestamp\tguid\tage\tsize\n");
+
+    std::mutex outputLock;
+    std::atomic<uint64_t> fileCount(0);
+    std::atomic<uint64_t> errorCount(0);
+    std::atomic<uint64_t> bytesMapped(0);
+    std::atomic<uint64_t> bytesTouched(0);
+
+    auto start = std::chrono::steady_clock::now();
+    double cpuStart = ProcessCpuSeconds();
+
+    std::vector<const char*> suffixes(1, ".pdb");
+    {
+        WorkStealingPool pool(threads);
+        WalkTree(pool, roots, suffixes, [&](const std::string& path)
+        {
+            PdbIdentity identity;
+            uint64_t touched = 0;
+            const char* error = nullptr;
+            FileStat st;
+            if (!GetFileStat(path, &st) || !ReadPdbIdentityFromFile(path, &identity, &touched, &error))
+            {
+                ++errorCount;
+                std::lock_guard<std::mutex> guard(outputLock);
+                fprintf(stderr, "%s: %s.\n", path.c_str(), error ? error : "could not stat file");
+                return;
+            }
+            ++fileCount;
+            bytesMapped += st.size;
+            bytesTouched += touched;
+
+            // Format outside the lock so that only the write is serialized.
+            char szGuid[kGuidStringSize];
+            FormatGuid(identity.guid, szGuid);
+            char fields[128];
+            std::string row;
+            if (json)
+            {
+                row = "{\"path\":";
+                AppendJsonString(&row, path);
+                sprintf(fields, ",\"timestamp\":\"%08X\",\"guid\":\"%s\",\"age\":%u,\"size\":%llu}\n",
+                        identity.timeStamp, szGuid, identity.age,
+                        static_cast<unsigned long long>(st.size));
+            }
+            else
+            {
+                row = path;
+                sprintf(fields, "\t%08X\t%s\t%u\t%llu\n", identity.timeStamp, szGuid, identity.age,
+                        static_cast<unsigned long long>(st.size));
+            }
+            row += fields;
+            std::lock_guard<std::mutex> guard(outputLock);
+            fwrite(row.data(), 1, row.size(), stdout);
+        });
+    }
+    fflush(stdout);
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double cpu = ProcessCpuSeconds() - cpuStart;
+    if (elapsed <= 0)
+        elapsed = 1e-9;
+    // The summary goes to stderr so that stdout stays machine readable.
+    fprintf(stderr, "Scanned %llu PDBs (%llu errors) in %.3f s with %u threads.\n",
+            static_cast<unsigned long long>(fileCount.load()),
+            static_cast<unsigned long long>(errorCount.load()), elapsed, threads);
+    fprintf(stderr, "  %.0f files/s, %.1f MB/s touched (%.1f MB touched of %.1f MB mapped).\n",
+            fileCount / elapsed, bytesTouched / elapsed / 1e6, bytesTouched / 1e6, bytesMapped / 1e6);
+    double utilization = cpu / (elapsed * threads);
+    fprintf(stderr, "  CPU time %.3f s, %.0f%% of %u threads -- %s bound.\n", cpu,
+            utilization * 100, threads, utilization < 0.5 ? "I/O" : "CPU");
+
+    return errorCount ? 1 : 0;
+}
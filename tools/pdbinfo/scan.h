@@ -0,0 +1,32 @@
+// Copyright 2013 Cygnus Software
+// Recursive, parallel scanning of directory trees full of PDBs.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "pdb.h"
+
+class WorkStealingPool;
+
+// Map a PDB and decode its identity. On success pBytesTouched (if non-null)
+// receives an estimate of how many bytes of the file were actually read,
+// which is normally a handful of blocks no matter how large the PDB is. On
+// failure pError receives a static description.
+bool ReadPdbIdentityFromFile(const std::string& path, PdbIdentity* pIdentity,
+                             uint64_t* pBytesTouched, const char** pError);
+
+// Walk each root recursively and call visit(path) for every file whose name
+// ends with one of the suffixes (ignoring case). Roots that are files are
+// visited regardless of their names. Directory listing and visits both run
+// as tasks on the pool; this returns once all of them have finished.
+// Unreadable directories are reported on stderr and skipped.
+void WalkTree(WorkStealingPool& pool, const std::vector<std::string>& roots,
+              const std::vector<const char*>& suffixes,
+              const std::function<void(const std::string& path)>& visit);
+
+// Append path to out as a JSON string literal, with quotes.
+void AppendJsonString(std::string* out, const std::string& value);
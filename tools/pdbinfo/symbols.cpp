@@ -0,0 +1,544 @@
+// Copyright 2013 Cygnus Software
+// Batch symbolization: pdbinfo -symbolize maps a list of RVAs to the nearest
+// public symbol and to the module (object file) that contributed the code.
+//
+// Only three things are decoded: the DBI header and its section
+// contributions, the section headers, and the public symbols listed in the
+// publics (PSGSI) address map. Everything else in the PDB, including the
+// often huge per-module symbol streams, is never touched.
+//
+
+#include "symbols.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include "commands.h"
+#include "dbi.h"
+#include "msf.h"
+#include "place.h"
+#include "platform.h"
+
+static const char kSymbolCacheMagic[8] = { 'P', 'D', 'B', 'S', 'Y', 'M', 0, 0 };
+
+// CodeView record kind of a public symbol.
+const uint16_t S_PUB32 = 0x110E;
+
+// Size of the publics stream header that precedes the GSI hash table.
+const uint32_t kPublicsHeaderSize = 28;
+
+// How many queries SymbolTable::Lookup runs in lockstep.
+const size_t kLookupBatch = 16;
+
+static_assert(sizeof(SymbolCacheHeader) == 48, "SymbolCacheHeader must match the file layout.");
+
+// For each value, the index of the last key that is <= value, or count if
+// there is none. The number of halving steps only depends on count, so the
+// whole batch walks down the array together and each step is a conditional
+// move rather than a branch. Misses for the different values are
+// independent, so the CPU overlaps them.
+static void FindLastNotAbove(const uint32_t* keys, uint32_t count, const uint32_t* values, size_t n,
+                             uint32_t* pIndices)
+{
+    if (count == 0)
+    {
+        for (size_t i = 0; i < n; ++i)
+            pIndices[i] = 0;
+        return;
+    }
+    const uint32_t* base[kLookupBatch];
+    for (size_t i = 0; i < n; ++i)
+        base[i] = keys;
+    for (uint32_t remaining = count; remaining > 1;)
+    {
+        uint32_t half = remaining / 2;
+        for (size_t i = 0; i < n; ++i)
+            base[i] = (base[i][half] <= values[i]) ? base[i] + half : base[i];
+        remaining -= half;
+    }
+    for (size_t i = 0; i < n; ++i)
+        pIndices[i] = (*base[i] <= values[i]) ? static_cast<uint32_t>(base[i] - keys) : count;
+}
+
+static uint32_t AppendName(std::vector<char>* pNames, const char* name, size_t length)
+{
+    uint32_t offset = static_cast<uint32_t>(pNames->size());
+    pNames->insert(pNames->end(), name, name + length);
+    pNames->push_back(0);
+    return offset;
+}
+
+struct RvaName
+{
+    uint32_t rva;
+    uint32_t name;
+
+    bool operator<(const RvaName& rhs) const
+    {
+        return rva < rhs.rva || (rva == rhs.rva && name < rhs.name);
+    }
+};
+
+struct RvaContribution
+{
+    uint32_t rva;
+    uint32_t size;
+    uint32_t module;
+
+    bool operator<(const RvaContribution& rhs) const { return rva < rhs.rva; }
+};
+
+// Read the public symbols in address map order. Each address map entry is
+// the offset of an S_PUB32 record in the symbol record stream:
+//   uint16_t length;   Not counting the length field itself.
+//   uint16_t kind;
+//   uint32_t flags;
+//   uint32_t offset;
+//   uint16_t section;
+//   char     name[];
+static const char* ReadPublics(const MsfFile& msf, const DbiHeader& header,
+                               const std::vector<DbiSectionHeader>& sections,
+                               std::vector<RvaName>* pSymbols, std::vector<char>* pNames)
+{
+    uint16_t publics = header.publicStream;
+    uint16_t records = header.symRecordStream;
+    if (publics == kDbiNoStream || records == kDbiNoStream ||
+        !msf.StreamExists(publics) || !msf.StreamExists(records))
+        return "the PDB has no public symbols";
+
+    uint8_t psgsi[kPublicsHeaderSize];
+    if (!msf.ReadStream(publics, 0, psgsi, sizeof(psgsi)))
+        return "truncated publics stream";
+    uint32_t hashBytes = LoadU32(psgsi);
+    uint32_t addressMapBytes = LoadU32(psgsi + 4);
+    uint64_t addressMapOffset = static_cast<uint64_t>(kPublicsHeaderSize) + hashBytes;
+    if (addressMapOffset + addressMapBytes > msf.StreamSize(publics))
+        return "publics address map extends past the end of the stream";
+    std::vector<uint8_t> addressMap(addressMapBytes);
+    if (addressMapBytes && !msf.ReadStream(publics, static_cast<uint32_t>(addressMapOffset),
+                                            addressMap.data(), addressMapBytes))
+        return "publics stream lists blocks outside the file";
+
+    uint32_t count = addressMapBytes / 4;
+    pSymbols->reserve(count);
+    std::vector<uint8_t> record(0x10000 + 2);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t offset = LoadU32(&addressMap[i * 4]);
+        if (!msf.ReadStream(records, offset, record.data(), 4))
+            continue;
+        uint32_t length = LoadU16(record.data());
+        if (LoadU16(record.data() + 2) != S_PUB32 || length < 12 ||
+            !msf.ReadStream(records, offset, record.data(), length + 2))
+            continue;
+        uint32_t symbolOffset = LoadU32(record.data() + 8);
+        uint16_t section = LoadU16(record.data() + 12);
+        if (section == 0 || section > sections.size())
+            continue;
+        const char* name = reinterpret_cast<const char*>(record.data() + 14);
+        size_t maxLength = length + 2 - 14;
+        const char* nameEnd = static_cast<const char*>(memchr(name, 0, maxLength));
+        size_t nameLength = nameEnd ? nameEnd - name : maxLength;
+
+        RvaName symbol;
+        symbol.rva = sections[section - 1].virtualAddress + symbolOffset;
+        symbol.name = AppendName(pNames, name, nameLength);
+        pSymbols->push_back(symbol);
+    }
+    return nullptr;
+}
+
+SymbolTable::SymbolTable()
+    : error_(nullptr)
+    , symbolCount_(0)
+    , contributionCount_(0)
+    , moduleCount_(0)
+    , symbolRvas_(nullptr)
+    , symbolNames_(nullptr)
+    , contributionRvas_(nullptr)
+    , contributionSizes_(nullptr)
+    , contributionModules_(nullptr)
+    , moduleNames_(nullptr)
+    , names_(nullptr)
+    , namesSize_(0)
+{
+}
+
+void SymbolTable::SetViews(const uint32_t* words, const char* names, uint32_t namesSize)
+{
+    symbolRvas_ = words;
+    symbolNames_ = symbolRvas_ + symbolCount_;
+    contributionRvas_ = symbolNames_ + symbolCount_;
+    contributionSizes_ = contributionRvas_ + contributionCount_;
+    contributionModules_ = contributionSizes_ + contributionCount_;
+    moduleNames_ = contributionModules_ + contributionCount_;
+    names_ = names;
+    namesSize_ = namesSize;
+}
+
+const char* SymbolTable::Name(uint32_t offset) const
+{
+    return offset < namesSize_ ? names_ + offset : "";
+}
+
+bool SymbolTable::Build(const MsfFile& msf)
+{
+    DbiStream dbi;
+    if (!dbi.Open(msf))
+    {
+        error_ = dbi.Error();
+        return false;
+    }
+    std::vector<DbiSectionHeader> sections;
+    if (!dbi.ReadSectionHeaders(msf, &sections))
+    {
+        error_ = "could not read the section headers";
+        return false;
+    }
+
+    // Offset zero is the empty string, used for anything without a name.
+    std::vector<char> names(1, 0);
+    std::vector<RvaName> symbols;
+    error_ = ReadPublics(msf, dbi.Header(), sections, &symbols, &names);
+    if (error_)
+        return false;
+    // Identical code folding gives many names to one address. Keep only the
+    // first so that the RVA array has no duplicates.
+    std::sort(symbols.begin(), symbols.end());
+    size_t unique = 0;
+    for (size_t i = 0; i < symbols.size(); ++i)
+    {
+        if (unique == 0 || symbols[i].rva != symbols[unique - 1].rva)
+            symbols[unique++] = symbols[i];
+    }
+    symbols.resize(unique);
+
+    std::vector<DbiSectionContribution> raw;
+    if (!dbi.ReadSectionContributions(&raw))
+    {
+        error_ = "could not read the section contributions";
+        return false;
+    }
+    std::vector<RvaContribution> contributions;
+    contributions.reserve(raw.size());
+    for (size_t i = 0; i < raw.size(); ++i)
+    {
+        if (raw[i].section == 0 || raw[i].section > sections.size() || raw[i].size == 0)
+            continue;
+        RvaContribution contribution;
+        contribution.rva = sections[raw[i].section - 1].virtualAddress + raw[i].offset;
+        contribution.size = raw[i].size;
+        contribution.module = raw[i].module;
+        contributions.push_back(contribution);
+    }
+    std::sort(contributions.begin(), contributions.end());
+
+    std::vector<DbiModule> modules;
+    if (!dbi.ReadModules(&modules))
+    {
+        error_ = "could not read the module info";
+        return false;
+    }
+
+    symbolCount_ = static_cast<uint32_t>(symbols.size());
+    contributionCount_ = static_cast<uint32_t>(contributions.size());
+    moduleCount_ = static_cast<uint32_t>(modules.size());
+    std::vector<uint32_t> words;
+    words.reserve(symbolCount_ * 2 + contributionCount_ * 3 + moduleCount_);
+    for (size_t i = 0; i < symbols.size(); ++i)
+        words.push_back(symbols[i].rva);
+    for (size_t i = 0; i < symbols.size(); ++i)
+        words.push_back(symbols[i].name);
+    for (size_t i = 0; i < contributions.size(); ++i)
+        words.push_back(contributions[i].rva);
+    for (size_t i = 0; i < contributions.size(); ++i)
+        words.push_back(contributions[i].size);
+    for (size_t i = 0; i < contributions.size(); ++i)
+        words.push_back(contributions[i].module);
+    for (size_t i = 0; i < modules.size(); ++i)
+        words.push_back(AppendName(&names, modules[i].moduleName.data(), modules[i].moduleName.size()));
+
+    cache_.Close();
+    words_.swap(words);
+    nameData_.swap(names);
+    SetViews(words_.data(), nameData_.data(), static_cast<uint32_t>(nameData_.size()));
+    return true;
+}
+
+bool SymbolTable::Load(const char* path, const PdbGuid& guid, uint32_t age)
+{
+    if (!cache_.Open(path))
+    {
+        words_.clear();
+        nameData_.clear();
+        symbolCount_ = contributionCount_ = moduleCount_ = 0;
+        SetViews(nullptr, nullptr, 0);
+        error_ = cache_.Error();
+        return false;
+    }
+    if (!Load(cache_.Data(), cache_.Size(), guid, age))
+    {
+        cache_.Close();
+        return false;
+    }
+    return true;
+}
+
+bool SymbolTable::Load(const uint8_t* data, size_t size, const PdbGuid& guid, uint32_t age)
+{
+    words_.clear();
+    nameData_.clear();
+    symbolCount_ = contributionCount_ = moduleCount_ = 0;
+    SetViews(nullptr, nullptr, 0);
+    SymbolCacheHeader header;
+    error_ = nullptr;
+    if (size < sizeof(header))
+        error_ = "truncated symbol cache";
+    else
+    {
+        memcpy(&header, data, sizeof(header));
+        uint64_t words = header.symbolCount * 2ULL + header.contributionCount * 3ULL + header.moduleCount;
+        if (memcmp(header.magic, kSymbolCacheMagic, sizeof(kSymbolCacheMagic)) != 0 ||
+            header.version != kSymbolCacheVersion)
+            error_ = "not a symbol cache, or an old version";
+        else if (header.age != age || memcmp(&header.guid, &guid, sizeof(guid)) != 0)
+            error_ = "symbol cache is for a different pdb";
+        else if (sizeof(header) + words * 4 + header.namesSize != size ||
+                 header.namesSize == 0 || data[size - 1] != 0)
+            error_ = "symbol cache is truncated or corrupt";
+        else
+        {
+            // Module indices and name offsets are checked at lookup time.
+            symbolCount_ = header.symbolCount;
+            contributionCount_ = header.contributionCount;
+            moduleCount_ = header.moduleCount;
+            const uint8_t* base = data + sizeof(header);
+            SetViews(reinterpret_cast<const uint32_t*>(base),
+                     reinterpret_cast<const char*>(base + words * 4), header.namesSize);
+        }
+    }
+    return !error_;
+}
+
+bool SymbolTable::Save(const char* path, const PdbGuid& guid, uint32_t age) const
+{
+    SymbolCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kSymbolCacheMagic, sizeof(kSymbolCacheMagic));
+    header.version = kSymbolCacheVersion;
+    header.age = age;
+    header.guid = guid;
+    header.symbolCount = symbolCount_;
+    header.contributionCount = contributionCount_;
+    header.moduleCount = moduleCount_;
+    header.namesSize = namesSize_;
+
+    size_t words = symbolCount_ * 2 + contributionCount_ * 3 + moduleCount_;
+    std::string tempPath = TempPathFor(path);
+    FILE* fp = OpenFile(tempPath, "wb");
+    if (!fp)
+        return false;
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = ok && (words == 0 || fwrite(symbolRvas_, 4, words, fp) == words);
+    ok = ok && fwrite(names_, 1, namesSize_, fp) == namesSize_;
+    ok = (fclose(fp) == 0) && ok;
+    // Several symbolizers may race to publish the same cache entry. They all
+    // write identical contents so whichever rename lands last is fine.
+    if (!ok || !RenameReplace(tempPath, path))
+    {
+        RemoveFile(tempPath);
+        return false;
+    }
+    return true;
+}
+
+void SymbolTable::Lookup(const uint32_t* rvas, size_t count, SymbolLookup* pResults) const
+{
+    uint32_t symbolIndex[kLookupBatch];
+    uint32_t contributionIndex[kLookupBatch];
+    for (size_t start = 0; start < count; start += kLookupBatch)
+    {
+        size_t n = std::min(kLookupBatch, count - start);
+        const uint32_t* values = rvas + start;
+        FindLastNotAbove(symbolRvas_, symbolCount_, values, n, symbolIndex);
+        FindLastNotAbove(contributionRvas_, contributionCount_, values, n, contributionIndex);
+        for (size_t i = 0; i < n; ++i)
+        {
+            uint32_t rva = values[i];
+            SymbolLookup& result = pResults[start + i];
+            result.name = nullptr;
+            result.displacement = rva;
+            result.module = nullptr;
+
+            uint32_t c = contributionIndex[i];
+            bool inContribution = c < contributionCount_ && rva - contributionRvas_[c] < contributionSizes_[c];
+            if (inContribution)
+            {
+                if (contributionModules_[c] < moduleCount_)
+                    result.module = Name(moduleNames_[contributionModules_[c]]);
+                result.displacement = rva - contributionRvas_[c];
+            }
+            // A public before the start of the containing contribution
+            // belongs to some other function; the address is most likely in
+            // a static function, which has no public symbol.
+            uint32_t s = symbolIndex[i];
+            if (s < symbolCount_ && (!inContribution || symbolRvas_[s] >= contributionRvas_[c]))
+            {
+                result.name = Name(symbolNames_[s]);
+                result.displacement = rva - symbolRvas_[s];
+            }
+        }
+    }
+}
+
+static void PrintSymbolizeUsage()
+{
+    printf("Maps RVAs to public symbols and modules.\n\n");
+    printf("usage: pdbinfo -symbolize [-cache <dir>] <pdb> [rva...]\n");
+    printf("  RVAs are hexadecimal. If none are given they are read from stdin,\n");
+    printf("  one per line.\n");
+    printf("  -cache   Directory of decoded symbol tables, keyed by guid and age.\n");
+}
+
+static void SymbolizeBatch(const SymbolTable& table, const std::vector<uint32_t>& rvas,
+                           std::vector<SymbolLookup>* pResults, std::string* pOutput)
+{
+    pResults->resize(rvas.size());
+    table.Lookup(rvas.data(), rvas.size(), pResults->data());
+    pOutput->clear();
+    char line[64];
+    for (size_t i = 0; i < rvas.size(); ++i)
+    {
+        const SymbolLookup& result = (*pResults)[i];
+        sprintf(line, "%08X\t", rvas[i]);
+        *pOutput += line;
+        if (result.name)
+        {
+            *pOutput += result.name;
+            sprintf(line, "+0x%X", result.displacement);
+            *pOutput += line;
+        }
+        else if (result.module)
+        {
+            sprintf(line, "<unknown>+0x%X", result.displacement);
+            *pOutput += line;
+        }
+        *pOutput += '\t';
+        if (result.module)
+            *pOutput += result.module;
+        *pOutput += '\n';
+    }
+    fwrite(pOutput->data(), 1, pOutput->size(), stdout);
+}
+
+int SymbolizeMain(int argc, char* argv[])
+{
+    const char* cacheDirectory = nullptr;
+    const char* pdbPath = nullptr;
+    std::vector<uint32_t> rvas;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-cache") == 0 && i + 1 < argc)
+            cacheDirectory = argv[++i];
+        else if (argv[i][0] == '-')
+        {
+            PrintSymbolizeUsage();
+            return 1;
+        }
+        else if (!pdbPath)
+            pdbPath = argv[i];
+        else
+            rvas.push_back(static_cast<uint32_t>(strtoul(argv[i], nullptr, 16)));
+    }
+    if (!pdbPath)
+    {
+        PrintSymbolizeUsage();
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    MappedFile file;
+    if (!file.Open(pdbPath))
+    {
+        printf("Could not open %s: %s.\n", pdbPath, file.Error());
+        return 1;
+    }
+    MsfFile msf;
+    if (!msf.Open(file.Data(), file.Size()))
+    {
+        printf("%s is not a valid PDB file: %s.\n", pdbPath, msf.Error());
+        return 1;
+    }
+    PdbIdentity identity;
+    if (!ReadPdbIdentity(msf, &identity))
+    {
+        printf("Could not read the PDB info stream.\n");
+        return 1;
+    }
+
+    // A hit in the cache means the publics are never decoded.
+    SymbolTable table;
+    std::string cachePath;
+    bool fromCache = false;
+    if (cacheDirectory)
+    {
+        char key[kSymbolStoreKeySize];
+        FormatSymbolStoreKey(identity.guid, identity.age, key);
+        cachePath = JoinPath(cacheDirectory, std::string(key) + ".sym");
+        fromCache = table.Load(cachePath.c_str(), identity.guid, identity.age);
+    }
+    if (!fromCache)
+    {
+        if (!table.Build(msf))
+        {
+            printf("Could not decode the symbols of %s: %s.\n", pdbPath, table.Error());
+            return 1;
+        }
+        if (cacheDirectory && (!MakeDirectories(cacheDirectory) ||
+                               !table.Save(cachePath.c_str(), identity.guid, identity.age)))
+            fprintf(stderr, "Could not write the symbol cache %s.\n", cachePath.c_str());
+    }
+    double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    std::vector<SymbolLookup> results;
+    std::string output;
+    uint64_t queryCount = rvas.size();
+    if (!rvas.empty())
+        SymbolizeBatch(table, rvas, &results, &output);
+    else
+    {
+        // Stream stdin through in large batches.
+        const size_t kBatch = 4096;
+        char line[256];
+        while (fgets(line, sizeof(line), stdin))
+        {
+            char* end = nullptr;
+            unsigned long rva = strtoul(line, &end, 16);
+            if (end == line)
+                continue;
+            rvas.push_back(static_cast<uint32_t>(rva));
+            if (rvas.size() == kBatch)
+            {
+                SymbolizeBatch(table, rvas, &results, &output);
+                queryCount += rvas.size();
+                rvas.clear();
+            }
+        }
+        if (!rvas.empty())
+            SymbolizeBatch(table, rvas, &results, &output);
+        queryCount += rvas.size();
+    }
+    fflush(stdout);
+    double lookupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fprintf(stderr, "%u publics, %u contributions, %u modules %s in %.3f s.\n",
+            table.SymbolCount(), table.ContributionCount(), table.ModuleCount(),
+            fromCache ? "loaded from cache" : "decoded", loadSeconds);
+    fprintf(stderr, "%llu addresses symbolized in %.3f s.\n",
+            static_cast<unsigned long long>(queryCount), lookupSeconds);
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Copyright 2013 Cygnus Software
+// Address to symbol lookup using only the public symbols and the section
+// contributions of a PDB, which is what crash triage and profilers need most
+// of the time and is far cheaper than loading full module symbols.
+//
+// Decoding the PDB produces a few flat, sorted uint32_t arrays keyed by RVA.
+// The same arrays are what the cache file holds, so a cached table is used
+// straight from the mapping with no parsing at all.
+//
+// Cache file layout, all little-endian:
+//   SymbolCacheHeader
+//   uint32_t symbolRvas[symbolCount]          Sorted, unique.
+//   uint32_t symbolNames[symbolCount]         Offsets into names.
+//   uint32_t contributionRvas[contributionCount]   Sorted.
+//   uint32_t contributionSizes[contributionCount]
+//   uint32_t contributionModules[contributionCount]
+//   uint32_t moduleNames[moduleCount]         Offsets into names.
+//   char     names[namesSize]                 Null terminated strings.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "mappedfile.h"
+#include "pdb.h"
+
+class MsfFile;
+
+const uint32_t kSymbolCacheVersion = 1;
+
+struct SymbolCacheHeader
+{
+    char magic[8];              // "PDBSYM\0\0"
+    uint32_t version;
+    uint32_t age;
+    PdbGuid guid;
+    uint32_t symbolCount;
+    uint32_t contributionCount;
+    uint32_t moduleCount;
+    uint32_t namesSize;
+};
+
+struct SymbolLookup
+{
+    // The public symbol at or before the address, or null if there is none
+    // in the same contribution.
+    const char* name;
+    uint32_t displacement;      // From name, or from the contribution start.
+    // The module whose contribution contains the address, or null.
+    const char* module;
+};
+
+class SymbolTable
+{
+public:
+    SymbolTable();
+
+    // Decode the publics and section contributions of an open PDB.
+    bool Build(const MsfFile& msf);
+    // Map a cache file written by Save. Fails if the file is malformed or is
+    // for a different GUID and age.
+    bool Load(const char* path, const PdbGuid& guid, uint32_t age);
+    // Use a cache that is already in memory. The data must be 4 byte aligned
+    // and remain valid for as long as this object is used.
+    bool Load(const uint8_t* data, size_t size, const PdbGuid& guid, uint32_t age);
+    bool Save(const char* path, const PdbGuid& guid, uint32_t age) const;
+
+    const char* Error() const { return error_; }
+    uint32_t SymbolCount() const { return symbolCount_; }
+    uint32_t ContributionCount() const { return contributionCount_; }
+    uint32_t ModuleCount() const { return moduleCount_; }
+
+    // Resolve a batch of RVAs. The searches are run in lockstep so that the
+    // cache misses of neighbouring queries overlap.
+    void Lookup(const uint32_t* rvas, size_t count, SymbolLookup* pResults) const;
+
+private:
+    SymbolTable(const SymbolTable&);
+    SymbolTable& operator=(const SymbolTable&);
+
+    void SetViews(const uint32_t* words, const char* names, uint32_t namesSize);
+    const char* Name(uint32_t offset) const;
+
+    const char* error_;
+    uint32_t symbolCount_;
+    uint32_t contributionCount_;
+    uint32_t moduleCount_;
+
+    const uint32_t* symbolRvas_;
+    const uint32_t* symbolNames_;
+    const uint32_t* contributionRvas_;
+    const uint32_t* contributionSizes_;
+    const uint32_t* contributionModules_;
+    const uint32_t* moduleNames_;
+    const char* names_;
+    uint32_t namesSize_;
+
+    // Backing store for the views: either decoded arrays or a cache mapping.
+    std::vector<uint32_t> words_;
+    std::vector<char> nameData_;
+    MappedFile cache_;
+};
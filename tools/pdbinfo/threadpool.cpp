@@ -0,0 +1,121 @@
+// Copyright 2013 Cygnus Software
+
+#include "threadpool.h"
+
+// Identifies which pool, and which worker within it, the current thread is.
+static thread_local const WorkStealingPool* t_pool = nullptr;
+static thread_local int t_workerIndex = -1;
+
+WorkStealingPool::WorkStealingPool(unsigned threadCount)
+    : queued_(0)
+    , pending_(0)
+    , nextQueue_(0)
+    , shutdown_(false)
+{
+    if (threadCount == 0)
+        threadCount = 1;
+    for (unsigned i = 0; i < threadCount; ++i)
+        workers_.push_back(std::unique_ptr<Worker>(new Worker));
+    for (unsigned i = 0; i < threadCount; ++i)
+        threads_.push_back(std::thread(&WorkStealingPool::WorkerMain, this, i));
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    Wait();
+    {
+        std::lock_guard<std::mutex> guard(sleepLock_);
+        shutdown_ = true;
+    }
+    workAvailable_.notify_all();
+    for (size_t i = 0; i < threads_.size(); ++i)
+        threads_[i].join();
+}
+
+int WorkStealingPool::CurrentWorker() const
+{
+    return t_pool == this ? t_workerIndex : -1;
+}
+
+void WorkStealingPool::Submit(Task task)
+{
+    int self = CurrentWorker();
+    unsigned index = self >= 0 ? static_cast<unsigned>(self)
+                               : nextQueue_++ % static_cast<unsigned>(workers_.size());
+    ++pending_;
+    {
+        Worker& worker = *workers_[index];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        worker.tasks.push_back(std::move(task));
+    }
+    ++queued_;
+    // Taking the sleep lock orders this notification after any worker's
+    // check of queued_, so a worker that is about to sleep can't miss it.
+    {
+        std::lock_guard<std::mutex> guard(sleepLock_);
+    }
+    workAvailable_.notify_one();
+}
+
+void WorkStealingPool::Wait()
+{
+    std::unique_lock<std::mutex> guard(sleepLock_);
+    while (pending_ != 0)
+        allDone_.wait(guard);
+}
+
+bool WorkStealingPool::TryPop(unsigned index, Task* pTask)
+{
+    Worker& worker = *workers_[index];
+    std::lock_guard<std::mutex> guard(worker.lock);
+    if (worker.tasks.empty())
+        return false;
+    *pTask = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::TrySteal(unsigned thief, Task* pTask)
+{
+    unsigned count = static_cast<unsigned>(workers_.size());
+    for (unsigned i = 1; i < count; ++i)
+    {
+        Worker& victim = *workers_[(thief + i) % count];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (victim.tasks.empty())
+            continue;
+        *pTask = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::WorkerMain(unsigned index)
+{
+    t_pool = this;
+    t_workerIndex = static_cast<int>(index);
+
+    for (;;)
+    {
+        Task task;
+        if (TryPop(index, &task) || TrySteal(index, &task))
+        {
+            --queued_;
+            task();
+            task = nullptr;
+            if (--pending_ == 0)
+            {
+                std::lock_guard<std::mutex> guard(sleepLock_);
+                allDone_.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(sleepLock_);
+        while (!shutdown_ && queued_ == 0)
+            workAvailable_.wait(guard);
+        if (shutdown_ && queued_ == 0)
+            return;
+    }
+}
@@ -0,0 +1,71 @@
+// Copyright 2013 Cygnus Software
+// A small work-stealing thread pool. Each worker owns a deque of tasks. A
+// worker pushes and pops its own tasks at the back (LIFO, so recursively
+// submitted work stays cache warm) and, when it runs dry, steals from the
+// front of the other workers' deques. That keeps all cores busy when the
+// work is very uneven, such as a directory walk where one directory holds
+// ten thousand PDBs and its siblings hold none.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool
+{
+public:
+    typedef std::function<void()> Task;
+
+    explicit WorkStealingPool(unsigned threadCount);
+    ~WorkStealingPool();
+
+    unsigned ThreadCount() const { return static_cast<unsigned>(workers_.size()); }
+
+    // Queue a task. When called from a worker thread the task goes on that
+    // worker's own deque, otherwise the deques are filled round-robin. Tasks
+    // may submit more tasks.
+    void Submit(Task task);
+
+    // Block until every submitted task, including tasks submitted by other
+    // tasks, has finished.
+    void Wait();
+
+    // Index of the calling worker thread, or -1 when not called from one of
+    // this pool's workers. Handy for per-thread accumulators.
+    int CurrentWorker() const;
+
+private:
+    WorkStealingPool(const WorkStealingPool&);
+    WorkStealingPool& operator=(const WorkStealingPool&);
+
+    struct Worker
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    void WorkerMain(unsigned index);
+    bool TryPop(unsigned index, Task* pTask);
+    bool TrySteal(unsigned thief, Task* pTask);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+
+    // Tasks sitting in deques, used to decide whether idle workers can sleep.
+    std::atomic<size_t> queued_;
+    // Tasks submitted but not yet finished, used by Wait.
+    std::atomic<size_t> pending_;
+    std::atomic<unsigned> nextQueue_;
+    bool shutdown_;
+
+    std::mutex sleepLock_;
+    std::condition_variable workAvailable_;
+    std::condition_variable allDone_;
+};
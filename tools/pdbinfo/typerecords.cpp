@@ -0,0 +1,413 @@
+// Copyright 2013 Cygnus Software
+
+#include "typerecords.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace
+{
+
+// Leaf kinds of the type records that appear at the top level of the TPI
+// and IPI streams.
+const uint16_t LF_MODIFIER = 0x1001;
+const uint16_t LF_POINTER = 0x1002;
+const uint16_t LF_PROCEDURE = 0x1008;
+const uint16_t LF_MFUNCTION = 0x1009;
+const uint16_t LF_ARGLIST = 0x1201;
+const uint16_t LF_FIELDLIST = 0x1203;
+const uint16_t LF_BITFIELD = 0x1205;
+const uint16_t LF_METHODLIST = 0x1206;
+const uint16_t LF_ARRAY = 0x1503;
+const uint16_t LF_CLASS = 0x1504;
+const uint16_t LF_STRUCTURE = 0x1505;
+const uint16_t LF_UNION = 0x1506;
+const uint16_t LF_ENUM = 0x1507;
+const uint16_t LF_INTERFACE = 0x1519;
+const uint16_t LF_VFTABLE = 0x151d;
+const uint16_t LF_VTSHAPE = 0x000a;
+const uint16_t LF_LABEL = 0x000e;
+const uint16_t LF_FUNC_ID = 0x1601;
+const uint16_t LF_MFUNC_ID = 0x1602;
+const uint16_t LF_BUILDINFO = 0x1603;
+const uint16_t LF_SUBSTR_LIST = 0x1604;
+const uint16_t LF_STRING_ID = 0x1605;
+const uint16_t LF_UDT_SRC_LINE = 0x1606;
+const uint16_t LF_UDT_MOD_SRC_LINE = 0x1607;
+
+// Leaf kinds of the members of a field list.
+const uint16_t LF_BCLASS = 0x1400;
+const uint16_t LF_VBCLASS = 0x1401;
+const uint16_t LF_IVBCLASS = 0x1402;
+const uint16_t LF_INDEX = 0x1404;
+const uint16_t LF_VFUNCTAB = 0x1409;
+const uint16_t LF_ENUMERATE = 0x1502;
+const uint16_t LF_MEMBER = 0x150d;
+const uint16_t LF_STMEMBER = 0x150e;
+const uint16_t LF_METHOD = 0x150f;
+const uint16_t LF_NESTTYPE = 0x1510;
+const uint16_t LF_ONEMETHOD = 0x1511;
+
+// Numeric leaves, used for sizes inside UDT records.
+const uint16_t LF_NUMERIC = 0x8000;
+const uint16_t LF_CHAR = 0x8000;
+const uint16_t LF_SHORT = 0x8001;
+const uint16_t LF_USHORT = 0x8002;
+const uint16_t LF_LONG = 0x8003;
+const uint16_t LF_ULONG = 0x8004;
+const uint16_t LF_QUADWORD = 0x8009;
+const uint16_t LF_UQUADWORD = 0x800a;
+
+// Method properties, in bits 2 to 4 of a method's attributes, that mean
+// the method introduces a virtual function and so has a vtable offset.
+const uint16_t kMethodIntroVirtual = 4;
+const uint16_t kMethodPureIntroVirtual = 6;
+
+// Pointer modes, in bits 5 to 7 of a pointer's attributes, of pointers to
+// members, which are followed by the type index of the class.
+const uint32_t kPointerToDataMember = 2;
+const uint32_t kPointerToMemberFunction = 3;
+
+struct LeafName
+{
+    uint16_t kind;
+    const char* name;
+};
+
+const LeafName kLeafNames[] =
+{
+    { LF_MODIFIER, "LF_MODIFIER" },
+    { LF_POINTER, "LF_POINTER" },
+    { LF_PROCEDURE, "LF_PROCEDURE" },
+    { LF_MFUNCTION, "LF_MFUNCTION" },
+    { LF_ARGLIST, "LF_ARGLIST" },
+    { LF_FIELDLIST, "LF_FIELDLIST" },
+    { LF_BITFIELD, "LF_BITFIELD" },
+    { LF_METHODLIST, "LF_METHODLIST" },
+    { LF_ARRAY, "LF_ARRAY" },
+    { LF_CLASS, "LF_CLASS" },
+    { LF_STRUCTURE, "LF_STRUCTURE" },
+    { LF_UNION, "LF_UNION" },
+    { LF_ENUM, "LF_ENUM" },
+    { LF_INTERFACE, "LF_INTERFACE" },
+    { LF_VFTABLE, "LF_VFTABLE" },
+    { LF_VTSHAPE, "LF_VTSHAPE" },
+    { LF_LABEL, "LF_LABEL" },
+    { LF_FUNC_ID, "LF_FUNC_ID" },
+    { LF_MFUNC_ID, "LF_MFUNC_ID" },
+    { LF_BUILDINFO, "LF_BUILDINFO" },
+    { LF_SUBSTR_LIST, "LF_SUBSTR_LIST" },
+    { LF_STRING_ID, "LF_STRING_ID" },
+    { LF_UDT_SRC_LINE, "LF_UDT_SRC_LINE" },
+    { LF_UDT_MOD_SRC_LINE, "LF_UDT_MOD_SRC_LINE" },
+};
+
+// Add the index field at offset, if it is within the record.
+void AddIndex(std::vector<TypeIndexRef>* pRefs, uint32_t size, uint32_t offset, bool isItem = false)
+{
+    if (offset <= size && size - offset >= 4)
+    {
+        TypeIndexRef ref = { offset, isItem };
+        pRefs->push_back(ref);
+    }
+}
+
+// Add count index fields that start at offset.
+void AddIndexList(std::vector<TypeIndexRef>* pRefs, uint32_t size, uint32_t offset, uint32_t count,
+                  bool isItem = false)
+{
+    for (uint32_t i = 0; i < count && offset <= size && size - offset >= 4; ++i, offset += 4)
+        AddIndex(pRefs, size, offset, isItem);
+}
+
+// Length of the zero terminated name at offset, including the terminator,
+// or 0 if it runs off the end.
+uint32_t NameSize(const uint8_t* data, uint32_t size, uint32_t offset)
+{
+    if (offset >= size)
+        return 0;
+    const void* end = memchr(data + offset, 0, size - offset);
+    return end ? static_cast<uint32_t>(static_cast<const uint8_t*>(end) - data) - offset + 1 : 0;
+}
+
+bool IntroducesVirtual(uint16_t attributes)
+{
+    uint16_t property = (attributes >> 2) & 7;
+    return property == kMethodIntroVirtual || property == kMethodPureIntroVirtual;
+}
+
+// Size of the numeric leaf at offset, or 0 if there isn't a valid one.
+uint32_t NumericSizeAt(const uint8_t* data, uint32_t size, uint32_t offset)
+{
+    return offset < size ? NumericLeafSize(data + offset, size - offset) : 0;
+}
+
+// Find the type indices of each member of a field list. Stops at the first
+// member it doesn't understand.
+void FindFieldListIndices(const uint8_t* data, uint32_t size, std::vector<TypeIndexRef>* pRefs)
+{
+    uint32_t offset = 0;
+    while (offset < size)
+    {
+        // LF_PAD bytes, 0xF0 + n, skip n bytes to the next member.
+        if (data[offset] >= 0xF0)
+        {
+            offset += std::max(data[offset] & 0x0F, 1);
+            continue;
+        }
+        if (size - offset < 2)
+            return;
+        uint16_t leaf = LoadU16(data + offset);
+        const uint8_t* member = data + offset + 2;
+        uint32_t start = offset + 2;
+        uint32_t remaining = size - offset - 2;
+        // Fixed part, numeric leaves and name of the member. A zero size
+        // means the member is malformed.
+        uint32_t fixed;
+        uint32_t numerics = 0;
+        bool named = true;
+        switch (leaf)
+        {
+        case LF_BCLASS:
+            AddIndex(pRefs, size, start + 2);
+            fixed = 6;
+            numerics = 1;
+            named = false;
+            break;
+        case LF_VBCLASS:
+        case LF_IVBCLASS:
+            AddIndexList(pRefs, size, start + 2, 2);
+            fixed = 10;
+            numerics = 2;
+            named = false;
+            break;
+        case LF_INDEX:
+        case LF_VFUNCTAB:
+            AddIndex(pRefs, size, start + 2);
+            fixed = 6;
+            named = false;
+            break;
+        case LF_ENUMERATE:
+            fixed = 2;
+            numerics = 1;
+            break;
+        case LF_MEMBER:
+            AddIndex(pRefs, size, start + 2);
+            fixed = 6;
+            numerics = 1;
+            break;
+        case LF_STMEMBER:
+        case LF_METHOD:
+        case LF_NESTTYPE:
+            AddIndex(pRefs, size, start + 2);
+            fixed = 6;
+            break;
+        case LF_ONEMETHOD:
+            if (remaining < 2)
+                return;
+            AddIndex(pRefs, size, start + 2);
+            fixed = IntroducesVirtual(LoadU16(member)) ? 10 : 6;
+            break;
+        default:
+            return;
+        }
+        uint32_t length = fixed;
+        for (uint32_t i = 0; i < numerics; ++i)
+        {
+            uint32_t numeric = NumericSizeAt(member, remaining, length);
+            if (numeric == 0)
+                return;
+            length += numeric;
+        }
+        if (named)
+        {
+            uint32_t name = NameSize(member, remaining, length);
+            if (name == 0)
+                return;
+            length += name;
+        }
+        if (length > remaining)
+            return;
+        offset += 2 + length;
+    }
+}
+
+}  // namespace
+
+const char* LeafKindName(uint16_t kind)
+{
+    for (size_t i = 0; i < sizeof(kLeafNames) / sizeof(kLeafNames[0]); ++i)
+    {
+        if (kLeafNames[i].kind == kind)
+            return kLeafNames[i].name;
+    }
+    return nullptr;
+}
+
+uint32_t NumericLeafSize(const uint8_t* p, uint32_t size)
+{
+    if (size < 2)
+        return 0;
+    uint16_t leaf = LoadU16(p);
+    if (leaf < LF_NUMERIC)
+        return 2;
+    uint32_t valueSize;
+    switch (leaf)
+    {
+    case LF_CHAR: valueSize = 1; break;
+    case LF_SHORT: case LF_USHORT: valueSize = 2; break;
+    case LF_LONG: case LF_ULONG: valueSize = 4; break;
+    case LF_QUADWORD: case LF_UQUADWORD: valueSize = 8; break;
+    default: return 0;
+    }
+    return 2 + valueSize <= size ? 2 + valueSize : 0;
+}
+
+bool RecordName(uint16_t kind, const uint8_t* data, uint32_t size, const char** pName, size_t* pLength)
+{
+    uint32_t nameOffset;
+    switch (kind)
+    {
+    case LF_CLASS:
+    case LF_STRUCTURE:
+    case LF_INTERFACE:
+    case LF_UNION:
+    {
+        // count, property, field list, and for classes derivation list and
+        // vtable shape, then the size as a numeric leaf.
+        uint32_t fixed = kind == LF_UNION ? 8 : 16;
+        if (size < fixed)
+            return false;
+        uint32_t numeric = NumericLeafSize(data + fixed, size - fixed);
+        if (numeric == 0)
+            return false;
+        nameOffset = fixed + numeric;
+        break;
+    }
+    case LF_ENUM:
+        nameOffset = 12;
+        break;
+    case LF_FUNC_ID:
+    case LF_MFUNC_ID:
+        nameOffset = 8;
+        break;
+    default:
+        return false;
+    }
+    if (nameOffset >= size)
+        return false;
+    const char* name = reinterpret_cast<const char*>(data + nameOffset);
+    const void* end = memchr(name, 0, size - nameOffset);
+    *pName = name;
+    *pLength = end ? static_cast<const char*>(end) - name : size - nameOffset;
+    return true;
+}
+
+void FindTypeIndices(uint16_t kind, const uint8_t* data, uint32_t size, std::vector<TypeIndexRef>* pRefs)
+{
+    pRefs->clear();
+    switch (kind)
+    {
+    case LF_MODIFIER:
+    case LF_BITFIELD:
+        AddIndex(pRefs, size, 0);
+        break;
+    case LF_STRING_ID:
+        AddIndex(pRefs, size, 0, true);
+        break;
+    case LF_POINTER:
+        AddIndex(pRefs, size, 0);
+        // Pointers to members name the class too.
+        if (size >= 8)
+        {
+            uint32_t mode = (LoadU32(data + 4) >> 5) & 7;
+            if (mode == kPointerToDataMember || mode == kPointerToMemberFunction)
+                AddIndex(pRefs, size, 8);
+        }
+        break;
+    case LF_PROCEDURE:
+        AddIndex(pRefs, size, 0);
+        AddIndex(pRefs, size, 8);
+        break;
+    case LF_MFUNCTION:
+        AddIndexList(pRefs, size, 0, 3);
+        AddIndex(pRefs, size, 16);
+        break;
+    case LF_ARGLIST:
+    case LF_SUBSTR_LIST:
+        if (size >= 4)
+            AddIndexList(pRefs, size, 4, LoadU32(data), kind == LF_SUBSTR_LIST);
+        break;
+    case LF_BUILDINFO:
+        if (size >= 2)
+            AddIndexList(pRefs, size, 2, LoadU16(data), true);
+        break;
+    case LF_FIELDLIST:
+        FindFieldListIndices(data, size, pRefs);
+        break;
+    case LF_METHODLIST:
+        for (uint32_t offset = 0; offset <= size && size - offset >= 8;)
+        {
+            AddIndex(pRefs, size, offset + 4);
+            offset += IntroducesVirtual(LoadU16(data + offset)) ? 12 : 8;
+        }
+        break;
+    case LF_ARRAY:
+    case LF_VFTABLE:
+    case LF_MFUNC_ID:
+        AddIndexList(pRefs, size, 0, 2);
+        break;
+    case LF_FUNC_ID:
+        // The scope is an id, the function's type a type.
+        AddIndex(pRefs, size, 0, true);
+        AddIndex(pRefs, size, 4);
+        break;
+    case LF_UDT_SRC_LINE:
+        // The type, then the id of the source file's name.
+        AddIndex(pRefs, size, 0);
+        AddIndex(pRefs, size, 4, true);
+        break;
+    case LF_UDT_MOD_SRC_LINE:
+        // The source file is an offset into /names rather than an id.
+        AddIndex(pRefs, size, 0);
+        break;
+    case LF_CLASS:
+    case LF_STRUCTURE:
+    case LF_INTERFACE:
+        AddIndexList(pRefs, size, 4, 3);
+        break;
+    case LF_UNION:
+        AddIndex(pRefs, size, 4);
+        break;
+    case LF_ENUM:
+        AddIndexList(pRefs, size, 4, 2);
+        break;
+    default:
+        break;
+    }
+}
+
+TypeRecordReader::TypeRecordReader(const MsfFile& msf, uint32_t stream, const TpiHeader& header)
+    : reader_(msf, stream, header.headerSize)
+    , end_(header.headerSize + header.typeRecordBytes)
+    , truncated_(false)
+{
+}
+
+bool TypeRecordReader::Next(uint16_t* pKind, const uint8_t** pData, uint32_t* pSize)
+{
+    if (reader_.Offset() == end_)
+        return false;
+    const uint8_t* prefix = end_ - reader_.Offset() >= 2 ? reader_.Read(2) : nullptr;
+    uint32_t length = prefix ? LoadU16(prefix) : 0;
+    const uint8_t* record = length >= 2 && length <= end_ - reader_.Offset() ? reader_.Read(length) : nullptr;
+    if (!record)
+    {
+        truncated_ = true;
+        return false;
+    }
+    *pKind = LoadU16(record);
+    *pData = record + 2;
+    *pSize = length - 2;
+    return true;
+}
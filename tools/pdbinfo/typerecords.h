@@ -0,0 +1,61 @@
+// Copyright 2013 Cygnus Software
+// Decoding of the CodeView type records in the TPI and IPI streams: a
+// reader that steps through the records and the few pieces of record
+// parsing that pdbinfo needs. Shared by -bloat and the fuzzer, so that what
+// is fuzzed is what runs.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "msf.h"
+#include "pdb.h"
+
+// Reads the records of a TPI or IPI stream one at a time. Records that fall
+// within one block are returned straight from the file data.
+class TypeRecordReader
+{
+public:
+    TypeRecordReader(const MsfFile& msf, uint32_t stream, const TpiHeader& header);
+
+    // The leaf kind of the next record and the bytes that follow the kind,
+    // valid until the next call. Returns false at the end of the records,
+    // or if a record runs past them, which sets Truncated().
+    bool Next(uint16_t* pKind, const uint8_t** pData, uint32_t* pSize);
+    bool Truncated() const { return truncated_; }
+
+private:
+    MsfStreamReader reader_;
+    uint32_t end_;
+    bool truncated_;
+};
+
+// Name of a leaf kind, such as "LF_STRUCTURE", or null for kinds that aren't
+// known.
+const char* LeafKindName(uint16_t kind);
+
+// Size of the numeric leaf at p, or 0 if it isn't one that is understood.
+uint32_t NumericLeafSize(const uint8_t* p, uint32_t size);
+
+// Find the name in a UDT, enum or function id record. data points just
+// past the leaf kind. The name isn't necessarily terminated within size.
+bool RecordName(uint16_t kind, const uint8_t* data, uint32_t size, const char** pName, size_t* pLength);
+
+// Type indices below this are the predefined (simple) types, which are part
+// of a record's content rather than references to other records.
+const uint32_t kFirstRecordTypeIndex = 0x1000;
+
+// A field of a record that holds a type index. Items are the ids of IPI
+// records, such as the scope of an LF_FUNC_ID; the rest index TPI records.
+struct TypeIndexRef
+{
+    uint32_t offset;        // From the data that follows the leaf kind.
+    bool isItem;
+};
+
+// Find the fields of a record that hold type indices, in order. data points
+// just past the leaf kind. Members of a field list that aren't understood
+// end the search, so their indices aren't listed.
+void FindTypeIndices(uint16_t kind, const uint8_t* data, uint32_t size, std::vector<TypeIndexRef>* pRefs);
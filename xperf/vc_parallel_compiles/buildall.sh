@@ -0,0 +1,192 @@
+#!/bin/bash
+# Linux counterpart of buildall.bat. Builds the three projects of the
+# benchmark from CMakeLists.txt with gcc and clang, with and without the
+# precompiled header, at several -j levels. Each build runs under buildwatch
+# (devenvwrapper/buildwatch.cpp), which times every compile the way
+# ETWTimeBuild_lowrate.bat does on Windows.
+#
+# Then CompileUnity is built at each -j level with that many unity batches,
+# from buildtimes -unity on the file times of the CompileMostParallel build
+# without the precompiled header at the first -j level. It is built once with
+# the batches packed longest first and once, as CompileUnityChunks, with them
+# cut in name order. The end of the output compares the wall times of every
+# project.
+#
+# With -cache every build runs through compilecache (devenvwrapper/
+# compilecache.cpp) twice: cold, with an empty cache, and warm, after a clean,
+# with the cache the cold build filled. The difference is what a compile
+# cache buys a rebuild of unchanged sources, and the cold build shows what
+# its lookups cost.
+#
+# -kernel builds everything with one of the compile cost kernels of kernels.h,
+# such as INLINE, instead of fib.h.
+#
+# The results go to the output directory:
+#   results.csv   compiler, pch, project, -j, wall seconds, compile seconds
+#                 and their ratio, the average number of compiles running,
+#                 then the cache state (off, cold or warm), its hits and
+#                 misses and the compile seconds it saved
+#   <run>.tsv     the buildwatch process log of each build, for
+#                 buildtimes -analyze -format procs
+#   <run>.log     its output
+#   history.cth   the time of each translation unit in every build, labeled
+#                 with the run, for buildtimes -history -file Group1 history.cth
+#   *.cmake       the unity batches, with the buildtimes -unity report of
+#                 each in *.cmake.txt
+#   cache         with -cache, the compile cache of the last build, whose
+#                 stats.tsv has the hit or miss and time saved of each file
+
+usage()
+{
+	echo "Usage: $0 [-j \"1 2 4 8\"] [-compilers \"gcc clang\"] [-constexpr] [-kernel name] [-cache] [outdir]"
+	exit 1
+}
+
+here=$(cd "$(dirname "$0")" && pwd)
+jobs="1 2 4 $(nproc)"
+compilers="gcc clang"
+constexpr=OFF
+kernel=
+cache=
+out=
+while [ $# -gt 0 ]; do
+	case "$1" in
+	-j) [ $# -ge 2 ] || usage; jobs=$2; shift 2 ;;
+	-compilers) [ $# -ge 2 ] || usage; compilers=$2; shift 2 ;;
+	-constexpr) constexpr=ON; shift ;;
+	-kernel) [ $# -ge 2 ] || usage; kernel=$2; shift 2 ;;
+	-cache) cache=1; shift ;;
+	-*) usage ;;
+	*) [ -z "$out" ] || usage; out=$1; shift ;;
+	esac
+done
+out=$(mkdir -p "${out:-buildall-results}" && cd "${out:-buildall-results}" && pwd) || exit 1
+
+generator="Unix Makefiles"
+if command -v ninja > /dev/null; then
+	generator=Ninja
+fi
+
+# The timing tools.
+tools=$out/tools
+cmake -S "$here/devenvwrapper" -B "$tools" -G "$generator" > /dev/null && cmake --build "$tools" > /dev/null || exit 1
+buildwatch=$tools/buildwatch
+buildtimes=$tools/buildtimes
+cachedir=$out/cache
+launcher=
+if [ -n "$cache" ]; then
+	launcher="$tools/compilecache;-dir;$cachedir"
+fi
+
+# Clean build and time a target, and add its results. With -cache, do it cold
+# and then warm.
+timed_build()
+{
+	local build=$1 target=$2 project=$3 j=$4
+	local states=off
+	if [ -n "$cache" ]; then
+		states="cold warm"
+	fi
+	local state
+	for state in $states; do
+		local run=$compiler-pch$pch-$project-j$j
+		if [ $state != off ]; then
+			run=$run-$state
+		fi
+		[ $state != cold ] || rm -rf "$cachedir"
+		local logged=0
+		[ ! -f "$cachedir/stats.tsv" ] || logged=$(wc -l < "$cachedir/stats.tsv")
+		cmake --build "$build" --target clean > /dev/null
+		"$buildwatch" -log "$out/$run.tsv" -top 0 cmake --build "$build" --target $target -j $j > "$out/$run.log" 2>&1
+		local summary=$(tail -1 "$out/$run.log")
+		# "N processes in W s, of which C were compilers, running for T s (U s of CPU)."
+		local wall=$(echo "$summary" | sed -n 's/.* processes in \([0-9.]*\) s.*/\1/p')
+		local compile=$(echo "$summary" | sed -n 's/.* running for \([0-9.]*\) s.*/\1/p')
+		if [ -z "$wall" ] || [ -z "$compile" ]; then
+			echo "$run failed."
+			continue
+		fi
+		local parallelism=$(awk "BEGIN { if ($wall > 0) printf \"%.2f\", $compile / $wall }")
+		# The compiles of this build in the cache's stats log: time, result,
+		# seconds, seconds saved, source.
+		local cached=0,0,0
+		if [ $state != off ]; then
+			cached=$(tail -n +$((logged + 1)) "$cachedir/stats.tsv" 2> /dev/null | awk -F'\t' '
+				$2 == "hit" || $2 == "remote" { ++hits }
+				$2 == "miss" { ++misses }
+				{ saved += $4 }
+				END { printf "%d,%d,%.3f", hits, misses, saved }')
+		fi
+		echo "$compiler,$pch,$project,$j,$wall,$compile,$parallelism,$state,$cached" >> "$out/results.csv"
+		printf "%-54s %8.2f s wall %8.2f s compiling %6.2f running\n" $run $wall $compile $parallelism
+		"$buildtimes" -history -add "$out/history.cth" -label $run -format procs "$out/$run.tsv" > /dev/null
+	done
+}
+
+echo "compiler,pch,project,jobs,wall,compile,parallelism,cache,hits,misses,saved" > "$out/results.csv"
+for compiler in $compilers; do
+	case $compiler in
+	gcc) cxx=g++ ;;
+	clang) cxx=clang++ ;;
+	*) cxx=$compiler ;;
+	esac
+	if ! command -v $cxx > /dev/null; then
+		echo "$cxx not found, skipping $compiler."
+		continue
+	fi
+	for pch in ON OFF; do
+		build=$out/build-$compiler-pch$pch
+		cmake -S "$here" -B "$build" -G "$generator" -DCMAKE_CXX_COMPILER=$cxx -DCOMPILE_PARALLEL_PCH=$pch \
+			-DCOMPILE_PARALLEL_CONSTEXPR=$constexpr -DCOMPILE_PARALLEL_KERNEL=$kernel -DCOMPILE_PARALLEL_UNITY= -DCMAKE_CXX_COMPILER_LAUNCHER="$launcher" \
+			> /dev/null || exit 1
+		for project in CompileNonParallel CompileMoreParallel CompileMostParallel; do
+			for j in $jobs; do
+				timed_build "$build" $project $project $j
+			done
+		done
+	done
+
+	set -- $jobs
+	measured=$out/$compiler-pchOFF-CompileMostParallel-j$1${cache:+-cold}.tsv
+	[ -f "$measured" ] || continue
+	for j in $jobs; do
+		for batching in packed chunked; do
+			project=CompileUnity
+			chunks=
+			if [ $batching = chunked ]; then
+				project=CompileUnityChunks
+				chunks=-chunks
+			fi
+			batches=$out/$compiler-unity-$batching-j$j.cmake
+			"$buildtimes" -unity -batches $j $chunks -match "$here/" -format procs "$measured" "$batches" > "$batches.txt" ||
+				exit 1
+			for pch in ON OFF; do
+				build=$out/build-$compiler-unity-pch$pch
+				cmake -S "$here" -B "$build" -G "$generator" -DCMAKE_CXX_COMPILER=$cxx -DCOMPILE_PARALLEL_PCH=$pch \
+					-DCOMPILE_PARALLEL_CONSTEXPR=$constexpr -DCOMPILE_PARALLEL_KERNEL=$kernel -DCOMPILE_PARALLEL_UNITY="$batches" \
+					-DCMAKE_CXX_COMPILER_LAUNCHER="$launcher" > /dev/null || exit 1
+				timed_build "$build" CompileUnity $project $j
+			done
+		done
+	done
+done
+
+# Wall seconds of each project at each -j level.
+awk -F, -v jobs="$jobs" '
+	NR > 1 {
+		key = $1 " pch " $2 " " $3 ($8 == "off" ? "" : " " $8)
+		if (!(key in seen)) { seen[key] = 1; keys[++count] = key }
+		wall[key, $4] = $5
+	}
+	END {
+		n = split(jobs, j, " ")
+		printf "\n%-40s", "Wall seconds at -j"
+		for (i = 1; i <= n; ++i) printf "%8s", j[i]
+		printf "\n"
+		for (k = 1; k <= count; ++k) {
+			printf "%-40s", keys[k]
+			for (i = 1; i <= n; ++i) printf "%8s", ((keys[k], j[i]) in wall) ? wall[keys[k], j[i]] : "-"
+			printf "\n"
+		}
+	}' "$out/results.csv"
+echo "Results are in $out/results.csv."
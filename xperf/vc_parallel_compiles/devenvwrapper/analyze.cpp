@@ -0,0 +1,290 @@
+// buildtimes -analyze: how much parallelism a build got, where it was lost,
+// how the projects overlapped, and what the same compiles would take on other
+// core counts.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "buildanalysis.h"
+#include "buildmodel.h"
+#include "commands.h"
+
+namespace
+{
+
+const size_t kHistogramRows = 20;
+
+const SchedulePolicy kPolicies[] = { kScheduleFileOrder, kScheduleLongestFirst, kScheduleProjectSerialized };
+
+// Parse "1,2,4,8" into core counts. Returns false on anything else.
+bool ParseCoreList(const char* text, std::vector<uint32_t>* pCores)
+{
+	pCores->clear();
+	const char* p = text;
+	for (;;)
+	{
+		char* end;
+		long cores = strtol(p, &end, 10);
+		if (end == p || cores <= 0 || cores > 100000)
+			return false;
+		pCores->push_back(static_cast<uint32_t>(cores));
+		if (*end == 0)
+			return true;
+		if (*end != ',')
+			return false;
+		p = end + 1;
+	}
+}
+
+// The average number of running compiles in each of bucketCount equal
+// slices of the build.
+void BucketCurve(const std::vector<ConcurrencyStep>& steps, size_t bucketCount, std::vector<double>* pAverages)
+{
+	std::vector<double>& averages = *pAverages;
+	averages.assign(bucketCount, 0.0);
+	if (steps.empty() || bucketCount == 0)
+		return;
+	long long first = steps.front().start;
+	double width = double(steps.back().end - first) / bucketCount;
+	if (width <= 0)
+		return;
+	for (size_t i = 0; i < steps.size(); ++i)
+	{
+		double start = (steps[i].start - first) / width;
+		double end = (steps[i].end - first) / width;
+		for (size_t bucket = static_cast<size_t>(start); bucket < bucketCount && bucket < end; ++bucket)
+		{
+			double overlap = std::min(end, double(bucket + 1)) - std::max(start, double(bucket));
+			averages[bucket] += overlap * steps[i].running;
+		}
+	}
+}
+
+void PrintBar(double value, double maximum, int width)
+{
+	int length = maximum > 0 ? static_cast<int>(value / maximum * width + 0.5) : 0;
+	for (int i = 0; i < length; ++i)
+		putchar('#');
+}
+
+// The time spent at each count, with the counts grouped so that wide builds
+// still fit on a screen.
+void PrintHistogram(const std::vector<long long>& histogram, long long wall, double frequency)
+{
+	size_t groupSize = (histogram.size() + kHistogramRows - 1) / kHistogramRows;
+	for (size_t low = 0; low < histogram.size(); low += groupSize)
+	{
+		size_t high = std::min(low + groupSize, histogram.size()) - 1;
+		long long ticks = 0;
+		for (size_t running = low; running <= high; ++running)
+			ticks += histogram[running];
+		if (!ticks)
+			continue;
+		if (low == high)
+			printf("%9u", static_cast<unsigned>(low));
+		else
+			printf("%4u-%-4u", static_cast<unsigned>(low), static_cast<unsigned>(high));
+		printf(" %10.2f s %5.1f%% ", ticks / frequency, wall ? ticks * 100.0 / wall : 0.0);
+		PrintBar(double(ticks), double(wall), 50);
+		printf("\n");
+	}
+}
+
+const char* FileNamePart(const std::string& path)
+{
+	size_t slash = path.find_last_of("\\/");
+	return path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+// How the projects overlapped, and the ones with the most compile time.
+void PrintProjects(const std::vector<CompileJob>& jobs, const std::vector<ProjectWork>& projects, long long wall,
+                   double frequency, size_t topCount)
+{
+	auto seconds = [frequency](long long ticks) { return ticks / frequency; };
+	std::vector<ConcurrencyStep> steps;
+	ProjectConcurrencyCurve(jobs, &steps);
+	std::vector<long long> histogram;
+	ConcurrencyHistogram(steps, &histogram);
+	long long projectTime = 0;
+	long long shared = 0;
+	for (size_t i = 0; i < projects.size(); ++i)
+	{
+		projectTime += projects[i].busy;
+		shared += projects[i].shared;
+	}
+	long long overlapped = 0;
+	for (size_t running = 2; running < histogram.size(); ++running)
+		overlapped += histogram[running];
+	printf("\n%u projects, %.2f compiling at once on average and %u at the peak. More than one was compiling\n",
+	       static_cast<unsigned>(projects.size()), wall ? double(projectTime) / wall : 0.0,
+	       histogram.empty() ? 0u : static_cast<unsigned>(histogram.size() - 1));
+	printf("for %.2f s (%.1f%% of wall time), and %.1f%% of project compile time was shared with another project.\n",
+	       seconds(overlapped), wall ? overlapped * 100.0 / wall : 0.0, projectTime ? shared * 100.0 / projectTime : 0.0);
+	printf("Time with each number of projects compiling:\n");
+	PrintHistogram(histogram, wall, frequency);
+
+	std::vector<const ProjectWork*> biggest;
+	for (size_t i = 0; i < projects.size(); ++i)
+		biggest.push_back(&projects[i]);
+	std::stable_sort(biggest.begin(), biggest.end(), [](const ProjectWork* lhs, const ProjectWork* rhs)
+	{
+		return lhs->total > rhs->total;
+	});
+	if (biggest.size() > topCount)
+		biggest.resize(topCount);
+	printf("\nProjects with the most compile time; parallel is compile time over the time the project was compiling:\n");
+	printf("%8s %7s %11s %11s %11s %8s %5s %7s\n", "project", "files", "compile", "span", "compiling", "parallel", "peak",
+	       "shared");
+	for (size_t i = 0; i < biggest.size(); ++i)
+	{
+		const ProjectWork& work = *biggest[i];
+		printf("%7d> %7u %9.2f s %9.2f s %9.2f s %8.2f %5u %6.1f%%\n", work.projectNode,
+		       static_cast<unsigned>(work.jobCount), seconds(work.total), seconds(work.lastEnd - work.firstStart),
+		       seconds(work.busy), work.busy ? double(work.total) / work.busy : 0.0, work.peak,
+		       work.busy ? work.shared * 100.0 / work.busy : 0.0);
+	}
+}
+
+}  // namespace
+
+int AnalyzeMain(int argc, char* argv[])
+{
+	TimelineOptions options;
+	uint32_t machineCores = 0;
+	std::vector<uint32_t> simulateCores;
+	size_t bucketCount = 40;
+	size_t pathCount = 10;
+	size_t projectCount = 10;
+	bool ok = true;
+	bool badArgs = false;
+	int arg = 0;
+	for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] && ok && !badArgs; ++arg)
+	{
+		if (ParseTimelineOption(&arg, argc, argv, &options, &ok))
+			continue;
+		if (arg + 1 >= argc)
+			badArgs = true;
+		else if (strcmp(argv[arg], "-cores") == 0)
+			machineCores = static_cast<uint32_t>(atoi(argv[++arg]));
+		else if (strcmp(argv[arg], "-simulate") == 0)
+			badArgs = !ParseCoreList(argv[++arg], &simulateCores);
+		else if (strcmp(argv[arg], "-buckets") == 0)
+			bucketCount = static_cast<size_t>(atoi(argv[++arg]));
+		else if (strcmp(argv[arg], "-path") == 0)
+			pathCount = static_cast<size_t>(atoi(argv[++arg]));
+		else if (strcmp(argv[arg], "-projects") == 0)
+			projectCount = static_cast<size_t>(atoi(argv[++arg]));
+		else
+			badArgs = true;
+	}
+	if (!ok || badArgs || argc - arg != 1)
+	{
+		printf("usage: buildtimes -analyze %s\n", kTimelineUsage);
+		printf("                           [-cores n] [-simulate n,n,...] [-buckets n] [-path n] [-projects n]\n");
+		printf("                           <log|-|dir>\n");
+		printf("  -cores is the core count of the machine that ran the build, for the idle time.\n");
+		printf("  It defaults to the peak number of concurrent compiles.\n");
+		return 1;
+	}
+
+	std::unique_ptr<BuildTimeline> timeline = LoadTimeline(options, argv[arg]);
+	if (!timeline)
+		return 1;
+	std::vector<CompileJob> jobs;
+	timeline->BuildJobs(&jobs);
+	const std::vector<std::string>& sources = timeline->Sources();
+	const double frequency = timeline->Frequency();
+	auto seconds = [frequency](long long ticks) { return ticks / frequency; };
+
+	std::vector<ConcurrencyStep> steps;
+	ConcurrencyCurve(jobs, &steps);
+	std::vector<long long> histogram;
+	ConcurrencyHistogram(steps, &histogram);
+	std::vector<ProjectWork> projects;
+	ProjectTotals(jobs, &projects);
+
+	long long wall = steps.empty() ? 0 : steps.back().end - steps.front().start;
+	long long busy = 0;
+	for (size_t i = 0; i < jobs.size(); ++i)
+		busy += jobs[i].end - jobs[i].start;
+	uint32_t peak = histogram.empty() ? 0 : static_cast<uint32_t>(histogram.size() - 1);
+	if (!machineCores)
+		machineCores = std::max(peak, 1u);
+
+	printf("%u compiles of %u files in %u projects.\n", static_cast<unsigned>(jobs.size()),
+	       static_cast<unsigned>(sources.size()), static_cast<unsigned>(projects.size()));
+	printf("Wall time        %10.2f s, from the first compile start to the last compile end\n", seconds(wall));
+	printf("Compile time     %10.2f s\n", seconds(busy));
+	printf("Parallelism      %10.2f on average, %u at the peak\n", wall ? double(busy) / wall : 0.0, peak);
+	double capacity = double(machineCores) * wall;
+	printf("Idle core time   %10.2f s of %.2f s on %u cores (%.1f%%)\n", seconds(static_cast<long long>(capacity - busy)),
+	       seconds(static_cast<long long>(capacity)), machineCores, capacity > 0 ? (capacity - busy) * 100.0 / capacity : 0.0);
+
+	std::vector<double> averages;
+	BucketCurve(steps, bucketCount, &averages);
+	if (!averages.empty())
+	{
+		printf("\nConcurrency over time (average running compiles per %.2f s):\n", seconds(wall) / bucketCount);
+		for (size_t i = 0; i < averages.size(); ++i)
+		{
+			printf("%9.2f s %7.2f ", seconds(wall) * i / bucketCount, averages[i]);
+			PrintBar(averages[i], std::max(double(peak), 1.0), 50);
+			printf("\n");
+		}
+	}
+
+	printf("\nTime with each number of compiles running:\n");
+	PrintHistogram(histogram, wall, frequency);
+
+	CriticalPath path;
+	FindCriticalPath(jobs, &path);
+	printf("\nLongest serial chain: %u compiles, %.2f s compiling and %.2f s between them (%.1f%% of wall time).\n",
+	       static_cast<unsigned>(path.jobs.size()), seconds(path.busy), seconds(path.gaps),
+	       wall ? (path.busy + path.gaps) * 100.0 / wall : 0.0);
+	std::vector<size_t> longest = path.jobs;
+	std::stable_sort(longest.begin(), longest.end(), [&jobs](size_t lhs, size_t rhs)
+	{
+		return jobs[lhs].end - jobs[lhs].start > jobs[rhs].end - jobs[rhs].start;
+	});
+	if (longest.size() > pathCount)
+		longest.resize(pathCount);
+	for (size_t i = 0; i < longest.size(); ++i)
+	{
+		const CompileJob& job = jobs[longest[i]];
+		printf("%10.2f s  %d>%s\n", seconds(job.end - job.start), job.projectNode, FileNamePart(sources[job.source]));
+	}
+
+	if (!projects.empty())
+		PrintProjects(jobs, projects, wall, frequency, projectCount);
+
+	if (simulateCores.empty())
+	{
+		for (uint32_t cores = 1; cores < peak; cores *= 2)
+			simulateCores.push_back(cores);
+		simulateCores.push_back(std::max(peak, 1u));
+		if (machineCores != peak)
+			simulateCores.push_back(machineCores);
+		std::sort(simulateCores.begin(), simulateCores.end());
+	}
+	printf("\nSimulated wall time of the compiles alone, in seconds, with the lower bound in brackets:\n");
+	printf("%6s", "cores");
+	for (size_t policy = 0; policy < sizeof(kPolicies) / sizeof(kPolicies[0]); ++policy)
+		printf(" %26s", SchedulePolicyName(kPolicies[policy]));
+	printf("\n");
+	for (size_t i = 0; i < simulateCores.size(); ++i)
+	{
+		printf("%6u", simulateCores[i]);
+		for (size_t policy = 0; policy < sizeof(kPolicies) / sizeof(kPolicies[0]); ++policy)
+		{
+			long long simulated = SimulateSchedule(jobs, simulateCores[i], kPolicies[policy]);
+			long long bound = ScheduleLowerBound(jobs, simulateCores[i], kPolicies[policy]);
+			printf(" %14.2f (%9.2f)", seconds(simulated), seconds(bound));
+		}
+		printf("\n");
+	}
+	return 0;
+}
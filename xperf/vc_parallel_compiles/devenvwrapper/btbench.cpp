@@ -0,0 +1,508 @@
+// Replays captured build output through the /Bt+ parser to measure how fast
+// devenvwrapper can consume it, and compares it with the original line at a
+// time parser (fgets into a 2000 byte buffer, then strstr, sscanf and
+// strrchr). The two should find the same compile stages, except for stages
+// on lines longer than the old buffer, which it splits.
+//
+// With -pipeline the log is also written through a pipe, as devenv would,
+// and read back by the old single threaded loop, which reads, echoes and
+// parses in turn, and then by the reader, parser and echo threads of
+// OutputPipeline. The echo goes to the null device, optionally slowed down to
+// mimic a console. For each it reports the lag from the output being written
+// to it being parsed and how long the writer was blocked on a full pipe.
+//
+// With -generate a synthetic devenv log of the requested size is written
+// first: numbered project prefixes, file name lines, warnings, the two
+// timing lines per translation unit and the occasional very long line.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "btparse.h"
+#include "pipeline.h"
+
+namespace
+{
+
+// Totals that both parsers should agree on.
+struct StageTotals
+{
+	unsigned long long stages;
+	unsigned long long ticks;
+	unsigned long long nameBytes;
+};
+
+class TotalingHandler : public BtLogParser::Handler
+{
+public:
+	TotalingHandler() { memset(&totals_, 0, sizeof(totals_)); }
+
+	void OnStage(const CompileStage& stage) override
+	{
+		++totals_.stages;
+		totals_.ticks += stage.end - stage.start;
+		totals_.nameBytes += stage.fileName.size;
+	}
+
+	const StageTotals& Totals() const { return totals_; }
+
+private:
+	StageTotals totals_;
+};
+
+double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// A cheap deterministic generator so that the same size gives the same log.
+class Random
+{
+public:
+	explicit Random(unsigned seed) : state_(seed) {}
+	unsigned Next()
+	{
+		state_ = state_ * 1103515245 + 12345;
+		return state_ >> 8;
+	}
+	unsigned Below(unsigned limit) { return Next() % limit; }
+
+private:
+	unsigned state_;
+};
+
+bool GenerateLog(const char* path, unsigned long long targetBytes)
+{
+	FILE* fp = fopen(path, "wb");
+	if (!fp)
+		return false;
+	Random random(1);
+	const char* const compilerDir = "C:\\Program Files (x86)\\Microsoft Visual Studio 12.0\\VC\\bin";
+	long long counter = 1379145750955LL;
+	unsigned long long written = 0;
+	std::string line;
+	std::string longLine;
+	char text[1024];
+	for (unsigned file = 0; written < targetBytes; ++file)
+	{
+		int node = 1 + file / 50 % 16;
+		unsigned project = file / 50;
+		sprintf(text, "C:\\src\\project%u\\module%u\\file%u.cpp", project, file % 7, file);
+		std::string source = text;
+		line.clear();
+		if (file % 50 == 0)
+		{
+			sprintf(text, "%d>------ Build started: Project: project%u, Configuration: Release Win32 ------\r\n", node,
+			        project);
+			line += text;
+		}
+		sprintf(text, "%d>  file%u.cpp\r\n", node, file);
+		line += text;
+		for (unsigned w = random.Below(6); w > 0; --w)
+		{
+			sprintf(text, "%d>%s(%u): warning C4996: 'strcpy': This function or variable may be unsafe. "
+			              "Consider using strcpy_s instead.\r\n", node, source.c_str(), 10 + random.Below(5000));
+			line += text;
+		}
+		if (file % 200 == 17)
+		{
+			// A template error or a response file echo, longer than the old
+			// 2000 byte buffer.
+			longLine.assign(2000 + random.Below(8000), 'x');
+			line += std::to_string(node) + ">" + source + "(1): note: see reference to " + longLine + "\r\n";
+		}
+		long long start = counter + random.Below(100000);
+		long long middle = start + 1000 + random.Below(30000000);
+		long long end = middle + 1000 + random.Below(3000000);
+		counter = start;
+		sprintf(text, "%d>  time(%s\\c1xx.dll)=%.5fs < %lld - %lld > BB [%s]\r\n", node, compilerDir,
+		        (middle - start) / 1e7, start, middle, source.c_str());
+		line += text;
+		sprintf(text, "%d>  time(%s\\c2.dll)=%.5fs < %lld - %lld > BB [%s]\r\n", node, compilerDir,
+		        (end - middle) / 1e7, middle, end, source.c_str());
+		line += text;
+		if (fwrite(line.data(), 1, line.size(), fp) != line.size())
+		{
+			fclose(fp);
+			return false;
+		}
+		written += line.size();
+	}
+	return fclose(fp) == 0;
+}
+
+bool RunParser(const char* path, size_t blockSize)
+{
+	FILE* fp = fopen(path, "rb");
+	if (!fp)
+	{
+		printf("Could not open %s.\n", path);
+		return false;
+	}
+	std::vector<char> block(blockSize);
+	TotalingHandler handler;
+	BtLogParser parser(&handler);
+	unsigned long long bytes = 0;
+	double parseSeconds = 0.0;
+	auto start = std::chrono::steady_clock::now();
+	for (;;)
+	{
+		size_t bytesRead = fread(block.data(), 1, block.size(), fp);
+		if (bytesRead == 0)
+			break;
+		bytes += bytesRead;
+		auto parseStart = std::chrono::steady_clock::now();
+		parser.Feed(block.data(), bytesRead);
+		parseSeconds += Seconds(parseStart);
+	}
+	parser.Finish();
+	double totalSeconds = Seconds(start);
+	fclose(fp);
+
+	const StageTotals& totals = handler.Totals();
+	printf("  btparse  %8.1f MB/s parsing, %8.1f MB/s with reads, %llu lines, %llu stages, longest line %u\n",
+	       bytes / 1e6 / parseSeconds, bytes / 1e6 / totalSeconds, parser.LineCount(), totals.stages,
+	       static_cast<unsigned>(parser.LongestLine()));
+	printf("           checksum %llu %llu\n", totals.ticks, totals.nameBytes);
+	return true;
+}
+
+long long Nanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef _WIN32
+const char kNullDevice[] = "NUL";
+
+bool CreatePipe(int fds[2])
+{
+	return _pipe(fds, 64 * 1024, _O_BINARY) == 0;
+}
+#else
+const char kNullDevice[] = "/dev/null";
+
+bool CreatePipe(int fds[2])
+{
+	return pipe(fds) == 0;
+}
+
+int _read(int fd, void* buffer, unsigned size)
+{
+	return static_cast<int>(read(fd, buffer, size));
+}
+
+int _write(int fd, const void* buffer, unsigned size)
+{
+	return static_cast<int>(write(fd, buffer, size));
+}
+
+int _close(int fd)
+{
+	return close(fd);
+}
+#endif
+
+// Plays the part of devenv: writes the log into a pipe in small pieces, at a
+// given rate or as fast as the pipe takes it, and records when each piece was
+// written so that the reading side can tell how late it is.
+class ChildSimulator
+{
+public:
+	ChildSimulator(const std::vector<char>& log, size_t writeSize, double bytesPerSecond)
+		: log_(log)
+		, writeSize_(writeSize)
+		, bytesPerSecond_(bytesPerSecond)
+		, writes_((log.size() + writeSize - 1) / writeSize)
+		, published_(0)
+	{
+	}
+
+	void Run(int fd)
+	{
+		long long begin = Nanoseconds();
+		for (size_t i = 0; i < writes_.size(); ++i)
+		{
+			size_t offset = i * writeSize_;
+			size_t size = std::min(writeSize_, log_.size() - offset);
+			if (bytesPerSecond_ > 0)
+			{
+				long long due = begin + static_cast<long long>(offset / bytesPerSecond_ * 1e9);
+				while (Nanoseconds() < due)
+					std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+			long long start = Nanoseconds();
+			writes_[i] = start;
+			published_.store(i + 1, std::memory_order_release);
+			for (size_t written = 0; written < size;)
+			{
+				int result = _write(fd, &log_[offset + written], static_cast<unsigned>(size - written));
+				if (result <= 0)
+					return;
+				written += result;
+			}
+			blocked_.Add(Nanoseconds() - start);
+		}
+	}
+
+	// The time the child started writing the last of the first byteCount
+	// bytes. Called in order of increasing byteCount.
+	long long WriteTime(unsigned long long byteCount)
+	{
+		size_t last = static_cast<size_t>((byteCount - 1) / writeSize_);
+		while (published_.load(std::memory_order_acquire) <= last)
+			std::this_thread::yield();
+		return writes_[last];
+	}
+
+	// How long each write took, which is how long the child was blocked.
+	const LatencyStats& Blocked() const { return blocked_; }
+
+private:
+	const std::vector<char>& log_;
+	size_t writeSize_;
+	double bytesPerSecond_;
+	std::vector<long long> writes_;
+	std::atomic<size_t> published_;
+	LatencyStats blocked_;
+};
+
+// Stands in for a console that takes echoMicroseconds per block.
+void Echo(FILE* nullOutput, const char* data, size_t size, unsigned echoMicroseconds)
+{
+	fwrite(data, 1, size, nullOutput);
+	if (echoMicroseconds)
+		std::this_thread::sleep_for(std::chrono::microseconds(echoMicroseconds));
+}
+
+// Feed a simulated devenv's output through the old single threaded loop,
+// which reads, echoes and parses in turn, and then through OutputPipeline.
+// The lag is from the child writing a piece of output to it being parsed,
+// which is the skew that ETW events would get.
+bool RunPipeline(const char* path, size_t blockSize, unsigned echoMicroseconds, double bytesPerSecond)
+{
+	std::vector<char> log;
+	FILE* fp = fopen(path, "rb");
+	if (!fp)
+		return false;
+	char buffer[1 << 16];
+	for (size_t bytesRead; (bytesRead = fread(buffer, 1, sizeof(buffer), fp)) != 0;)
+		log.insert(log.end(), buffer, buffer + bytesRead);
+	fclose(fp);
+	FILE* nullOutput = fopen(kNullDevice, "wb");
+	if (!nullOutput || log.empty())
+		return false;
+
+	for (int pipelined = 0; pipelined < 2; ++pipelined)
+	{
+		int fds[2];
+		if (!CreatePipe(fds))
+			return false;
+		// devenv's output comes through the C runtime a line or a buffer at
+		// a time, so write it in 4 KB pieces.
+		ChildSimulator child(log, 4096, bytesPerSecond);
+		std::thread childThread([&child, &fds]
+		{
+			child.Run(fds[1]);
+			_close(fds[1]);
+		});
+
+		TotalingHandler handler;
+		BtLogParser parser(&handler);
+		LatencyStats lag;
+		unsigned long long parsed = 0;
+		auto afterParse = [&](size_t size)
+		{
+			parsed += size;
+			lag.Add(Nanoseconds() - child.WriteTime(parsed));
+		};
+		auto start = std::chrono::steady_clock::now();
+		PipelineStats stats;
+		memset(&stats, 0, sizeof(stats));
+		if (!pipelined)
+		{
+			std::vector<char> block(blockSize);
+			for (;;)
+			{
+				int bytesRead = _read(fds[0], block.data(), static_cast<unsigned>(block.size()));
+				if (bytesRead <= 0)
+					break;
+				Echo(nullOutput, block.data(), bytesRead, echoMicroseconds);
+				parser.Feed(block.data(), bytesRead);
+				afterParse(bytesRead);
+			}
+		}
+		else
+		{
+			OutputPipeline pipeline(blockSize, 64);
+			int readFd = fds[0];
+			pipeline.Run(
+				[readFd](char* data, size_t size) -> long long { return _read(readFd, data, static_cast<unsigned>(size)); },
+				Nanoseconds,
+				[&](const OutputChunk& chunk)
+				{
+					parser.Feed(chunk.data, chunk.size);
+					afterParse(chunk.size);
+				},
+				[nullOutput, echoMicroseconds](const OutputChunk& chunk)
+				{
+					Echo(nullOutput, chunk.data, chunk.size, echoMicroseconds);
+				});
+			stats = pipeline.Stats();
+		}
+		parser.Finish();
+		double seconds = Seconds(start);
+		childThread.join();
+		_close(fds[0]);
+
+		const LatencyStats& blocked = child.Blocked();
+		printf("  %-8s %8.1f MB/s, lag %8.3f ms average %8.3f ms max, child blocked %8.1f ms, %llu stages\n",
+		       pipelined ? "pipeline" : "serial", parsed / 1e6 / seconds, lag.Average() / 1e6, lag.maximum / 1e6,
+		       blocked.total / 1e6, handler.Totals().stages);
+		if (pipelined)
+			printf("           %llu reads, %llu waited for a free buffer, queue high water %u to parse and %u to echo\n",
+			       stats.chunks, stats.readerStalls, static_cast<unsigned>(stats.parseHighWater),
+			       static_cast<unsigned>(stats.echoHighWater));
+	}
+	fclose(nullOutput);
+	return true;
+}
+
+// The parser that devenvwrapper.cpp used to have, minus the ETW calls.
+bool RunLegacyParser(const char* path)
+{
+	FILE* fp = fopen(path, "rb");
+	if (!fp)
+		return false;
+	StageTotals totals;
+	memset(&totals, 0, sizeof(totals));
+	unsigned long long fragments = 0;
+	unsigned long long bytes = 0;
+	char buffer[2000];
+	auto start = std::chrono::steady_clock::now();
+	for (;;)
+	{
+		if (!fgets(buffer, sizeof(buffer), fp))
+			break;
+		size_t length = strlen(buffer);
+		bytes += length;
+		if (length == 0 || buffer[length - 1] != '\n')
+			++fragments;
+		int stage = 0;
+		if (strstr(buffer, "c1xx.dll"))
+			stage = 1;
+		if (strstr(buffer, "c2.dll"))
+			stage = 2;
+		if (stage > 0)
+		{
+			char* lessThan = strchr(buffer, '<');
+			if (lessThan)
+			{
+				long long stageStart, stageEnd;
+				if (2 == sscanf(lessThan, "< %lld - %lld", &stageStart, &stageEnd))
+				{
+					char* lastSlash = strrchr(lessThan, '\\');
+					if (lastSlash)
+					{
+						const char* filename = lastSlash + 1;
+						char* squareBracket = strchr(lastSlash, ']');
+						if (squareBracket)
+							squareBracket[0] = 0;
+						++totals.stages;
+						totals.ticks += stageEnd - stageStart;
+						totals.nameBytes += strlen(filename);
+					}
+				}
+			}
+		}
+	}
+	double seconds = Seconds(start);
+	fclose(fp);
+	printf("  legacy   %8.1f MB/s with reads, %llu stages, %llu reads that ended mid-line\n", bytes / 1e6 / seconds,
+	       totals.stages, fragments);
+	printf("           checksum %llu %llu\n", totals.ticks, totals.nameBytes);
+	return true;
+}
+
+void PrintUsage()
+{
+	printf("Replays build logs through the /Bt+ parser.\n\n");
+	printf("usage: btbench [-generate bytes] [-block bytes] [-nolegacy] [-pipeline] [-echodelay us] [-rate MB/s]\n");
+	printf("               <log>...\n");
+	printf("  -generate bytes   First write a synthetic log of about this size to each <log>.\n");
+	printf("  -block bytes      Size of the reads fed to the parser. Defaults to 1 MB.\n");
+	printf("  -nolegacy         Skip the comparison with the old fgets based parser.\n");
+	printf("  -pipeline         Compare the single threaded read loop with OutputPipeline.\n");
+	printf("  -echodelay us     With -pipeline, how long echoing each block takes. Defaults to 0.\n");
+	printf("  -rate MB/s        With -pipeline, how fast the output is written. Defaults to unlimited.\n");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+	unsigned long long generateBytes = 0;
+	size_t blockSize = 1 << 20;
+	bool legacy = true;
+	bool pipeline = false;
+	unsigned echoMicroseconds = 0;
+	double bytesPerSecond = 0;
+	std::vector<const char*> logs;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-generate") == 0 && i + 1 < argc)
+			generateBytes = strtoull(argv[++i], nullptr, 0);
+		else if (strcmp(argv[i], "-block") == 0 && i + 1 < argc)
+			blockSize = static_cast<size_t>(strtoull(argv[++i], nullptr, 0));
+		else if (strcmp(argv[i], "-nolegacy") == 0)
+			legacy = false;
+		else if (strcmp(argv[i], "-pipeline") == 0)
+			pipeline = true;
+		else if (strcmp(argv[i], "-echodelay") == 0 && i + 1 < argc)
+			echoMicroseconds = static_cast<unsigned>(strtoul(argv[++i], nullptr, 0));
+		else if (strcmp(argv[i], "-rate") == 0 && i + 1 < argc)
+			bytesPerSecond = atof(argv[++i]) * 1e6;
+		else if (argv[i][0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+			logs.push_back(argv[i]);
+	}
+	if (logs.empty() || blockSize == 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	for (size_t i = 0; i < logs.size(); ++i)
+	{
+		if (generateBytes && !GenerateLog(logs[i], generateBytes))
+		{
+			printf("Could not write %s.\n", logs[i]);
+			return 1;
+		}
+		printf("%s\n", logs[i]);
+		if (!RunParser(logs[i], blockSize))
+			return 1;
+		if (legacy)
+			RunLegacyParser(logs[i]);
+		if (pipeline && !RunPipeline(logs[i], blockSize, echoMicroseconds, bytesPerSecond))
+			return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,224 @@
+#include "btparse.h"
+
+#include <stdio.h>
+
+namespace
+{
+
+inline bool IsDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+// Parse a decimal number at p, skipping leading spaces. Returns the first
+// character after it, or null if there are no digits.
+const char* ParseNumber(const char* p, const char* end, long long* pValue)
+{
+	while (p < end && *p == ' ')
+		++p;
+	if (p == end || !IsDigit(*p))
+		return nullptr;
+	long long value = 0;
+	// QPC values are far below 10^18, so 18 digits can't overflow.
+	for (int digits = 0; p < end && IsDigit(*p) && digits < 18; ++p, ++digits)
+		value = value * 10 + (*p - '0');
+	if (p < end && IsDigit(*p))
+		return nullptr;
+	*pValue = value;
+	return p;
+}
+
+const char* FindLast(const char* begin, const char* end, char c)
+{
+	while (end > begin)
+	{
+		if (*--end == c)
+			return end;
+	}
+	return nullptr;
+}
+
+// Which stage a compiler DLL name is, or 0.
+int StageForDll(const char* name, size_t length)
+{
+	if ((length == 4 && memcmp(name, "c1xx", 4) == 0) || (length == 2 && memcmp(name, "c1", 2) == 0))
+		return 1;
+	if (length == 2 && memcmp(name, "c2", 2) == 0)
+		return 2;
+	return 0;
+}
+
+}  // namespace
+
+bool ParseBtLine(const char* line, size_t length, CompileStage* pStage)
+{
+	const char* p = line;
+	const char* end = line + length;
+
+	// The optional "N>" project prefix, then indentation, then "time(".
+	// Checking this first rejects ordinary output after a few bytes.
+	while (p < end && *p == ' ')
+		++p;
+	int projectNode = 0;
+	if (p < end && IsDigit(*p))
+	{
+		while (p < end && IsDigit(*p) && projectNode < 100000000)
+			projectNode = projectNode * 10 + (*p++ - '0');
+		if (p == end || *p != '>')
+			return false;
+		++p;
+		while (p < end && *p == ' ')
+			++p;
+	}
+	if (end - p < 5 || memcmp(p, "time(", 5) != 0)
+		return false;
+	p += 5;
+
+	// The DLL path may contain parentheses, as in "Program Files (x86)", so
+	// look for the ".dll)=" that ends it.
+	const char* dllEnd = nullptr;
+	for (const char* close = p; (close = static_cast<const char*>(memchr(close, ')', end - close))) != nullptr; ++close)
+	{
+		if (close - p >= 4 && close + 1 < end && close[1] == '=' && memcmp(close - 4, ".dll", 4) == 0)
+		{
+			dllEnd = close - 4;
+			break;
+		}
+	}
+	if (!dllEnd)
+		return false;
+	const char* dllName = dllEnd;
+	while (dllName > p && dllName[-1] != '\\' && dllName[-1] != '/')
+		--dllName;
+	int stage = StageForDll(dllName, dllEnd - dllName);
+	if (!stage)
+		return false;
+
+	// "=1.38807s < start - end >"
+	p = static_cast<const char*>(memchr(dllEnd, '<', end - dllEnd));
+	if (!p)
+		return false;
+	long long start, finish;
+	p = ParseNumber(p + 1, end, &start);
+	if (!p)
+		return false;
+	while (p < end && *p == ' ')
+		++p;
+	if (p == end || *p != '-')
+		return false;
+	p = ParseNumber(p + 1, end, &finish);
+	if (!p)
+		return false;
+
+	// "> BB [source]". The path can contain brackets itself so take the
+	// last ']' and the first '[' after the timing.
+	const char* open = static_cast<const char*>(memchr(p, '[', end - p));
+	const char* close = open ? FindLast(open, end, ']') : nullptr;
+	TextRef source;
+	if (open && close)
+		source = TextRef(open + 1, close - open - 1);
+	else
+	{
+		// No brackets: take the rest of the line after '>'.
+		const char* greater = static_cast<const char*>(memchr(p, '>', end - p));
+		if (!greater)
+			return false;
+		const char* text = greater + 1;
+		while (text < end && *text == ' ')
+			++text;
+		source = TextRef(text, end - text);
+	}
+	const char* name = source.data + source.size;
+	while (name > source.data && name[-1] != '\\' && name[-1] != '/')
+		--name;
+
+	pStage->stage = stage;
+	pStage->projectNode = projectNode;
+	pStage->start = start;
+	pStage->end = finish;
+	pStage->source = source;
+	pStage->fileName = TextRef(name, source.data + source.size - name);
+	return true;
+}
+
+BtLogParser::BtLogParser(Handler* pHandler)
+	: handler_(pHandler)
+	, lineCount_(0)
+	, stageCount_(0)
+	, longestLine_(0)
+{
+}
+
+void BtLogParser::ParseLine(const char* line, size_t length)
+{
+	if (length && line[length - 1] == '\r')
+		--length;
+	++lineCount_;
+	if (length > longestLine_)
+		longestLine_ = length;
+	CompileStage stage;
+	if (ParseBtLine(line, length, &stage))
+	{
+		++stageCount_;
+		handler_->OnStage(stage);
+	}
+}
+
+void BtLogParser::Feed(const char* data, size_t size)
+{
+	const char* p = data;
+	const char* end = data + size;
+	if (!partial_.empty())
+	{
+		// Finish the line that the last block ended in the middle of.
+		const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+		if (!newline)
+		{
+			partial_.insert(partial_.end(), p, end);
+			return;
+		}
+		partial_.insert(partial_.end(), p, newline);
+		ParseLine(partial_.data(), partial_.size());
+		partial_.clear();
+		p = newline + 1;
+	}
+	for (;;)
+	{
+		const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+		if (!newline)
+			break;
+		ParseLine(p, newline - p);
+		p = newline + 1;
+	}
+	partial_.insert(partial_.end(), p, end);
+}
+
+void BtLogParser::Finish()
+{
+	if (!partial_.empty())
+	{
+		ParseLine(partial_.data(), partial_.size());
+		partial_.clear();
+	}
+}
+
+bool ParseBtLogFile(const char* path, BtLogParser* pParser)
+{
+	bool useStdin = strcmp(path, "-") == 0;
+	FILE* fp = useStdin ? stdin : fopen(path, "rb");
+	if (!fp)
+		return false;
+	std::vector<char> block(1 << 20);
+	for (;;)
+	{
+		size_t bytesRead = fread(block.data(), 1, block.size(), fp);
+		if (bytesRead == 0)
+			break;
+		pParser->Feed(block.data(), bytesRead);
+	}
+	pParser->Finish();
+	bool ok = !ferror(fp);
+	if (!useStdin)
+		fclose(fp);
+	return ok;
+}
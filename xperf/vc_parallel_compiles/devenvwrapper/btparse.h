@@ -0,0 +1,97 @@
+// Parser for the compiler timing lines that /Bt+ adds to build output, such as
+//   1>  time(C:\...\bin\c1xx.dll)=1.38807s < 1379145750955 - 1379148726430 > BB [C:\src\Group3_J.cpp]
+//   1>  time(C:\...\bin\c2.dll)=0.00499s < 1379148732623 - 1379148743323 > BB [C:\src\Group3_J.cpp]
+// The numbers in angle brackets are QueryPerformanceCounter values for the
+// start and end of the compile stage: c1xx.dll (or c1.dll for C) is the front
+// end and c2.dll is the back end.
+//
+// Output is fed in blocks of any size. Lines are found with memchr, which the
+// C runtime implements with SIMD, and parsed in place, so nothing is copied
+// or allocated per line. The one exception is a line that straddles two
+// blocks, which is gathered into a buffer that is reused. Lines may be any
+// length. The parser has no Windows dependencies so that it can be used and
+// benchmarked away from devenv.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// A span of text in the caller's buffer. std::string_view would do, but the
+// VS 2013 toolset that builds devenvwrapper doesn't have it.
+struct TextRef
+{
+	const char* data;
+	size_t size;
+
+	TextRef() : data(nullptr), size(0) {}
+	TextRef(const char* text, size_t length) : data(text), size(length) {}
+
+	bool empty() const { return size == 0; }
+	std::string str() const { return std::string(data, size); }
+	bool operator==(const TextRef& rhs) const { return size == rhs.size && memcmp(data, rhs.data, size) == 0; }
+	bool operator!=(const TextRef& rhs) const { return !(*this == rhs); }
+};
+
+struct CompileStage
+{
+	// 1 for the front end, 2 for the back end.
+	int stage;
+	// The N of the "N>" prefix that devenv and msbuild put on the output of
+	// each project, or 0 if there is none.
+	int projectNode;
+	// QueryPerformanceCounter values when the stage started and finished.
+	long long start;
+	long long end;
+	// The source file, as written between the square brackets, and the part
+	// of it after the last path separator.
+	TextRef source;
+	TextRef fileName;
+};
+
+// Parse one line, without its line terminator. Returns false if it isn't a
+// /Bt+ timing line.
+bool ParseBtLine(const char* line, size_t length, CompileStage* pStage);
+
+class BtLogParser
+{
+public:
+	class Handler
+	{
+	public:
+		virtual ~Handler() {}
+		// The text that stage refers to is only valid during the call.
+		virtual void OnStage(const CompileStage& stage) = 0;
+	};
+
+	explicit BtLogParser(Handler* pHandler);
+
+	// Parse the complete lines in a block of output. A final partial line
+	// is held until the next call.
+	void Feed(const char* data, size_t size);
+	// Parse whatever is left as the last line.
+	void Finish();
+
+	unsigned long long LineCount() const { return lineCount_; }
+	unsigned long long StageCount() const { return stageCount_; }
+	size_t LongestLine() const { return longestLine_; }
+
+private:
+	BtLogParser(const BtLogParser&);
+	BtLogParser& operator=(const BtLogParser&);
+
+	void ParseLine(const char* line, size_t length);
+
+	Handler* handler_;
+	std::vector<char> partial_;
+	unsigned long long lineCount_;
+	unsigned long long stageCount_;
+	size_t longestLine_;
+};
+
+// Feed a whole file, or stdin for "-", through a parser. Returns false if
+// the file can't be read.
+bool ParseBtLogFile(const char* path, BtLogParser* pParser);
@@ -0,0 +1,372 @@
+#include "buildanalysis.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+
+namespace
+{
+
+long long Duration(const CompileJob& job)
+{
+	return job.end - job.start;
+}
+
+// List scheduling: each duration, in order, goes on the core that frees up
+// first. Returns when the last one finishes.
+long long ListSchedule(const std::vector<long long>& durations, uint32_t cores)
+{
+	if (cores == 0)
+		return 0;
+	std::priority_queue<long long, std::vector<long long>, std::greater<long long>> freeAt;
+	for (uint32_t i = 0; i < cores; ++i)
+		freeAt.push(0);
+	long long finish = 0;
+	for (size_t i = 0; i < durations.size(); ++i)
+	{
+		long long end = freeAt.top() + durations[i];
+		freeAt.pop();
+		freeAt.push(end);
+		finish = std::max(finish, end);
+	}
+	return finish;
+}
+
+// Number the project nodes of the jobs from 0, in order of first appearance,
+// with an empty ProjectWork for each.
+void NumberProjects(const std::vector<CompileJob>& jobs, std::vector<ProjectWork>* pProjects,
+                    std::vector<uint32_t>* pJobProjects)
+{
+	std::vector<ProjectWork>& projects = *pProjects;
+	projects.clear();
+	pJobProjects->resize(jobs.size());
+	std::unordered_map<int, uint32_t> index;
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		auto inserted = index.insert(std::make_pair(jobs[i].projectNode, static_cast<uint32_t>(projects.size())));
+		if (inserted.second)
+		{
+			ProjectWork work = { jobs[i].projectNode, jobs[i].start, jobs[i].end, 0, 0, 0, 0, 0 };
+			projects.push_back(work);
+		}
+		(*pJobProjects)[i] = inserted.first->second;
+	}
+}
+
+// Walk the starts and ends of the jobs in time order, calling onSpan with the
+// length of each span between edges and the projects that had a compile
+// running through it, from the first start to the last end. Also sets the
+// peak of each project. As in ConcurrencyCurve, a compile that starts as
+// another ends doesn't overlap it.
+template <typename OnSpan>
+void SweepProjects(const std::vector<CompileJob>& jobs, const std::vector<uint32_t>& jobProjects,
+                   std::vector<ProjectWork>* pProjects, OnSpan onSpan)
+{
+	std::vector<ProjectWork>& projects = *pProjects;
+	// Time, then -1 for an end and +1 for a start, then the project, so that
+	// the ends at a time are applied before the starts.
+	typedef std::pair<std::pair<long long, int>, uint32_t> Edge;
+	std::vector<Edge> edges;
+	edges.reserve(jobs.size() * 2);
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		edges.push_back(Edge(std::make_pair(jobs[i].start, 1), jobProjects[i]));
+		edges.push_back(Edge(std::make_pair(jobs[i].end, -1), jobProjects[i]));
+	}
+	std::sort(edges.begin(), edges.end());
+
+	std::vector<uint32_t> running(projects.size(), 0);
+	// The projects with a compile running, and each one's place in the list.
+	std::vector<uint32_t> active;
+	std::vector<size_t> position(projects.size(), 0);
+	for (size_t i = 0; i < edges.size();)
+	{
+		long long time = edges[i].first.first;
+		for (; i < edges.size() && edges[i].first.first == time; ++i)
+		{
+			uint32_t project = edges[i].second;
+			if (edges[i].first.second > 0)
+			{
+				if (running[project]++ == 0)
+				{
+					position[project] = active.size();
+					active.push_back(project);
+				}
+				projects[project].peak = std::max(projects[project].peak, running[project]);
+			}
+			else if (--running[project] == 0)
+			{
+				active[position[project]] = active.back();
+				position[active.back()] = position[project];
+				active.pop_back();
+			}
+		}
+		if (i < edges.size())
+			onSpan(edges[i].first.first - time, active);
+	}
+}
+
+}  // namespace
+
+void ConcurrencyCurve(const std::vector<CompileJob>& jobs, std::vector<ConcurrencyStep>* pSteps)
+{
+	std::vector<ConcurrencyStep>& steps = *pSteps;
+	steps.clear();
+	// Starts are +1 and ends -1. All the edges at one time are applied
+	// together so that a compile that starts as another ends doesn't count
+	// as overlap.
+	std::vector<std::pair<long long, int>> edges;
+	edges.reserve(jobs.size() * 2);
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		edges.push_back(std::make_pair(jobs[i].start, 1));
+		edges.push_back(std::make_pair(jobs[i].end, -1));
+	}
+	std::sort(edges.begin(), edges.end());
+	uint32_t running = 0;
+	for (size_t i = 0; i < edges.size();)
+	{
+		long long time = edges[i].first;
+		for (; i < edges.size() && edges[i].first == time; ++i)
+			running += edges[i].second;
+		if (i == edges.size())
+			break;
+		long long next = edges[i].first;
+		if (!steps.empty() && steps.back().running == running)
+			steps.back().end = next;
+		else
+		{
+			ConcurrencyStep step = { time, next, running };
+			steps.push_back(step);
+		}
+	}
+}
+
+void ConcurrencyHistogram(const std::vector<ConcurrencyStep>& steps, std::vector<long long>* pTicks)
+{
+	std::vector<long long>& ticks = *pTicks;
+	ticks.clear();
+	for (size_t i = 0; i < steps.size(); ++i)
+	{
+		if (steps[i].running >= ticks.size())
+			ticks.resize(steps[i].running + 1);
+		ticks[steps[i].running] += steps[i].end - steps[i].start;
+	}
+}
+
+void FindCriticalPath(const std::vector<CompileJob>& jobs, CriticalPath* pPath)
+{
+	CriticalPath& path = *pPath;
+	path.jobs.clear();
+	path.busy = 0;
+	path.gaps = 0;
+	if (jobs.empty())
+		return;
+
+	std::vector<size_t> byEnd(jobs.size());
+	for (size_t i = 0; i < byEnd.size(); ++i)
+		byEnd[i] = i;
+	std::sort(byEnd.begin(), byEnd.end(), [&jobs](size_t lhs, size_t rhs)
+	{
+		return jobs[lhs].end < jobs[rhs].end;
+	});
+	long long first = jobs[0].start;
+	for (size_t i = 1; i < jobs.size(); ++i)
+		first = std::min(first, jobs[i].start);
+
+	// Ends are non-decreasing along byEnd, so the predecessor of a job is
+	// the last entry before it that ends no later than the job starts. Only
+	// entries before the current one are searched, so the walk terminates.
+	size_t position = byEnd.size() - 1;
+	for (;;)
+	{
+		size_t current = byEnd[position];
+		path.jobs.push_back(current);
+		path.busy += Duration(jobs[current]);
+		long long start = jobs[current].start;
+		auto found = std::upper_bound(byEnd.begin(), byEnd.begin() + position, start, [&jobs](long long time, size_t job)
+		{
+			return time < jobs[job].end;
+		});
+		if (found == byEnd.begin())
+		{
+			path.gaps += start - first;
+			break;
+		}
+		position = found - byEnd.begin() - 1;
+		path.gaps += start - jobs[byEnd[position]].end;
+	}
+	std::reverse(path.jobs.begin(), path.jobs.end());
+}
+
+void ProjectTotals(const std::vector<CompileJob>& jobs, std::vector<ProjectWork>* pProjects)
+{
+	std::vector<ProjectWork>& projects = *pProjects;
+	std::vector<uint32_t> jobProjects;
+	NumberProjects(jobs, &projects, &jobProjects);
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		ProjectWork& work = projects[jobProjects[i]];
+		work.firstStart = std::min(work.firstStart, jobs[i].start);
+		work.lastEnd = std::max(work.lastEnd, jobs[i].end);
+		work.total += Duration(jobs[i]);
+		++work.jobCount;
+	}
+	SweepProjects(jobs, jobProjects, &projects, [&projects](long long length, const std::vector<uint32_t>& active)
+	{
+		for (size_t i = 0; i < active.size(); ++i)
+		{
+			projects[active[i]].busy += length;
+			if (active.size() > 1)
+				projects[active[i]].shared += length;
+		}
+	});
+	std::stable_sort(projects.begin(), projects.end(), [](const ProjectWork& lhs, const ProjectWork& rhs)
+	{
+		return lhs.firstStart < rhs.firstStart;
+	});
+}
+
+void ProjectConcurrencyCurve(const std::vector<CompileJob>& jobs, std::vector<ConcurrencyStep>* pSteps)
+{
+	std::vector<ConcurrencyStep>& steps = *pSteps;
+	steps.clear();
+	std::vector<ProjectWork> projects;
+	std::vector<uint32_t> jobProjects;
+	NumberProjects(jobs, &projects, &jobProjects);
+	long long time = 0;
+	for (size_t i = 0; i < jobs.size(); ++i)
+		time = i ? std::min(time, jobs[i].start) : jobs[i].start;
+	SweepProjects(jobs, jobProjects, &projects, [&steps, &time](long long length, const std::vector<uint32_t>& active)
+	{
+		uint32_t running = static_cast<uint32_t>(active.size());
+		if (!steps.empty() && steps.back().running == running)
+			steps.back().end += length;
+		else
+		{
+			ConcurrencyStep step = { time, time + length, running };
+			steps.push_back(step);
+		}
+		time += length;
+	});
+}
+
+const char* SchedulePolicyName(SchedulePolicy policy)
+{
+	switch (policy)
+	{
+	case kScheduleFileOrder:
+		return "file order";
+	case kScheduleLongestFirst:
+		return "longest first";
+	case kScheduleProjectSerialized:
+		return "project serialized";
+	}
+	return "unknown";
+}
+
+long long SimulateSchedule(const std::vector<CompileJob>& jobs, uint32_t cores, SchedulePolicy policy)
+{
+	std::vector<long long> durations;
+	if (policy == kScheduleProjectSerialized)
+	{
+		std::vector<ProjectWork> projects;
+		ProjectTotals(jobs, &projects);
+		for (size_t i = 0; i < projects.size(); ++i)
+			durations.push_back(projects[i].total);
+	}
+	else
+	{
+		// The order the compiles started in.
+		std::vector<size_t> order(jobs.size());
+		for (size_t i = 0; i < order.size(); ++i)
+			order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&jobs](size_t lhs, size_t rhs)
+		{
+			return jobs[lhs].start < jobs[rhs].start;
+		});
+		for (size_t i = 0; i < order.size(); ++i)
+			durations.push_back(Duration(jobs[order[i]]));
+		if (policy == kScheduleLongestFirst)
+			std::stable_sort(durations.begin(), durations.end(), std::greater<long long>());
+	}
+	return ListSchedule(durations, cores);
+}
+
+long long ScheduleLowerBound(const std::vector<CompileJob>& jobs, uint32_t cores, SchedulePolicy policy)
+{
+	if (cores == 0)
+		return 0;
+	long long total = 0;
+	long long longest = 0;
+	if (policy == kScheduleProjectSerialized)
+	{
+		std::vector<ProjectWork> projects;
+		ProjectTotals(jobs, &projects);
+		for (size_t i = 0; i < projects.size(); ++i)
+		{
+			total += projects[i].total;
+			longest = std::max(longest, projects[i].total);
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < jobs.size(); ++i)
+		{
+			total += Duration(jobs[i]);
+			longest = std::max(longest, Duration(jobs[i]));
+		}
+	}
+	return std::max(longest, (total + cores - 1) / cores);
+}
+
+void PackUnityBatches(const std::vector<double>& seconds, uint32_t batchCount, std::vector<UnityBatch>* pBatches)
+{
+	std::vector<UnityBatch>& batches = *pBatches;
+	batches.assign(std::min<size_t>(batchCount, seconds.size()), UnityBatch());
+	if (batches.empty())
+		return;
+	std::vector<size_t> order(seconds.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&seconds](size_t lhs, size_t rhs)
+	{
+		return seconds[lhs] > seconds[rhs];
+	});
+	typedef std::pair<double, size_t> Load;
+	std::priority_queue<Load, std::vector<Load>, std::greater<Load>> lightest;
+	for (size_t i = 0; i < batches.size(); ++i)
+	{
+		batches[i].seconds = 0;
+		lightest.push(Load(0.0, i));
+	}
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		UnityBatch& batch = batches[lightest.top().second];
+		lightest.pop();
+		batch.files.push_back(order[i]);
+		batch.seconds += seconds[order[i]];
+		lightest.push(Load(batch.seconds, &batch - batches.data()));
+	}
+	for (size_t i = 0; i < batches.size(); ++i)
+		std::sort(batches[i].files.begin(), batches[i].files.end());
+}
+
+void ChunkUnityBatches(const std::vector<double>& seconds, uint32_t batchCount, std::vector<UnityBatch>* pBatches)
+{
+	std::vector<UnityBatch>& batches = *pBatches;
+	batches.assign(std::min<size_t>(batchCount, seconds.size()), UnityBatch());
+	size_t file = 0;
+	for (size_t i = 0; i < batches.size(); ++i)
+	{
+		size_t end = seconds.size() * (i + 1) / batches.size();
+		batches[i].seconds = 0;
+		for (; file < end; ++file)
+		{
+			batches[i].files.push_back(file);
+			batches[i].seconds += seconds[file];
+		}
+	}
+}
@@ -0,0 +1,115 @@
+// Measures of how much parallelism a build got, computed from the compile
+// jobs of a BuildTimeline, and a simulator that replays the same measured
+// jobs on a different number of cores to predict the wall time.
+//
+// All times are in ticks of the timeline's frequency. A job's duration is
+// from the start of its front end to the end of its back end, so the gap
+// between the two stages, when the compiler process is still running, is
+// counted as busy.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "buildmodel.h"
+
+// A span of time during which the number of running compiles was constant.
+struct ConcurrencyStep
+{
+	long long start;
+	long long end;
+	uint32_t running;
+};
+
+// The number of running compiles over time, from the first start to the
+// last end. Adjacent steps always have different counts.
+void ConcurrencyCurve(const std::vector<CompileJob>& jobs, std::vector<ConcurrencyStep>* pSteps);
+
+// Ticks spent with each number of compiles running, indexed by that number.
+void ConcurrencyHistogram(const std::vector<ConcurrencyStep>& steps, std::vector<long long>* pTicks);
+
+// The chain of compiles, each starting after the previous one ended, that
+// finishes last. It is found by walking back from the last compile to the
+// compile that ended most recently before it started. Nothing on the chain
+// can be sped up by more cores: only shorter compiles or shorter gaps help.
+struct CriticalPath
+{
+	// Indices into the jobs, first to last.
+	std::vector<size_t> jobs;
+	// Time spent compiling on the path, and time between its compiles,
+	// including any time before the first one.
+	long long busy;
+	long long gaps;
+};
+
+void FindCriticalPath(const std::vector<CompileJob>& jobs, CriticalPath* pPath);
+
+struct ProjectWork
+{
+	int projectNode;
+	long long firstStart;
+	long long lastEnd;
+	// The sum of the project's compile times.
+	long long total;
+	size_t jobCount;
+	// Time with at least one of the project's compiles running, and how much
+	// of that another project was compiling too. total / busy is the
+	// project's own parallelism, from /MP.
+	long long busy;
+	long long shared;
+	// The most of the project's compiles that ran at once.
+	uint32_t peak;
+};
+
+// The compiles of each project node, in the order the projects started. One
+// sweep over the job edges, so hundreds of projects cost no more than one.
+void ProjectTotals(const std::vector<CompileJob>& jobs, std::vector<ProjectWork>* pProjects);
+
+// The number of projects with a compile running over time, in the form of
+// ConcurrencyCurve, which shows how much the build gains from running
+// projects side by side.
+void ProjectConcurrencyCurve(const std::vector<CompileJob>& jobs, std::vector<ConcurrencyStep>* pSteps);
+
+enum SchedulePolicy
+{
+	// Each job goes on the first core that frees up, in the order the
+	// compiles started, which is the order msbuild hands them out.
+	kScheduleFileOrder,
+	// The longest jobs go first, which is what a build system with a record
+	// of previous compile times can do.
+	kScheduleLongestFirst,
+	// A project's jobs run one at a time, as they do without /MP, and each
+	// core takes the next project when it finishes one.
+	kScheduleProjectSerialized,
+};
+
+const char* SchedulePolicyName(SchedulePolicy policy);
+
+// The wall time for the jobs on that many cores, ignoring everything but
+// the compiles: no links, no dependencies between projects.
+long long SimulateSchedule(const std::vector<CompileJob>& jobs, uint32_t cores, SchedulePolicy policy);
+
+// No schedule can beat the total work divided by the cores, or the longest
+// job (or, when projects are serialized, the longest project).
+long long ScheduleLowerBound(const std::vector<CompileJob>& jobs, uint32_t cores, SchedulePolicy policy);
+
+// The files of a unity build batch, each batch compiled as one translation
+// unit, and the sum of their measured compile times.
+struct UnityBatch
+{
+	// Indices into the times, in the order given.
+	std::vector<size_t> files;
+	double seconds;
+};
+
+// Longest processing time first: the files, slowest first, each go into the
+// batch with the least time so far. With a batch per core the batches end
+// within the slowest file of each other, and never later than 4/3 of the best
+// possible split.
+void PackUnityBatches(const std::vector<double>& seconds, uint32_t batchCount, std::vector<UnityBatch>* pBatches);
+
+// The files in their given order, cut into batchCount runs whose counts differ
+// by at most one, which is how unity files are usually formed.
+void ChunkUnityBatches(const std::vector<double>& seconds, uint32_t batchCount, std::vector<UnityBatch>* pBatches);
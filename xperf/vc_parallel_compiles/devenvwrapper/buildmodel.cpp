@@ -0,0 +1,136 @@
+#include "buildmodel.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+#include "stagekeys.h"
+
+BuildTimeline::BuildTimeline(double frequency)
+	: frequency_(frequency)
+{
+}
+
+uint32_t BuildTimeline::Intern(const TextRef& text)
+{
+	key_.assign(text.data, text.size);
+	auto found = sourceIndex_.find(key_);
+	if (found != sourceIndex_.end())
+		return found->second;
+	uint32_t index = static_cast<uint32_t>(sources_.size());
+	sources_.push_back(key_);
+	sourceIndex_.insert(std::make_pair(key_, index));
+	return index;
+}
+
+void BuildTimeline::AddStage(int stage, int projectNode, long long start, long long end, const TextRef& source)
+{
+	StageEvent event;
+	event.stage = stage;
+	event.projectNode = projectNode;
+	event.start = start;
+	event.end = end;
+	event.source = Intern(source);
+	stages_.push_back(event);
+}
+
+void BuildTimeline::OnStage(const CompileStage& stage)
+{
+	AddStage(stage.stage, stage.projectNode, stage.start, stage.end, stage.source);
+}
+
+long long BuildTimeline::FirstTick() const
+{
+	if (stages_.empty())
+		return 0;
+	long long first = stages_[0].start;
+	for (size_t i = 1; i < stages_.size(); ++i)
+		first = std::min(first, stages_[i].start);
+	return first;
+}
+
+void BuildTimeline::BuildJobs(std::vector<CompileJob>* pJobs) const
+{
+	std::vector<CompileJob>& jobs = *pJobs;
+	jobs.clear();
+	// Front ends waiting for their back end, by project and file: the latest
+	// job for each key, and for each job the one before it. A file can be
+	// compiled more than once in a build (one per configuration), hence the
+	// stack.
+	StageKeyTable keys;
+	std::vector<int> waiting;
+	std::vector<int> below;
+	for (size_t i = 0; i < stages_.size(); ++i)
+	{
+		const StageEvent& stage = stages_[i];
+		const std::string& source = sources_[stage.source];
+		uint32_t key = keys.Intern(stage.projectNode, TextRef(source.data(), source.size()));
+		if (key == waiting.size())
+			waiting.push_back(-1);
+		if (stage.stage == 2 && waiting[key] >= 0)
+		{
+			CompileJob& job = jobs[waiting[key]];
+			waiting[key] = below[waiting[key]];
+			if (stages_[job.frontEnd].end <= stage.start)
+			{
+				job.backEnd = static_cast<int>(i);
+				job.end = std::max(job.end, stage.end);
+				continue;
+			}
+		}
+		CompileJob job;
+		job.source = stage.source;
+		job.projectNode = stage.projectNode;
+		job.frontEnd = stage.stage == 1 ? static_cast<int>(i) : -1;
+		job.backEnd = stage.stage == 2 ? static_cast<int>(i) : -1;
+		job.start = stage.start;
+		job.end = stage.end;
+		job.lane = 0;
+		below.push_back(-1);
+		if (stage.stage == 1)
+		{
+			below.back() = waiting[key];
+			waiting[key] = static_cast<int>(jobs.size());
+		}
+		jobs.push_back(job);
+	}
+	std::stable_sort(jobs.begin(), jobs.end(), [](const CompileJob& lhs, const CompileJob& rhs)
+	{
+		return lhs.start < rhs.start;
+	});
+}
+
+uint32_t AssignLanes(std::vector<CompileJob>* pJobs)
+{
+	std::vector<CompileJob>& jobs = *pJobs;
+	std::vector<size_t> order(jobs.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&jobs](size_t lhs, size_t rhs)
+	{
+		return jobs[lhs].start < jobs[rhs].start;
+	});
+
+	typedef std::pair<long long, uint32_t> Busy;  // End time and lane.
+	std::priority_queue<Busy, std::vector<Busy>, std::greater<Busy>> busy;
+	std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> idle;
+	uint32_t laneCount = 0;
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		CompileJob& job = jobs[order[i]];
+		while (!busy.empty() && busy.top().first <= job.start)
+		{
+			idle.push(busy.top().second);
+			busy.pop();
+		}
+		if (idle.empty())
+			job.lane = laneCount++;
+		else
+		{
+			job.lane = idle.top();
+			idle.pop();
+		}
+		busy.push(Busy(job.end, job.lane));
+	}
+	return laneCount;
+}
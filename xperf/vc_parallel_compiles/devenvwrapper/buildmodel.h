@@ -0,0 +1,77 @@
+// The compile timing model shared by the analysis tools. A BuildTimeline
+// collects compile stages, from the /Bt+ parser or an importer, with their
+// own copies of the file names. It then pairs them up into compile jobs:
+// the front end and back end of one translation unit, which run one after
+// the other in the same compiler process.
+//
+// /Bt+ doesn't say which compiler process ran a stage, so processes are
+// reconstructed by packing the jobs into lanes: each job goes on the lowest
+// numbered lane that is idle when it starts. That needs as many lanes as the
+// most jobs that ever ran at once, which is the number of compiler processes
+// (or /MP threads) that were busy at the peak.
+//
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "btparse.h"
+
+struct StageEvent
+{
+	int stage;
+	int projectNode;
+	long long start;
+	long long end;
+	// Index into BuildTimeline::Sources().
+	uint32_t source;
+};
+
+struct CompileJob
+{
+	uint32_t source;
+	int projectNode;
+	// Indices into BuildTimeline::Stages(), or -1 if that stage wasn't seen.
+	int frontEnd;
+	int backEnd;
+	long long start;
+	long long end;
+	// Filled in by AssignLanes.
+	uint32_t lane;
+};
+
+class BuildTimeline : public BtLogParser::Handler
+{
+public:
+	// Ticks per second of the start and end values, which for /Bt+ is the
+	// QueryPerformanceFrequency of the machine that ran the build.
+	explicit BuildTimeline(double frequency);
+
+	void OnStage(const CompileStage& stage) override;
+	void AddStage(int stage, int projectNode, long long start, long long end, const TextRef& source);
+
+	double Frequency() const { return frequency_; }
+	const std::vector<StageEvent>& Stages() const { return stages_; }
+	const std::vector<std::string>& Sources() const { return sources_; }
+	// The earliest start, or zero if there are no stages.
+	long long FirstTick() const;
+
+	// Pair each back end with the front end of the same file that came
+	// before it. Jobs are returned in order of start time.
+	void BuildJobs(std::vector<CompileJob>* pJobs) const;
+
+private:
+	uint32_t Intern(const TextRef& text);
+
+	double frequency_;
+	std::vector<StageEvent> stages_;
+	std::vector<std::string> sources_;
+	std::unordered_map<std::string, uint32_t> sourceIndex_;
+	std::string key_;
+};
+
+// Put each job on the lowest numbered lane that is free when it starts.
+// Returns the number of lanes used.
+uint32_t AssignLanes(std::vector<CompileJob>* pJobs);
@@ -0,0 +1,226 @@
+// Offline analysis of the /Bt+ timing lines in a captured build log, such as
+// the output of devenv /build or msbuild redirected to a file. The mode is
+// selected with a leading switch.
+//
+// -analyze reports how parallel the build was and simulates the same compiles
+// on other core counts.
+//
+// -import reads clang -ftime-trace or gcc -ftime-report files and summarizes
+// them. Every mode takes -format clang or -format gcc and a directory to work
+// on those instead of a /Bt+ log.
+//
+// -format procs reads the process log that buildwatch records on Linux, for
+// builds whose compilers don't report their own timings.
+//
+// -events adds a build's timings to a binary event log and summarizes the
+// months of builds that one can hold. -format events reads the last of them.
+//
+// -history keeps per file compile times across builds and reports the
+// translation units that got slower in the latest ones.
+//
+// -unity splits the compiled files into unity build batches balanced on their
+// compile times, for CMake's UNITY_BUILD_MODE GROUP.
+//
+// -trace writes the compile stages as a Chrome trace that chrome://tracing or
+// ui.perfetto.dev will display, one row per compiler process. /Bt+ timings are
+// QueryPerformanceCounter ticks so the log doesn't say what a second is. The
+// default of 10 MHz is what Windows 10 and later use on most machines; pass
+// -frequency for logs from older versions.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "buildmodel.h"
+#include "commands.h"
+#include "eventlog.h"
+#include "proclog.h"
+#include "tracejson.h"
+
+extern const double kDefaultFrequency = 10000000.0;
+
+const char kTimelineUsage[] = "[-format bt|clang|gcc|procs|events] [-frequency hz] [-suffix text] [-threads n]";
+
+TimelineOptions::TimelineOptions()
+	: format(kFormatBt)
+	, frequency(kDefaultFrequency)
+	, threads(0)
+{
+}
+
+bool ParseTimelineOption(int* pArg, int argc, char* argv[], TimelineOptions* pOptions, bool* pOk)
+{
+	int& arg = *pArg;
+	const char* option = argv[arg];
+	if (strcmp(option, "-format") != 0 && strcmp(option, "-frequency") != 0 && strcmp(option, "-suffix") != 0 &&
+	    strcmp(option, "-threads") != 0)
+		return false;
+	if (arg + 1 >= argc)
+	{
+		*pOk = false;
+		return true;
+	}
+	const char* value = argv[++arg];
+	if (strcmp(option, "-format") == 0)
+	{
+		if (!ParseTimingFormat(value, &pOptions->format))
+			*pOk = false;
+	}
+	else if (strcmp(option, "-frequency") == 0)
+	{
+		pOptions->frequency = atof(value);
+		if (pOptions->frequency <= 0)
+			*pOk = false;
+	}
+	else if (strcmp(option, "-suffix") == 0)
+		pOptions->suffix = value;
+	else
+		pOptions->threads = static_cast<unsigned>(atoi(value));
+	return true;
+}
+
+std::unique_ptr<BuildTimeline> LoadTimeline(const TimelineOptions& options, const char* path)
+{
+	if (options.format == kFormatProcessLog)
+	{
+		std::unique_ptr<BuildTimeline> timeline(new BuildTimeline(kImportFrequency));
+		std::vector<ProcessRecord> records;
+		if (!ReadProcessLog(path, &records))
+		{
+			printf("Couldn't read %s as a buildwatch process log\n", path);
+			return nullptr;
+		}
+		if (AddProcessStages(records, timeline.get()) == 0)
+		{
+			printf("No compiler processes among the %u processes in %s.\n", static_cast<unsigned>(records.size()), path);
+			return nullptr;
+		}
+		return timeline;
+	}
+	if (options.format == kFormatEventLog)
+	{
+		EventLogReader reader;
+		if (!reader.Open(path))
+		{
+			printf("Couldn't read %s as an event log\n", path);
+			return nullptr;
+		}
+		if (reader.Builds().empty())
+		{
+			printf("No builds in %s.\n", path);
+			return nullptr;
+		}
+		const LoggedBuild& build = reader.Builds().back();
+		std::unique_ptr<BuildTimeline> timeline(new BuildTimeline(build.frequency));
+		if (AddLoggedStages(reader, build, timeline.get()) == 0)
+		{
+			printf("The last build in %s has no compile timings.\n", path);
+			return nullptr;
+		}
+		return timeline;
+	}
+	if (options.format != kFormatBt)
+	{
+		std::unique_ptr<BuildTimeline> timeline(new BuildTimeline(kImportFrequency));
+		std::string suffix = options.suffix.empty() ? DefaultTimingSuffix(options.format) : options.suffix;
+		ImportStats stats;
+		if (!ImportTimings(options.format, path, suffix, options.threads, timeline.get(), &stats))
+		{
+			printf("Couldn't find %s\n", path);
+			return nullptr;
+		}
+		if (timeline->Stages().empty())
+		{
+			printf("No compile timings in the %u %s files in %s.\n", static_cast<unsigned>(stats.files),
+			       options.format == kFormatClangTimeTrace ? "-ftime-trace" : "-ftime-report", path);
+			return nullptr;
+		}
+		return timeline;
+	}
+
+	std::unique_ptr<BuildTimeline> timeline(new BuildTimeline(options.frequency));
+	BtLogParser parser(timeline.get());
+	if (!ParseBtLogFile(path, &parser))
+	{
+		printf("Couldn't read %s\n", path);
+		return nullptr;
+	}
+	if (timeline->Stages().empty())
+	{
+		printf("No compilation timing details in %s. Was /Bt+ in the compiler options?\n", path);
+		return nullptr;
+	}
+	return timeline;
+}
+
+namespace
+{
+
+int TraceMain(int argc, char* argv[])
+{
+	TimelineOptions options;
+	bool ok = true;
+	int arg = 0;
+	for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] && ok; ++arg)
+	{
+		if (!ParseTimelineOption(&arg, argc, argv, &options, &ok))
+			ok = false;
+	}
+	if (!ok || argc - arg != 2)
+	{
+		printf("usage: buildtimes -trace %s <log|-|dir> <out.json>\n", kTimelineUsage);
+		return 1;
+	}
+
+	std::unique_ptr<BuildTimeline> timeline = LoadTimeline(options, argv[arg]);
+	if (!timeline)
+		return 1;
+	if (!WriteChromeTraceFile(*timeline, argv[arg + 1]))
+	{
+		printf("Couldn't write %s\n", argv[arg + 1]);
+		return 1;
+	}
+	std::vector<CompileJob> jobs;
+	timeline->BuildJobs(&jobs);
+	uint32_t lanes = AssignLanes(&jobs);
+	printf("Wrote %u stages of %u files as %u compiles on %u lanes to %s.\n",
+	       static_cast<unsigned>(timeline->Stages().size()), static_cast<unsigned>(timeline->Sources().size()),
+	       static_cast<unsigned>(jobs.size()), lanes, argv[arg + 1]);
+	return 0;
+}
+
+void PrintUsage()
+{
+	printf("usage: buildtimes -analyze [options] <log|-|dir>\n");
+	printf("       buildtimes -events [options] <events.cel>\n");
+	printf("       buildtimes -history [options] <store>\n");
+	printf("       buildtimes -import [options] <file|dir>\n");
+	printf("       buildtimes -trace [options] <log|-|dir> <out.json>\n");
+	printf("       buildtimes -unity [options] <log|-|dir> <out.cmake>\n");
+	printf("Run a mode without arguments for its options.\n");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+	if (strcmp(argv[1], "-analyze") == 0)
+		return AnalyzeMain(argc - 2, argv + 2);
+	if (strcmp(argv[1], "-events") == 0)
+		return EventsMain(argc - 2, argv + 2);
+	if (strcmp(argv[1], "-history") == 0)
+		return HistoryMain(argc - 2, argv + 2);
+	if (strcmp(argv[1], "-import") == 0)
+		return ImportMain(argc - 2, argv + 2);
+	if (strcmp(argv[1], "-trace") == 0)
+		return TraceMain(argc - 2, argv + 2);
+	if (strcmp(argv[1], "-unity") == 0)
+		return UnityMain(argc - 2, argv + 2);
+	PrintUsage();
+	return 1;
+}
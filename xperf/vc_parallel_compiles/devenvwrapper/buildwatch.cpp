@@ -0,0 +1,546 @@
+// Runs a build command on Linux and records every process that it starts,
+// which is what the PROC_THREAD provider in ETWTimeBuild_lowrate.bat gives on
+// Windows: when each process started, when it called exec and with what
+// command line, when it exited, its CPU time and its peak RSS. That gives
+// per translation unit costs for make or ninja builds with compilers that
+// print no timings of their own.
+//
+// The processes are followed with ptrace, stopping only at fork, exec and
+// exit, so a compile runs at full speed between those. This needs no
+// privileges, unlike the proc connector, which needs CAP_NET_ADMIN. The CPU
+// time and peak RSS come from wait4 when each process exits.
+//
+// Each process is written to the log (see proclog.h) as it exits. At the end
+// buildwatch prints the most expensive compiles and, with -trace, writes the
+// same Chrome trace as devenvwrapper -trace. The log can be analyzed later
+// with buildtimes -format procs. buildwatch exits with the build's exit code.
+//
+// With -stats, the compiles also go into a LiveBuildStats (livestats.h) as
+// they exit, and a snapshot of the percentiles and the slowest compiles so
+// far is printed every few seconds, or served on a Unix domain socket.
+//
+
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "buildmodel.h"
+#include "importers.h"
+#include "livestats.h"
+#include "proclog.h"
+#include "tracejson.h"
+
+namespace
+{
+
+// Seconds between snapshots when only -socket is given.
+const double kDefaultStatsInterval = 10;
+
+struct TrackedProcess
+{
+	TrackedProcess() : thread(false), attachStopPending(true) {}
+
+	ProcessRecord record;
+	// Threads are followed, since they can fork too, but not logged.
+	bool thread;
+	// New tracees start with a SIGSTOP that must not be passed on.
+	bool attachStopPending;
+};
+
+long long NowMicroseconds()
+{
+	timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+long long Microseconds(const timeval& time)
+{
+	return time.tv_sec * 1000000LL + time.tv_usec;
+}
+
+// Read a numeric field such as "PPid:" from /proc/pid/status.
+bool ReadStatusField(pid_t pid, const char* field, int* pValue)
+{
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%d/status", pid);
+	FILE* fp = fopen(path, "r");
+	if (!fp)
+		return false;
+	char line[256];
+	size_t length = strlen(field);
+	bool found = false;
+	while (!found && fgets(line, sizeof(line), fp))
+	{
+		if (strncmp(line, field, length) == 0)
+		{
+			*pValue = atoi(line + length);
+			found = true;
+		}
+	}
+	fclose(fp);
+	return found;
+}
+
+void ReadCommandLine(pid_t pid, std::vector<std::string>* pArgv)
+{
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
+	pArgv->clear();
+	FILE* fp = fopen(path, "rb");
+	if (!fp)
+		return;
+	std::string data;
+	char buffer[4096];
+	size_t bytesRead;
+	while ((bytesRead = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+		data.append(buffer, bytesRead);
+	fclose(fp);
+	for (size_t start = 0; start < data.size();)
+	{
+		size_t end = data.find('\0', start);
+		if (end == std::string::npos)
+			end = data.size();
+		pArgv->push_back(data.substr(start, end - start));
+		start = end + 1;
+	}
+}
+
+std::string ReadWorkingDirectory(pid_t pid)
+{
+	char path[64];
+	char target[PATH_MAX];
+	snprintf(path, sizeof(path), "/proc/%d/cwd", pid);
+	ssize_t length = readlink(path, target, sizeof(target));
+	return length > 0 ? std::string(target, length) : std::string();
+}
+
+class ProcessWatcher
+{
+public:
+	ProcessWatcher(FILE* log, LiveBuildStats* pStats)
+		: log_(log), stats_(pStats), root_(0), exitCode_(0), rootDone_(false) {}
+
+	// Start the command stopped, and follow it. Returns false if it can't be
+	// started.
+	bool Start(char* argv[]);
+	// Follow the build until the command exits. Returns its exit code.
+	int Run();
+
+	const std::vector<ProcessRecord>& Finished() const { return finished_; }
+	size_t StillRunning() const;
+
+private:
+	TrackedProcess& Track(pid_t pid, pid_t parent);
+	void OnEvent(pid_t pid, int event);
+	void OnExit(pid_t pid, int status, const rusage& usage);
+	void AddLiveStage(const ProcessRecord& record);
+	void EndLiveCompile(pid_t driver);
+
+	FILE* log_;
+	LiveBuildStats* stats_;
+	pid_t root_;
+	int exitCode_;
+	bool rootDone_;
+	std::unordered_map<pid_t, TrackedProcess> processes_;
+	std::vector<ProcessRecord> finished_;
+	// The source of the compiler proper that each running driver ran last,
+	// for its assembler, as in AddProcessStages.
+	std::unordered_map<pid_t, std::string> driverSources_;
+	// Running processes that have run a compiler stage, so that a clang
+	// driver that ran clang -cc1 isn't counted as a compile as well.
+	std::unordered_set<pid_t> stageParents_;
+};
+
+bool ProcessWatcher::Start(char* argv[])
+{
+	long long start = NowMicroseconds();
+	pid_t child = fork();
+	if (child < 0)
+		return false;
+	if (child == 0)
+	{
+		ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+		raise(SIGSTOP);
+		execvp(argv[0], argv);
+		fprintf(stderr, "buildwatch: couldn't run %s: %s\n", argv[0], strerror(errno));
+		_exit(127);
+	}
+
+	int status;
+	if (waitpid(child, &status, __WALL) != child || !WIFSTOPPED(status))
+		return false;
+	long options = PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK | PTRACE_O_TRACECLONE | PTRACE_O_TRACEEXEC |
+	               PTRACE_O_TRACEEXIT;
+	if (ptrace(PTRACE_SETOPTIONS, child, nullptr, reinterpret_cast<void*>(options)) != 0)
+	{
+		kill(child, SIGKILL);
+		return false;
+	}
+	root_ = child;
+	TrackedProcess& process = Track(child, getpid());
+	process.record.start = start;
+	process.attachStopPending = false;
+	ptrace(PTRACE_CONT, child, nullptr, nullptr);
+	return true;
+}
+
+size_t ProcessWatcher::StillRunning() const
+{
+	size_t running = 0;
+	for (auto it = processes_.begin(); it != processes_.end(); ++it)
+	{
+		if (!it->second.thread)
+			++running;
+	}
+	return running;
+}
+
+TrackedProcess& ProcessWatcher::Track(pid_t pid, pid_t parent)
+{
+	auto inserted = processes_.insert(std::make_pair(pid, TrackedProcess()));
+	TrackedProcess& process = inserted.first->second;
+	if (inserted.second)
+	{
+		process.record.pid = pid;
+		process.record.parent = parent;
+		process.record.start = NowMicroseconds();
+		int value;
+		if (ReadStatusField(pid, "Tgid:", &value))
+			process.thread = value != pid;
+		if (ReadStatusField(pid, "PPid:", &value))
+			process.record.parent = value;
+	}
+	return process;
+}
+
+void ProcessWatcher::OnEvent(pid_t pid, int event)
+{
+	unsigned long message = 0;
+	ptrace(PTRACE_GETEVENTMSG, pid, nullptr, &message);
+	switch (event)
+	{
+	case PTRACE_EVENT_FORK:
+	case PTRACE_EVENT_VFORK:
+	case PTRACE_EVENT_CLONE:
+		Track(static_cast<pid_t>(message), pid);
+		break;
+	case PTRACE_EVENT_EXEC:
+	{
+		// A thread that calls exec takes over the thread group leader's pid.
+		pid_t former = static_cast<pid_t>(message);
+		if (former != pid)
+			processes_.erase(former);
+		TrackedProcess& process = Track(pid, 0);
+		process.thread = false;
+		process.record.exec = NowMicroseconds();
+		ReadCommandLine(pid, &process.record.argv);
+		process.record.cwd = ReadWorkingDirectory(pid);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+void ProcessWatcher::OnExit(pid_t pid, int status, const rusage& usage)
+{
+	auto found = processes_.find(pid);
+	if (found == processes_.end())
+		return;
+	TrackedProcess& process = found->second;
+	ProcessRecord& record = process.record;
+	record.end = NowMicroseconds();
+	record.userTime = Microseconds(usage.ru_utime);
+	record.systemTime = Microseconds(usage.ru_stime);
+	record.peakRss = usage.ru_maxrss;
+	record.status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+	if (!process.thread)
+	{
+		if (log_)
+			WriteProcessRecord(log_, record);
+		if (stats_)
+			AddLiveStage(record);
+		finished_.push_back(record);
+	}
+	EndLiveCompile(pid);
+	stageParents_.erase(pid);
+	if (pid == root_)
+	{
+		exitCode_ = record.status;
+		rootDone_ = true;
+	}
+	processes_.erase(found);
+}
+
+void ProcessWatcher::AddLiveStage(const ProcessRecord& record)
+{
+	int stage = CompilerStage(record);
+	if (stage)
+		stageParents_.insert(record.parent);
+	if (record.end < record.exec)
+		return;
+	if (!stage)
+	{
+		// A clang driver that compiled in process is the whole compile.
+		if (!IsClangCompileDriver(record) || stageParents_.count(record.pid))
+			return;
+		std::string source = CompilerSource(record.argv);
+		if (source[0] != '/' && !record.cwd.empty())
+			source = record.cwd + "/" + source;
+		TextRef text(source.data(), source.size());
+		stats_->AddStage(1, 0, text, (record.end - record.exec) / 1e6);
+		stats_->EndCompile(0, text);
+		return;
+	}
+	std::string source;
+	auto found = driverSources_.find(record.parent);
+	if (stage == 2 && found != driverSources_.end())
+	{
+		source = found->second;
+		driverSources_.erase(found);
+	}
+	else
+	{
+		source = CompilerSource(record.argv);
+		if (!source.empty() && source[0] != '/' && !record.cwd.empty())
+			source = record.cwd + "/" + source;
+		// A driver that compiles several files runs the next front end
+		// without assembling the last one's output when given -S.
+		if (stage == 1)
+		{
+			EndLiveCompile(record.parent);
+			driverSources_[record.parent] = source;
+		}
+	}
+	if (!source.empty())
+		stats_->AddStage(stage, 0, TextRef(source.data(), source.size()), (record.end - record.exec) / 1e6);
+}
+
+// The driver won't run an assembler for the last front end that it ran, so
+// that front end was the whole compile.
+void ProcessWatcher::EndLiveCompile(pid_t driver)
+{
+	auto found = driverSources_.find(driver);
+	if (found == driverSources_.end())
+		return;
+	if (stats_ && !found->second.empty())
+		stats_->EndCompile(0, TextRef(found->second.data(), found->second.size()));
+	driverSources_.erase(found);
+}
+
+int ProcessWatcher::Run()
+{
+	while (!rootDone_)
+	{
+		int status;
+		rusage usage;
+		pid_t pid = wait4(-1, &status, __WALL, &usage);
+		if (pid < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (WIFEXITED(status) || WIFSIGNALED(status))
+		{
+			OnExit(pid, status, usage);
+			continue;
+		}
+		if (!WIFSTOPPED(status))
+			continue;
+
+		// A new tracee can report its first stop before its parent reports
+		// the fork, so either one may be the first we hear of it.
+		TrackedProcess& process = Track(pid, 0);
+		int signal = WSTOPSIG(status);
+		int event = status >> 16;
+		if (event)
+		{
+			OnEvent(pid, event);
+			signal = 0;
+		}
+		else if (signal == SIGSTOP && process.attachStopPending)
+		{
+			process.attachStopPending = false;
+			signal = 0;
+		}
+		else
+		{
+			// A group stop, as opposed to a signal being delivered, has no
+			// siginfo. Resuming it lets the process carry on, which is the
+			// price of using PTRACE_TRACEME rather than PTRACE_SEIZE.
+			siginfo_t info;
+			if (ptrace(PTRACE_GETSIGINFO, pid, nullptr, &info) != 0)
+				signal = 0;
+		}
+		ptrace(PTRACE_CONT, pid, nullptr, reinterpret_cast<void*>(static_cast<long>(signal)));
+	}
+	if (!rootDone_)
+		exitCode_ = 1;
+	return exitCode_;
+}
+
+void PrintSummary(const std::vector<ProcessRecord>& records, long long wall, size_t topCount)
+{
+	std::vector<int> stages;
+	FindCompilerStages(records, &stages);
+	std::vector<const ProcessRecord*> compiles;
+	long long compileTime = 0;
+	long long compileCpu = 0;
+	for (size_t i = 0; i < records.size(); ++i)
+	{
+		if (stages[i] == 1)
+		{
+			compiles.push_back(&records[i]);
+			compileTime += records[i].end - records[i].exec;
+			compileCpu += records[i].userTime + records[i].systemTime;
+		}
+	}
+	printf("%u processes in %1.3f s, of which %u were compilers, running for %1.3f s (%1.3f s of CPU).\n",
+	       static_cast<unsigned>(records.size()), wall / 1e6, static_cast<unsigned>(compiles.size()),
+	       compileTime / 1e6, compileCpu / 1e6);
+	if (compiles.empty() || topCount == 0)
+		return;
+
+	std::sort(compiles.begin(), compiles.end(), [](const ProcessRecord* lhs, const ProcessRecord* rhs)
+	{
+		return lhs->end - lhs->exec > rhs->end - rhs->exec;
+	});
+	if (compiles.size() > topCount)
+		compiles.resize(topCount);
+	printf("Longest compiles:\n");
+	printf("    Wall (s)   CPU (s)  Peak (MB)  Source\n");
+	for (size_t i = 0; i < compiles.size(); ++i)
+	{
+		const ProcessRecord& record = *compiles[i];
+		printf("%12.3f%10.3f%11.1f  %s\n", (record.end - record.exec) / 1e6,
+		       (record.userTime + record.systemTime) / 1e6, record.peakRss / 1024.0,
+		       CompilerSource(record.argv).c_str());
+	}
+}
+
+void PrintUsage()
+{
+	printf("usage: buildwatch [-log procs.tsv] [-trace out.json] [-top n] [-stats seconds] [-socket path]\n");
+	printf("                  <command> [args...]\n");
+	printf("  Runs the command and records every process that it starts. The log can be\n");
+	printf("  read with buildtimes -format procs. -stats prints the compile time percentiles\n");
+	printf("  and the slowest compiles so far every so many seconds, or sends them to the\n");
+	printf("  clients of a Unix domain socket with -socket.\n");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+	const char* logPath = nullptr;
+	const char* tracePath = nullptr;
+	size_t topCount = 10;
+	double statsInterval = 0;
+	const char* socketPath = nullptr;
+	int arg = 1;
+	for (; arg < argc && argv[arg][0] == '-'; ++arg)
+	{
+		if (strcmp(argv[arg], "-log") == 0 && arg + 1 < argc)
+			logPath = argv[++arg];
+		else if (strcmp(argv[arg], "-trace") == 0 && arg + 1 < argc)
+			tracePath = argv[++arg];
+		else if (strcmp(argv[arg], "-top") == 0 && arg + 1 < argc)
+			topCount = static_cast<size_t>(atoi(argv[++arg]));
+		else if (strcmp(argv[arg], "-stats") == 0 && arg + 1 < argc)
+			statsInterval = atof(argv[++arg]);
+		else if (strcmp(argv[arg], "-socket") == 0 && arg + 1 < argc)
+			socketPath = argv[++arg];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (arg >= argc)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	FILE* log = nullptr;
+	if (logPath)
+	{
+		log = fopen(logPath, "w");
+		if (!log || !WriteProcessLogHeader(log))
+		{
+			printf("Couldn't write %s\n", logPath);
+			return 1;
+		}
+	}
+
+	if (socketPath && statsInterval <= 0)
+		statsInterval = kDefaultStatsInterval;
+	std::unique_ptr<LiveBuildStats> stats;
+	StatsPublisher publisher;
+	long long start = NowMicroseconds();
+	if (statsInterval > 0)
+	{
+		stats.reset(new LiveBuildStats(topCount));
+		if (socketPath && !publisher.Listen(socketPath))
+		{
+			printf("Couldn't listen on %s\n", socketPath);
+			return 1;
+		}
+		// The build's output goes straight to the console, so a snapshot
+		// may land in the middle of a line. It starts on a new one.
+		LiveBuildStats* pStats = stats.get();
+		publisher.Start(statsInterval,
+			[pStats, start](std::string* pText) { pStats->FormatSnapshot((NowMicroseconds() - start) / 1e6, pText); },
+			[](const std::string& text)
+			{
+				printf("\n%s", text.c_str());
+				fflush(stdout);
+			});
+	}
+
+	ProcessWatcher watcher(log, stats.get());
+	if (!watcher.Start(argv + arg))
+	{
+		printf("Couldn't start %s under ptrace\n", argv[arg]);
+		return 1;
+	}
+	// Let Ctrl+C go to the build, which then exits and is logged as usual.
+	signal(SIGINT, SIG_IGN);
+	signal(SIGQUIT, SIG_IGN);
+	int exitCode = watcher.Run();
+	long long wall = NowMicroseconds() - start;
+	publisher.Stop();
+	if (log)
+		fclose(log);
+
+	printf("\n");
+	if (watcher.StillRunning())
+		printf("%u processes were still running when the build command exited.\n",
+		       static_cast<unsigned>(watcher.StillRunning()));
+	PrintSummary(watcher.Finished(), wall, topCount);
+
+	if (tracePath)
+	{
+		BuildTimeline timeline(kImportFrequency);
+		if (AddProcessStages(watcher.Finished(), &timeline) == 0)
+			printf("No compiler processes, so no trace was written.\n");
+		else if (!WriteChromeTraceFile(timeline, tracePath))
+			printf("Couldn't write %s\n", tracePath);
+	}
+	return exitCode;
+}
@@ -0,0 +1,44 @@
+// The buildtimes modes, each in its own file, and the helpers they share.
+//
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include "importers.h"
+
+class BuildTimeline;
+
+// The QueryPerformanceFrequency assumed for logs when -frequency isn't given.
+extern const double kDefaultFrequency;
+
+// Where the compile timings come from, set by the options that all modes
+// take: -format bt|clang|gcc|procs|events, -frequency hz (for bt), -suffix text
+// and -threads n (for clang and gcc).
+struct TimelineOptions
+{
+	TimelineOptions();
+
+	TimingFormat format;
+	double frequency;
+	// Empty for the format's default.
+	std::string suffix;
+	unsigned threads;
+};
+
+// The usage text for those options.
+extern const char kTimelineUsage[];
+
+// If argv[*pArg] is one of those options, read it, step past it and return
+// true. *pOk is cleared if its value is missing or bad.
+bool ParseTimelineOption(int* pArg, int argc, char* argv[], TimelineOptions* pOptions, bool* pOk);
+// Parse a log file, or stdin for "-", import clang or gcc timings from a
+// file or directory, or read a buildwatch process log or the last build in an
+// event log. Prints a message and returns null if there are none.
+std::unique_ptr<BuildTimeline> LoadTimeline(const TimelineOptions& options, const char* path);
+
+int AnalyzeMain(int argc, char* argv[]);
+int EventsMain(int argc, char* argv[]);
+int HistoryMain(int argc, char* argv[]);
+int ImportMain(int argc, char* argv[]);
+int UnityMain(int argc, char* argv[]);
@@ -0,0 +1,586 @@
+// A ccache style compiler launcher for gcc and clang on Linux, for measuring
+// what a compile cache buys a build. Put it in front of the compiler, for
+// example with -DCMAKE_CXX_COMPILER_LAUNCHER=compilecache.
+//
+// A compile is looked up by a SHA-256 key of the compiler's identity (its
+// path, size and modification time), its arguments other than where the
+// output goes, and the source after preprocessing, which covers every header
+// it includes. With -g the working directory is added too, since it goes
+// into the debug information, and a clang -include-pch file is hashed whole
+// because -E doesn't expand it. On a hit the object file, dependency file and
+// warnings come from the cache. On a miss the compile runs as usual and what
+// it produced is stored.
+//
+// Entries go in a DirectoryStore (objectcache.h) in -dir, or $COMPILECACHE_DIR,
+// or ~/.cache/compilecache. With -remote, or $COMPILECACHE_REMOTE, a second
+// directory stands in for a shared remote cache: it is tried after a local
+// miss, and a hit there is copied to the local store. Both are safe for any
+// number of compiles at once.
+//
+// Anything but a single -c compile to an object file, such as a link or -E,
+// is passed straight to the compiler. Every compile adds a line to stats.tsv
+// in the local store, which compilecache -stats sums up: hits, misses and the
+// compile time saved, less what the lookups cost, per source file.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "filelist.h"
+#include "objectcache.h"
+#include "sha256.h"
+
+namespace
+{
+
+// Changed when the key or entry format changes, so old entries are missed.
+const char kKeyVersion[] = "compilecache 1";
+
+struct CompileArgs
+{
+	CompileArgs() : cacheable(false), debugInfo(false) {}
+
+	bool cacheable;
+	bool debugInfo;
+	std::string source;
+	std::string output;
+	std::string depfile;
+	// Precompiled headers that preprocessing doesn't read as text.
+	std::vector<std::string> pchFiles;
+	// The arguments less those that only say where the output goes, plus -E.
+	std::vector<std::string> preprocess;
+	// The arguments that go into the key: all but the output paths, so that
+	// the same compile to another file still hits, unless the output path
+	// names the dependency file's target.
+	std::vector<std::string> keyArgs;
+};
+
+// Driver options whose value is the next argument.
+bool TakesValue(const std::string& arg)
+{
+	static const char* const kOptions[] = { "-o", "-MF", "-MT", "-MQ", "-include", "-imacros", "-include-pch", "-isystem",
+	                                        "-iquote", "-idirafter", "-iprefix", "-iwithprefix", "-isysroot", "-I", "-D",
+	                                        "-U", "-x", "-Xclang", "-Xpreprocessor", "-Xassembler", "-Xlinker", "-arch",
+	                                        "-target", "--param", "-aux-info" };
+	for (size_t i = 0; i < sizeof(kOptions) / sizeof(kOptions[0]); ++i)
+	{
+		if (arg == kOptions[i])
+			return true;
+	}
+	return false;
+}
+
+// Options that stop the compile from being one source to one object file.
+bool PreventsCaching(const std::string& arg)
+{
+	return arg == "-E" || arg == "-S" || arg == "-M" || arg == "-MM" || arg == "-fsyntax-only" || arg == "-" ||
+	       arg.compare(0, 11, "-save-temps") == 0 || arg.compare(0, 10, "-fprofile-") == 0;
+}
+
+void AnalyzeArgs(const std::vector<std::string>& argv, CompileArgs* pArgs)
+{
+	bool compileOnly = false;
+	bool writesDepfile = false;
+	bool namesTarget = false;
+	size_t sources = 0;
+	pArgs->preprocess.push_back(argv[0]);
+	for (size_t i = 1; i < argv.size(); ++i)
+	{
+		const std::string& arg = argv[i];
+		if (PreventsCaching(arg))
+			return;
+		if (arg == "-c")
+			compileOnly = true;
+		else if (arg == "-MD" || arg == "-MMD")
+			writesDepfile = true;
+		else if (arg == "-MP")
+		{
+		}
+		else if (TakesValue(arg))
+		{
+			if (i + 1 >= argv.size())
+				return;
+			const std::string& value = argv[i + 1];
+			// -include-pch, or clang's -Xclang -include-pch -Xclang <file>.
+			bool pch = arg == "-include-pch" ||
+			           (arg == "-Xclang" && i >= 2 && argv[i - 1] == "-include-pch" && argv[i - 2] == "-Xclang");
+			if (pch)
+				pArgs->pchFiles.push_back(value);
+			if (arg == "-o")
+				pArgs->output = value;
+			else if (arg == "-MF")
+				pArgs->depfile = value;
+			else if (arg == "-MT" || arg == "-MQ")
+				namesTarget = true;
+			else
+			{
+				pArgs->preprocess.push_back(arg);
+				pArgs->preprocess.push_back(value);
+			}
+			if (arg != "-o" && arg != "-MF")
+			{
+				pArgs->keyArgs.push_back(arg);
+				pArgs->keyArgs.push_back(value);
+			}
+			++i;
+			continue;
+		}
+		else
+		{
+			if (arg.compare(0, 2, "-g") == 0 && arg != "-g0")
+				pArgs->debugInfo = true;
+			if (arg[0] != '-')
+			{
+				++sources;
+				pArgs->source = arg;
+			}
+			pArgs->preprocess.push_back(arg);
+		}
+		pArgs->keyArgs.push_back(arg);
+	}
+	pArgs->preprocess.push_back("-E");
+	if (writesDepfile && !namesTarget)
+		pArgs->keyArgs.push_back("-o" + pArgs->output);
+	pArgs->cacheable = compileOnly && sources == 1 && !pArgs->output.empty() && writesDepfile == !pArgs->depfile.empty();
+}
+
+long long NowMicroseconds()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+	    std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// The compiler as found on the PATH, like execvp does.
+std::string FindProgram(const std::string& name)
+{
+	if (name.find('/') != std::string::npos)
+		return name;
+	const char* path = getenv("PATH");
+	std::string dirs = path ? path : "/usr/bin:/bin";
+	for (size_t start = 0; start <= dirs.size();)
+	{
+		size_t end = dirs.find(':', start);
+		if (end == std::string::npos)
+			end = dirs.size();
+		std::string candidate = (end > start ? dirs.substr(start, end - start) : ".") + "/" + name;
+		if (access(candidate.c_str(), X_OK) == 0)
+			return candidate;
+		start = end + 1;
+	}
+	return name;
+}
+
+void HashFileIdentity(const std::string& path, Sha256* pHash)
+{
+	struct stat status;
+	char identity[128] = "missing";
+	if (stat(path.c_str(), &status) == 0)
+	{
+		sprintf(identity, "%lld %lld.%09ld", static_cast<long long>(status.st_size),
+		        static_cast<long long>(status.st_mtim.tv_sec), static_cast<long>(status.st_mtim.tv_nsec));
+	}
+	pHash->Update(path.c_str(), path.size() + 1);
+	pHash->Update(identity, strlen(identity) + 1);
+}
+
+std::vector<char*> ExecArgs(const std::vector<std::string>& argv)
+{
+	std::vector<char*> args;
+	for (size_t i = 0; i < argv.size(); ++i)
+		args.push_back(const_cast<char*>(argv[i].c_str()));
+	args.push_back(nullptr);
+	return args;
+}
+
+// Run a program and wait for it. With pStdout or pStderr, that output is
+// collected, and stderr is also passed on if echoStderr. Returns the exit
+// code, or -1 if it couldn't be run.
+int RunProgram(const std::vector<std::string>& argv, std::string* pStdout, std::string* pStderr, bool echoStderr)
+{
+	int outPipe[2] = { -1, -1 };
+	int errPipe[2] = { -1, -1 };
+	if ((pStdout && pipe(outPipe) != 0) || (pStderr && pipe(errPipe) != 0))
+		return -1;
+	std::vector<char*> args = ExecArgs(argv);
+	pid_t pid = fork();
+	if (pid < 0)
+		return -1;
+	if (pid == 0)
+	{
+		if (pStdout)
+		{
+			dup2(outPipe[1], 1);
+			close(outPipe[0]);
+			close(outPipe[1]);
+		}
+		if (pStderr)
+		{
+			dup2(errPipe[1], 2);
+			close(errPipe[0]);
+			close(errPipe[1]);
+		}
+		else if (pStdout)
+		{
+			// Only the preprocessor output is wanted, and a failure is
+			// reported again by the compile that follows.
+			int null = open("/dev/null", O_WRONLY);
+			dup2(null, 2);
+		}
+		execvp(args[0], args.data());
+		_exit(127);
+	}
+	if (pStdout)
+		close(outPipe[1]);
+	if (pStderr)
+		close(errPipe[1]);
+	// Read both pipes until they close, so that neither fills up and stalls
+	// the child.
+	int fds[2] = { pStdout ? outPipe[0] : -1, pStderr ? errPipe[0] : -1 };
+	std::string* outputs[2] = { pStdout, pStderr };
+	char buffer[65536];
+	for (int open = (fds[0] >= 0) + (fds[1] >= 0); open > 0;)
+	{
+		fd_set readable;
+		FD_ZERO(&readable);
+		int highest = -1;
+		for (int i = 0; i < 2; ++i)
+		{
+			if (fds[i] >= 0)
+			{
+				FD_SET(fds[i], &readable);
+				highest = std::max(highest, fds[i]);
+			}
+		}
+		if (select(highest + 1, &readable, nullptr, nullptr, nullptr) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		for (int i = 0; i < 2; ++i)
+		{
+			if (fds[i] < 0 || !FD_ISSET(fds[i], &readable))
+				continue;
+			ssize_t count = read(fds[i], buffer, sizeof(buffer));
+			if (count < 0 && errno == EINTR)
+				continue;
+			if (count <= 0)
+			{
+				close(fds[i]);
+				fds[i] = -1;
+				--open;
+				continue;
+			}
+			outputs[i]->append(buffer, count);
+			if (i == 1 && echoStderr)
+				fwrite(buffer, 1, count, stderr);
+		}
+	}
+	for (int i = 0; i < 2; ++i)
+	{
+		if (fds[i] >= 0)
+			close(fds[i]);
+	}
+	int status;
+	while (waitpid(pid, &status, 0) < 0)
+	{
+		if (errno != EINTR)
+			return -1;
+	}
+	if (WIFEXITED(status))
+		return WEXITSTATUS(status) == 127 && pStdout ? -1 : WEXITSTATUS(status);
+	return 128 + WTERMSIG(status);
+}
+
+bool ReadFileText(const std::string& path, std::string* pText)
+{
+	std::vector<char> data;
+	if (!ReadWholeFile(path.c_str(), &data))
+		return false;
+	pText->assign(data.begin(), data.end());
+	return true;
+}
+
+// Write a file under a temporary name and rename it into place, so that a
+// build tool never sees half of an object file.
+bool WriteFileAtomically(const std::string& path, const std::string& data)
+{
+	char suffix[32];
+	sprintf(suffix, ".%d.tmp", static_cast<int>(getpid()));
+	std::string temporary = path + suffix;
+	FILE* fp = fopen(temporary.c_str(), "wb");
+	if (!fp)
+		return false;
+	bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+	ok = fclose(fp) == 0 && ok;
+	if (!ok || rename(temporary.c_str(), path.c_str()) != 0)
+	{
+		remove(temporary.c_str());
+		return false;
+	}
+	return true;
+}
+
+std::string DefaultCacheDir()
+{
+	const char* dir = getenv("COMPILECACHE_DIR");
+	if (dir && *dir)
+		return dir;
+	const char* home = getenv("HOME");
+	return std::string(home && *home ? home : "/tmp") + "/.cache/compilecache";
+}
+
+std::string DefaultRemoteDir()
+{
+	const char* dir = getenv("COMPILECACHE_REMOTE");
+	return dir ? dir : "";
+}
+
+int ExecCompiler(const std::vector<std::string>& argv)
+{
+	std::vector<char*> args = ExecArgs(argv);
+	execvp(args[0], args.data());
+	fprintf(stderr, "compilecache: couldn't run %s: %s\n", args[0], strerror(errno));
+	return 127;
+}
+
+int CompileMain(const std::string& cacheDir, const std::string& remoteDir, const std::vector<std::string>& argv)
+{
+	auto start = std::chrono::steady_clock::now();
+	CompileArgs args;
+	AnalyzeArgs(argv, &args);
+	if (!args.cacheable)
+		return ExecCompiler(argv);
+
+	CacheEvent event;
+	event.time = NowMicroseconds();
+	event.source = args.source;
+	event.saved = 0;
+	std::string statsPath = CacheStatsPath(cacheDir);
+
+	std::string preprocessed;
+	if (RunProgram(args.preprocess, &preprocessed, nullptr, false) != 0)
+	{
+		// Let the compile report the error.
+		event.result = kCacheUncacheable;
+		event.seconds = SecondsSince(start);
+		MakeDirectories(cacheDir);
+		AppendCacheEvent(statsPath, event);
+		return ExecCompiler(argv);
+	}
+	Sha256 hash;
+	hash.Update(kKeyVersion, sizeof(kKeyVersion));
+	HashFileIdentity(FindProgram(argv[0]), &hash);
+	for (size_t i = 0; i < args.keyArgs.size(); ++i)
+		hash.Update(args.keyArgs[i].c_str(), args.keyArgs[i].size() + 1);
+	if (args.debugInfo)
+	{
+		char cwd[4096];
+		if (getcwd(cwd, sizeof(cwd)))
+			hash.Update(cwd, strlen(cwd) + 1);
+	}
+	for (size_t i = 0; i < args.pchFiles.size(); ++i)
+	{
+		std::string pch;
+		ReadFileText(args.pchFiles[i], &pch);
+		hash.Update(pch);
+	}
+	hash.Update(preprocessed);
+	std::string key = hash.HexDigest();
+
+	DirectoryStore local(cacheDir);
+	std::unique_ptr<DirectoryStore> remote(remoteDir.empty() ? nullptr : new DirectoryStore(remoteDir));
+	CacheEntry entry;
+	bool hit = local.Fetch(key, &entry);
+	if (hit)
+		event.result = kCacheHit;
+	else if (remote && remote->Fetch(key, &entry))
+	{
+		hit = true;
+		event.result = kCacheRemoteHit;
+		local.Publish(key, entry);
+	}
+	if (hit && WriteFileAtomically(args.output, entry.object) &&
+	    (args.depfile.empty() || WriteFileAtomically(args.depfile, entry.depfile)))
+	{
+		fwrite(entry.diagnostics.data(), 1, entry.diagnostics.size(), stderr);
+		event.seconds = SecondsSince(start);
+		event.saved = entry.compileMicroseconds / 1e6 - event.seconds;
+		AppendCacheEvent(statsPath, event);
+		return 0;
+	}
+
+	auto compileStart = std::chrono::steady_clock::now();
+	std::string diagnostics;
+	int status = RunProgram(argv, nullptr, &diagnostics, true);
+	if (status < 0)
+	{
+		fprintf(stderr, "compilecache: couldn't run %s\n", argv[0].c_str());
+		return 127;
+	}
+	double compileSeconds = SecondsSince(compileStart);
+	event.result = kCacheMiss;
+	event.seconds = SecondsSince(start);
+	// The lookup was all cost.
+	event.saved = compileSeconds - event.seconds;
+	if (status == 0)
+	{
+		entry = CacheEntry();
+		entry.compileMicroseconds = static_cast<long long>(compileSeconds * 1e6);
+		entry.diagnostics = diagnostics;
+		if (ReadFileText(args.output, &entry.object) && (args.depfile.empty() || ReadFileText(args.depfile, &entry.depfile)))
+		{
+			local.Publish(key, entry);
+			if (remote)
+				remote->Publish(key, entry);
+		}
+	}
+	MakeDirectories(cacheDir);
+	AppendCacheEvent(statsPath, event);
+	return status;
+}
+
+struct SourceSavings
+{
+	SourceSavings() : hits(0), misses(0), saved(0) {}
+
+	unsigned hits;
+	unsigned misses;
+	double saved;
+};
+
+int StatsMain(const std::string& cacheDir, size_t topCount)
+{
+	std::vector<CacheEvent> events;
+	std::string statsPath = CacheStatsPath(cacheDir);
+	if (!ReadCacheEvents(statsPath.c_str(), &events))
+	{
+		printf("No compiles have used %s yet.\n", cacheDir.c_str());
+		return 1;
+	}
+	unsigned counts[kCacheUncacheable + 1] = {};
+	double seconds = 0;
+	double saved = 0;
+	double missCost = 0;
+	std::map<std::string, SourceSavings> sources;
+	for (size_t i = 0; i < events.size(); ++i)
+	{
+		const CacheEvent& event = events[i];
+		++counts[event.result];
+		seconds += event.seconds;
+		if (event.result == kCacheMiss)
+			missCost -= event.saved;
+		else
+			saved += event.saved;
+		SourceSavings& source = sources[event.source];
+		if (event.result == kCacheHit || event.result == kCacheRemoteHit)
+			++source.hits;
+		else if (event.result == kCacheMiss)
+			++source.misses;
+		source.saved += event.saved;
+	}
+	uint64_t entries, bytes;
+	DirectoryStore(cacheDir).Measure(&entries, &bytes);
+	unsigned lookups = counts[kCacheHit] + counts[kCacheRemoteHit] + counts[kCacheMiss];
+	printf("%s: %llu entries, %.1f MB.\n", cacheDir.c_str(), static_cast<unsigned long long>(entries), bytes / 1e6);
+	printf("%u compiles: %u hits, %u remote hits, %u misses (%.0f%% hit rate), %u uncacheable.\n",
+	       static_cast<unsigned>(events.size()), counts[kCacheHit], counts[kCacheRemoteHit], counts[kCacheMiss],
+	       lookups ? 100.0 * (counts[kCacheHit] + counts[kCacheRemoteHit]) / lookups : 0.0,
+	       counts[kCacheUncacheable]);
+	printf("They took %.1f s. Hits saved %.1f s of compiling and lookups that missed cost %.1f s, for a net %.1f s.\n",
+	       seconds, saved, missCost, saved - missCost);
+
+	std::vector<std::pair<double, std::string>> order;
+	for (auto it = sources.begin(); it != sources.end(); ++it)
+		order.push_back(std::make_pair(it->second.saved, it->first));
+	std::sort(order.begin(), order.end(), [](const std::pair<double, std::string>& lhs,
+	                                         const std::pair<double, std::string>& rhs)
+	{
+		return lhs.first > rhs.first;
+	});
+	if (order.size() > topCount)
+		order.resize(topCount);
+	if (!order.empty())
+		printf("\n%10s %6s %6s  %s\n", "saved", "hits", "misses", "source");
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		const SourceSavings& source = sources[order[i].second];
+		printf("%8.2f s %6u %6u  %s\n", source.saved, source.hits, source.misses, order[i].second.c_str());
+	}
+	return 0;
+}
+
+void PrintUsage()
+{
+	printf("usage: compilecache [-dir path] [-remote path] <compiler> [args...]\n");
+	printf("       compilecache -stats [-dir path] [-top n]\n");
+	printf("  Runs the compile, or takes its object file from the cache if the same\n");
+	printf("  preprocessed source was compiled the same way before. The cache is in -dir,\n");
+	printf("  $COMPILECACHE_DIR or ~/.cache/compilecache, and -remote or $COMPILECACHE_REMOTE\n");
+	printf("  names a directory shared like a remote cache. -stats reports the hits, misses\n");
+	printf("  and time saved, and the files that saved the most.\n");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+	std::string cacheDir = DefaultCacheDir();
+	std::string remoteDir = DefaultRemoteDir();
+	bool stats = false;
+	size_t topCount = 20;
+	int arg = 1;
+	for (; arg < argc && argv[arg][0] == '-'; ++arg)
+	{
+		if (strcmp(argv[arg], "-stats") == 0)
+			stats = true;
+		else if (arg + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+		else if (strcmp(argv[arg], "-dir") == 0)
+			cacheDir = argv[++arg];
+		else if (strcmp(argv[arg], "-remote") == 0)
+			remoteDir = argv[++arg];
+		else if (strcmp(argv[arg], "-top") == 0)
+			topCount = static_cast<size_t>(atoi(argv[++arg]));
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (stats)
+	{
+		if (arg != argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+		return StatsMain(cacheDir, topCount);
+	}
+	if (arg >= argc)
+	{
+		PrintUsage();
+		return 1;
+	}
+	return CompileMain(cacheDir, remoteDir, std::vector<std::string>(argv + arg, argv + argc));
+}
@@ -2,15 +2,101 @@
 // /Bt+ to your compiler options then this program will convert the /Bt+ output to
 // ETW events.
 // /Bt+ only works reliably on VS 2013.
+// With -trace <file.json> before the devenv arguments the compile stages are
+// also written as a Chrome trace, for chrome://tracing or ui.perfetto.dev.
+// With -eventlog <file.cel> they are appended to a binary event log, see
+// eventlog.h, labeled with the devenv command line or -label <text>.
+// With -stats <seconds> the compile time percentiles and the slowest compiles
+// so far are printed every so many seconds while the build runs.
 // For more information see http://randomascii.wordpress.com
 
 #include "stdafx.h"
+#include <io.h>
 #include <string>
 // Include the event register/write/unregister macros compiled from the manifest file.
 // Note that this includes evntprov.h which requires a Vista+ Windows SDK.
 #include "DevEnvWrapperETWProviderGenerated.h"
 
-#include <map>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include "btparse.h"
+#include "buildmodel.h"
+#include "eventlog.h"
+#include "livestats.h"
+#include "pipeline.h"
+#include "stagekeys.h"
+#include "tracejson.h"
+
+// Turns the /Bt+ timing lines into ETW events.
+class EtwStageWriter : public BtLogParser::Handler
+{
+public:
+	EtwStageWriter(float frequency, BuildTimeline* pTimeline, LiveBuildStats* pStats)
+		: frequency_(frequency), timeline_(pTimeline), stats_(pStats), arrival_(0) {}
+
+	// The arrival time of the chunk of output being parsed.
+	void SetArrival(long long arrival) { arrival_ = arrival; }
+
+	// How long lines took to reach the wrapper after their stage ended, and
+	// how long the wrapper then took to write the event.
+	const LatencyStats& DeliveryLatency() const { return deliveryLatency_; }
+	const LatencyStats& WrapperLatency() const { return wrapperLatency_; }
+
+	void OnStage(const CompileStage& stage) override
+	{
+		if (timeline_)
+			timeline_->OnStage(stage);
+		float elapsed = (stage.end - stage.start) / frequency_;
+		if (stats_)
+			stats_->AddStage(stage.stage, stage.projectNode, stage.source, elapsed);
+		// The ETW events want a null-terminated file name.
+		filename_.assign(stage.fileName.data, stage.fileName.size);
+		const char* filename = filename_.c_str();
+		// Match the back end to the front end of the same file in the same
+		// project. Projects build side by side, and their files can share
+		// names.
+		uint32_t key = stageKeys_.Intern(stage.projectNode, stage.source);
+		if (key == firstStageTimes_.size())
+			firstStageTimes_.push_back(0.0f);
+		float firstStageTime = stage.stage == 2 ? firstStageTimes_[key] : 0.0f;
+
+		// ETW stamps each event when it is written, so the offsets have to be
+		// from then, not from when the line arrived. Sample the counter as
+		// late as possible.
+		LARGE_INTEGER currentCounter;
+		QueryPerformanceCounter(&currentCounter);
+		float startOffset = (stage.start - currentCounter.QuadPart) / frequency_; // Negative number representing offset from start.
+		float endOffset = (stage.end - currentCounter.QuadPart) / frequency_; // Negative number representing offset from end.
+		deliveryLatency_.Add(arrival_ - stage.end);
+		wrapperLatency_.Add(currentCounter.QuadPart - arrival_);
+
+		// Write our custom ETW events, as defined in etwprovider.man.
+		// Record details of the compile stage we just finished.
+		if (stage.stage == 1)
+		{
+			EventWriteCompileStage1Done(filename, elapsed, startOffset, endOffset);
+			firstStageTimes_[key] = elapsed;
+		}
+		else
+		{
+			EventWriteCompileStage2Done(filename, elapsed, startOffset, endOffset);
+			EventWriteCompileSummary(filename, elapsed + firstStageTime);
+		}
+	}
+
+private:
+	float frequency_;
+	BuildTimeline* timeline_;
+	LiveBuildStats* stats_;
+	long long arrival_;
+	LatencyStats deliveryLatency_;
+	LatencyStats wrapperLatency_;
+	std::string filename_;
+	StageKeyTable stageKeys_;
+	// By StageKeyTable id.
+	std::vector<float> firstStageTimes_;
+};
 
 int _tmain(int argc, _TCHAR* argv[])
 {
@@ -21,8 +107,29 @@ int _tmain(int argc, _TCHAR* argv[])
 	QueryPerformanceFrequency(&llFrequency);
 	float frequency = float(llFrequency.QuadPart);
 
+	// Our options come first, then the path of devenv, which is skipped.
+	int firstArg = 1;
+	const _TCHAR* tracePath = nullptr;
+	const _TCHAR* eventLogPath = nullptr;
+	const _TCHAR* label = nullptr;
+	double statsInterval = 0;
+	for (; argc > firstArg + 1; firstArg += 2)
+	{
+		if (_tcscmp(argv[firstArg], _T("-trace")) == 0)
+			tracePath = argv[firstArg + 1];
+		else if (_tcscmp(argv[firstArg], _T("-eventlog")) == 0)
+			eventLogPath = argv[firstArg + 1];
+		else if (_tcscmp(argv[firstArg], _T("-label")) == 0)
+			label = argv[firstArg + 1];
+		else if (_tcscmp(argv[firstArg], _T("-stats")) == 0)
+			statsInterval = _tstof(argv[firstArg + 1]);
+		else
+			break;
+	}
+	++firstArg;
+
 	std::string commandLine = "devenv";
-	for (int arg = 2; arg < argc; ++arg)
+	for (int arg = firstArg; arg < argc; ++arg)
 	{
 		commandLine += ' ';
 		char buffer[1000];
@@ -39,87 +146,129 @@ int _tmain(int argc, _TCHAR* argv[])
 	if (!pOutput)
 		return 10;
 
-	// Raise our priority so that we can always respond to compiler output quickly. It's fine
-	// to run at high priority since we will mostly be idle.
-	// It is important to raise our priority after starting devenv because we don't want to
-	// accidentally run it at high priority.
-	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
-
-	std::map<std::string, float> firstStageTimes;
+	BuildTimeline timeline(double(llFrequency.QuadPart));
+	std::unique_ptr<LiveBuildStats> stats;
+	if (statsInterval > 0)
+		stats.reset(new LiveBuildStats(10));
+	EtwStageWriter writer(frequency, tracePath || eventLogPath ? &timeline : nullptr, stats.get());
+	BtLogParser parser(&writer);
 
-	// Buffer for reading output lines from devenv.
-	char buffer[2000];
-	int timingDetailsCount = 0;
-	for (;;)
+	// The echo thread and the snapshots share the console. A snapshot waits
+	// for the chunk being written and starts on a new line.
+	std::mutex consoleLock;
+	bool atLineStart = true;
+	StatsPublisher publisher;
+	if (stats)
 	{
-		if (!fgets(buffer, _countof(buffer), pOutput))
-			break;
-		// Print all the output lines we see.
-		printf("%s", buffer);
-
-		// Need to parse lines that look roughly like this:
-		// 1>  time(C:\Program Files (x86)\Microsoft Visual C++ Compiler Nov 2013 CTP\bin\c1xx.dll)=1.38807s < 1379145750955 - 1379148726430 > BB [C:\homedepot\Source\unmanaged\BlogStuff\CompileParallel\Group3_J.cpp]
-		// 1>  time(C:\Program Files (x86)\Microsoft Visual C++ Compiler Nov 2013 CTP\bin\c2.dll)=0.00499s < 1379148732623 - 1379148743323 > BB [C:\homedepot\Source\unmanaged\BlogStuff\CompileParallel\Group3_J.cpp]
-		// Look for .dll and then walk backwards to find c1xx versus c2. Then look forward for '<' and do a sscanf to get the QueryPerformanceCounter numbers.
-		// Then look for [] or perhaps the last '\' to get the file name.
-		int stage = 0;
-		// Look for the markers for stage 1 and stage 2 compilation.
-		if (strstr(buffer, "c1xx.dll"))
-			stage = 1;
-		if (strstr(buffer, "c2.dll"))
-			stage = 2;
-		if (stage > 0)
+		LiveBuildStats* pStats = stats.get();
+		auto buildStart = std::chrono::steady_clock::now();
+		publisher.Start(statsInterval,
+			[pStats, buildStart](std::string* pText)
+			{
+				double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - buildStart).count();
+				pStats->FormatSnapshot(elapsed, pText);
+			},
+			[&consoleLock, &atLineStart](const std::string& text)
+			{
+				std::lock_guard<std::mutex> lock(consoleLock);
+				if (!atLineStart)
+					fputs("\n", stdout);
+				fwrite(text.data(), 1, text.size(), stdout);
+				fflush(stdout);
+				atLineStart = true;
+			});
+	}
+
+	// A reader thread takes the output as soon as it is available and stamps
+	// it, this thread parses it and writes the ETW events, and an echo thread
+	// prints it. The chunks are handed between them through lock-free rings,
+	// so a slow console or a burst of output doesn't hold up the reads.
+	OutputPipeline pipeline(64 * 1024, 64);
+	int outputFile = _fileno(pOutput);
+	bool raisedPriority = false;
+	pipeline.Run(
+		[&](char* buffer, size_t size) -> long long
 		{
-			++timingDetailsCount;
-			// Look for the '<' before the timing details.
-			char* lessThan = strchr(buffer, '<');
-			if (lessThan)
+			// Only the reader runs at high priority, so that it can always
+			// respond to compiler output quickly. It's fine since it is mostly
+			// idle. It is important to raise the priority after starting devenv
+			// because we don't want to accidentally run it at high priority.
+			if (!raisedPriority)
 			{
-				long long start, end;
-				// Parse the timing details -- QPC start and end times
-				if (2 == sscanf_s(lessThan, "< %lld - %lld", &start, &end))
-				{
-					float elapsed = (end - start) / frequency;
-					LARGE_INTEGER currentCounter;
-					QueryPerformanceCounter(&currentCounter);
-					float startOffset = (start - currentCounter.QuadPart) / frequency; // Negative number representing offset from start.
-					float endOffset = (end - currentCounter.QuadPart) / frequency; // Negative number representing offset from end.
-					// Look for the file part of the source name.
-					char* lastSlash = strrchr(lessThan, '\\');
-					if (lastSlash)
-					{
-						const char* filename = lastSlash + 1;
-						char* squareBracket = strchr(lastSlash, ']');
-						if (squareBracket)
-							squareBracket[0] = 0;
-
-						// Write our custom ETW events, as defined in etwprovider.man.
-						// Record details of the compile stage we just finished.
-						if (stage == 1)
-						{
-							EventWriteCompileStage1Done(filename, elapsed, startOffset, endOffset);
-							firstStageTimes[filename] = elapsed;
-						}
-						else
-						{
-							EventWriteCompileStage2Done(filename, elapsed, startOffset, endOffset);
-							EventWriteCompileSummary(filename, elapsed + firstStageTimes[filename]);
-						}
-					}
-				}
+				SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+				raisedPriority = true;
 			}
-		}
-	}
-	fclose(pOutput);
+			return _read(outputFile, buffer, static_cast<unsigned>(size));
+		},
+		[]() -> long long
+		{
+			LARGE_INTEGER counter;
+			QueryPerformanceCounter(&counter);
+			return counter.QuadPart;
+		},
+		[&](const OutputChunk& chunk)
+		{
+			writer.SetArrival(chunk.arrival);
+			parser.Feed(chunk.data, chunk.size);
+		},
+		[&](const OutputChunk& chunk)
+		{
+			// Print all the output we see.
+			std::lock_guard<std::mutex> lock(consoleLock);
+			fwrite(chunk.data, 1, chunk.size, stdout);
+			if (chunk.size)
+				atLineStart = chunk.data[chunk.size - 1] == '\n';
+		});
+	parser.Finish();
+	_pclose(pOutput);
+	publisher.Stop();
 
+	unsigned long long timingDetailsCount = parser.StageCount();
 	if (timingDetailsCount)
 	{
-		printf("%d compilation timing details seen.\n", timingDetailsCount);
+		printf("%llu compilation timing details seen.\n", timingDetailsCount);
+		const LatencyStats& delivery = writer.DeliveryLatency();
+		const LatencyStats& wrapper = writer.WrapperLatency();
+		printf("Lines arrived %.1f ms (max %.1f ms) after their stage ended and were turned into events %.3f ms (max %.3f ms) later.\n",
+		       delivery.Average() * 1000 / frequency, delivery.maximum * 1000 / frequency,
+		       wrapper.Average() * 1000 / frequency, wrapper.maximum * 1000 / frequency);
+		const PipelineStats& stats = pipeline.Stats();
+		printf("%llu bytes of output in %llu reads, %llu of which waited for a free buffer.\n", stats.bytes, stats.chunks,
+		       stats.readerStalls);
 	}
 	else
 	{
 		printf("No compilation timing details seen. Did you add /Bt+ to the compiler options?\n");
 	}
 
+	if (tracePath && timingDetailsCount)
+	{
+		char path[MAX_PATH];
+		sprintf_s(path, "%S", tracePath);
+		if (WriteChromeTraceFile(timeline, path))
+			printf("Compile timeline written to %s.\n", path);
+		else
+			printf("Couldn't write %s.\n", path);
+	}
+
+	if (eventLogPath && timingDetailsCount)
+	{
+		char path[MAX_PATH];
+		sprintf_s(path, "%S", eventLogPath);
+		std::string buildLabel = commandLine;
+		if (label)
+		{
+			char buffer[1000];
+			sprintf_s(buffer, "%S", label);
+			buildLabel = buffer;
+		}
+		long long now = std::chrono::duration_cast<std::chrono::microseconds>(
+		    std::chrono::system_clock::now().time_since_epoch()).count();
+		if (AppendEventLog(path, timeline, buildLabel, now))
+			printf("Compile stages appended to %s.\n", path);
+		else
+			printf("Couldn't append to %s.\n", path);
+	}
+
 	return 0;
 }
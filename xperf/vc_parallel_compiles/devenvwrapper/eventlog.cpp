@@ -0,0 +1,259 @@
+#include "eventlog.h"
+
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+#include "buildmodel.h"
+
+namespace
+{
+
+// The line endings and the DOS end of file character catch a log that went
+// through a text mode transfer.
+const char kFileMagic[8] = { 'C', 'E', 'V', 'L', '\r', '\n', '\x1a', '\n' };
+const uint32_t kVersion = 1;
+const size_t kFileHeaderSize = 16;
+const uint32_t kSegmentMarker = 0x47455342;  // "BSEG"
+const size_t kSegmentHeaderSize = 48;
+
+void PutU32(std::vector<uint8_t>* pOut, size_t offset, uint32_t value)
+{
+	for (int i = 0; i < 4; ++i)
+		(*pOut)[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+void PutU64(std::vector<uint8_t>* pOut, size_t offset, uint64_t value)
+{
+	for (int i = 0; i < 8; ++i)
+		(*pOut)[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+uint32_t GetU32(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t GetU64(const uint8_t* p)
+{
+	return GetU32(p) | (static_cast<uint64_t>(GetU32(p + 4)) << 32);
+}
+
+void PutVarint(std::vector<uint8_t>* pOut, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		pOut->push_back(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	pOut->push_back(static_cast<uint8_t>(value));
+}
+
+// Four numbers after a tag byte with the length code of each.
+void PutGroupVarint(std::vector<uint8_t>* pOut, const uint64_t values[4])
+{
+	size_t tagOffset = pOut->size();
+	pOut->push_back(0);
+	uint8_t tag = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		uint64_t value = values[i];
+		unsigned code = value <= 0xFF ? 0 : value <= 0xFFFF ? 1 : value <= 0xFFFFFFFFu ? 2 : 3;
+		tag |= static_cast<uint8_t>(code << (2 * i));
+		for (unsigned byte = 0; byte < (1u << code); ++byte)
+			pOut->push_back(static_cast<uint8_t>(value >> (8 * byte)));
+	}
+	(*pOut)[tagOffset] = tag;
+}
+
+bool GetVarint(const uint8_t** pP, const uint8_t* end, uint64_t* pValue)
+{
+	uint64_t value = 0;
+	for (int shift = 0; *pP < end && shift < 64; shift += 7)
+	{
+		uint8_t byte = *(*pP)++;
+		value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+		{
+			*pValue = value;
+			return true;
+		}
+	}
+	return false;
+}
+
+}  // namespace
+
+bool AppendEventLog(const char* path, const BuildTimeline& timeline, const std::string& label, long long time)
+{
+	LockedFile file;
+	if (!file.Open(path))
+		return false;
+	long long size = file.Size();
+	if (size < 0)
+		return false;
+
+	std::unordered_map<std::string, uint32_t> ids;
+	uint32_t stringCount = 0;
+	if (size == 0)
+	{
+		uint8_t header[kFileHeaderSize] = {};
+		memcpy(header, kFileMagic, sizeof(kFileMagic));
+		header[8] = static_cast<uint8_t>(kVersion);
+		if (!file.WriteAt(0, header, sizeof(header)))
+			return false;
+		size = kFileHeaderSize;
+	}
+	else
+	{
+		long long validSize;
+		{
+			EventLogReader reader;
+			if (!reader.Open(path))
+				return false;
+			const std::vector<TextRef>& strings = reader.Strings();
+			ids.reserve(strings.size());
+			for (size_t i = 0; i < strings.size(); ++i)
+				ids.insert(std::make_pair(strings[i].str(), static_cast<uint32_t>(i)));
+			stringCount = static_cast<uint32_t>(strings.size());
+			validSize = static_cast<long long>(reader.ValidSize());
+		}
+		// Drop a segment that a crashed writer left unfinished, now that the
+		// reader's mapping is gone.
+		if (validSize < size)
+		{
+			size = validSize;
+			if (!file.Truncate(size))
+				return false;
+		}
+	}
+
+	const std::vector<StageEvent>& stages = timeline.Stages();
+	std::vector<size_t> order(stages.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs)
+	{
+		return stages[lhs].start < stages[rhs].start;
+	});
+
+	std::vector<uint8_t> segment(kSegmentHeaderSize);
+	segment.insert(segment.end(), label.begin(), label.end());
+	// Give the timeline's sources their ids in the log, adding the new ones.
+	const std::vector<std::string>& sources = timeline.Sources();
+	std::vector<uint32_t> sourceIds(sources.size());
+	uint32_t firstString = stringCount;
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		auto inserted = ids.insert(std::make_pair(sources[i], stringCount));
+		if (inserted.second)
+		{
+			++stringCount;
+			PutVarint(&segment, sources[i].size());
+			segment.insert(segment.end(), sources[i].begin(), sources[i].end());
+		}
+		sourceIds[i] = inserted.first->second;
+	}
+	long long firstTick = order.empty() ? 0 : stages[order[0]].start;
+	long long previous = firstTick;
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		const StageEvent& stage = stages[order[i]];
+		uint64_t values[4] = { static_cast<uint64_t>(stage.start - previous),
+		                       static_cast<uint64_t>(std::max(stage.end - stage.start, 0LL)), sourceIds[stage.source],
+		                       (static_cast<uint64_t>(stage.projectNode) << 2) | (stage.stage & 3) };
+		PutGroupVarint(&segment, values);
+		previous = stage.start;
+	}
+
+	size_t payloadSize = segment.size() - kSegmentHeaderSize;
+	if (payloadSize > 0xFFFFFFFFu)
+		return false;
+	uint64_t frequencyBits;
+	double frequency = timeline.Frequency();
+	memcpy(&frequencyBits, &frequency, sizeof(frequencyBits));
+	PutU32(&segment, 0, kSegmentMarker);
+	PutU32(&segment, 4, static_cast<uint32_t>(payloadSize));
+	PutU32(&segment, 8, static_cast<uint32_t>(stages.size()));
+	PutU32(&segment, 12, firstString);
+	PutU32(&segment, 16, stringCount - firstString);
+	PutU32(&segment, 20, static_cast<uint32_t>(label.size()));
+	PutU64(&segment, 24, frequencyBits);
+	PutU64(&segment, 32, static_cast<uint64_t>(time));
+	PutU64(&segment, 40, static_cast<uint64_t>(firstTick));
+	return file.WriteAt(size, segment.data(), segment.size());
+}
+
+bool EventLogReader::Open(const char* path)
+{
+	builds_.clear();
+	strings_.clear();
+	validSize_ = 0;
+	if (!file_.Open(path))
+		return false;
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(file_.Data());
+	size_t size = file_.Size();
+	if (size < kFileHeaderSize || memcmp(data, kFileMagic, sizeof(kFileMagic)) != 0 || GetU32(data + 8) != kVersion)
+		return false;
+
+	size_t position = kFileHeaderSize;
+	validSize_ = position;
+	while (size - position >= kSegmentHeaderSize)
+	{
+		const uint8_t* header = data + position;
+		uint32_t payloadSize = GetU32(header + 4);
+		uint32_t labelSize = GetU32(header + 20);
+		if (GetU32(header) != kSegmentMarker || size - position - kSegmentHeaderSize < payloadSize ||
+		    labelSize > payloadSize || GetU32(header + 12) != strings_.size())
+			break;
+		const uint8_t* p = header + kSegmentHeaderSize;
+		const uint8_t* end = p + payloadSize;
+
+		LoggedBuild build;
+		build.label = TextRef(reinterpret_cast<const char*>(p), labelSize);
+		p += labelSize;
+		uint32_t stringCount = GetU32(header + 16);
+		bool ok = true;
+		for (uint32_t i = 0; i < stringCount && ok; ++i)
+		{
+			uint64_t length;
+			ok = GetVarint(&p, end, &length) && length <= static_cast<uint64_t>(end - p);
+			if (ok)
+			{
+				strings_.push_back(TextRef(reinterpret_cast<const char*>(p), static_cast<size_t>(length)));
+				p += length;
+			}
+		}
+		if (!ok)
+		{
+			strings_.resize(GetU32(header + 12));
+			break;
+		}
+		uint64_t frequencyBits = GetU64(header + 24);
+		memcpy(&build.frequency, &frequencyBits, sizeof(build.frequency));
+		build.eventCount = GetU32(header + 8);
+		build.time = static_cast<long long>(GetU64(header + 32));
+		build.firstTick = static_cast<long long>(GetU64(header + 40));
+		build.events = p;
+		build.eventsEnd = end;
+		builds_.push_back(build);
+		position += kSegmentHeaderSize + payloadSize;
+		validSize_ = position;
+	}
+	return true;
+}
+
+size_t AddLoggedStages(const EventLogReader& reader, const LoggedBuild& build, BuildTimeline* pTimeline)
+{
+	const std::vector<TextRef>& strings = reader.Strings();
+	EventCursor cursor(build);
+	LoggedEvent event;
+	size_t stages = 0;
+	while (cursor.Next(&event))
+	{
+		if (event.source >= strings.size())
+			continue;
+		pTimeline->AddStage(event.stage, event.projectNode, event.start, event.end, strings[event.source]);
+		++stages;
+	}
+	return stages;
+}
@@ -0,0 +1,175 @@
+// An append-only binary log of compile stage events: the same front end and
+// back end stages that devenvwrapper writes as the CompileStage1Done and
+// CompileStage2Done ETW events, kept outside of .etl files so that months of
+// builds can be stored and scanned on any OS. CompileSummary isn't stored,
+// since it is the sum of the two stages of a file.
+//
+// The file starts with a 16 byte header and then has one segment per build,
+// each appended in a single write:
+//
+//   segment header  48 bytes, little endian: marker, payload size, event
+//                   count, first string id, string count, label size,
+//                   frequency, build time, first start tick
+//   label           the build's label, such as a commit id
+//   strings         the source files this build added to the string table,
+//                   each as a varint length and the bytes
+//   events          in order of start, four numbers each:
+//                     start - previous start, end - start, source id,
+//                     projectNode << 2 | stage
+//
+// File names are interned across the whole file, so a build only adds the
+// names that no earlier build used, and the events refer to them by number.
+//
+// The numbers of an event are a group varint: a tag byte holds the length of
+// each as two bits, for 1, 2, 4 or 8 bytes, and then the numbers follow,
+// little endian. That is as compact as one varint per number, around 10 bytes
+// an event, but the lengths are all known from the first byte, so the reader
+// doesn't branch on each number's length, which differs from one event to
+// the next too often to predict.
+//
+// Appending takes an exclusive lock on the file and first drops a segment
+// that was cut short by a crash, so builds can share one log. The reader maps
+// the file and decodes events in place, without allocating per event.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "btparse.h"
+#include "filelist.h"
+
+class BuildTimeline;
+
+struct LoggedEvent
+{
+	int stage;
+	int projectNode;
+	// Index into EventLogReader::Strings().
+	uint32_t source;
+	long long start;
+	long long end;
+};
+
+struct LoggedBuild
+{
+	TextRef label;
+	// When the build was logged, in microseconds since 1970.
+	long long time;
+	// Ticks per second of the event times.
+	double frequency;
+	uint32_t eventCount;
+	long long firstTick;
+	const uint8_t* events;
+	const uint8_t* eventsEnd;
+};
+
+// Append the stages of a build as a new segment, creating the log if needed.
+// Returns false if it can't be written.
+bool AppendEventLog(const char* path, const BuildTimeline& timeline, const std::string& label, long long time);
+
+class EventLogReader
+{
+public:
+	// Map the log and find its builds and strings. Returns false if it can't
+	// be read or isn't an event log.
+	bool Open(const char* path);
+
+	const std::vector<LoggedBuild>& Builds() const { return builds_; }
+	// The interned source files, pointing into the mapped file.
+	const std::vector<TextRef>& Strings() const { return strings_; }
+	size_t FileSize() const { return file_.Size(); }
+	// The size of the complete segments. Anything after that was cut short.
+	size_t ValidSize() const { return validSize_; }
+
+private:
+	MappedFile file_;
+	std::vector<LoggedBuild> builds_;
+	std::vector<TextRef> strings_;
+	size_t validSize_;
+};
+
+// Add the stages of a logged build to a timeline, which must have the
+// build's frequency. Returns the number of stages.
+size_t AddLoggedStages(const EventLogReader& reader, const LoggedBuild& build, BuildTimeline* pTimeline);
+
+// Decodes the events of one build in order.
+class EventCursor
+{
+public:
+	explicit EventCursor(const LoggedBuild& build)
+		: p_(build.events)
+		, end_(build.eventsEnd)
+		, start_(static_cast<uint64_t>(build.firstTick))
+	{
+	}
+
+	// Returns false at the end, or if the data is bad.
+	bool Next(LoggedEvent* pEvent)
+	{
+		static const uint8_t kLengths[4] = { 1, 2, 4, 8 };
+		static const uint64_t kMasks[4] = { 0xFF, 0xFFFF, 0xFFFFFFFF, ~0ULL };
+		if (p_ >= end_)
+			return false;
+		unsigned tag = *p_;
+		const uint8_t* p = p_ + 1;
+		uint64_t values[4];
+		if (end_ - p >= kMaxEventSize)
+		{
+			// No value can run past the end, so load whole words.
+			for (int i = 0; i < 4; ++i)
+			{
+				unsigned code = (tag >> (2 * i)) & 3;
+				values[i] = LoadWord(p) & kMasks[code];
+				p += kLengths[code];
+			}
+		}
+		else
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				unsigned length = kLengths[(tag >> (2 * i)) & 3];
+				if (end_ - p < static_cast<ptrdiff_t>(length))
+					return false;
+				values[i] = 0;
+				for (unsigned byte = 0; byte < length; ++byte)
+					values[i] |= static_cast<uint64_t>(p[byte]) << (8 * byte);
+				p += length;
+			}
+		}
+		p_ = p;
+		// Unsigned, so that a corrupt log can't overflow.
+		start_ += values[0];
+		pEvent->start = static_cast<long long>(start_);
+		pEvent->end = static_cast<long long>(start_ + values[1]);
+		pEvent->source = static_cast<uint32_t>(values[2]);
+		pEvent->stage = static_cast<int>(values[3] & 3);
+		pEvent->projectNode = static_cast<int>(values[3] >> 2);
+		return true;
+	}
+
+private:
+	// Enough for three values of 8 bytes and a whole word for the fourth.
+	static const ptrdiff_t kMaxEventSize = 32;
+
+	static uint64_t LoadWord(const uint8_t* p)
+	{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		uint64_t word = 0;
+		for (int byte = 7; byte >= 0; --byte)
+			word = (word << 8) | p[byte];
+		return word;
+#else
+		uint64_t word;
+		memcpy(&word, p, sizeof(word));
+		return word;
+#endif
+	}
+
+	const uint8_t* p_;
+	const uint8_t* end_;
+	uint64_t start_;
+};
@@ -0,0 +1,206 @@
+// buildtimes -events: keep compile timings in a binary event log (eventlog.h)
+// and summarize the history in one.
+//
+// With -append the stages of one build, read from anything that the other
+// modes take, are added to the log. Otherwise every build in the log is
+// scanned, on all cores, and the source files that took the most time over
+// all of them are listed, along with how fast the log was read.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "buildmodel.h"
+#include "commands.h"
+#include "eventlog.h"
+
+namespace
+{
+
+struct FileTotals
+{
+	FileTotals() : compiles(0), front(0), back(0) {}
+
+	// The number of front ends, which is one per compile.
+	uint32_t compiles;
+	// In seconds.
+	double front;
+	double back;
+};
+
+struct ScanTotals
+{
+	ScanTotals() : events(0), bad(0) {}
+
+	std::vector<FileTotals> files;
+	unsigned long long events;
+	// Events with a source id that isn't in the string table.
+	unsigned long long bad;
+};
+
+void ScanWorker(const EventLogReader& reader, std::atomic<size_t>* pNext, ScanTotals* pTotals)
+{
+	const std::vector<LoggedBuild>& builds = reader.Builds();
+	ScanTotals& totals = *pTotals;
+	totals.files.resize(reader.Strings().size());
+	const uint32_t fileCount = static_cast<uint32_t>(totals.files.size());
+	for (size_t i; (i = pNext->fetch_add(1)) < builds.size();)
+	{
+		const double secondsPerTick = 1.0 / builds[i].frequency;
+		EventCursor cursor(builds[i]);
+		LoggedEvent event;
+		while (cursor.Next(&event))
+		{
+			++totals.events;
+			if (event.source >= fileCount)
+			{
+				++totals.bad;
+				continue;
+			}
+			FileTotals& file = totals.files[event.source];
+			double seconds = (event.end - event.start) * secondsPerTick;
+			if (event.stage == 1)
+			{
+				++file.compiles;
+				file.front += seconds;
+			}
+			else
+				file.back += seconds;
+		}
+	}
+}
+
+int AppendMain(const char* logPath, const std::string& label, const TimelineOptions& options, const char* input)
+{
+	std::unique_ptr<BuildTimeline> timeline = LoadTimeline(options, input);
+	if (!timeline)
+		return 1;
+	long long now = std::chrono::duration_cast<std::chrono::microseconds>(
+	    std::chrono::system_clock::now().time_since_epoch()).count();
+	if (!AppendEventLog(logPath, *timeline, label.empty() ? input : label, now))
+	{
+		printf("Couldn't append to %s\n", logPath);
+		return 1;
+	}
+	printf("Appended %u stages of %u files to %s.\n", static_cast<unsigned>(timeline->Stages().size()),
+	       static_cast<unsigned>(timeline->Sources().size()), logPath);
+	return 0;
+}
+
+int ScanMain(const char* logPath, unsigned threadCount, size_t topCount)
+{
+	auto start = std::chrono::steady_clock::now();
+	EventLogReader reader;
+	if (!reader.Open(logPath))
+	{
+		printf("Couldn't read %s as an event log\n", logPath);
+		return 1;
+	}
+	const std::vector<LoggedBuild>& builds = reader.Builds();
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	threadCount = static_cast<unsigned>(std::min<size_t>(threadCount, std::max<size_t>(builds.size(), 1)));
+
+	std::atomic<size_t> next(0);
+	std::vector<ScanTotals> results(threadCount);
+	std::vector<std::thread> workers;
+	for (unsigned i = 1; i < threadCount; ++i)
+		workers.push_back(std::thread(ScanWorker, std::cref(reader), &next, &results[i]));
+	ScanWorker(reader, &next, &results[0]);
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+	ScanTotals& totals = results[0];
+	for (size_t i = 1; i < results.size(); ++i)
+	{
+		totals.events += results[i].events;
+		totals.bad += results[i].bad;
+		for (size_t file = 0; file < totals.files.size(); ++file)
+		{
+			totals.files[file].compiles += results[i].files[file].compiles;
+			totals.files[file].front += results[i].files[file].front;
+			totals.files[file].back += results[i].files[file].back;
+		}
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("Scanned %u builds, %llu events and %u source files, %.1f MB, in %.3f s: %.1f M events/s, %.0f MB/s.\n",
+	       static_cast<unsigned>(builds.size()), totals.events, static_cast<unsigned>(reader.Strings().size()),
+	       reader.FileSize() / 1e6, elapsed, elapsed > 0 ? totals.events / elapsed / 1e6 : 0.0,
+	       elapsed > 0 ? reader.FileSize() / 1e6 / elapsed : 0.0);
+	if (reader.ValidSize() < reader.FileSize())
+		printf("The last %u bytes are an unfinished build, which the next append will drop.\n",
+		       static_cast<unsigned>(reader.FileSize() - reader.ValidSize()));
+	if (totals.bad)
+		printf("%llu events refer to unknown source files.\n", totals.bad);
+	if (builds.empty())
+		return 0;
+	printf("First build %s, last build %s.\n", builds.front().label.str().c_str(), builds.back().label.str().c_str());
+
+	std::vector<uint32_t> order;
+	double front = 0, back = 0;
+	for (size_t i = 0; i < totals.files.size(); ++i)
+	{
+		front += totals.files[i].front;
+		back += totals.files[i].back;
+		if (totals.files[i].compiles || totals.files[i].back > 0)
+			order.push_back(static_cast<uint32_t>(i));
+	}
+	printf("Front end %.1f s, back end %.1f s over all builds.\n", front, back);
+	size_t shown = std::min(topCount, order.size());
+	std::partial_sort(order.begin(), order.begin() + shown, order.end(), [&](uint32_t lhs, uint32_t rhs)
+	{
+		return totals.files[lhs].front + totals.files[lhs].back > totals.files[rhs].front + totals.files[rhs].back;
+	});
+	if (shown)
+		printf("\n%10s %8s %10s %10s %10s  %s\n", "total", "compiles", "average", "front end", "back end", "file");
+	for (size_t i = 0; i < shown; ++i)
+	{
+		const FileTotals& file = totals.files[order[i]];
+		double total = file.front + file.back;
+		printf("%8.1f s %8u %8.3f s %8.1f s %8.1f s  %s\n", total, file.compiles,
+		       file.compiles ? total / file.compiles : 0.0, file.front, file.back,
+		       reader.Strings()[order[i]].str().c_str());
+	}
+	return 0;
+}
+
+}  // namespace
+
+int EventsMain(int argc, char* argv[])
+{
+	TimelineOptions options;
+	const char* appendPath = nullptr;
+	std::string label;
+	size_t topCount = 20;
+	bool ok = true;
+	int arg = 0;
+	for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] && ok; ++arg)
+	{
+		if (ParseTimelineOption(&arg, argc, argv, &options, &ok))
+			continue;
+		if (strcmp(argv[arg], "-append") == 0 && arg + 1 < argc)
+			appendPath = argv[++arg];
+		else if (strcmp(argv[arg], "-label") == 0 && arg + 1 < argc)
+			label = argv[++arg];
+		else if (strcmp(argv[arg], "-top") == 0 && arg + 1 < argc)
+			topCount = static_cast<size_t>(atoi(argv[++arg]));
+		else
+			ok = false;
+	}
+	if (!ok || argc - arg != 1)
+	{
+		printf("usage: buildtimes -events -append <events.cel> [-label text] %s <log|-|dir>\n", kTimelineUsage);
+		printf("       buildtimes -events [-threads n] [-top n] <events.cel>\n");
+		printf("  The label, such as a commit id, defaults to the input's name.\n");
+		return 1;
+	}
+	if (appendPath)
+		return AppendMain(appendPath, label, options, argv[arg]);
+	return ScanMain(argv[arg], options.threads, topCount);
+}
@@ -0,0 +1,344 @@
+#include "filelist.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+bool EndsWith(const std::string& text, const std::string& suffix)
+{
+	return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+#ifdef _WIN32
+
+// FILETIME counts 100 ns intervals from 1601.
+const long long kFileTimeTo1970 = 116444736000000000LL;
+
+bool IsDirectory(const std::string& path, bool* pIsDirectory)
+{
+	DWORD attributes = GetFileAttributesA(path.c_str());
+	if (attributes == INVALID_FILE_ATTRIBUTES)
+		return false;
+	*pIsDirectory = (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+	return true;
+}
+
+void ListDirectory(const std::string& directory, const std::string& suffix, std::vector<std::string>* pFiles)
+{
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &data);
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+	do
+	{
+		std::string name = data.cFileName;
+		if (name == "." || name == "..")
+			continue;
+		std::string path = directory + "\\" + name;
+		if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			ListDirectory(path, suffix, pFiles);
+		else if (EndsWith(name, suffix))
+			pFiles->push_back(path);
+	} while (FindNextFileA(find, &data));
+	FindClose(find);
+}
+
+#else
+
+bool IsDirectory(const std::string& path, bool* pIsDirectory)
+{
+	struct stat status;
+	if (stat(path.c_str(), &status) != 0)
+		return false;
+	*pIsDirectory = S_ISDIR(status.st_mode);
+	return true;
+}
+
+void ListDirectory(const std::string& directory, const std::string& suffix, std::vector<std::string>* pFiles)
+{
+	DIR* dir = opendir(directory.c_str());
+	if (!dir)
+		return;
+	while (dirent* entry = readdir(dir))
+	{
+		std::string name = entry->d_name;
+		if (name == "." || name == "..")
+			continue;
+		std::string path = directory + "/" + name;
+		bool isDirectory = false;
+#ifdef DT_DIR
+		// d_type saves a stat per file on most file systems.
+		if (entry->d_type == DT_DIR)
+			isDirectory = true;
+		else if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK)
+			IsDirectory(path, &isDirectory);
+#else
+		IsDirectory(path, &isDirectory);
+#endif
+		if (isDirectory)
+			ListDirectory(path, suffix, pFiles);
+		else if (EndsWith(name, suffix))
+			pFiles->push_back(path);
+	}
+	closedir(dir);
+}
+
+#endif
+
+}  // namespace
+
+bool FindFiles(const std::string& path, const std::string& suffix, std::vector<std::string>* pFiles)
+{
+	bool isDirectory;
+	if (!IsDirectory(path, &isDirectory))
+		return false;
+	if (!isDirectory)
+	{
+		pFiles->push_back(path);
+		return true;
+	}
+	size_t first = pFiles->size();
+	ListDirectory(path, suffix, pFiles);
+	std::sort(pFiles->begin() + first, pFiles->end());
+	return true;
+}
+
+bool ReadWholeFile(const char* path, std::vector<char>* pData)
+{
+	FILE* fp = fopen(path, "rb");
+	if (!fp)
+		return false;
+	// Size the buffer from the file length, with a byte to spare to notice
+	// that it grew, then keep doubling if it did.
+	size_t capacity = 4096;
+	if (fseek(fp, 0, SEEK_END) == 0)
+	{
+		long length = ftell(fp);
+		if (length > 0)
+			capacity = static_cast<size_t>(length) + 1;
+		fseek(fp, 0, SEEK_SET);
+	}
+	pData->resize(capacity);
+	size_t used = 0;
+	for (;;)
+	{
+		used += fread(pData->data() + used, 1, pData->size() - used, fp);
+		if (used < pData->size())
+			break;
+		pData->resize(pData->size() * 2);
+	}
+	pData->resize(used);
+	bool ok = !ferror(fp);
+	fclose(fp);
+	return ok;
+}
+
+long long FileWriteTime(const char* path)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data))
+		return -1;
+	long long ticks = (static_cast<long long>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+	return (ticks - kFileTimeTo1970) / 10;
+#else
+	struct stat status;
+	if (stat(path, &status) != 0)
+		return -1;
+#if defined(__APPLE__)
+	return status.st_mtimespec.tv_sec * 1000000LL + status.st_mtimespec.tv_nsec / 1000;
+#else
+	return status.st_mtim.tv_sec * 1000000LL + status.st_mtim.tv_nsec / 1000;
+#endif
+#endif
+}
+
+MappedFile::MappedFile()
+	: data_(nullptr)
+	, size_(0)
+#ifdef _WIN32
+	, mapping_(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const char* path)
+{
+	Close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+	                          FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER length;
+	bool ok = GetFileSizeEx(file, &length) != 0;
+	if (ok && length.QuadPart > 0)
+	{
+		// The view keeps the file open, so the handles can go.
+		mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping_)
+			data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+		ok = data_ != nullptr;
+		size_ = ok ? static_cast<size_t>(length.QuadPart) : 0;
+	}
+	CloseHandle(file);
+	if (!ok)
+		Close();
+	return ok;
+#else
+	int file = open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat status;
+	bool ok = fstat(file, &status) == 0;
+	if (ok && status.st_size > 0)
+	{
+		void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE | MAP_POPULATE, file, 0);
+		ok = data != MAP_FAILED;
+		if (ok)
+		{
+			// The file is read front to back.
+			madvise(data, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+			data_ = static_cast<const char*>(data);
+			size_ = static_cast<size_t>(status.st_size);
+		}
+	}
+	close(file);
+	return ok;
+#endif
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (data_)
+		UnmapViewOfFile(data_);
+	if (mapping_)
+		CloseHandle(mapping_);
+	mapping_ = nullptr;
+#else
+	if (data_)
+		munmap(const_cast<char*>(data_), size_);
+#endif
+	data_ = nullptr;
+	size_ = 0;
+}
+
+#ifdef _WIN32
+
+LockedFile::LockedFile() : file_(INVALID_HANDLE_VALUE) {}
+
+LockedFile::~LockedFile()
+{
+	// Closing the handle releases the lock.
+	if (file_ != INVALID_HANDLE_VALUE)
+		CloseHandle(file_);
+}
+
+bool LockedFile::Open(const char* path)
+{
+	file_ = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS,
+	                    FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file_ == INVALID_HANDLE_VALUE)
+		return false;
+	// Lock a byte far past the end rather than the data, since a locked
+	// region can't be read through another process's mapping.
+	OVERLAPPED overlapped = {};
+	overlapped.Offset = 0xFFFFFFFE;
+	overlapped.OffsetHigh = 0x7FFFFFFF;
+	return LockFileEx(file_, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped) != 0;
+}
+
+long long LockedFile::Size()
+{
+	LARGE_INTEGER size;
+	return GetFileSizeEx(file_, &size) ? size.QuadPart : -1;
+}
+
+bool LockedFile::Truncate(long long size)
+{
+	LARGE_INTEGER position;
+	position.QuadPart = size;
+	return SetFilePointerEx(file_, position, nullptr, FILE_BEGIN) && SetEndOfFile(file_);
+}
+
+bool LockedFile::WriteAt(long long offset, const void* data, size_t size)
+{
+	LARGE_INTEGER position;
+	position.QuadPart = offset;
+	DWORD written;
+	return SetFilePointerEx(file_, position, nullptr, FILE_BEGIN) &&
+	       WriteFile(file_, data, static_cast<DWORD>(size), &written, nullptr) && written == size;
+}
+
+#else
+
+LockedFile::LockedFile() : file_(-1) {}
+
+LockedFile::~LockedFile()
+{
+	if (file_ >= 0)
+		close(file_);
+}
+
+bool LockedFile::Open(const char* path)
+{
+	file_ = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+	if (file_ < 0)
+		return false;
+	while (flock(file_, LOCK_EX) != 0)
+	{
+		if (errno != EINTR)
+			return false;
+	}
+	return true;
+}
+
+long long LockedFile::Size()
+{
+	struct stat status;
+	return fstat(file_, &status) == 0 ? status.st_size : -1;
+}
+
+bool LockedFile::Truncate(long long size)
+{
+	return ftruncate(file_, size) == 0;
+}
+
+bool LockedFile::WriteAt(long long offset, const void* data, size_t size)
+{
+	const char* p = static_cast<const char*>(data);
+	while (size)
+	{
+		ssize_t written = pwrite(file_, p, size, offset);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		p += written;
+		offset += written;
+		size -= static_cast<size_t>(written);
+	}
+	return true;
+}
+
+#endif
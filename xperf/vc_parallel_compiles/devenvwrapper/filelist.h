@@ -0,0 +1,75 @@
+// The little bit of file system access that the importers, the event log and
+// the history store need, for Windows and POSIX.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// If path is a file, append it. If it is a directory, append every file below
+// it whose name ends in suffix, in sorted order. Returns false if path doesn't
+// exist.
+bool FindFiles(const std::string& path, const std::string& suffix, std::vector<std::string>* pFiles);
+
+// Read a whole file into data, reusing its memory. Returns false on failure.
+bool ReadWholeFile(const char* path, std::vector<char>* pData);
+
+// When the file was last written, in microseconds since 1970, or -1.
+long long FileWriteTime(const char* path);
+
+// A whole file mapped read-only into memory, for reading large files without
+// copying them.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	// Returns false if the file can't be opened or mapped. An empty file maps
+	// to no data.
+	bool Open(const char* path);
+	void Close();
+
+	const char* Data() const { return data_; }
+	size_t Size() const { return size_; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const char* data_;
+	size_t size_;
+#ifdef _WIN32
+	void* mapping_;
+#endif
+};
+
+// A file opened for reading and writing and locked against other LockedFiles
+// for as long as it is open. The lock is advisory, so plain readers still see
+// the file. A file that is replaced by a rename can't hold its own lock, so
+// lock one next to it instead.
+class LockedFile
+{
+public:
+	LockedFile();
+	~LockedFile();
+
+	// Creates the file if needed and waits for the lock. Returns false if
+	// the file can't be opened or locked.
+	bool Open(const char* path);
+	long long Size();
+	bool Truncate(long long size);
+	bool WriteAt(long long offset, const void* data, size_t size);
+
+private:
+	LockedFile(const LockedFile&);
+	LockedFile& operator=(const LockedFile&);
+
+#ifdef _WIN32
+	void* file_;
+#else
+	int file_;
+#endif
+};
@@ -0,0 +1,235 @@
+// buildtimes -history: keep per file compile times across builds in a history
+// store (historystore.h) and report the translation units that got slower in
+// the latest builds (regression.h).
+//
+// -add puts one build, read from anything the other modes take, on the end of
+// the store. -import adds the builds of an event log that are newer than the
+// last one in the store, so a nightly job can import the same growing log
+// every time. Otherwise the store is tested for regressions, or with -file
+// the recent times of the matching files are listed.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "buildmodel.h"
+#include "commands.h"
+#include "eventlog.h"
+#include "historystore.h"
+#include "regression.h"
+
+namespace
+{
+
+// Builds are added this many at a time, which bounds the memory used.
+const size_t kImportBatch = 32;
+
+long long NowMicroseconds()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+	    std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+int AddMain(const char* storePath, const std::string& label, const TimelineOptions& options, const char* input)
+{
+	std::unique_ptr<BuildTimeline> timeline = LoadTimeline(options, input);
+	if (!timeline)
+		return 1;
+	std::vector<BuildFileTimes> builds(1);
+	builds[0].label = label.empty() ? input : label;
+	builds[0].time = NowMicroseconds();
+	SumFileTimes(*timeline, &builds[0]);
+	if (!AddToHistory(storePath, builds))
+	{
+		printf("Couldn't add to %s\n", storePath);
+		return 1;
+	}
+	printf("Added %u files to %s as %s.\n", static_cast<unsigned>(builds[0].files.size()), storePath,
+	       builds[0].label.c_str());
+	return 0;
+}
+
+int ImportLogMain(const char* storePath, const char* logPath)
+{
+	long long newest = -1;
+	{
+		HistoryReader store;
+		if (store.Open(storePath) && store.BuildCount())
+			newest = store.Time(store.BuildCount() - 1);
+	}
+	EventLogReader reader;
+	if (!reader.Open(logPath))
+	{
+		printf("Couldn't read %s as an event log\n", logPath);
+		return 1;
+	}
+	size_t added = 0;
+	std::vector<BuildFileTimes> batch;
+	const std::vector<LoggedBuild>& builds = reader.Builds();
+	for (size_t i = 0; i <= builds.size(); ++i)
+	{
+		if (i < builds.size())
+		{
+			if (builds[i].time <= newest)
+				continue;
+			BuildTimeline timeline(builds[i].frequency);
+			AddLoggedStages(reader, builds[i], &timeline);
+			batch.push_back(BuildFileTimes());
+			batch.back().label = builds[i].label.str();
+			batch.back().time = builds[i].time;
+			SumFileTimes(timeline, &batch.back());
+		}
+		if (batch.size() == kImportBatch || (i == builds.size() && !batch.empty()))
+		{
+			if (!AddToHistory(storePath, batch))
+			{
+				printf("Couldn't add to %s\n", storePath);
+				return 1;
+			}
+			added += batch.size();
+			batch.clear();
+		}
+	}
+	printf("Added %u of the %u builds in %s to %s.\n", static_cast<unsigned>(added),
+	       static_cast<unsigned>(builds.size()), logPath, storePath);
+	return 0;
+}
+
+void PrintFileHistory(const HistoryReader& store, const char* text, uint32_t buildCount)
+{
+	const size_t kMaximumFiles = 10;
+	uint32_t first = store.BuildCount() - std::min(buildCount, store.BuildCount());
+	std::vector<float> front(store.BuildCount()), back(store.BuildCount());
+	size_t shown = 0;
+	for (uint32_t file = 0; file < store.FileCount() && shown < kMaximumFiles; ++file)
+	{
+		std::string name = store.FileName(file).str();
+		if (!strstr(name.c_str(), text))
+			continue;
+		++shown;
+		printf("%s\n%10s %10s  %s\n", name.c_str(), "front end", "back end", "build");
+		store.ReadFront(file, 0, store.BuildCount(), front.data());
+		store.ReadBack(file, 0, store.BuildCount(), back.data());
+		for (uint32_t b = first; b < store.BuildCount(); ++b)
+		{
+			if (front[b] == front[b] || back[b] == back[b])
+				printf("%8.3f s %8.3f s  %s\n", front[b], back[b], store.Label(b).str().c_str());
+		}
+		printf("\n");
+	}
+	if (!shown)
+		printf("No files match %s.\n", text);
+}
+
+int ReportMain(const char* storePath, const RegressionOptions& options, size_t topCount, const char* fileText)
+{
+	auto start = std::chrono::steady_clock::now();
+	HistoryReader store;
+	if (!store.Open(storePath))
+	{
+		printf("Couldn't read %s as a history store\n", storePath);
+		return 1;
+	}
+	if (fileText)
+	{
+		PrintFileHistory(store, fileText, options.recent + options.baseline);
+		return 0;
+	}
+
+	std::vector<Regression> regressions;
+	RegressionStats stats;
+	FindRegressions(store, options, &regressions, &stats);
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("%u builds of %u files. Tested %u files in the last %u builds against the %u before them in %.3f s.\n",
+	       store.BuildCount(), store.FileCount(), static_cast<unsigned>(stats.tested),
+	       std::min(options.recent, store.BuildCount()), options.baseline, elapsed);
+	if (stats.added)
+		printf("%u files are new in the last %u builds.\n", static_cast<unsigned>(stats.added), options.recent);
+	if (regressions.empty())
+	{
+		printf("No translation unit got more than %.1f deviations and %.2f s slower.\n", options.threshold,
+		       options.minimumSeconds);
+		return 0;
+	}
+
+	double totalChange = 0;
+	for (size_t i = 0; i < regressions.size(); ++i)
+		totalChange += regressions[i].after - regressions[i].before;
+	printf("%u translation units got slower, adding %.1f s of compile time to each build.\n",
+	       static_cast<unsigned>(regressions.size()), totalChange);
+	if (regressions.size() > topCount)
+		regressions.resize(topCount);
+	printf("\n%9s %9s %9s %6s %9s %9s %6s  %-12s %s\n", "before", "after", "change", "", "front end", "back end",
+	       "score", "since", "file");
+	for (size_t i = 0; i < regressions.size(); ++i)
+	{
+		const Regression& r = regressions[i];
+		printf("%7.3f s %7.3f s %+7.3f s %+5.0f%% %+7.3f s %+7.3f s %6.1f  %-12s %s\n", r.before, r.after,
+		       r.after - r.before, 100.0 * (r.after - r.before) / r.before, r.frontChange, r.backChange, r.score,
+		       store.Label(r.since).str().c_str(), store.FileName(r.file).str().c_str());
+	}
+	return 0;
+}
+
+}  // namespace
+
+int HistoryMain(int argc, char* argv[])
+{
+	TimelineOptions options;
+	RegressionOptions regression;
+	const char* addPath = nullptr;
+	const char* importPath = nullptr;
+	const char* fileText = nullptr;
+	std::string label;
+	size_t topCount = 30;
+	bool ok = true;
+	int arg = 0;
+	for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] && ok; ++arg)
+	{
+		if (ParseTimelineOption(&arg, argc, argv, &options, &ok))
+			continue;
+		if (arg + 1 >= argc)
+			ok = false;
+		else if (strcmp(argv[arg], "-add") == 0)
+			addPath = argv[++arg];
+		else if (strcmp(argv[arg], "-import") == 0)
+			importPath = argv[++arg];
+		else if (strcmp(argv[arg], "-label") == 0)
+			label = argv[++arg];
+		else if (strcmp(argv[arg], "-recent") == 0)
+			regression.recent = static_cast<uint32_t>(atoi(argv[++arg]));
+		else if (strcmp(argv[arg], "-baseline") == 0)
+			regression.baseline = static_cast<uint32_t>(atoi(argv[++arg]));
+		else if (strcmp(argv[arg], "-threshold") == 0)
+			regression.threshold = atof(argv[++arg]);
+		else if (strcmp(argv[arg], "-min") == 0)
+			regression.minimumSeconds = atof(argv[++arg]);
+		else if (strcmp(argv[arg], "-top") == 0)
+			topCount = static_cast<size_t>(atoi(argv[++arg]));
+		else if (strcmp(argv[arg], "-file") == 0)
+			fileText = argv[++arg];
+		else
+			ok = false;
+	}
+	if (!ok || argc - arg != 1 || (addPath && importPath) || regression.recent == 0)
+	{
+		printf("usage: buildtimes -history -add <store> [-label text] %s <log|-|dir>\n", kTimelineUsage);
+		printf("       buildtimes -history -import <store> <events.cel>\n");
+		printf("       buildtimes -history [-recent n] [-baseline n] [-threshold z] [-min seconds] [-top n]\n");
+		printf("                           [-file text] <store>\n");
+		printf("  Reports the files whose median time in the last %u builds is %.0f robust deviations\n",
+		       RegressionOptions().recent, RegressionOptions().threshold);
+		printf("  and %.2f s above the median of the %u builds before them.\n", RegressionOptions().minimumSeconds,
+		       RegressionOptions().baseline);
+		return 1;
+	}
+	if (addPath)
+		return AddMain(addPath, label, options, argv[arg]);
+	if (importPath)
+		return ImportLogMain(importPath, argv[arg]);
+	return ReportMain(argv[arg], regression, topCount, fileText);
+}
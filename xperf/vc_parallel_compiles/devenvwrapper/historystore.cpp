@@ -0,0 +1,347 @@
+#include "historystore.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <unordered_map>
+#include "buildmodel.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+const char kMagic[8] = { 'C', 'T', 'H', 'I', 'S', 'T', '\r', '\n' };
+const uint32_t kVersion = 1;
+const size_t kHeaderSize = 32;
+const size_t kBuildEntrySize = 16;
+const size_t kFileEntrySize = 8;
+
+uint32_t GetU32(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t GetU64(const uint8_t* p)
+{
+	return GetU32(p) | (static_cast<uint64_t>(GetU32(p + 4)) << 32);
+}
+
+void PutU32(std::string* pOut, uint32_t value)
+{
+	for (int i = 0; i < 4; ++i)
+		*pOut += static_cast<char>(value >> (8 * i));
+}
+
+void PutU64(std::string* pOut, uint64_t value)
+{
+	PutU32(pOut, static_cast<uint32_t>(value));
+	PutU32(pOut, static_cast<uint32_t>(value >> 32));
+}
+
+size_t Pad4(size_t size)
+{
+	return (size + 3) & ~static_cast<size_t>(3);
+}
+
+// Writes the floats of a column, a buffer at a time.
+class ColumnWriter
+{
+public:
+	explicit ColumnWriter(FILE* fp) : fp_(fp), ok_(true) {}
+
+	void Write(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		PutU32(&buffer_, bits);
+		if (buffer_.size() >= 1 << 20)
+			Flush();
+	}
+
+	void WriteBytes(const uint8_t* data, size_t size)
+	{
+		Flush();
+		if (size && fwrite(data, 1, size, fp_) != size)
+			ok_ = false;
+	}
+
+	bool Flush()
+	{
+		if (!buffer_.empty() && fwrite(buffer_.data(), 1, buffer_.size(), fp_) != buffer_.size())
+			ok_ = false;
+		buffer_.clear();
+		return ok_;
+	}
+
+private:
+	FILE* fp_;
+	std::string buffer_;
+	bool ok_;
+};
+
+bool ReplaceFile(const std::string& from, const char* to)
+{
+#ifdef _WIN32
+	return MoveFileExA(from.c_str(), to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(from.c_str(), to) == 0;
+#endif
+}
+
+// A name for a temporary file that no other process or thread will pick.
+std::string TemporarySuffix()
+{
+	static std::atomic<unsigned> counter(0);
+#ifdef _WIN32
+	int pid = _getpid();
+#else
+	int pid = getpid();
+#endif
+	char suffix[64];
+	sprintf(suffix, ".%d.%u.new", pid, counter++);
+	return suffix;
+}
+
+}  // namespace
+
+void SumFileTimes(const BuildTimeline& timeline, BuildFileTimes* pTimes)
+{
+	const std::vector<std::string>& sources = timeline.Sources();
+	const std::vector<StageEvent>& stages = timeline.Stages();
+	std::vector<double> front(sources.size(), -1.0);
+	std::vector<double> back(sources.size(), -1.0);
+	for (size_t i = 0; i < stages.size(); ++i)
+	{
+		const StageEvent& stage = stages[i];
+		double& total = stage.stage == 1 ? front[stage.source] : back[stage.source];
+		total = std::max(total, 0.0) + (stage.end - stage.start) / timeline.Frequency();
+	}
+	const float missing = std::numeric_limits<float>::quiet_NaN();
+	pTimes->files = sources;
+	pTimes->front.resize(sources.size());
+	pTimes->back.resize(sources.size());
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		pTimes->front[i] = front[i] < 0 ? missing : static_cast<float>(front[i]);
+		pTimes->back[i] = back[i] < 0 ? missing : static_cast<float>(back[i]);
+	}
+}
+
+bool AddToHistory(const char* path, const std::vector<BuildFileTimes>& builds)
+{
+	// Two builds that add to the same store at once would otherwise each
+	// start from the old store, and the second rename would lose the first
+	// one's builds. The store is replaced by a rename on every update, so
+	// the lock is held on a file next to it that stays put. Readers don't
+	// take it, since they never see half of an update.
+	LockedFile lock;
+	if (!lock.Open((std::string(path) + ".lock").c_str()))
+		return false;
+	HistoryReader old;
+	FILE* existing = fopen(path, "rb");
+	if (existing)
+	{
+		fclose(existing);
+		if (!old.Open(path))
+			return false;
+	}
+
+	// Old files keep their numbers and new ones go on the end.
+	std::vector<std::string> fileNames;
+	std::unordered_map<std::string, uint32_t> fileIndex;
+	for (uint32_t i = 0; i < old.FileCount(); ++i)
+	{
+		fileNames.push_back(old.FileName(i).str());
+		fileIndex.insert(std::make_pair(fileNames.back(), i));
+	}
+	// The new values, build by build, by the file's number in the store.
+	const float missing = std::numeric_limits<float>::quiet_NaN();
+	std::vector<std::vector<uint32_t>> buildFiles(builds.size());
+	for (size_t b = 0; b < builds.size(); ++b)
+	{
+		const BuildFileTimes& build = builds[b];
+		buildFiles[b].resize(build.files.size());
+		for (size_t i = 0; i < build.files.size(); ++i)
+		{
+			auto inserted = fileIndex.insert(std::make_pair(build.files[i], static_cast<uint32_t>(fileNames.size())));
+			if (inserted.second)
+				fileNames.push_back(build.files[i]);
+			buildFiles[b][i] = inserted.first->second;
+		}
+	}
+	const uint32_t oldBuilds = old.BuildCount();
+	const uint32_t buildCount = oldBuilds + static_cast<uint32_t>(builds.size());
+	const uint32_t fileCount = static_cast<uint32_t>(fileNames.size());
+	std::vector<float> newFront(builds.size() * static_cast<size_t>(fileCount), missing);
+	std::vector<float> newBack(newFront.size(), missing);
+	for (size_t b = 0; b < builds.size(); ++b)
+	{
+		for (size_t i = 0; i < buildFiles[b].size(); ++i)
+		{
+			size_t index = buildFiles[b][i] * builds.size() + b;
+			newFront[index] = builds[b].front[i];
+			newBack[index] = builds[b].back[i];
+		}
+	}
+
+	std::string strings;
+	std::string tables;
+	for (uint32_t b = 0; b < buildCount; ++b)
+	{
+		std::string label = b < oldBuilds ? old.Label(b).str() : builds[b - oldBuilds].label;
+		long long time = b < oldBuilds ? old.Time(b) : builds[b - oldBuilds].time;
+		PutU64(&tables, static_cast<uint64_t>(time));
+		PutU32(&tables, static_cast<uint32_t>(strings.size()));
+		PutU32(&tables, static_cast<uint32_t>(label.size()));
+		strings += label;
+	}
+	for (uint32_t f = 0; f < fileCount; ++f)
+	{
+		PutU32(&tables, static_cast<uint32_t>(strings.size()));
+		PutU32(&tables, static_cast<uint32_t>(fileNames[f].size()));
+		strings += fileNames[f];
+	}
+	uint64_t stringBytes = strings.size();
+	strings.resize(Pad4(strings.size()), '\0');
+
+	std::string header(kMagic, sizeof(kMagic));
+	PutU32(&header, kVersion);
+	PutU32(&header, buildCount);
+	PutU32(&header, fileCount);
+	PutU32(&header, 0);
+	PutU64(&header, stringBytes);
+
+	std::string temporary = std::string(path) + TemporarySuffix();
+	FILE* fp = fopen(temporary.c_str(), "wb");
+	if (!fp)
+		return false;
+	ColumnWriter writer(fp);
+	writer.WriteBytes(reinterpret_cast<const uint8_t*>(header.data()), header.size());
+	writer.WriteBytes(reinterpret_cast<const uint8_t*>(tables.data()), tables.size());
+	writer.WriteBytes(reinterpret_cast<const uint8_t*>(strings.data()), strings.size());
+	std::vector<float> column(oldBuilds);
+	for (int stage = 1; stage <= 2; ++stage)
+	{
+		const std::vector<float>& added = stage == 1 ? newFront : newBack;
+		for (uint32_t f = 0; f < fileCount; ++f)
+		{
+			if (f < old.FileCount())
+			{
+				if (stage == 1)
+					old.ReadFront(f, 0, oldBuilds, column.data());
+				else
+					old.ReadBack(f, 0, oldBuilds, column.data());
+			}
+			else
+				column.assign(oldBuilds, missing);
+			for (uint32_t b = 0; b < oldBuilds; ++b)
+				writer.Write(column[b]);
+			for (size_t b = 0; b < builds.size(); ++b)
+				writer.Write(added[f * builds.size() + b]);
+		}
+	}
+	bool ok = writer.Flush();
+	ok = fclose(fp) == 0 && ok;
+	// The old store has to be unmapped before it can be replaced.
+	old.Close();
+	if (!ok || !ReplaceFile(temporary, path))
+	{
+		remove(temporary.c_str());
+		return false;
+	}
+	return true;
+}
+
+HistoryReader::HistoryReader()
+	: buildCount_(0)
+	, fileCount_(0)
+	, builds_(nullptr)
+	, files_(nullptr)
+	, strings_(nullptr)
+	, front_(nullptr)
+	, back_(nullptr)
+{
+}
+
+bool HistoryReader::Open(const char* path)
+{
+	Close();
+	if (!file_.Open(path))
+		return false;
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(file_.Data());
+	size_t size = file_.Size();
+	if (size < kHeaderSize || memcmp(data, kMagic, sizeof(kMagic)) != 0 || GetU32(data + 8) != kVersion)
+		return false;
+	uint64_t buildCount = GetU32(data + 12);
+	uint64_t fileCount = GetU32(data + 16);
+	uint64_t stringBytes = GetU64(data + 24);
+	uint64_t stringsOffset = kHeaderSize + buildCount * kBuildEntrySize + fileCount * kFileEntrySize;
+	uint64_t columnsOffset = stringsOffset + ((stringBytes + 3) & ~3ULL);
+	uint64_t columnBytes = buildCount * fileCount * sizeof(float);
+	if (stringBytes > size || columnsOffset + 2 * columnBytes != size)
+		return false;
+
+	builds_ = data + kHeaderSize;
+	files_ = builds_ + buildCount * kBuildEntrySize;
+	strings_ = data + stringsOffset;
+	front_ = data + columnsOffset;
+	back_ = front_ + columnBytes;
+	for (uint64_t b = 0; b < buildCount; ++b)
+	{
+		const uint8_t* entry = builds_ + b * kBuildEntrySize;
+		if (static_cast<uint64_t>(GetU32(entry + 8)) + GetU32(entry + 12) > stringBytes)
+			return false;
+	}
+	for (uint64_t f = 0; f < fileCount; ++f)
+	{
+		const uint8_t* entry = files_ + f * kFileEntrySize;
+		if (static_cast<uint64_t>(GetU32(entry)) + GetU32(entry + 4) > stringBytes)
+			return false;
+	}
+	buildCount_ = static_cast<uint32_t>(buildCount);
+	fileCount_ = static_cast<uint32_t>(fileCount);
+	return true;
+}
+
+void HistoryReader::Close()
+{
+	file_.Close();
+	buildCount_ = 0;
+	fileCount_ = 0;
+}
+
+TextRef HistoryReader::Label(uint32_t build) const
+{
+	const uint8_t* entry = builds_ + build * kBuildEntrySize;
+	return TextRef(reinterpret_cast<const char*>(strings_) + GetU32(entry + 8), GetU32(entry + 12));
+}
+
+long long HistoryReader::Time(uint32_t build) const
+{
+	return static_cast<long long>(GetU64(builds_ + build * kBuildEntrySize));
+}
+
+TextRef HistoryReader::FileName(uint32_t file) const
+{
+	const uint8_t* entry = files_ + file * kFileEntrySize;
+	return TextRef(reinterpret_cast<const char*>(strings_) + GetU32(entry), GetU32(entry + 4));
+}
+
+void HistoryReader::ReadFront(uint32_t file, uint32_t first, uint32_t count, float* pTimes) const
+{
+	memcpy(pTimes, front_ + (static_cast<size_t>(file) * buildCount_ + first) * sizeof(float), count * sizeof(float));
+}
+
+void HistoryReader::ReadBack(uint32_t file, uint32_t first, uint32_t count, float* pTimes) const
+{
+	memcpy(pTimes, back_ + (static_cast<size_t>(file) * buildCount_ + first) * sizeof(float), count * sizeof(float));
+}
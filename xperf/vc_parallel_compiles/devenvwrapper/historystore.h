@@ -0,0 +1,85 @@
+// A store of compile times across many builds, for finding the translation
+// units that got slower. For every source file it keeps the seconds spent in
+// the front end (stage 1) and the back end (stage 2) in each build, and each
+// build is labeled, normally with the commit it built.
+//
+// The layout is columnar, one column per file and stage holding that file's
+// time in every build in order, so that the recent history of a file is one
+// contiguous read:
+//
+//   header       32 bytes: magic, version, build count, file count, string
+//                bytes
+//   builds       16 bytes each: time (microseconds since 1970), label offset
+//                and length
+//   files        8 bytes each: name offset and length
+//   strings      the labels and names, padded to 4 bytes
+//   front        file count x build count floats, file by file
+//   back         the same for the back end
+//
+// Everything is little endian. A file that wasn't compiled in a build has a
+// NaN there. Adding builds writes a new store next to the old one, file by
+// file, and then renames it over the old one, so a reader never sees half of
+// an update. Updates hold a lock on path.lock, so concurrent ones queue up
+// rather than lose each other's builds. A year of nightly builds of 40,000
+// files is around 120 MB.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "btparse.h"
+#include "filelist.h"
+
+class BuildTimeline;
+
+// One build's compile times per source file, in seconds.
+struct BuildFileTimes
+{
+	std::string label;
+	// Microseconds since 1970.
+	long long time;
+	std::vector<std::string> files;
+	std::vector<float> front;
+	std::vector<float> back;
+};
+
+// Sum the stages of each source file in a timeline. A file compiled more than
+// once in a build, say for two configurations, gets the total.
+void SumFileTimes(const BuildTimeline& timeline, BuildFileTimes* pTimes);
+
+// Add builds to the end of the store at path, creating it if there is none.
+// Returns false if it can't be read or written.
+bool AddToHistory(const char* path, const std::vector<BuildFileTimes>& builds);
+
+class HistoryReader
+{
+public:
+	HistoryReader();
+
+	// Map the store. Returns false if it can't be read or isn't a store.
+	bool Open(const char* path);
+	void Close();
+
+	uint32_t BuildCount() const { return buildCount_; }
+	uint32_t FileCount() const { return fileCount_; }
+	TextRef Label(uint32_t build) const;
+	long long Time(uint32_t build) const;
+	TextRef FileName(uint32_t file) const;
+
+	// Copy the times of a file in count builds from first on.
+	void ReadFront(uint32_t file, uint32_t first, uint32_t count, float* pTimes) const;
+	void ReadBack(uint32_t file, uint32_t first, uint32_t count, float* pTimes) const;
+
+private:
+	MappedFile file_;
+	uint32_t buildCount_;
+	uint32_t fileCount_;
+	const uint8_t* builds_;
+	const uint8_t* files_;
+	const uint8_t* strings_;
+	const uint8_t* front_;
+	const uint8_t* back_;
+};
@@ -0,0 +1,87 @@
+// buildtimes -import: read a build's clang -ftime-trace or gcc -ftime-report
+// files, say how fast that was, and list the slowest translation units. The
+// other modes import the same way given -format.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "buildmodel.h"
+#include "commands.h"
+#include "importers.h"
+
+int ImportMain(int argc, char* argv[])
+{
+	TimelineOptions options;
+	options.format = kFormatClangTimeTrace;
+	size_t topCount = 20;
+	bool ok = true;
+	int arg = 0;
+	for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] && ok; ++arg)
+	{
+		if (ParseTimelineOption(&arg, argc, argv, &options, &ok))
+			continue;
+		if (strcmp(argv[arg], "-top") == 0 && arg + 1 < argc)
+			topCount = static_cast<size_t>(atoi(argv[++arg]));
+		else
+			ok = false;
+	}
+	if (!ok || argc - arg != 1 || options.format == kFormatBt || options.format == kFormatProcessLog ||
+	    options.format == kFormatEventLog)
+	{
+		printf("usage: buildtimes -import [-format clang|gcc] [-suffix text] [-threads n] [-top n] <file|dir>\n");
+		printf("  The format defaults to clang. Files are found by suffix, which defaults to\n");
+		printf("  %s for clang and %s for gcc.\n", DefaultTimingSuffix(kFormatClangTimeTrace),
+		       DefaultTimingSuffix(kFormatGccTimeReport));
+		return 1;
+	}
+
+	std::string suffix = options.suffix.empty() ? DefaultTimingSuffix(options.format) : options.suffix;
+	BuildTimeline timeline(kImportFrequency);
+	ImportStats stats;
+	auto start = std::chrono::steady_clock::now();
+	if (!ImportTimings(options.format, argv[arg], suffix, options.threads, &timeline, &stats))
+	{
+		printf("Couldn't find %s\n", argv[arg]);
+		return 1;
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("Read %u files, %.1f MB, in %.3f s: %.0f files/s, %.1f MB/s.\n", static_cast<unsigned>(stats.files),
+	       stats.bytes / 1e6, elapsed, elapsed > 0 ? stats.files / elapsed : 0.0,
+	       elapsed > 0 ? stats.bytes / 1e6 / elapsed : 0.0);
+	printf("%u compiles imported, %u files not in the format, %u unreadable.\n", static_cast<unsigned>(stats.compiles),
+	       static_cast<unsigned>(stats.skipped), static_cast<unsigned>(stats.unreadable));
+	if (timeline.Stages().empty())
+		return 1;
+
+	std::vector<CompileJob> jobs;
+	timeline.BuildJobs(&jobs);
+	const std::vector<StageEvent>& stages = timeline.Stages();
+	long long frontTotal = 0, backTotal = 0;
+	for (size_t i = 0; i < stages.size(); ++i)
+		(stages[i].stage == 1 ? frontTotal : backTotal) += stages[i].end - stages[i].start;
+	printf("Front end %.2f s, back end %.2f s.\n", frontTotal / kImportFrequency, backTotal / kImportFrequency);
+
+	std::stable_sort(jobs.begin(), jobs.end(), [](const CompileJob& lhs, const CompileJob& rhs)
+	{
+		return lhs.end - lhs.start > rhs.end - rhs.start;
+	});
+	if (jobs.size() > topCount)
+		jobs.resize(topCount);
+	if (!jobs.empty())
+		printf("\n%10s %10s %10s  %s\n", "total", "front end", "back end", "file");
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		const CompileJob& job = jobs[i];
+		long long front = job.frontEnd >= 0 ? stages[job.frontEnd].end - stages[job.frontEnd].start : 0;
+		long long back = job.backEnd >= 0 ? stages[job.backEnd].end - stages[job.backEnd].start : 0;
+		printf("%8.3f s %8.3f s %8.3f s  %s\n", (job.end - job.start) / kImportFrequency, front / kImportFrequency,
+		       back / kImportFrequency, timeline.Sources()[job.source].c_str());
+	}
+	return 0;
+}
@@ -0,0 +1,566 @@
+#include "importers.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include "filelist.h"
+
+namespace
+{
+
+// Just enough of a JSON reader to walk a trace without building a tree. It
+// works in place and never allocates. Strings are returned with their escapes
+// left in, which is fine for comparing them with plain names. Any error makes
+// every later call fail.
+class JsonScanner
+{
+public:
+	JsonScanner(const char* data, size_t size) : p_(data), end_(data + size), ok_(true) {}
+
+	bool Ok() const { return ok_; }
+
+	// Skip white space and consume c if it is next.
+	bool Consume(char c)
+	{
+		SkipSpace();
+		if (ok_ && p_ < end_ && *p_ == c)
+		{
+			++p_;
+			return true;
+		}
+		return false;
+	}
+
+	bool Expect(char c)
+	{
+		if (!Consume(c))
+			ok_ = false;
+		return ok_;
+	}
+
+	bool ReadString(TextRef* pText)
+	{
+		if (!Expect('"'))
+			return false;
+		const char* start = p_;
+		if (!SkipStringBody())
+			return false;
+		*pText = TextRef(start, p_ - 1 - start);
+		return true;
+	}
+
+	// Trace times are integers, or have a few decimals, so they are parsed
+	// here and only exponents are left to strtod.
+	bool ReadNumber(double* pValue)
+	{
+		SkipSpace();
+		const char* start = p_;
+		bool negative = p_ < end_ && *p_ == '-';
+		if (negative)
+			++p_;
+		double value = 0;
+		const char* digits = p_;
+		while (p_ < end_ && *p_ >= '0' && *p_ <= '9')
+			value = value * 10 + (*p_++ - '0');
+		if (p_ < end_ && *p_ == '.')
+		{
+			double scale = 0.1;
+			for (++p_; p_ < end_ && *p_ >= '0' && *p_ <= '9'; ++p_, scale *= 0.1)
+				value += (*p_ - '0') * scale;
+		}
+		if (p_ == digits)
+			return ok_ = false;
+		if (p_ < end_ && (*p_ == 'e' || *p_ == 'E'))
+		{
+			char text[64];
+			while (p_ < end_ && strchr("0123456789+-eE.", *p_))
+				++p_;
+			size_t length = std::min(static_cast<size_t>(p_ - start), sizeof(text) - 1);
+			memcpy(text, start, length);
+			text[length] = 0;
+			*pValue = strtod(text, nullptr);
+			return true;
+		}
+		*pValue = negative ? -value : value;
+		return true;
+	}
+
+	// Skip any value. Nested objects and arrays are skipped by counting
+	// brackets, without looking at what is inside them.
+	bool SkipValue()
+	{
+		SkipSpace();
+		if (!ok_ || p_ == end_)
+			return ok_ = false;
+		char c = *p_;
+		if (c == '"')
+		{
+			++p_;
+			return SkipStringBody();
+		}
+		if (c != '{' && c != '[')
+		{
+			// A number, true, false or null.
+			while (p_ < end_ && *p_ != ',' && *p_ != '}' && *p_ != ']' && !IsSpace(*p_))
+				++p_;
+			return true;
+		}
+		int depth = 0;
+		while (p_ < end_)
+		{
+			c = *p_++;
+			if (c == '"')
+			{
+				if (!SkipStringBody())
+					return false;
+			}
+			else if (c == '{' || c == '[')
+				++depth;
+			else if ((c == '}' || c == ']') && --depth == 0)
+				return true;
+		}
+		return ok_ = false;
+	}
+
+private:
+	static bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+	}
+
+	void SkipSpace()
+	{
+		while (p_ < end_ && IsSpace(*p_))
+			++p_;
+	}
+
+	// Called after the opening quote. Leaves p_ after the closing quote.
+	bool SkipStringBody()
+	{
+		for (;;)
+		{
+			const char* quote = static_cast<const char*>(memchr(p_, '"', end_ - p_));
+			if (!quote)
+				return ok_ = false;
+			// The quote is escaped if an odd number of backslashes precede it.
+			const char* slash = quote;
+			while (slash > p_ && slash[-1] == '\\')
+				--slash;
+			p_ = quote + 1;
+			if ((quote - slash) % 2 == 0)
+				return true;
+		}
+	}
+
+	const char* p_;
+	const char* end_;
+	bool ok_;
+};
+
+bool Equals(const TextRef& text, const char* literal)
+{
+	size_t length = strlen(literal);
+	return text.size == length && memcmp(text.data, literal, length) == 0;
+}
+
+void Widen(long long start, long long end, long long* pStart, long long* pEnd)
+{
+	if (*pStart < 0 || start < *pStart)
+		*pStart = start;
+	if (end > *pEnd)
+		*pEnd = end;
+}
+
+// Read one event and widen the matching stage if it is a front end or back
+// end slice.
+bool ParseClangEvent(JsonScanner* pScanner, ImportedCompile* pCompile)
+{
+	JsonScanner& scanner = *pScanner;
+	if (!scanner.Expect('{'))
+		return false;
+	TextRef name, phase;
+	double ts = -1, dur = -1;
+	if (!scanner.Consume('}'))
+	{
+		do
+		{
+			TextRef key;
+			if (!scanner.ReadString(&key) || !scanner.Expect(':'))
+				return false;
+			bool ok;
+			if (Equals(key, "name"))
+				ok = scanner.ReadString(&name);
+			else if (Equals(key, "ph"))
+				ok = scanner.ReadString(&phase);
+			else if (Equals(key, "ts"))
+				ok = scanner.ReadNumber(&ts);
+			else if (Equals(key, "dur"))
+				ok = scanner.ReadNumber(&dur);
+			else
+				ok = scanner.SkipValue();
+			if (!ok)
+				return false;
+		} while (scanner.Consume(','));
+		if (!scanner.Expect('}'))
+			return false;
+	}
+	if (!Equals(phase, "X") || ts < 0 || dur < 0)
+		return true;
+	long long start = static_cast<long long>(ts + 0.5);
+	long long end = static_cast<long long>(ts + dur + 0.5);
+	// Recent versions of clang can split the front end into several slices.
+	if (Equals(name, "Frontend"))
+		Widen(start, end, &pCompile->frontStart, &pCompile->frontEnd);
+	else if (Equals(name, "Backend"))
+		Widen(start, end, &pCompile->backStart, &pCompile->backEnd);
+	return true;
+}
+
+// The number after the first ':' that follows the third '(' before the end
+// of the line: the wall time, in both the old layout ("0.31 (52%) usr 0.10
+// (77%) sys 0.42 (55%) wall") and the new one (columns headed usr sys wall).
+bool GccWallTime(const char* line, const char* end, double* pSeconds)
+{
+	const char* colon = static_cast<const char*>(memchr(line, ':', end - line));
+	if (!colon)
+		return false;
+	const char* p = colon + 1;
+	for (int column = 0; column < 3; ++column)
+	{
+		while (p < end && (*p == ' ' || *p == '\t'))
+			++p;
+		char* numberEnd;
+		double value = strtod(p, &numberEnd);
+		if (numberEnd == p)
+			return false;
+		if (column == 2)
+		{
+			*pSeconds = value;
+			return true;
+		}
+		// Skip the percentage and, in the old layout, the usr or sys label.
+		const char* close = static_cast<const char*>(memchr(numberEnd, ')', end - numberEnd));
+		if (!close)
+			return false;
+		p = close + 1;
+		while (p < end && (*p == ' ' || *p == '\t'))
+			++p;
+		while (p < end && *p >= 'a' && *p <= 'z')
+			++p;
+	}
+	return false;
+}
+
+bool IsGccBackEndPhase(const char* name, size_t length)
+{
+	static const char* const kBackEndPhases[] = { "opt and generate", "last asm", "finalize", "stream in", "stream out" };
+	for (size_t i = 0; i < sizeof(kBackEndPhases) / sizeof(kBackEndPhases[0]); ++i)
+	{
+		size_t phaseLength = strlen(kBackEndPhases[i]);
+		if (length >= phaseLength && memcmp(name, kBackEndPhases[i], phaseLength) == 0)
+			return true;
+	}
+	return false;
+}
+
+// The name a compile is shown under: the trace file name without the
+// format's suffix or an object file extension.
+std::string SourceName(const std::string& path, const std::string& suffix)
+{
+	std::string name = path;
+	if (!suffix.empty() && name.size() > suffix.size() &&
+	    name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+		name.resize(name.size() - suffix.size());
+	static const char* const kObjectExtensions[] = { ".o", ".obj" };
+	for (size_t i = 0; i < sizeof(kObjectExtensions) / sizeof(kObjectExtensions[0]); ++i)
+	{
+		size_t length = strlen(kObjectExtensions[i]);
+		if (name.size() > length && name.compare(name.size() - length, length, kObjectExtensions[i]) == 0)
+		{
+			name.resize(name.size() - length);
+			break;
+		}
+	}
+	return name;
+}
+
+std::string DirectoryPart(const std::string& path)
+{
+	size_t slash = path.find_last_of("\\/");
+	return slash == std::string::npos ? std::string() : path.substr(0, slash);
+}
+
+// What a worker found in one file.
+struct FileResult
+{
+	size_t file;
+	std::vector<ImportedCompile> compiles;
+};
+
+struct WorkerTotals
+{
+	unsigned long long bytes;
+	size_t unreadable;
+	size_t skipped;
+};
+
+void ImportWorker(TimingFormat format, const std::vector<std::string>& files, std::atomic<size_t>* pNext,
+                  std::vector<FileResult>* pResults, WorkerTotals* pTotals)
+{
+	std::vector<char> data;
+	for (;;)
+	{
+		size_t file = (*pNext)++;
+		if (file >= files.size())
+			break;
+		const char* path = files[file].c_str();
+		if (!ReadWholeFile(path, &data))
+		{
+			++pTotals->unreadable;
+			continue;
+		}
+		pTotals->bytes += data.size();
+		FileResult result;
+		result.file = file;
+		if (format == kFormatClangTimeTrace)
+		{
+			ImportedCompile compile;
+			long long beginning;
+			if (ParseClangTimeTrace(data.data(), data.size(), &compile, &beginning))
+			{
+				if (beginning < 0)
+				{
+					// Without a clock, assume the trace was written as the
+					// compile finished.
+					long long written = FileWriteTime(path);
+					long long last = std::max(compile.frontEnd, compile.backEnd);
+					beginning = written >= 0 ? written - last : 0;
+				}
+				if (compile.frontStart >= 0)
+				{
+					compile.frontStart += beginning;
+					compile.frontEnd += beginning;
+				}
+				if (compile.backStart >= 0)
+				{
+					compile.backStart += beginning;
+					compile.backEnd += beginning;
+				}
+				result.compiles.push_back(compile);
+			}
+		}
+		else if (ParseGccTimeReport(data.data(), data.size(), &result.compiles))
+		{
+			long long written = FileWriteTime(path);
+			if (written < 0)
+				written = 0;
+			for (size_t i = 0; i < result.compiles.size(); ++i)
+			{
+				ImportedCompile& compile = result.compiles[i];
+				compile.frontStart += written;
+				compile.frontEnd += written;
+				compile.backStart += written;
+				compile.backEnd += written;
+			}
+		}
+		if (result.compiles.empty())
+			++pTotals->skipped;
+		else
+			pResults->push_back(std::move(result));
+	}
+}
+
+}  // namespace
+
+bool ParseTimingFormat(const char* name, TimingFormat* pFormat)
+{
+	if (strcmp(name, "bt") == 0)
+		*pFormat = kFormatBt;
+	else if (strcmp(name, "clang") == 0)
+		*pFormat = kFormatClangTimeTrace;
+	else if (strcmp(name, "gcc") == 0)
+		*pFormat = kFormatGccTimeReport;
+	else if (strcmp(name, "procs") == 0)
+		*pFormat = kFormatProcessLog;
+	else if (strcmp(name, "events") == 0)
+		*pFormat = kFormatEventLog;
+	else
+		return false;
+	return true;
+}
+
+const char* DefaultTimingSuffix(TimingFormat format)
+{
+	switch (format)
+	{
+	case kFormatClangTimeTrace:
+		return ".json";
+	case kFormatGccTimeReport:
+		return ".ftime-report";
+	default:
+		return "";
+	}
+}
+
+bool ParseClangTimeTrace(const char* data, size_t size, ImportedCompile* pCompile, long long* pBeginning)
+{
+	ImportedCompile& compile = *pCompile;
+	compile.frontStart = compile.frontEnd = compile.backStart = compile.backEnd = -1;
+	*pBeginning = -1;
+	bool sawEvents = false;
+
+	JsonScanner scanner(data, size);
+	if (!scanner.Expect('{'))
+		return false;
+	if (scanner.Consume('}'))
+		return false;
+	do
+	{
+		TextRef key;
+		if (!scanner.ReadString(&key) || !scanner.Expect(':'))
+			return false;
+		if (Equals(key, "traceEvents"))
+		{
+			sawEvents = true;
+			if (!scanner.Expect('['))
+				return false;
+			if (!scanner.Consume(']'))
+			{
+				do
+				{
+					if (!ParseClangEvent(&scanner, &compile))
+						return false;
+				} while (scanner.Consume(','));
+				if (!scanner.Expect(']'))
+					return false;
+			}
+		}
+		else if (Equals(key, "beginningOfTime"))
+		{
+			double beginning;
+			if (!scanner.ReadNumber(&beginning))
+				return false;
+			*pBeginning = static_cast<long long>(beginning);
+		}
+		else if (!scanner.SkipValue())
+			return false;
+	} while (scanner.Consume(','));
+	return scanner.Expect('}') && sawEvents && (compile.frontStart >= 0 || compile.backStart >= 0);
+}
+
+bool ParseGccTimeReport(const char* data, size_t size, std::vector<ImportedCompile>* pCompiles)
+{
+	const char* p = data;
+	const char* end = data + size;
+	double front = 0, back = 0;
+	bool inReport = false;
+	size_t first = pCompiles->size();
+	while (p < end)
+	{
+		const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+		const char* lineEnd = newline ? newline : end;
+		const char* text = p;
+		p = newline ? newline + 1 : end;
+		while (text < lineEnd && (*text == ' ' || *text == '\t'))
+			++text;
+
+		if (lineEnd - text >= 13 && memcmp(text, "Time variable", 13) == 0)
+		{
+			inReport = true;
+			front = back = 0;
+			continue;
+		}
+		if (!inReport)
+			continue;
+		double seconds;
+		if (lineEnd - text >= 6 && memcmp(text, "phase ", 6) == 0)
+		{
+			if (!GccWallTime(text, lineEnd, &seconds))
+				continue;
+			if (IsGccBackEndPhase(text + 6, lineEnd - text - 6))
+				back += seconds;
+			else
+				front += seconds;
+		}
+		else if (lineEnd - text >= 5 && memcmp(text, "TOTAL", 5) == 0)
+		{
+			// Stage times end when the report is written: at 0.
+			long long backLength = static_cast<long long>(back * 1e6 + 0.5);
+			long long frontLength = static_cast<long long>(front * 1e6 + 0.5);
+			ImportedCompile compile;
+			compile.backEnd = 0;
+			compile.backStart = -backLength;
+			compile.frontEnd = compile.backStart;
+			compile.frontStart = compile.frontEnd - frontLength;
+			pCompiles->push_back(compile);
+			inReport = false;
+		}
+	}
+	return pCompiles->size() > first;
+}
+
+bool ImportTimings(TimingFormat format, const std::string& path, const std::string& suffix, unsigned threads,
+                   BuildTimeline* pTimeline, ImportStats* pStats)
+{
+	ImportStats& stats = *pStats;
+	memset(&stats, 0, sizeof(stats));
+	std::vector<std::string> files;
+	if (!FindFiles(path, suffix, &files))
+		return false;
+	stats.files = files.size();
+
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(files.size(), 1)));
+	std::vector<std::vector<FileResult>> results(threads);
+	std::vector<WorkerTotals> totals(threads);
+	memset(totals.data(), 0, totals.size() * sizeof(totals[0]));
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> workers;
+	for (unsigned i = 1; i < threads; ++i)
+		workers.push_back(std::thread(ImportWorker, format, std::cref(files), &next, &results[i], &totals[i]));
+	ImportWorker(format, files, &next, &results[0], &totals[0]);
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+
+	// Merge in file order. Each worker's results are already in order, so
+	// this only has to interleave them.
+	std::vector<FileResult*> ordered;
+	for (unsigned i = 0; i < threads; ++i)
+	{
+		stats.bytes += totals[i].bytes;
+		stats.unreadable += totals[i].unreadable;
+		stats.skipped += totals[i].skipped;
+		for (size_t j = 0; j < results[i].size(); ++j)
+			ordered.push_back(&results[i][j]);
+	}
+	std::sort(ordered.begin(), ordered.end(), [](const FileResult* lhs, const FileResult* rhs)
+	{
+		return lhs->file < rhs->file;
+	});
+
+	std::unordered_map<std::string, int> projectNodes;
+	for (size_t i = 0; i < ordered.size(); ++i)
+	{
+		const std::string& file = files[ordered[i]->file];
+		auto inserted = projectNodes.insert(std::make_pair(DirectoryPart(file), static_cast<int>(projectNodes.size() + 1)));
+		int projectNode = inserted.first->second;
+		std::string source = SourceName(file, suffix);
+		TextRef sourceRef(source.data(), source.size());
+		const std::vector<ImportedCompile>& compiles = ordered[i]->compiles;
+		for (size_t j = 0; j < compiles.size(); ++j)
+		{
+			const ImportedCompile& compile = compiles[j];
+			if (compile.frontStart >= 0)
+				pTimeline->AddStage(1, projectNode, compile.frontStart, compile.frontEnd, sourceRef);
+			if (compile.backStart >= 0)
+				pTimeline->AddStage(2, projectNode, compile.backStart, compile.backEnd, sourceRef);
+			++stats.compiles;
+		}
+	}
+	return true;
+}
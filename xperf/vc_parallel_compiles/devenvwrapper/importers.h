@@ -0,0 +1,90 @@
+// Importers that put clang and gcc compile timings into a BuildTimeline, as
+// the same front end (stage 1) and back end (stage 2) events that /Bt+ gives
+// for VC++, so that every buildtimes mode works on Linux builds too.
+//
+// clang -ftime-trace writes a Chrome trace JSON file per translation unit,
+// next to the object file and named after it. Its "Frontend" and "Backend"
+// events become the two stages, and "beginningOfTime" (clang 11 and later)
+// puts each file on a common clock. Older traces fall back to the time the
+// trace file was written, which is when the compile finished.
+//
+// gcc -ftime-report prints a table to stderr with no file name and no clock,
+// so each report has to be captured to its own file, named after the
+// translation unit, for example with "2> $@.ftime-report" in a makefile.
+// The wall time of the parsing phases is the front end and that of the
+// "opt and generate" and later phases is the back end. They are placed to end
+// at the time the report file was written.
+//
+// Traces are usually found by walking a build directory. The files are read
+// and parsed by a pool of threads, each reusing one buffer and keeping only
+// the few numbers it needs, so tens of thousands of traces take seconds. Only
+// the merge into the timeline is serial, and it is done in file order so the
+// result doesn't depend on the thread count.
+//
+// Stage times are in microseconds since 1970, so the timeline must be created
+// with kImportFrequency. Each directory of trace files is given its own
+// project node, in order of first appearance, which for CMake and most make
+// based builds groups the files of a target together.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "buildmodel.h"
+
+enum TimingFormat
+{
+	kFormatBt,
+	kFormatClangTimeTrace,
+	kFormatGccTimeReport,
+	// A buildwatch process log, read by proclog.h rather than imported here.
+	kFormatProcessLog,
+	// The last build in a binary event log, read by eventlog.h.
+	kFormatEventLog,
+};
+
+// Ticks per second of imported timings.
+const double kImportFrequency = 1e6;
+
+// Parse "bt", "clang", "gcc", "procs" or "events". Returns false for anything else.
+bool ParseTimingFormat(const char* name, TimingFormat* pFormat);
+// The file name suffix that FindFiles looks for with each format.
+const char* DefaultTimingSuffix(TimingFormat format);
+
+// The stages of one compile, in microseconds. A stage that wasn't found has
+// a start of -1.
+struct ImportedCompile
+{
+	long long frontStart;
+	long long frontEnd;
+	long long backStart;
+	long long backEnd;
+};
+
+// Parse a clang -ftime-trace file already in memory. If the trace has no
+// beginningOfTime, times are from the start of the compile and pBeginning is
+// set to -1. Returns false if it isn't a time trace.
+bool ParseClangTimeTrace(const char* data, size_t size, ImportedCompile* pCompile, long long* pBeginning);
+
+// Parse the gcc -ftime-report tables in a file already in memory. Times are
+// relative to the end of each compile, so they are all negative or zero.
+// Returns false if there are none.
+bool ParseGccTimeReport(const char* data, size_t size, std::vector<ImportedCompile>* pCompiles);
+
+struct ImportStats
+{
+	size_t files;
+	unsigned long long bytes;
+	size_t compiles;
+	// Files that couldn't be read, and files that weren't in the format.
+	size_t unreadable;
+	size_t skipped;
+};
+
+// Import the traces at path, a file or a directory that is searched for
+// files ending in suffix. threads of 0 uses one per core. Returns false if
+// path doesn't exist.
+bool ImportTimings(TimingFormat format, const std::string& path, const std::string& suffix, unsigned threads,
+                   BuildTimeline* pTimeline, ImportStats* pStats);
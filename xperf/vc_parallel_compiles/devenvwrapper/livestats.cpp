@@ -0,0 +1,336 @@
+#include "livestats.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+namespace
+{
+
+// Bucket i holds values in (kLowest * gamma^(i-1), kLowest * gamma^i], with
+// gamma = (1 + a) / (1 - a) for a relative accuracy a. Bucket 0 holds
+// everything up to kLowest, and the top one everything above its bound,
+// which at 1536 buckets is around 100 days.
+const double kRelativeAccuracy = 0.01;
+const double kLowest = 1e-6;
+const size_t kBuckets = 1536;
+const double kGamma = (1 + kRelativeAccuracy) / (1 - kRelativeAccuracy);
+const double kLogGamma = log(kGamma);
+
+// Front ends still waiting for their back end. More than the most compiles
+// that run at once.
+const size_t kPendingFronts = 1024;
+
+uint64_t HashSource(int projectNode, const TextRef& source)
+{
+	uint64_t hash = 14695981039346656037ULL ^ static_cast<uint32_t>(projectNode);
+	for (size_t i = 0; i < source.size; ++i)
+	{
+		hash ^= static_cast<unsigned char>(source.data[i]);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+bool SlowerFirst(double lhs, double rhs)
+{
+	return lhs > rhs;
+}
+
+void AppendFormat(std::string* pText, const char* format, double a, double b, double c, double d, double e)
+{
+	char line[200];
+	sprintf(line, format, a, b, c, d, e);
+	*pText += line;
+}
+
+}  // namespace
+
+QuantileSketch::QuantileSketch()
+	: counts_(kBuckets, 0)
+	, count_(0)
+	, sum_(0)
+	, minimum_(0)
+	, maximum_(0)
+{
+}
+
+void QuantileSketch::Add(double value)
+{
+	size_t bucket = 0;
+	if (value > kLowest)
+		bucket = std::min(kBuckets - 1, static_cast<size_t>(ceil(log(value / kLowest) / kLogGamma)));
+	++counts_[bucket];
+	minimum_ = count_ ? std::min(minimum_, value) : value;
+	maximum_ = count_ ? std::max(maximum_, value) : value;
+	++count_;
+	sum_ += value;
+}
+
+double QuantileSketch::Quantile(double q) const
+{
+	if (!count_)
+		return 0;
+	uint64_t rank = static_cast<uint64_t>(std::max(0.0, std::min(q, 1.0)) * (count_ - 1));
+	uint64_t seen = 0;
+	size_t bucket = 0;
+	for (; bucket < kBuckets - 1; ++bucket)
+	{
+		seen += counts_[bucket];
+		if (seen > rank)
+			break;
+	}
+	// The middle of the bucket in relative terms, which is within the
+	// relative accuracy of every value in it.
+	double value = bucket ? kLowest * 2 * pow(kGamma, static_cast<double>(bucket)) / (kGamma + 1) : kLowest;
+	return std::max(minimum_, std::min(value, maximum_));
+}
+
+LiveBuildStats::LiveBuildStats(size_t topCount)
+	: pending_(kPendingFronts)
+	, nextPending_(0)
+	, topCount_(topCount)
+	, compilesAtLastSnapshot_(0)
+	, lastSnapshot_(0)
+{
+	for (size_t i = 0; i < pending_.size(); ++i)
+		pending_[i].seconds = -1;
+}
+
+void LiveBuildStats::AddStage(int stage, int projectNode, const TextRef& source, double seconds)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	uint64_t hash = HashSource(projectNode, source);
+	if (stage == 1)
+	{
+		front_.Add(seconds);
+		PendingFront& entry = pending_[nextPending_];
+		nextPending_ = (nextPending_ + 1) % pending_.size();
+		entry.hash = hash;
+		entry.projectNode = projectNode;
+		entry.source.assign(source.data, source.size);
+		entry.seconds = seconds;
+		return;
+	}
+
+	back_.Add(seconds);
+	// Without a front end, the back end alone is the compile.
+	double front = TakePendingFront(hash, projectNode, source);
+	AddCompile(projectNode, source, std::max(front, 0.0) + seconds);
+}
+
+void LiveBuildStats::EndCompile(int projectNode, const TextRef& source)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	double front = TakePendingFront(HashSource(projectNode, source), projectNode, source);
+	if (front >= 0)
+		AddCompile(projectNode, source, front);
+}
+
+double LiveBuildStats::TakePendingFront(uint64_t hash, int projectNode, const TextRef& source)
+{
+	for (size_t i = 1; i <= pending_.size(); ++i)
+	{
+		PendingFront& entry = pending_[(nextPending_ + pending_.size() - i) % pending_.size()];
+		if (entry.seconds >= 0 && entry.hash == hash && entry.projectNode == projectNode &&
+		    entry.source.size() == source.size && memcmp(entry.source.data(), source.data, source.size) == 0)
+		{
+			double seconds = entry.seconds;
+			entry.seconds = -1;
+			return seconds;
+		}
+	}
+	return -1;
+}
+
+void LiveBuildStats::AddCompile(int projectNode, const TextRef& source, double seconds)
+{
+	compiles_.Add(seconds);
+	auto faster = [](const SlowCompile& lhs, const SlowCompile& rhs) { return SlowerFirst(lhs.seconds, rhs.seconds); };
+	if (slowest_.size() == topCount_)
+	{
+		if (!topCount_ || seconds <= slowest_.front().seconds)
+			return;
+		std::pop_heap(slowest_.begin(), slowest_.end(), faster);
+		slowest_.pop_back();
+	}
+	SlowCompile compile = { seconds, projectNode, source.str() };
+	slowest_.push_back(compile);
+	std::push_heap(slowest_.begin(), slowest_.end(), faster);
+}
+
+void LiveBuildStats::FormatSnapshot(double elapsed, std::string* pText)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	char line[200];
+	sprintf(line, "--- %.0f s into the build: %llu compiles, %llu in the last %.0f s\n", elapsed,
+	         static_cast<unsigned long long>(compiles_.Count()),
+	         static_cast<unsigned long long>(compiles_.Count() - compilesAtLastSnapshot_), elapsed - lastSnapshot_);
+	*pText += line;
+	compilesAtLastSnapshot_ = compiles_.Count();
+	lastSnapshot_ = elapsed;
+	if (!compiles_.Count() && !front_.Count())
+		return;
+
+	sprintf(line, "%-10s %8s %9s %9s %9s %9s %11s\n", "", "count", "median", "90%", "99%", "max", "total");
+	*pText += line;
+	const QuantileSketch* sketches[] = { &front_, &back_, &compiles_ };
+	const char* names[] = { "front end", "back end", "compile" };
+	for (size_t i = 0; i < 3; ++i)
+	{
+		const QuantileSketch& sketch = *sketches[i];
+		sprintf(line, "%-10s %8llu", names[i], static_cast<unsigned long long>(sketch.Count()));
+		*pText += line;
+		AppendFormat(pText, " %7.2f s %7.2f s %7.2f s %7.2f s %9.1f s\n", sketch.Quantile(0.5), sketch.Quantile(0.9),
+		             sketch.Quantile(0.99), sketch.Maximum(), sketch.Sum());
+	}
+
+	std::vector<SlowCompile> slowest = slowest_;
+	std::sort(slowest.begin(), slowest.end(), [](const SlowCompile& lhs, const SlowCompile& rhs)
+	{
+		return SlowerFirst(lhs.seconds, rhs.seconds);
+	});
+	if (!slowest.empty())
+		*pText += "Slowest compiles so far:\n";
+	for (size_t i = 0; i < slowest.size(); ++i)
+	{
+		if (slowest[i].projectNode)
+			sprintf(line, "%8.2f s  %d>", slowest[i].seconds, slowest[i].projectNode);
+		else
+			sprintf(line, "%8.2f s  ", slowest[i].seconds);
+		*pText += line;
+		*pText += slowest[i].source;
+		*pText += '\n';
+	}
+}
+
+StatsPublisher::StatsPublisher()
+	: stopping_(false)
+	, listener_(-1)
+{
+}
+
+StatsPublisher::~StatsPublisher()
+{
+	Stop();
+}
+
+bool StatsPublisher::Listen(const char* path)
+{
+#ifdef _WIN32
+	(void)path;
+	return false;
+#else
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path))
+		return false;
+	strcpy(address.sun_path, path);
+	// Replace a socket left by an earlier run, but nothing else.
+	struct stat status;
+	if (lstat(path, &status) == 0 && S_ISSOCK(status.st_mode))
+		unlink(path);
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0)
+		return false;
+	fcntl(listener, F_SETFD, FD_CLOEXEC);
+	fcntl(listener, F_SETFL, O_NONBLOCK);
+	if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 16) != 0)
+	{
+		close(listener);
+		return false;
+	}
+	listener_ = listener;
+	socketPath_ = path;
+	return true;
+#endif
+}
+
+void StatsPublisher::Start(double interval, const SnapshotFunction& snapshot, const WriteFunction& write)
+{
+	snapshot_ = snapshot;
+	write_ = write;
+	stopping_ = false;
+	auto period = std::chrono::milliseconds(static_cast<long long>(std::max(interval, 0.1) * 1000));
+	thread_ = std::thread([this, period]
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (!wake_.wait_for(lock, period, [this] { return stopping_; }))
+			Publish();
+	});
+}
+
+void StatsPublisher::Stop()
+{
+	if (thread_.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+		wake_.notify_one();
+		thread_.join();
+		Publish();
+	}
+#ifndef _WIN32
+	for (size_t i = 0; i < clients_.size(); ++i)
+		close(clients_[i]);
+	clients_.clear();
+	if (listener_ >= 0)
+	{
+		close(listener_);
+		unlink(socketPath_.c_str());
+		listener_ = -1;
+	}
+#endif
+}
+
+void StatsPublisher::Publish()
+{
+	std::string text;
+	snapshot_(&text);
+#ifndef _WIN32
+	if (listener_ >= 0)
+	{
+		for (;;)
+		{
+			int client = accept(listener_, nullptr, nullptr);
+			if (client < 0)
+				break;
+			fcntl(client, F_SETFD, FD_CLOEXEC);
+			clients_.push_back(client);
+		}
+		// A client that can't take a whole snapshot without blocking is
+		// dropped, so a stalled reader can't hold up the build.
+		for (size_t i = 0; i < clients_.size();)
+		{
+			ssize_t sent = send(clients_[i], text.data(), text.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+			if (sent == static_cast<ssize_t>(text.size()))
+			{
+				++i;
+				continue;
+			}
+			close(clients_[i]);
+			clients_[i] = clients_.back();
+			clients_.pop_back();
+		}
+		return;
+	}
+#endif
+	if (write_)
+		write_(text);
+}
@@ -0,0 +1,138 @@
+// Statistics on the compiles of a build while it runs: the distribution of
+// front end, back end and whole compile times, and the slowest translation
+// units so far. A long build can be watched without waiting for it to end
+// and for the trace to load.
+//
+// Memory use is fixed however many files are compiled. The distributions
+// are DDSketch style quantile sketches: a fixed array of counts in buckets
+// whose bounds grow geometrically by 2%, so any quantile is known to within
+// 1% of its value. The slowest compiles are a min-heap of the top K. A front
+// end waits for its back end in a fixed ring of the most recent ones, which
+// only has to hold as many as run at once.
+//
+// StatsPublisher formats a snapshot every few seconds, on its own thread,
+// and writes it to the console or to every client connected to a Unix domain
+// socket, for example with socat - UNIX-CONNECT:stats.sock.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "btparse.h"
+
+class QuantileSketch
+{
+public:
+	QuantileSketch();
+
+	// Seconds. Values below a microsecond share the lowest bucket.
+	void Add(double value);
+
+	uint64_t Count() const { return count_; }
+	double Sum() const { return sum_; }
+	double Minimum() const { return minimum_; }
+	double Maximum() const { return maximum_; }
+	// q from 0 to 1. Returns 0 if there are no values.
+	double Quantile(double q) const;
+
+private:
+	std::vector<uint32_t> counts_;
+	uint64_t count_;
+	double sum_;
+	double minimum_;
+	double maximum_;
+};
+
+class LiveBuildStats
+{
+public:
+	explicit LiveBuildStats(size_t topCount);
+
+	// Record a stage as it finishes. Safe to call from any thread.
+	void AddStage(int stage, int projectNode, const TextRef& source, double seconds);
+	// Record that the driver of a compile has moved on without running a back
+	// end, as with -S, -fsyntax-only or an integrated assembler. A front end
+	// still waiting for its back end is then the whole compile.
+	void EndCompile(int projectNode, const TextRef& source);
+
+	// Append a text snapshot, labeled with the seconds since the build began.
+	void FormatSnapshot(double elapsed, std::string* pText);
+
+private:
+	struct PendingFront
+	{
+		uint64_t hash;
+		int projectNode;
+		std::string source;
+		double seconds;
+	};
+
+	struct SlowCompile
+	{
+		double seconds;
+		int projectNode;
+		std::string source;
+	};
+
+	// Remove the newest matching front end and return its seconds, or -1 if
+	// there is none.
+	double TakePendingFront(uint64_t hash, int projectNode, const TextRef& source);
+	void AddCompile(int projectNode, const TextRef& source, double seconds);
+
+	std::mutex mutex_;
+	QuantileSketch front_;
+	QuantileSketch back_;
+	QuantileSketch compiles_;
+	// The most recent front ends, as a ring.
+	std::vector<PendingFront> pending_;
+	size_t nextPending_;
+	// A min-heap of the slowest compiles, by seconds.
+	std::vector<SlowCompile> slowest_;
+	size_t topCount_;
+	uint64_t compilesAtLastSnapshot_;
+	double lastSnapshot_;
+};
+
+class StatsPublisher
+{
+public:
+	// Append a snapshot to the text.
+	typedef std::function<void(std::string* pText)> SnapshotFunction;
+	typedef std::function<void(const std::string& text)> WriteFunction;
+
+	StatsPublisher();
+	~StatsPublisher();
+
+	// Send the snapshots to the clients of a Unix domain socket at path,
+	// instead of to the write function. Returns false if it can't be
+	// created, which is always on Windows.
+	bool Listen(const char* path);
+
+	// Publish a snapshot every interval seconds, on a new thread.
+	void Start(double interval, const SnapshotFunction& snapshot, const WriteFunction& write);
+	// Publish a last snapshot and stop the thread.
+	void Stop();
+
+private:
+	StatsPublisher(const StatsPublisher&);
+	StatsPublisher& operator=(const StatsPublisher&);
+
+	void Publish();
+
+	SnapshotFunction snapshot_;
+	WriteFunction write_;
+	std::thread thread_;
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	bool stopping_;
+	int listener_;
+	std::vector<int> clients_;
+	std::string socketPath_;
+};
@@ -0,0 +1,271 @@
+#include "objectcache.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include "filelist.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <direct.h>
+#include <process.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+const char kMagic[8] = { 'C', 'C', 'E', 'N', 'T', 'R', 'Y', '1' };
+const size_t kHeaderSize = 40;
+const char kEntrySuffix[] = ".entry";
+
+uint64_t GetU64(const uint8_t* p)
+{
+	uint64_t value = 0;
+	for (int i = 7; i >= 0; --i)
+		value = (value << 8) | p[i];
+	return value;
+}
+
+void PutU64(std::string* pOut, uint64_t value)
+{
+	for (int i = 0; i < 8; ++i)
+		*pOut += static_cast<char>(value >> (8 * i));
+}
+
+bool MakeDirectory(const std::string& path)
+{
+#ifdef _WIN32
+	int result = _mkdir(path.c_str());
+#else
+	int result = mkdir(path.c_str(), 0777);
+#endif
+	return result == 0 || errno == EEXIST;
+}
+
+bool ReplaceFile(const std::string& from, const std::string& to)
+{
+#ifdef _WIN32
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+// A name for a temporary file that no other process or thread will pick.
+std::string TemporarySuffix()
+{
+	static std::atomic<unsigned> counter(0);
+#ifdef _WIN32
+	int pid = _getpid();
+#else
+	int pid = getpid();
+#endif
+	char suffix[64];
+	sprintf(suffix, ".%d.%u.tmp", pid, counter++);
+	return suffix;
+}
+
+long long FileSize(const std::string& path)
+{
+	FILE* fp = fopen(path.c_str(), "rb");
+	if (!fp)
+		return -1;
+	long long size = -1;
+	if (fseek(fp, 0, SEEK_END) == 0)
+		size = ftell(fp);
+	fclose(fp);
+	return size;
+}
+
+}  // namespace
+
+void EncodeCacheEntry(const CacheEntry& entry, std::string* pData)
+{
+	pData->assign(kMagic, sizeof(kMagic));
+	PutU64(pData, static_cast<uint64_t>(entry.compileMicroseconds));
+	PutU64(pData, entry.object.size());
+	PutU64(pData, entry.depfile.size());
+	PutU64(pData, entry.diagnostics.size());
+	*pData += entry.object;
+	*pData += entry.depfile;
+	*pData += entry.diagnostics;
+}
+
+bool DecodeCacheEntry(const char* data, size_t size, CacheEntry* pEntry)
+{
+	if (size < kHeaderSize || memcmp(data, kMagic, sizeof(kMagic)) != 0)
+		return false;
+	const uint8_t* header = reinterpret_cast<const uint8_t*>(data);
+	uint64_t objectSize = GetU64(header + 16);
+	uint64_t depfileSize = GetU64(header + 24);
+	uint64_t diagnosticsSize = GetU64(header + 32);
+	uint64_t available = size - kHeaderSize;
+	if (objectSize > available || depfileSize > available - objectSize ||
+	    diagnosticsSize != available - objectSize - depfileSize)
+		return false;
+	pEntry->compileMicroseconds = static_cast<long long>(GetU64(header + 8));
+	const char* p = data + kHeaderSize;
+	pEntry->object.assign(p, static_cast<size_t>(objectSize));
+	p += objectSize;
+	pEntry->depfile.assign(p, static_cast<size_t>(depfileSize));
+	p += depfileSize;
+	pEntry->diagnostics.assign(p, static_cast<size_t>(diagnosticsSize));
+	return true;
+}
+
+DirectoryStore::DirectoryStore(const std::string& root)
+	: root_(root)
+{
+}
+
+std::string DirectoryStore::EntryPath(const std::string& key) const
+{
+	return root_ + "/" + key.substr(0, 2) + "/" + key.substr(2) + kEntrySuffix;
+}
+
+bool DirectoryStore::Fetch(const std::string& key, CacheEntry* pEntry)
+{
+	std::vector<char> data;
+	return ReadWholeFile(EntryPath(key).c_str(), &data) && DecodeCacheEntry(data.data(), data.size(), pEntry);
+}
+
+bool DirectoryStore::Publish(const std::string& key, const CacheEntry& entry)
+{
+	if (!MakeDirectories(root_ + "/" + key.substr(0, 2)))
+		return false;
+	std::string path = EntryPath(key);
+	std::string temporary = path + TemporarySuffix();
+	std::string data;
+	EncodeCacheEntry(entry, &data);
+	FILE* fp = fopen(temporary.c_str(), "wb");
+	if (!fp)
+		return false;
+	bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+	ok = fclose(fp) == 0 && ok;
+	if (!ok || !ReplaceFile(temporary, path))
+	{
+		remove(temporary.c_str());
+		return false;
+	}
+	return true;
+}
+
+void DirectoryStore::Measure(uint64_t* pEntries, uint64_t* pBytes) const
+{
+	std::vector<std::string> files;
+	FindFiles(root_, kEntrySuffix, &files);
+	*pEntries = files.size();
+	*pBytes = 0;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		long long size = FileSize(files[i]);
+		if (size > 0)
+			*pBytes += static_cast<uint64_t>(size);
+	}
+}
+
+const char* CacheResultName(CacheResult result)
+{
+	switch (result)
+	{
+	case kCacheMiss:
+		return "miss";
+	case kCacheHit:
+		return "hit";
+	case kCacheRemoteHit:
+		return "remote";
+	default:
+		return "uncacheable";
+	}
+}
+
+std::string CacheStatsPath(const std::string& root)
+{
+	return root + "/stats.tsv";
+}
+
+bool AppendCacheEvent(const std::string& path, const CacheEvent& event)
+{
+	std::string source = event.source;
+	for (size_t i = 0; i < source.size(); ++i)
+	{
+		if (source[i] == '\t' || source[i] == '\n')
+			source[i] = ' ';
+	}
+	char fields[128];
+	sprintf(fields, "%lld\t%s\t%.6f\t%.6f\t", event.time, CacheResultName(event.result), event.seconds, event.saved);
+	std::string line = fields + source + "\n";
+#ifdef _WIN32
+	FILE* fp = fopen(path.c_str(), "ab");
+	if (!fp)
+		return false;
+	bool ok = fwrite(line.data(), 1, line.size(), fp) == line.size();
+	return fclose(fp) == 0 && ok;
+#else
+	int fd = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0666);
+	if (fd < 0)
+		return false;
+	bool ok = write(fd, line.data(), line.size()) == static_cast<ssize_t>(line.size());
+	return close(fd) == 0 && ok;
+#endif
+}
+
+bool ReadCacheEvents(const char* path, std::vector<CacheEvent>* pEvents)
+{
+	std::vector<char> data;
+	if (!ReadWholeFile(path, &data))
+		return false;
+	data.push_back('\0');
+	for (char* line = data.data(); *line;)
+	{
+		char* end = strchr(line, '\n');
+		if (end)
+			*end = '\0';
+		char* fields[5] = {};
+		char* field = line;
+		for (int i = 0; i < 5 && field; ++i)
+		{
+			fields[i] = field;
+			char* tab = i < 4 ? strchr(field, '\t') : nullptr;
+			if (tab)
+				*tab = '\0';
+			field = tab ? tab + 1 : nullptr;
+		}
+		if (fields[4])
+		{
+			CacheEvent event;
+			event.time = atoll(fields[0]);
+			event.result = kCacheUncacheable;
+			for (int result = kCacheMiss; result <= kCacheUncacheable; ++result)
+			{
+				if (strcmp(fields[1], CacheResultName(static_cast<CacheResult>(result))) == 0)
+					event.result = static_cast<CacheResult>(result);
+			}
+			event.seconds = atof(fields[2]);
+			event.saved = atof(fields[3]);
+			event.source = fields[4];
+			pEvents->push_back(event);
+		}
+		if (!end)
+			break;
+		line = end + 1;
+	}
+	return true;
+}
+
+bool MakeDirectories(const std::string& path)
+{
+	// Only the last one matters: the others may exist or, like a drive, not
+	// be creatable.
+	for (size_t slash = path.find_first_of("/\\", 1); slash != std::string::npos;
+	     slash = path.find_first_of("/\\", slash + 1))
+		MakeDirectory(path.substr(0, slash));
+	return MakeDirectory(path);
+}
@@ -0,0 +1,110 @@
+// The store behind compilecache, a ccache style compile cache. An entry holds
+// everything a compile produced, named by a SHA-256 key of everything that
+// went into it: the preprocessed source, the compiler and its arguments.
+//
+// DirectoryStore keeps entries as files sharded by the first two hex digits
+// of the key, root/ab/cdef..., so no directory gets more than 1/256 of them.
+// An entry is written to a temporary file in its shard and renamed into
+// place, so compiles running at once can share a store: a reader sees a whole
+// entry or none, and two writers of the same key write the same bytes. There
+// is no eviction; delete the directory to empty it.
+//
+// Entries are
+//
+//   header       40 bytes: magic, compile microseconds, then the object,
+//                dependency file and diagnostics sizes, all 64 bit little
+//                endian
+//   object       the object file
+//   depfile      the -MF dependency file, if the compile wrote one
+//   diagnostics  what the compiler wrote to stderr, replayed on a hit
+//
+// CacheStore is what a remote backend would implement. compilecache uses a
+// second DirectoryStore, on a shared directory, in its place.
+//
+// Each compile also appends a line to a stats log in the local store: when,
+// whether it hit, how long it took and how long the compile it replaced took,
+// and the source file, so the time the cache saved is known per file.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct CacheEntry
+{
+	CacheEntry() : compileMicroseconds(0) {}
+
+	// How long the compile took, which is what a hit saves.
+	long long compileMicroseconds;
+	std::string object;
+	std::string depfile;
+	std::string diagnostics;
+};
+
+void EncodeCacheEntry(const CacheEntry& entry, std::string* pData);
+// Returns false if the data isn't a whole entry.
+bool DecodeCacheEntry(const char* data, size_t size, CacheEntry* pEntry);
+
+class CacheStore
+{
+public:
+	virtual ~CacheStore() {}
+
+	// Returns false on a miss, including an entry that can't be read.
+	virtual bool Fetch(const std::string& key, CacheEntry* pEntry) = 0;
+	virtual bool Publish(const std::string& key, const CacheEntry& entry) = 0;
+};
+
+class DirectoryStore : public CacheStore
+{
+public:
+	explicit DirectoryStore(const std::string& root);
+
+	bool Fetch(const std::string& key, CacheEntry* pEntry) override;
+	bool Publish(const std::string& key, const CacheEntry& entry) override;
+
+	const std::string& Root() const { return root_; }
+	// The number of entries and their bytes, found by listing every shard.
+	void Measure(uint64_t* pEntries, uint64_t* pBytes) const;
+
+private:
+	std::string EntryPath(const std::string& key) const;
+
+	std::string root_;
+};
+
+enum CacheResult
+{
+	kCacheMiss,
+	kCacheHit,
+	kCacheRemoteHit,
+	// Not a single compile to an object file, so passed straight through.
+	kCacheUncacheable,
+};
+
+const char* CacheResultName(CacheResult result);
+
+struct CacheEvent
+{
+	// Microseconds since 1970.
+	long long time;
+	CacheResult result;
+	// How long compilecache took, and for a hit how long the compile it
+	// replaced took less that.
+	double seconds;
+	double saved;
+	std::string source;
+};
+
+// The stats log in a store's directory.
+std::string CacheStatsPath(const std::string& root);
+// Append one line with a single write, so that compiles running at once
+// don't interleave their lines.
+bool AppendCacheEvent(const std::string& path, const CacheEvent& event);
+bool ReadCacheEvents(const char* path, std::vector<CacheEvent>* pEvents);
+
+// Create a directory and any missing parents.
+bool MakeDirectories(const std::string& path);
@@ -0,0 +1,74 @@
+#include "pipeline.h"
+
+#include <string.h>
+#include <thread>
+#include <vector>
+#include "spscring.h"
+
+OutputPipeline::OutputPipeline(size_t chunkSize, size_t chunkCount)
+	: chunkSize_(chunkSize)
+	, chunkCount_(chunkCount)
+{
+	memset(&stats_, 0, sizeof(stats_));
+}
+
+void OutputPipeline::Run(const ReadFunction& read, const ClockFunction& clock, const ChunkFunction& parse,
+                         const ChunkFunction& echo)
+{
+	memset(&stats_, 0, sizeof(stats_));
+	std::vector<char> storage(chunkSize_ * chunkCount_);
+	std::vector<OutputChunk> chunks(chunkCount_);
+	SpscRing<OutputChunk*> freeChunks(chunkCount_);
+	SpscRing<OutputChunk*> toParse(chunkCount_);
+	SpscRing<OutputChunk*> toEcho(chunkCount_);
+	for (size_t i = 0; i < chunkCount_; ++i)
+	{
+		chunks[i].data = &storage[i * chunkSize_];
+		chunks[i].size = 0;
+		chunks[i].arrival = 0;
+		freeChunks.Push(&chunks[i]);
+	}
+
+	std::thread reader([&]
+	{
+		for (;;)
+		{
+			OutputChunk* chunk = nullptr;
+			if (!freeChunks.TryPop(&chunk))
+			{
+				++stats_.readerStalls;
+				freeChunks.Pop(&chunk);
+			}
+			long long bytesRead = read(chunk->data, chunkSize_);
+			if (bytesRead <= 0)
+				break;
+			chunk->arrival = clock();
+			chunk->size = static_cast<size_t>(bytesRead);
+			++stats_.chunks;
+			stats_.bytes += chunk->size;
+			toParse.Push(chunk);
+		}
+		toParse.Close();
+	});
+	std::thread echoer([&]
+	{
+		OutputChunk* chunk;
+		while (toEcho.Pop(&chunk))
+		{
+			echo(*chunk);
+			freeChunks.Push(chunk);
+		}
+	});
+
+	OutputChunk* chunk;
+	while (toParse.Pop(&chunk))
+	{
+		parse(*chunk);
+		toEcho.Push(chunk);
+	}
+	toEcho.Close();
+	reader.join();
+	echoer.join();
+	stats_.parseHighWater = toParse.HighWater();
+	stats_.echoHighWater = toEcho.HighWater();
+}
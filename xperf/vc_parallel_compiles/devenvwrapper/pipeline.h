@@ -0,0 +1,82 @@
+// Moves a child process's output through three threads so that reading the
+// pipe never waits for parsing or for the console:
+//
+//   reader  reads a chunk, stamps it with the time it arrived, and queues it
+//   parser  parses the chunk, then queues it to be echoed
+//   echo    writes the chunk to the console, then hands it back to the reader
+//
+// The chunks are allocated once and go round in a loop, each hop through its
+// own SpscRing, so there is no locking or allocation per chunk. When a
+// downstream stage falls behind the chunks queue up in front of it. The
+// reader only waits when all of them are in use, and then the pipe buffers
+// the child's output as it did before.
+//
+// The pipeline is portable. The caller supplies the read, the clock and what
+// to do with each chunk.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <functional>
+
+struct OutputChunk
+{
+	char* data;
+	size_t size;
+	// The clock value just after the read returned.
+	long long arrival;
+};
+
+struct PipelineStats
+{
+	unsigned long long chunks;
+	unsigned long long bytes;
+	// Reads that had to wait for a free chunk.
+	unsigned long long readerStalls;
+	// The most chunks that were ever waiting for each stage.
+	size_t parseHighWater;
+	size_t echoHighWater;
+};
+
+// Running totals for a latency, in clock ticks.
+struct LatencyStats
+{
+	LatencyStats() : count(0), total(0), maximum(0) {}
+
+	void Add(long long ticks)
+	{
+		++count;
+		total += ticks;
+		if (ticks > maximum)
+			maximum = ticks;
+	}
+	double Average() const { return count ? double(total) / count : 0.0; }
+
+	unsigned long long count;
+	long long total;
+	long long maximum;
+};
+
+class OutputPipeline
+{
+public:
+	// Returns the number of bytes read, or zero or less at the end.
+	typedef std::function<long long(char* buffer, size_t size)> ReadFunction;
+	typedef std::function<long long()> ClockFunction;
+	typedef std::function<void(const OutputChunk& chunk)> ChunkFunction;
+
+	OutputPipeline(size_t chunkSize, size_t chunkCount);
+
+	// Read until the end, calling parse and then echo for every chunk in
+	// order. read runs on a new thread, parse on the calling thread and echo
+	// on another new thread. Returns when every chunk has been echoed.
+	void Run(const ReadFunction& read, const ClockFunction& clock, const ChunkFunction& parse, const ChunkFunction& echo);
+
+	const PipelineStats& Stats() const { return stats_; }
+
+private:
+	size_t chunkSize_;
+	size_t chunkCount_;
+	PipelineStats stats_;
+};
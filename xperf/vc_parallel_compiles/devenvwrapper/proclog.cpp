@@ -0,0 +1,273 @@
+#include "proclog.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include "filelist.h"
+
+namespace
+{
+
+const char kHeader[] = "# buildwatch process log\tpid\tppid\tstart\texec\tend\tuser\tsys\tpeakrss\tstatus\tcwd\targv";
+
+bool WriteEscaped(FILE* fp, const std::string& text)
+{
+	for (size_t i = 0; i < text.size(); ++i)
+	{
+		char c = text[i];
+		const char* escape = c == '\t' ? "\\t" : c == '\n' ? "\\n" : c == '\\' ? "\\\\" : nullptr;
+		if (escape ? fputs(escape, fp) < 0 : putc(c, fp) == EOF)
+			return false;
+	}
+	return true;
+}
+
+std::string Unescape(const char* text, size_t length)
+{
+	std::string result;
+	result.reserve(length);
+	for (size_t i = 0; i < length; ++i)
+	{
+		if (text[i] == '\\' && i + 1 < length)
+		{
+			char c = text[++i];
+			result += c == 't' ? '\t' : c == 'n' ? '\n' : c;
+		}
+		else
+			result += text[i];
+	}
+	return result;
+}
+
+std::string BaseName(const std::string& path)
+{
+	size_t slash = path.find_last_of('/');
+	return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+bool EndsWith(const std::string& text, const char* suffix)
+{
+	size_t length = strlen(suffix);
+	return text.size() > length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+bool IsSourceName(const std::string& arg)
+{
+	static const char* const kExtensions[] = { ".c", ".cc", ".cp", ".cpp", ".cxx", ".c++", ".C", ".CPP", ".m", ".mm",
+	                                           ".i", ".ii", ".cu", ".s", ".S", ".asm" };
+	for (size_t i = 0; i < sizeof(kExtensions) / sizeof(kExtensions[0]); ++i)
+	{
+		if (EndsWith(arg, kExtensions[i]))
+			return true;
+	}
+	return false;
+}
+
+// Options of gcc's cc1 and clang -cc1 whose value is a separate argument
+// that can look like a source file name.
+bool TakesValue(const std::string& arg)
+{
+	static const char* const kOptions[] = { "-o", "-dumpbase", "-dumpdir", "-dumpbase-ext", "-auxbase", "-auxbase-strip",
+	                                        "-main-file-name", "-include", "-imacros", "-MF", "-MT", "-MQ", "-x",
+	                                        "-dependency-file", "-MD", "-MMD" };
+	for (size_t i = 0; i < sizeof(kOptions) / sizeof(kOptions[0]); ++i)
+	{
+		if (arg == kOptions[i])
+			return true;
+	}
+	return false;
+}
+
+}  // namespace
+
+bool WriteProcessLogHeader(FILE* fp)
+{
+	return fprintf(fp, "%s\n", kHeader) > 0;
+}
+
+bool WriteProcessRecord(FILE* fp, const ProcessRecord& record)
+{
+	if (fprintf(fp, "%d\t%d\t%lld\t%lld\t%lld\t%lld\t%lld\t%lld\t%d\t", record.pid, record.parent, record.start,
+	            record.exec, record.end, record.userTime, record.systemTime, record.peakRss, record.status) < 0)
+		return false;
+	if (!WriteEscaped(fp, record.cwd))
+		return false;
+	for (size_t i = 0; i < record.argv.size(); ++i)
+	{
+		if (putc('\t', fp) == EOF || !WriteEscaped(fp, record.argv[i]))
+			return false;
+	}
+	return putc('\n', fp) != EOF;
+}
+
+bool ReadProcessLog(const char* path, std::vector<ProcessRecord>* pRecords)
+{
+	std::vector<char> data;
+	if (!ReadWholeFile(path, &data))
+		return false;
+	size_t headerLength = strchr(kHeader, '\t') - kHeader;
+	if (data.size() < headerLength || memcmp(data.data(), kHeader, headerLength) != 0)
+		return false;
+	const char* p = data.data();
+	const char* end = p + data.size();
+	while (p < end)
+	{
+		const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+		const char* lineEnd = newline ? newline : end;
+		if (*p != '#' && lineEnd > p)
+		{
+			std::vector<std::string> fields;
+			for (const char* field = p;;)
+			{
+				const char* tab = static_cast<const char*>(memchr(field, '\t', lineEnd - field));
+				const char* fieldEnd = tab ? tab : lineEnd;
+				fields.push_back(Unescape(field, fieldEnd - field));
+				if (!tab)
+					break;
+				field = tab + 1;
+			}
+			if (fields.size() >= 10)
+			{
+				ProcessRecord record;
+				record.pid = atoi(fields[0].c_str());
+				record.parent = atoi(fields[1].c_str());
+				record.start = atoll(fields[2].c_str());
+				record.exec = atoll(fields[3].c_str());
+				record.end = atoll(fields[4].c_str());
+				record.userTime = atoll(fields[5].c_str());
+				record.systemTime = atoll(fields[6].c_str());
+				record.peakRss = atoll(fields[7].c_str());
+				record.status = atoi(fields[8].c_str());
+				record.cwd = fields[9];
+				record.argv.assign(fields.begin() + 10, fields.end());
+				pRecords->push_back(record);
+			}
+		}
+		p = lineEnd + 1;
+	}
+	return true;
+}
+
+int CompilerStage(const ProcessRecord& record)
+{
+	if (record.argv.empty() || record.exec < 0)
+		return 0;
+	std::string name = BaseName(record.argv[0]);
+	if (name == "cc1" || name == "cc1plus" || name == "cc1obj" || name == "cc1objplus")
+		return 1;
+	if (name == "as" || EndsWith(name, "-as"))
+		return 2;
+	if (record.argv.size() > 1 && name.compare(0, 5, "clang") == 0)
+	{
+		if (record.argv[1] == "-cc1")
+			return 1;
+		if (record.argv[1] == "-cc1as")
+			return 2;
+	}
+	return 0;
+}
+
+bool IsClangCompileDriver(const ProcessRecord& record)
+{
+	if (record.argv.size() < 2 || record.exec < 0 || record.argv[1].compare(0, 4, "-cc1") == 0)
+		return false;
+	// clang and clang++, perhaps with a version, but not the other clang
+	// tools.
+	std::string name = BaseName(record.argv[0]);
+	size_t length = name.compare(0, 7, "clang++") == 0 ? 7 : name.compare(0, 5, "clang") == 0 ? 5 : 0;
+	if (!length || (name.size() > length && name.find_first_not_of("-.0123456789", length) != std::string::npos))
+		return false;
+	bool compileOnly = false;
+	for (size_t i = 1; i < record.argv.size(); ++i)
+	{
+		if (record.argv[i] == "-c" || record.argv[i] == "-S")
+			compileOnly = true;
+	}
+	return compileOnly && !CompilerSource(record.argv).empty();
+}
+
+void FindCompilerStages(const std::vector<ProcessRecord>& records, std::vector<int>* pStages)
+{
+	std::vector<int>& stages = *pStages;
+	stages.resize(records.size());
+	std::unordered_set<int> stageParents;
+	for (size_t i = 0; i < records.size(); ++i)
+	{
+		stages[i] = CompilerStage(records[i]);
+		if (stages[i])
+			stageParents.insert(records[i].parent);
+	}
+	for (size_t i = 0; i < records.size(); ++i)
+	{
+		if (!stages[i] && IsClangCompileDriver(records[i]) && !stageParents.count(records[i].pid))
+			stages[i] = 1;
+	}
+}
+
+std::string CompilerSource(const std::vector<std::string>& argv)
+{
+	for (size_t i = 1; i < argv.size(); ++i)
+	{
+		if (TakesValue(argv[i]))
+			++i;
+		else if (argv[i][0] != '-' && IsSourceName(argv[i]))
+			return argv[i];
+	}
+	return std::string();
+}
+
+size_t AddProcessStages(const std::vector<ProcessRecord>& records, BuildTimeline* pTimeline)
+{
+	// The log is in order of exit. Stages are matched up in order of start.
+	std::vector<int> recordStages;
+	FindCompilerStages(records, &recordStages);
+	std::vector<std::pair<const ProcessRecord*, int>> compilers;
+	for (size_t i = 0; i < records.size(); ++i)
+	{
+		if (recordStages[i] && records[i].end >= records[i].exec)
+			compilers.push_back(std::make_pair(&records[i], recordStages[i]));
+	}
+	std::stable_sort(compilers.begin(), compilers.end(),
+	                 [](const std::pair<const ProcessRecord*, int>& lhs, const std::pair<const ProcessRecord*, int>& rhs)
+	{
+		return lhs.first->exec < rhs.first->exec;
+	});
+
+	// The source of the last compiler proper that each driver ran, for its
+	// assembler, which only sees a temporary .s file.
+	std::unordered_map<int, std::string> driverSources;
+	std::unordered_map<std::string, int> projectNodes;
+	size_t stages = 0;
+	for (size_t i = 0; i < compilers.size(); ++i)
+	{
+		const ProcessRecord& record = *compilers[i].first;
+		int stage = compilers[i].second;
+		std::string source;
+		if (stage == 1)
+		{
+			source = CompilerSource(record.argv);
+			driverSources[record.parent] = source;
+		}
+		else
+		{
+			auto found = driverSources.find(record.parent);
+			if (found != driverSources.end())
+			{
+				source = found->second;
+				driverSources.erase(found);
+			}
+			else
+				source = CompilerSource(record.argv);
+		}
+		if (source.empty())
+			continue;
+		if (source[0] != '/' && !record.cwd.empty())
+			source = record.cwd + "/" + source;
+		auto inserted = projectNodes.insert(std::make_pair(record.cwd, static_cast<int>(projectNodes.size() + 1)));
+		pTimeline->AddStage(stage, inserted.first->second, record.exec, record.end, TextRef(source.data(), source.size()));
+		++stages;
+	}
+	return stages;
+}
@@ -0,0 +1,64 @@
+// The process log that buildwatch records: one line per process that ran
+// during a build, with when it started and ended, its command line and what
+// it cost. It is tab separated text so that it can also be read with a
+// spreadsheet or a few lines of script:
+//
+//   pid ppid start exec end user sys peakrss status cwd argv0 argv1 ...
+//
+// Times are microseconds since 1970, CPU times are microseconds and the peak
+// RSS is in KB. exec is -1 for a process that never called exec. status is
+// the exit code, or 128 plus the signal that killed it. Tabs, newlines and
+// backslashes in cwd and argv are escaped as \t, \n and \\.
+//
+// Builds that don't print /Bt+ lines still run compilers, so the compiler
+// processes in the log are turned into the stages of the usual model: the
+// compiler proper (cc1, cc1plus or clang -cc1) is stage 1 and a separate
+// assembler run by the same driver is stage 2. Since clang 10 the driver runs
+// cc1 in its own process by default, so a clang or clang++ driver run with
+// -c or -S on a source file is stage 1 itself, unless it ran a clang -cc1.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "buildmodel.h"
+
+struct ProcessRecord
+{
+	ProcessRecord() : pid(0), parent(0), start(-1), exec(-1), end(-1), userTime(0), systemTime(0), peakRss(0), status(0) {}
+
+	int pid;
+	int parent;
+	long long start;
+	long long exec;
+	long long end;
+	// From wait4, so they include any children the process waited for.
+	long long userTime;
+	long long systemTime;
+	long long peakRss;
+	int status;
+	std::string cwd;
+	std::vector<std::string> argv;
+};
+
+bool WriteProcessLogHeader(FILE* fp);
+bool WriteProcessRecord(FILE* fp, const ProcessRecord& record);
+// Returns false if the file can't be read or isn't a process log.
+bool ReadProcessLog(const char* path, std::vector<ProcessRecord>* pRecords);
+
+// Whether a process is a compiler stage, and which.
+int CompilerStage(const ProcessRecord& record);
+// Whether a process is a clang driver that compiles a source file. It is a
+// compiler stage if it runs no compiler stages of its own.
+bool IsClangCompileDriver(const ProcessRecord& record);
+// The stage of each record of a log, including clang drivers that compiled
+// in process.
+void FindCompilerStages(const std::vector<ProcessRecord>& records, std::vector<int>* pStages);
+// The source file on a compiler command line, or empty.
+std::string CompilerSource(const std::vector<std::string>& argv);
+
+// Add a stage to the timeline, in microseconds, for each compiler process.
+// Each working directory is a project node. Returns the number of stages.
+size_t AddProcessStages(const std::vector<ProcessRecord>& records, BuildTimeline* pTimeline);
@@ -0,0 +1,129 @@
+#include "regression.h"
+
+#include <math.h>
+#include <algorithm>
+#include "historystore.h"
+
+namespace
+{
+
+// The fewest baseline builds that give a usable spread.
+const size_t kMinimumBaseline = 5;
+// 1.4826 x MAD estimates the standard deviation of normal data.
+const double kMadToDeviation = 1.4826;
+const double kRelativeFloor = 0.02;
+const double kAbsoluteFloor = 0.001;
+
+// Reorders values.
+double Median(std::vector<float>* pValues)
+{
+	std::vector<float>& values = *pValues;
+	if (values.empty())
+		return 0;
+	size_t middle = values.size() / 2;
+	std::nth_element(values.begin(), values.begin() + middle, values.end());
+	double median = values[middle];
+	if (values.size() % 2 == 0)
+		median = (median + *std::max_element(values.begin(), values.begin() + middle)) / 2;
+	return median;
+}
+
+// The median of the values that aren't NaN in [first, last).
+double MedianOf(const float* first, const float* last, std::vector<float>* pScratch)
+{
+	pScratch->clear();
+	for (const float* p = first; p != last; ++p)
+	{
+		if (*p == *p)
+			pScratch->push_back(*p);
+	}
+	return Median(pScratch);
+}
+
+}  // namespace
+
+void FindRegressions(const HistoryReader& history, const RegressionOptions& options,
+                     std::vector<Regression>* pRegressions, RegressionStats* pStats)
+{
+	pRegressions->clear();
+	pStats->tested = 0;
+	pStats->added = 0;
+	const uint32_t builds = history.BuildCount();
+	const uint32_t recent = std::min(options.recent, builds);
+	const uint32_t baseline = std::min(options.baseline, builds - recent);
+	const uint32_t first = builds - recent - baseline;
+	const uint32_t window = recent + baseline;
+	const size_t minimumRecent = std::max<size_t>(2, recent / 2);
+	if (recent == 0)
+		return;
+
+	std::vector<float> front(window), back(window), total(window);
+	std::vector<float> before, after, scratch;
+	for (uint32_t file = 0; file < history.FileCount(); ++file)
+	{
+		history.ReadFront(file, first, window, front.data());
+		history.ReadBack(file, first, window, back.data());
+		before.clear();
+		after.clear();
+		for (uint32_t i = 0; i < window; ++i)
+		{
+			bool hasFront = front[i] == front[i];
+			bool hasBack = back[i] == back[i];
+			total[i] = hasFront || hasBack ? (hasFront ? front[i] : 0) + (hasBack ? back[i] : 0) : front[i];
+			if (total[i] == total[i])
+				(i < baseline ? before : after).push_back(total[i]);
+		}
+		if (after.size() < minimumRecent)
+			continue;
+		if (before.size() < kMinimumBaseline)
+		{
+			if (before.empty())
+				++pStats->added;
+			continue;
+		}
+		++pStats->tested;
+
+		double baseMedian = Median(&before);
+		for (size_t i = 0; i < before.size(); ++i)
+			before[i] = static_cast<float>(fabs(before[i] - baseMedian));
+		double scale = std::max(kMadToDeviation * Median(&before), std::max(kRelativeFloor * baseMedian, kAbsoluteFloor));
+		double recentMedian = Median(&after);
+		double change = recentMedian - baseMedian;
+		double score = change / scale;
+		if (score < options.threshold || change < options.minimumSeconds)
+			continue;
+
+		Regression regression;
+		regression.file = file;
+		regression.before = static_cast<float>(baseMedian);
+		regression.after = static_cast<float>(recentMedian);
+		regression.score = score;
+		regression.frontChange = static_cast<float>(MedianOf(&front[baseline], &front[0] + window, &scratch) -
+		                                            MedianOf(&front[0], &front[baseline], &scratch));
+		regression.backChange = static_cast<float>(MedianOf(&back[baseline], &back[0] + window, &scratch) -
+		                                           MedianOf(&back[0], &back[baseline], &scratch));
+		// Walking back from the latest build, count the builds above the
+		// midpoint of the two medians less those below. The count peaks at
+		// the first build of the slow run.
+		double midpoint = (baseMedian + recentMedian) / 2;
+		regression.since = first + baseline;
+		int count = 0;
+		int best = 0;
+		for (uint32_t i = window; i-- > baseline;)
+		{
+			if (total[i] != total[i])
+				continue;
+			count += total[i] > midpoint ? 1 : -1;
+			if (count > best)
+			{
+				best = count;
+				regression.since = first + i;
+			}
+		}
+		pRegressions->push_back(regression);
+	}
+	std::sort(pRegressions->begin(), pRegressions->end(), [](const Regression& lhs, const Regression& rhs)
+	{
+		return lhs.after - lhs.before > rhs.after - rhs.before;
+	});
+}
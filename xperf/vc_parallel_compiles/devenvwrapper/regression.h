@@ -0,0 +1,66 @@
+// Finds the translation units that got slower in the latest builds of a
+// history store, by comparing the recent builds with the ones before them.
+//
+// Compile times are noisy, from machine load to cache state, and have the
+// odd wild outlier, so the test uses medians: a file has regressed if the
+// median of its recent times is more than threshold robust standard
+// deviations above the median of its baseline times. The robust standard
+// deviation is 1.4826 times the median absolute deviation of the baseline,
+// with a floor of 2% of the baseline median so that files with very steady
+// times aren't flagged for tiny changes.
+//
+// Because the baseline is the window just before the recent builds, a file
+// that got slower months ago and stayed slow is not reported again. Each
+// regression also gets the build where it most likely started: the start of
+// the longest run of recent builds that are mostly nearer the new median than
+// the old one, which outliers don't move.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class HistoryReader;
+
+struct RegressionOptions
+{
+	RegressionOptions() : recent(7), baseline(60), threshold(4.0), minimumSeconds(0.05) {}
+
+	// The number of latest builds to test and of builds before them to test
+	// against.
+	uint32_t recent;
+	uint32_t baseline;
+	// In robust standard deviations.
+	double threshold;
+	// Ignore changes smaller than this.
+	double minimumSeconds;
+};
+
+struct Regression
+{
+	uint32_t file;
+	// Median seconds of the baseline and recent builds, front end plus back
+	// end, and how much of the change is in each stage.
+	float before;
+	float after;
+	float frontChange;
+	float backChange;
+	// The shift in robust standard deviations.
+	double score;
+	// The build where the change most likely started.
+	uint32_t since;
+};
+
+struct RegressionStats
+{
+	// Files compiled in enough of both windows to be tested.
+	size_t tested;
+	// Files that only appear in the recent builds.
+	size_t added;
+};
+
+// The regressions are returned biggest change in seconds first.
+void FindRegressions(const HistoryReader& history, const RegressionOptions& options,
+                     std::vector<Regression>* pRegressions, RegressionStats* pStats);
@@ -0,0 +1,29 @@
+// SHA-256, for content addressing: the compile cache (objectcache.h) names
+// each entry by the digest of everything that went into the compile, where a
+// collision would hand back the wrong object file.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+class Sha256
+{
+public:
+	Sha256();
+
+	void Update(const void* data, size_t size);
+	void Update(const std::string& text) { Update(text.data(), text.size()); }
+	// The digest as 64 lowercase hex digits. Update can't be called after.
+	std::string HexDigest();
+
+private:
+	void Block(const uint8_t* p);
+
+	uint32_t state_[8];
+	uint8_t buffer_[64];
+	size_t buffered_;
+	uint64_t length_;
+};
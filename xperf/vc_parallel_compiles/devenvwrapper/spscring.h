@@ -0,0 +1,143 @@
+// A bounded queue between exactly one producer thread and one consumer
+// thread. Pushing and popping are lock free: each side owns one index and
+// only reads the other's. The indices are kept on separate cache lines so
+// that the two threads don't fight over one.
+//
+// The blocking Push and Pop spin briefly and then sleep on a condition
+// variable, so an idle pipeline costs no CPU. The other side only takes the
+// mutex to wake a sleeper, which is rare while data is flowing.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+template <typename T>
+class SpscRing
+{
+public:
+	// The capacity is rounded up to a power of two.
+	explicit SpscRing(size_t capacity)
+		: head_(0)
+		, tail_(0)
+		, closed_(false)
+		, sleepers_(0)
+		, highWater_(0)
+	{
+		size_t size = 1;
+		while (size < capacity)
+			size *= 2;
+		items_.resize(size);
+		mask_ = size - 1;
+	}
+
+	size_t Capacity() const { return items_.size(); }
+
+	// Producer only.
+	bool TryPush(const T& item)
+	{
+		size_t tail = tail_.load(std::memory_order_relaxed);
+		size_t queued = tail - head_.load(std::memory_order_acquire);
+		if (queued == items_.size())
+			return false;
+		items_[tail & mask_] = item;
+		tail_.store(tail + 1);
+		if (queued + 1 > highWater_)
+			highWater_ = queued + 1;
+		Wake();
+		return true;
+	}
+
+	void Push(const T& item)
+	{
+		while (!TryPush(item))
+			Wait([this] { return tail_.load() - head_.load() < items_.size(); });
+	}
+
+	// No more items will be pushed. Producer only.
+	void Close()
+	{
+		closed_.store(true);
+		Wake();
+	}
+
+	// Consumer only.
+	bool TryPop(T* pItem)
+	{
+		size_t head = head_.load(std::memory_order_relaxed);
+		if (head == tail_.load(std::memory_order_acquire))
+			return false;
+		*pItem = items_[head & mask_];
+		head_.store(head + 1);
+		Wake();
+		return true;
+	}
+
+	// Returns false once the ring is closed and empty.
+	bool Pop(T* pItem)
+	{
+		for (;;)
+		{
+			if (TryPop(pItem))
+				return true;
+			if (closed_.load())
+			{
+				// Close comes after the last push, so check once more.
+				return TryPop(pItem);
+			}
+			Wait([this] { return tail_.load() != head_.load() || closed_.load(); });
+		}
+	}
+
+	// The most items that were ever queued at once. Producer only.
+	size_t HighWater() const { return highWater_; }
+
+private:
+	SpscRing(const SpscRing&);
+	SpscRing& operator=(const SpscRing&);
+
+	template <typename Ready>
+	void Wait(Ready ready)
+	{
+		for (int spin = 0; spin < 200; ++spin)
+		{
+			if (ready())
+				return;
+		}
+		std::unique_lock<std::mutex> lock(mutex_);
+		++sleepers_;
+		// The timeout is a backstop. A push or pop after the check above
+		// sees sleepers_ and notifies under the mutex, so it isn't missed.
+		while (!ready())
+			wakeup_.wait_for(lock, std::chrono::milliseconds(50));
+		--sleepers_;
+	}
+
+	void Wake()
+	{
+		if (sleepers_.load() == 0)
+			return;
+		std::lock_guard<std::mutex> lock(mutex_);
+		wakeup_.notify_all();
+	}
+
+	std::vector<T> items_;
+	size_t mask_;
+	char padding0_[64];
+	// Written by the consumer.
+	std::atomic<size_t> head_;
+	char padding1_[64];
+	// Written by the producer.
+	std::atomic<size_t> tail_;
+	char padding2_[64];
+	std::atomic<bool> closed_;
+	std::atomic<int> sleepers_;
+	std::mutex mutex_;
+	std::condition_variable wakeup_;
+	size_t highWater_;
+};
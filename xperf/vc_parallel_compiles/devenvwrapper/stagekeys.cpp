@@ -0,0 +1,83 @@
+#include "stagekeys.h"
+
+#include <string.h>
+
+namespace
+{
+
+const size_t kInitialSlots = 64;
+
+// FNV-1a over the path, seeded with the project node, then mixed so that the
+// low bits used for the slot depend on all of it.
+uint64_t HashKey(int projectNode, const TextRef& path)
+{
+	uint64_t hash = 14695981039346656037ULL ^ static_cast<uint32_t>(projectNode);
+	for (size_t i = 0; i < path.size; ++i)
+	{
+		hash ^= static_cast<unsigned char>(path.data[i]);
+		hash *= 1099511628211ULL;
+	}
+	hash ^= hash >> 29;
+	hash *= 0xbf58476d1ce4e5b9ULL;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+}  // namespace
+
+StageKeyTable::StageKeyTable()
+	: slots_(kInitialSlots, 0)
+{
+}
+
+size_t StageKeyTable::Probe(uint64_t hash, int projectNode, const TextRef& path) const
+{
+	const size_t mask = slots_.size() - 1;
+	for (size_t slot = static_cast<size_t>(hash) & mask;; slot = (slot + 1) & mask)
+	{
+		uint32_t entry = slots_[slot];
+		if (!entry)
+			return slot;
+		const Key& key = keys_[entry - 1];
+		if (key.hash == hash && key.projectNode == projectNode && key.size == path.size &&
+		    memcmp(text_.data() + key.offset, path.data, path.size) == 0)
+			return slot;
+	}
+}
+
+void StageKeyTable::Grow()
+{
+	slots_.assign(slots_.size() * 2, 0);
+	const size_t mask = slots_.size() - 1;
+	for (size_t id = 0; id < keys_.size(); ++id)
+	{
+		size_t slot = static_cast<size_t>(keys_[id].hash) & mask;
+		while (slots_[slot])
+			slot = (slot + 1) & mask;
+		slots_[slot] = static_cast<uint32_t>(id + 1);
+	}
+}
+
+uint32_t StageKeyTable::Intern(int projectNode, const TextRef& path)
+{
+	uint64_t hash = HashKey(projectNode, path);
+	size_t slot = Probe(hash, projectNode, path);
+	if (slots_[slot])
+		return slots_[slot] - 1;
+	if ((keys_.size() + 1) * 2 > slots_.size())
+	{
+		Grow();
+		slot = Probe(hash, projectNode, path);
+	}
+	Key key = { hash, text_.size(), static_cast<uint32_t>(path.size), projectNode };
+	text_.append(path.data, path.size);
+	keys_.push_back(key);
+	slots_[slot] = static_cast<uint32_t>(keys_.size());
+	return static_cast<uint32_t>(keys_.size() - 1);
+}
+
+uint32_t StageKeyTable::Find(int projectNode, const TextRef& path) const
+{
+	uint32_t entry = slots_[Probe(HashKey(projectNode, path), projectNode, path)];
+	return entry ? entry - 1 : kNoStageKey;
+}
@@ -0,0 +1,56 @@
+// Interns the keys that compile stages are matched on: the project node (the
+// N of devenv's "N>" prefix) and the full path of the source file. A bare
+// file name isn't enough. Projects that build at the same time interleave
+// their output, and two projects often have files with the same name, such
+// as stdafx.cpp, so a back end could be matched to another project's front
+// end.
+//
+// Each new key gets the next id from 0, so callers keep their per key data in
+// plain vectors. The table itself is flat: the text of all the paths is in
+// one string, and lookups probe an open addressing array of ids. Nothing is
+// allocated per key beyond amortized vector growth.
+//
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "btparse.h"
+
+const uint32_t kNoStageKey = 0xffffffff;
+
+class StageKeyTable
+{
+public:
+	StageKeyTable();
+
+	// The id of the key, which is added if it is new.
+	uint32_t Intern(int projectNode, const TextRef& path);
+	// The id of the key, or kNoStageKey if it hasn't been added.
+	uint32_t Find(int projectNode, const TextRef& path) const;
+
+	size_t Size() const { return keys_.size(); }
+	int ProjectNode(uint32_t id) const { return keys_[id].projectNode; }
+	TextRef Path(uint32_t id) const { return TextRef(text_.data() + keys_[id].offset, keys_[id].size); }
+
+private:
+	struct Key
+	{
+		uint64_t hash;
+		size_t offset;
+		uint32_t size;
+		int projectNode;
+	};
+
+	// The slot that holds the key, or the empty slot where it would go.
+	size_t Probe(uint64_t hash, int projectNode, const TextRef& path) const;
+	void Grow();
+
+	// Id + 1 of the key in each slot, 0 for empty. The size is a power of
+	// two and at least twice the number of keys.
+	std::vector<uint32_t> slots_;
+	std::vector<Key> keys_;
+	std::string text_;
+};
@@ -0,0 +1,102 @@
+#include "tracejson.h"
+
+#include <string>
+
+namespace
+{
+
+void AppendJsonString(std::string* pOut, const std::string& text)
+{
+	std::string& out = *pOut;
+	out += '"';
+	for (size_t i = 0; i < text.size(); ++i)
+	{
+		unsigned char c = static_cast<unsigned char>(text[i]);
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += static_cast<char>(c);
+		}
+		else if (c < 0x20)
+		{
+			char escape[8];
+			sprintf(escape, "\\u%04x", c);
+			out += escape;
+		}
+		else
+			out += static_cast<char>(c);
+	}
+	out += '"';
+}
+
+std::string FileNamePart(const std::string& path)
+{
+	size_t slash = path.find_last_of("\\/");
+	return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+}  // namespace
+
+bool WriteChromeTrace(const BuildTimeline& timeline, FILE* fp)
+{
+	std::vector<CompileJob> jobs;
+	timeline.BuildJobs(&jobs);
+	uint32_t laneCount = AssignLanes(&jobs);
+	const long long first = timeline.FirstTick();
+	const double microseconds = 1e6 / timeline.Frequency();
+	const std::vector<StageEvent>& stages = timeline.Stages();
+	const std::vector<std::string>& sources = timeline.Sources();
+
+	std::string out;
+	out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	out += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"build\"}}";
+	char text[256];
+	for (uint32_t lane = 0; lane < laneCount; ++lane)
+	{
+		sprintf(text, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"compiler %u\"}}",
+		        lane + 1, lane + 1);
+		out += text;
+		sprintf(text, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"sort_index\":%u}}",
+		        lane + 1, lane + 1);
+		out += text;
+	}
+
+	auto appendSlice = [&](const std::string& name, const char* category, long long start, long long end,
+	                       uint32_t lane, const CompileJob& job)
+	{
+		out += ",\n{\"name\":";
+		AppendJsonString(&out, name);
+		sprintf(text, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"source\":",
+		        category, (start - first) * microseconds, (end - start) * microseconds, lane + 1);
+		out += text;
+		AppendJsonString(&out, sources[job.source]);
+		sprintf(text, ",\"project\":%d}}", job.projectNode);
+		out += text;
+	};
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		const CompileJob& job = jobs[i];
+		appendSlice(FileNamePart(sources[job.source]), "compile", job.start, job.end, job.lane, job);
+		if (job.frontEnd >= 0)
+			appendSlice("front end", "stage1", stages[job.frontEnd].start, stages[job.frontEnd].end, job.lane, job);
+		if (job.backEnd >= 0)
+			appendSlice("back end", "stage2", stages[job.backEnd].start, stages[job.backEnd].end, job.lane, job);
+		if (out.size() > (1 << 20))
+		{
+			if (fwrite(out.data(), 1, out.size(), fp) != out.size())
+				return false;
+			out.clear();
+		}
+	}
+	out += "\n]}\n";
+	return fwrite(out.data(), 1, out.size(), fp) == out.size();
+}
+
+bool WriteChromeTraceFile(const BuildTimeline& timeline, const char* path)
+{
+	FILE* fp = fopen(path, "wb");
+	if (!fp)
+		return false;
+	bool ok = WriteChromeTrace(timeline, fp);
+	return fclose(fp) == 0 && ok;
+}
@@ -0,0 +1,14 @@
+// Export of a BuildTimeline in the Chrome trace event format, which
+// chrome://tracing and ui.perfetto.dev open in any browser. Each compiler
+// lane from AssignLanes becomes a thread. Each compile job is a slice named
+// after its source file, and its front end and back end are slices nested
+// inside it. Times are in microseconds from the first stage of the build.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include "buildmodel.h"
+
+bool WriteChromeTrace(const BuildTimeline& timeline, FILE* fp);
+bool WriteChromeTraceFile(const BuildTimeline& timeline, const char* path);
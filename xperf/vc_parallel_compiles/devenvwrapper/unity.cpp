@@ -0,0 +1,185 @@
+// buildtimes -unity: split the files of a build into unity batches balanced
+// on their measured compile times, and write them as a CMake script that puts
+// each file in its batch with the UNITY_GROUP source property. A target built
+// with UNITY_BUILD_MODE GROUP then compiles each batch as one translation
+// unit.
+//
+// The batches are packed longest first (PackUnityBatches), so with as many
+// batches as cores each core finishes at about the same time. -chunks cuts
+// the files into runs in name order instead, the way unity files are usually
+// formed, to compare against. Either way the longest batch is reported along
+// with the alternative and the lower bound.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "buildanalysis.h"
+#include "buildmodel.h"
+#include "commands.h"
+#include "historystore.h"
+
+namespace
+{
+
+// The seconds of each file, with the files sorted by name. A stage that
+// wasn't seen counts as nothing.
+void FileSeconds(const BuildFileTimes& times, std::vector<std::string>* pFiles, std::vector<double>* pSeconds)
+{
+	std::vector<size_t> order(times.files.size());
+	for (size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&times](size_t lhs, size_t rhs)
+	{
+		return times.files[lhs] < times.files[rhs];
+	});
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		float front = times.front[order[i]];
+		float back = times.back[order[i]];
+		pFiles->push_back(times.files[order[i]]);
+		pSeconds->push_back((front == front ? front : 0.0) + (back == back ? back : 0.0));
+	}
+}
+
+double LongestBatch(const std::vector<UnityBatch>& batches)
+{
+	double longest = 0;
+	for (size_t i = 0; i < batches.size(); ++i)
+		longest = std::max(longest, batches[i].seconds);
+	return longest;
+}
+
+// A CMake quoted argument, with forward slashes.
+std::string CMakePath(const std::string& path)
+{
+	std::string quoted = "\"";
+	for (size_t i = 0; i < path.size(); ++i)
+	{
+		char c = path[i] == '\\' ? '/' : path[i];
+		if (c == '"' || c == '$')
+			quoted += '\\';
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+bool WriteBatches(const char* path, const std::vector<std::string>& files, const std::vector<UnityBatch>& batches,
+                  bool chunks)
+{
+	FILE* fp = fopen(path, "w");
+	if (!fp)
+		return false;
+	fprintf(fp, "# Unity batches from buildtimes -unity, %s on measured compile times.\n",
+	        chunks ? "chunked in name order" : "packed longest first");
+	for (size_t i = 0; i < batches.size(); ++i)
+	{
+		fprintf(fp, "# Batch %u: %u files, %.3f s.\n", static_cast<unsigned>(i),
+		        static_cast<unsigned>(batches[i].files.size()), batches[i].seconds);
+		for (size_t j = 0; j < batches[i].files.size(); ++j)
+		{
+			fprintf(fp, "set_source_files_properties(%s PROPERTIES UNITY_GROUP batch%u)\n",
+			        CMakePath(files[batches[i].files[j]]).c_str(), static_cast<unsigned>(i));
+		}
+	}
+	return fclose(fp) == 0;
+}
+
+}  // namespace
+
+int UnityMain(int argc, char* argv[])
+{
+	TimelineOptions options;
+	uint32_t batchCount = 4;
+	const char* match = nullptr;
+	bool chunks = false;
+	bool ok = true;
+	int arg = 0;
+	for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] && ok; ++arg)
+	{
+		if (ParseTimelineOption(&arg, argc, argv, &options, &ok))
+			continue;
+		if (strcmp(argv[arg], "-chunks") == 0)
+			chunks = true;
+		else if (arg + 1 >= argc)
+			ok = false;
+		else if (strcmp(argv[arg], "-batches") == 0)
+			batchCount = static_cast<uint32_t>(atoi(argv[++arg]));
+		else if (strcmp(argv[arg], "-match") == 0)
+			match = argv[++arg];
+		else
+			ok = false;
+	}
+	if (!ok || batchCount == 0 || argc - arg != 2)
+	{
+		printf("usage: buildtimes -unity [-batches n] [-chunks] [-match text] %s <log|-|dir> <out.cmake>\n",
+		       kTimelineUsage);
+		printf("  Splits the compiled files, or those whose paths contain the -match text, into\n");
+		printf("  n unity batches (default 4) balanced on their compile times, and writes a\n");
+		printf("  CMake script that sets their UNITY_GROUP properties. -chunks cuts them into\n");
+		printf("  runs in name order instead.\n");
+		return 1;
+	}
+
+	std::unique_ptr<BuildTimeline> timeline = LoadTimeline(options, argv[arg]);
+	if (!timeline)
+		return 1;
+	BuildFileTimes times;
+	SumFileTimes(*timeline, &times);
+	std::vector<std::string> files;
+	std::vector<double> seconds;
+	FileSeconds(times, &files, &seconds);
+	if (match)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < files.size(); ++i)
+		{
+			if (!strstr(files[i].c_str(), match))
+				continue;
+			files[kept] = files[i];
+			seconds[kept] = seconds[i];
+			++kept;
+		}
+		files.resize(kept);
+		seconds.resize(kept);
+	}
+	if (files.empty())
+	{
+		printf("No files match %s.\n", match);
+		return 1;
+	}
+
+	std::vector<UnityBatch> packed, chunked;
+	PackUnityBatches(seconds, batchCount, &packed);
+	ChunkUnityBatches(seconds, batchCount, &chunked);
+	const std::vector<UnityBatch>& batches = chunks ? chunked : packed;
+	if (!WriteBatches(argv[arg + 1], files, batches, chunks))
+	{
+		printf("Couldn't write %s\n", argv[arg + 1]);
+		return 1;
+	}
+
+	double total = 0;
+	double slowest = 0;
+	for (size_t i = 0; i < seconds.size(); ++i)
+	{
+		total += seconds[i];
+		slowest = std::max(slowest, seconds[i]);
+	}
+	printf("Wrote %u batches of %u files, %.3f s of compiling, to %s.\n", static_cast<unsigned>(batches.size()),
+	       static_cast<unsigned>(files.size()), total, argv[arg + 1]);
+	printf("%10s %6s  %s\n", "seconds", "files", "first file");
+	for (size_t i = 0; i < batches.size(); ++i)
+	{
+		printf("%8.3f s %6u  %s\n", batches[i].seconds, static_cast<unsigned>(batches[i].files.size()),
+		       files[batches[i].files.front()].c_str());
+	}
+	printf("Longest batch: %.3f s packed longest first, %.3f s chunked in name order, and no split can beat\n",
+	       LongestBatch(packed), LongestBatch(chunked));
+	printf("%.3f s. A batch can take less than its files did when they share headers or templates.\n",
+	       std::max(slowest, total / batches.size()));
+	return 0;
+}
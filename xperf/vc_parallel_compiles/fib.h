@@ -8,10 +8,18 @@
 // times ranging from ~1.0 s to ~40 s. FibNMedium
 // should probably be used for most cases.
 
+#ifdef _MSC_VER
 const int FibNFast = 28; // ~1.0 s
 const int FibNMedium = 29; // ~1.6 s
 const int FibNSlow = 30; // ~2.3 s
 const int FibNVerySlow = 31; // ~3.8 s
+#else
+// With gcc 12 at -O2.
+const int FibNFast = 29; // ~0.7 s
+const int FibNMedium = 30; // ~1.5 s
+const int FibNSlow = 31; // ~2.3 s
+const int FibNVerySlow = 32; // ~2.9 s
+#endif
 
 constexpr int const_fib(int n)
 {
@@ -31,10 +39,20 @@ constexpr int const_fib(int n)
 // times ranging from ~1.0 s to ~13 s. FibNMedium
 // should probably be used for most cases.
 
+#ifdef _MSC_VER
 const int FibNFast = 17;
 const int FibNMedium = 18;
 const int FibNSlow = 19;
 const int FibNVerySlow = 20;
+#else
+// gcc and clang create these types much faster than VC++ 2013, so they need
+// more of them. With gcc 12 at -O2. Keep N below 25 so that the TreePos
+// ranges of CALC_FIB1 to CALC_FIB6 don't overlap.
+const int FibNFast = 21; // ~0.7 s
+const int FibNMedium = 22; // ~1.0 s
+const int FibNSlow = 23; // ~2.1 s
+const int FibNVerySlow = 24; // ~3.5 s
+#endif
 
 // This is a template metaprogramming Fibonacci template with
 // anti-optimization measures. TreePos is a number
@@ -0,0 +1,221 @@
+// Each inclusion of this file declares the same functions again and then,
+// until KERNEL_INCLUDE_DEPTH levels deep, includes itself twice, so a
+// translation unit opens and parses it 2^KERNEL_INCLUDE_DEPTH - 1 times.
+// It has no include guard on purpose. The depth is tracked by defining
+// KERNEL_INCLUDE_1 to KERNEL_INCLUDE_n on the way in and undefining the
+// deepest on the way out, since the preprocessor can't count.
+//
+// VC++ 2013 stops at 10 levels of includes and gcc at 200. Up to 24 are
+// supported here.
+
+#if !defined(KERNEL_INCLUDE_1)
+#define KERNEL_INCLUDE_1
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 1
+#elif !defined(KERNEL_INCLUDE_2)
+#define KERNEL_INCLUDE_2
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 2
+#elif !defined(KERNEL_INCLUDE_3)
+#define KERNEL_INCLUDE_3
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 3
+#elif !defined(KERNEL_INCLUDE_4)
+#define KERNEL_INCLUDE_4
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 4
+#elif !defined(KERNEL_INCLUDE_5)
+#define KERNEL_INCLUDE_5
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 5
+#elif !defined(KERNEL_INCLUDE_6)
+#define KERNEL_INCLUDE_6
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 6
+#elif !defined(KERNEL_INCLUDE_7)
+#define KERNEL_INCLUDE_7
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 7
+#elif !defined(KERNEL_INCLUDE_8)
+#define KERNEL_INCLUDE_8
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 8
+#elif !defined(KERNEL_INCLUDE_9)
+#define KERNEL_INCLUDE_9
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 9
+#elif !defined(KERNEL_INCLUDE_10)
+#define KERNEL_INCLUDE_10
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 10
+#elif !defined(KERNEL_INCLUDE_11)
+#define KERNEL_INCLUDE_11
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 11
+#elif !defined(KERNEL_INCLUDE_12)
+#define KERNEL_INCLUDE_12
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 12
+#elif !defined(KERNEL_INCLUDE_13)
+#define KERNEL_INCLUDE_13
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 13
+#elif !defined(KERNEL_INCLUDE_14)
+#define KERNEL_INCLUDE_14
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 14
+#elif !defined(KERNEL_INCLUDE_15)
+#define KERNEL_INCLUDE_15
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 15
+#elif !defined(KERNEL_INCLUDE_16)
+#define KERNEL_INCLUDE_16
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 16
+#elif !defined(KERNEL_INCLUDE_17)
+#define KERNEL_INCLUDE_17
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 17
+#elif !defined(KERNEL_INCLUDE_18)
+#define KERNEL_INCLUDE_18
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 18
+#elif !defined(KERNEL_INCLUDE_19)
+#define KERNEL_INCLUDE_19
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 19
+#elif !defined(KERNEL_INCLUDE_20)
+#define KERNEL_INCLUDE_20
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 20
+#elif !defined(KERNEL_INCLUDE_21)
+#define KERNEL_INCLUDE_21
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 21
+#elif !defined(KERNEL_INCLUDE_22)
+#define KERNEL_INCLUDE_22
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 22
+#elif !defined(KERNEL_INCLUDE_23)
+#define KERNEL_INCLUDE_23
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 23
+#elif !defined(KERNEL_INCLUDE_24)
+#define KERNEL_INCLUDE_24
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 24
+#else
+#error kernel_includes.h is nested more than 24 deep
+#endif
+
+int KernelIncluded(int);
+int KernelIncluded(int value);
+int KernelIncluded(int, int);
+int KernelIncluded(int first, int second);
+template <int N> int KernelIncludedTemplate(int);
+template <int N> int KernelIncludedTemplate(int value);
+struct KernelIncludedStruct;
+extern int g_kernelIncluded;
+
+#if KERNEL_INCLUDE_LEVEL < KERNEL_INCLUDE_DEPTH
+#include "kernel_includes.h"
+#include "kernel_includes.h"
+#endif
+
+#if defined(KERNEL_INCLUDE_24)
+#undef KERNEL_INCLUDE_24
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 23
+#elif defined(KERNEL_INCLUDE_23)
+#undef KERNEL_INCLUDE_23
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 22
+#elif defined(KERNEL_INCLUDE_22)
+#undef KERNEL_INCLUDE_22
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 21
+#elif defined(KERNEL_INCLUDE_21)
+#undef KERNEL_INCLUDE_21
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 20
+#elif defined(KERNEL_INCLUDE_20)
+#undef KERNEL_INCLUDE_20
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 19
+#elif defined(KERNEL_INCLUDE_19)
+#undef KERNEL_INCLUDE_19
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 18
+#elif defined(KERNEL_INCLUDE_18)
+#undef KERNEL_INCLUDE_18
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 17
+#elif defined(KERNEL_INCLUDE_17)
+#undef KERNEL_INCLUDE_17
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 16
+#elif defined(KERNEL_INCLUDE_16)
+#undef KERNEL_INCLUDE_16
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 15
+#elif defined(KERNEL_INCLUDE_15)
+#undef KERNEL_INCLUDE_15
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 14
+#elif defined(KERNEL_INCLUDE_14)
+#undef KERNEL_INCLUDE_14
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 13
+#elif defined(KERNEL_INCLUDE_13)
+#undef KERNEL_INCLUDE_13
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 12
+#elif defined(KERNEL_INCLUDE_12)
+#undef KERNEL_INCLUDE_12
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 11
+#elif defined(KERNEL_INCLUDE_11)
+#undef KERNEL_INCLUDE_11
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 10
+#elif defined(KERNEL_INCLUDE_10)
+#undef KERNEL_INCLUDE_10
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 9
+#elif defined(KERNEL_INCLUDE_9)
+#undef KERNEL_INCLUDE_9
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 8
+#elif defined(KERNEL_INCLUDE_8)
+#undef KERNEL_INCLUDE_8
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 7
+#elif defined(KERNEL_INCLUDE_7)
+#undef KERNEL_INCLUDE_7
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 6
+#elif defined(KERNEL_INCLUDE_6)
+#undef KERNEL_INCLUDE_6
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 5
+#elif defined(KERNEL_INCLUDE_5)
+#undef KERNEL_INCLUDE_5
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 4
+#elif defined(KERNEL_INCLUDE_4)
+#undef KERNEL_INCLUDE_4
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 3
+#elif defined(KERNEL_INCLUDE_3)
+#undef KERNEL_INCLUDE_3
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 2
+#elif defined(KERNEL_INCLUDE_2)
+#undef KERNEL_INCLUDE_2
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 1
+#elif defined(KERNEL_INCLUDE_1)
+#undef KERNEL_INCLUDE_1
+#undef KERNEL_INCLUDE_LEVEL
+#define KERNEL_INCLUDE_LEVEL 0
+#endif
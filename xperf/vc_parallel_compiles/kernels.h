@@ -0,0 +1,291 @@
+#ifndef KERNELS_INCLUDE_H
+#define	KERNELS_INCLUDE_H
+
+// Compile cost kernels. fib.h makes compiles slow by instantiating templates
+// or evaluating constexpr calls, but real code is slow for other reasons too.
+// Each kernel here isolates one of them, behind the same CALC_FIB1 to
+// CALC_FIB6 macros, so that the same projects show which compiler phase
+// gains from parallel compiles and which doesn't. Define one of these, or
+// set COMPILE_PARALLEL_KERNEL in CMakeLists.txt, to pick a kernel:
+//
+//   USE_KERNEL_PACK            front end: variadic packs thousands wide
+//   USE_KERNEL_OVERLOAD        front end: overload resolution over hundreds
+//                              of candidates ranked by derived to base
+//                              conversions
+//   USE_KERNEL_SFINAE          front end: enable_if candidates whose traits
+//                              fail to substitute
+//   USE_KERNEL_INCLUDES        preprocessor: a deep tree of includes, once
+//                              per translation unit
+//   USE_KERNEL_CONSTEXPR_LOOP  front end: loops in constexpr functions, which
+//                              need C++14
+//   USE_KERNEL_INLINE          back end: thousands of small functions inlined
+//                              into one and optimized; little cost without
+//                              optimization
+//
+// With none of them fib.h is used, with or without USE_CONST_EXPR. As there,
+// each CALC_FIBn does its own work, so a file that uses several pays for each,
+// except with USE_KERNEL_INCLUDES. The constants give about a second each with
+// gcc 12 at -O2.
+
+#if defined(USE_KERNEL_PACK) || defined(USE_KERNEL_OVERLOAD) || defined(USE_KERNEL_SFINAE)
+
+// The integers 0 to N - 1 as a pack. Built by halves, so that the
+// instantiation depth is log N.
+template <int... I>
+struct KernelInts_t {};
+
+template <typename Lhs, typename Rhs>
+struct KernelConcat_t;
+
+template <int... Lhs, int... Rhs>
+struct KernelConcat_t<KernelInts_t<Lhs...>, KernelInts_t<Rhs...> > {
+	typedef KernelInts_t<Lhs..., (sizeof...(Lhs) + Rhs)...> type;
+};
+
+template <int N>
+struct KernelSeq_t {
+	typedef typename KernelConcat_t<typename KernelSeq_t<N / 2>::type,
+		typename KernelSeq_t<N - N / 2>::type>::type type;
+};
+
+template <>
+struct KernelSeq_t<0> {
+	typedef KernelInts_t<> type;
+};
+
+template <>
+struct KernelSeq_t<1> {
+	typedef KernelInts_t<0> type;
+};
+
+#endif
+
+#if defined(USE_KERNEL_PACK)
+
+const int PackNMedium = 700; // ~1.0 s
+
+// Each row takes the whole pack as arguments, so N rows make the compiler
+// copy, hash and compare N^2 template arguments. sizeof makes it instantiate
+// each row.
+template <int Tag, int Row, int... Columns>
+struct PackRow_t {
+	enum { value = Row };
+};
+
+template <int Tag, typename Seq>
+struct PackWide_t;
+
+template <int Tag, int... I>
+struct PackWide_t<Tag, KernelInts_t<I...> > {
+	enum { value = sizeof(KernelInts_t<sizeof(PackRow_t<Tag, I, I...>)...>) };
+};
+
+#define CALC_FIB1 PackWide_t<1, KernelSeq_t<PackNMedium>::type>::value
+#define CALC_FIB2 PackWide_t<2, KernelSeq_t<PackNMedium>::type>::value
+#define CALC_FIB3 PackWide_t<3, KernelSeq_t<PackNMedium>::type>::value
+#define CALC_FIB4 PackWide_t<4, KernelSeq_t<PackNMedium>::type>::value
+#define CALC_FIB5 PackWide_t<5, KernelSeq_t<PackNMedium>::type>::value
+#define CALC_FIB6 PackWide_t<6, KernelSeq_t<PackNMedium>::type>::value
+
+#elif defined(USE_KERNEL_OVERLOAD)
+
+// Below the default template depth of 900.
+const int OverloadNMedium = 240; // ~1.0 s
+
+// OverloadRank_t<Tag, N> derives from OverloadRank_t<Tag, N - 1>, and
+// OverloadSet_t<Tag, N>::pick has an overload for each of them. A call with
+// OverloadRank_t<Tag, I> can use any of the first I + 1, so the compiler
+// ranks them all by how far each base is from the argument. There is a call
+// for each I.
+template <int Tag, int N>
+struct OverloadRank_t : OverloadRank_t<Tag, N - 1> {};
+
+template <int Tag>
+struct OverloadRank_t<Tag, 0> {};
+
+template <int Tag, int N>
+struct OverloadSet_t : OverloadSet_t<Tag, N - 1> {
+	using OverloadSet_t<Tag, N - 1>::pick;
+	static char (&pick(OverloadRank_t<Tag, N>))[N + 1];
+};
+
+template <int Tag>
+struct OverloadSet_t<Tag, 0> {
+	static char (&pick(OverloadRank_t<Tag, 0>))[1];
+};
+
+template <int Tag, typename Seq>
+struct OverloadCalls_t;
+
+template <int Tag, int... I>
+struct OverloadCalls_t<Tag, KernelInts_t<I...> > {
+	enum { value = sizeof(KernelInts_t<sizeof(OverloadSet_t<Tag, sizeof...(I)>::pick(OverloadRank_t<Tag, I>()))...>) };
+};
+
+#define CALC_FIB1 OverloadCalls_t<1, KernelSeq_t<OverloadNMedium>::type>::value
+#define CALC_FIB2 OverloadCalls_t<2, KernelSeq_t<OverloadNMedium>::type>::value
+#define CALC_FIB3 OverloadCalls_t<3, KernelSeq_t<OverloadNMedium>::type>::value
+#define CALC_FIB4 OverloadCalls_t<4, KernelSeq_t<OverloadNMedium>::type>::value
+#define CALC_FIB5 OverloadCalls_t<5, KernelSeq_t<OverloadNMedium>::type>::value
+#define CALC_FIB6 OverloadCalls_t<6, KernelSeq_t<OverloadNMedium>::type>::value
+
+#elif defined(USE_KERNEL_SFINAE)
+
+// Below the default template depth of 900.
+const int SfinaeNMedium = 120; // ~1.0 s
+
+template <bool Condition, typename T>
+struct KernelEnableIf_t {};
+
+template <typename T>
+struct KernelEnableIf_t<true, T> {
+	typedef T type;
+};
+
+template <typename T, int K>
+struct SfinaeTrait_t {
+	enum { value = T::value == K };
+};
+
+template <int Tag, int N>
+struct SfinaeProbe_t {
+	enum { value = N };
+};
+
+// SfinaeSet_t<Tag, N>::pick is N + 1 function templates, each enabled for
+// one probe type only. A call makes the compiler deduce each of them,
+// instantiate its trait for the argument and drop all but one, and there is
+// a call for each probe, so N^2 traits and substitution failures.
+template <int Tag, int N>
+struct SfinaeSet_t : SfinaeSet_t<Tag, N - 1> {
+	using SfinaeSet_t<Tag, N - 1>::pick;
+	template <typename T>
+	static typename KernelEnableIf_t<SfinaeTrait_t<T, N>::value, char (&)[N + 1]>::type pick(T);
+};
+
+template <int Tag>
+struct SfinaeSet_t<Tag, 0> {
+	template <typename T>
+	static typename KernelEnableIf_t<SfinaeTrait_t<T, 0>::value, char (&)[1]>::type pick(T);
+};
+
+template <int Tag, typename Seq>
+struct SfinaeCalls_t;
+
+template <int Tag, int... I>
+struct SfinaeCalls_t<Tag, KernelInts_t<I...> > {
+	enum { value = sizeof(KernelInts_t<sizeof(SfinaeSet_t<Tag, sizeof...(I)>::pick(SfinaeProbe_t<Tag, I>()))...>) };
+};
+
+#define CALC_FIB1 SfinaeCalls_t<1, KernelSeq_t<SfinaeNMedium>::type>::value
+#define CALC_FIB2 SfinaeCalls_t<2, KernelSeq_t<SfinaeNMedium>::type>::value
+#define CALC_FIB3 SfinaeCalls_t<3, KernelSeq_t<SfinaeNMedium>::type>::value
+#define CALC_FIB4 SfinaeCalls_t<4, KernelSeq_t<SfinaeNMedium>::type>::value
+#define CALC_FIB5 SfinaeCalls_t<5, KernelSeq_t<SfinaeNMedium>::type>::value
+#define CALC_FIB6 SfinaeCalls_t<6, KernelSeq_t<SfinaeNMedium>::type>::value
+
+#elif defined(USE_KERNEL_INCLUDES)
+
+// A preprocessor constant, as kernel_includes.h compares against it. VC++
+// 2013 can't go past 9.
+#ifndef KERNEL_INCLUDE_DEPTH
+#define KERNEL_INCLUDE_DEPTH 12 // ~1.0 s
+#endif
+
+// Included here, so with a precompiled header the cost moves into the
+// compile that creates it, which is the point of a precompiled header.
+#include "kernel_includes.h"
+
+#define CALC_FIB1 ((1 << KERNEL_INCLUDE_DEPTH) - 1)
+#define CALC_FIB2 ((1 << KERNEL_INCLUDE_DEPTH) - 1)
+#define CALC_FIB3 ((1 << KERNEL_INCLUDE_DEPTH) - 1)
+#define CALC_FIB4 ((1 << KERNEL_INCLUDE_DEPTH) - 1)
+#define CALC_FIB5 ((1 << KERNEL_INCLUDE_DEPTH) - 1)
+#define CALC_FIB6 ((1 << KERNEL_INCLUDE_DEPTH) - 1)
+
+#elif defined(USE_KERNEL_CONSTEXPR_LOOP)
+
+// In thousands of iterations.
+const int LoopNMedium = 600; // ~1.0 s
+
+// A linear congruential generator run for n thousand steps. gcc allows
+// 2^18 iterations per loop, so each loop runs for a thousand or less. Unlike
+// const_fib the calls can't be cached, as there are only a few of them and
+// the work is in the loops. KernelValue_t makes the value a constant even
+// where the compiler could leave it to run time.
+constexpr int const_loop(unsigned seed, int thousands)
+{
+	for (int i = 0; i < thousands; ++i)
+	{
+		for (int j = 0; j < 1000; ++j)
+			seed = seed * 1103515245u + 12345u;
+	}
+	return static_cast<int>(seed >> 1);
+}
+
+template <int Value>
+struct KernelValue_t {
+	enum { value = Value };
+};
+
+#define CALC_FIB1 KernelValue_t<const_loop(1, LoopNMedium)>::value
+#define CALC_FIB2 KernelValue_t<const_loop(2, LoopNMedium)>::value
+#define CALC_FIB3 KernelValue_t<const_loop(3, LoopNMedium)>::value
+#define CALC_FIB4 KernelValue_t<const_loop(4, LoopNMedium)>::value
+#define CALC_FIB5 KernelValue_t<const_loop(5, LoopNMedium)>::value
+#define CALC_FIB6 KernelValue_t<const_loop(6, LoopNMedium)>::value
+
+#elif defined(USE_KERNEL_INLINE)
+
+const int InlineNMedium = 240; // ~1.0 s
+
+#ifdef _MSC_VER
+#define KERNEL_INLINE __forceinline
+#else
+#define KERNEL_INLINE inline __attribute__((always_inline))
+#endif
+
+// Count small steps, each with a branch, called through a tree of forced
+// inline functions so that they all end up in the function that uses
+// CALC_FIBn, where the optimizer works on all of them at once. The input is
+// volatile so that none of it can be folded away. The front end only has
+// about 2 * Count functions to instantiate.
+template <int Tag, int First, int Count>
+struct InlineTree_t {
+	static KERNEL_INLINE unsigned Run(unsigned x)
+	{
+		return InlineTree_t<Tag, First + Count / 2, Count - Count / 2>::Run(
+			InlineTree_t<Tag, First, Count / 2>::Run(x));
+	}
+};
+
+template <int Tag, int First>
+struct InlineTree_t<Tag, First, 1> {
+	static KERNEL_INLINE unsigned Run(unsigned x)
+	{
+		x ^= x >> (First % 13 + 3);
+		x *= 2654435761u + 2 * First;
+		if (x & (1u << (First % 31)))
+			x += First + Tag;
+		else
+			x -= Tag;
+		return x;
+	}
+};
+
+static volatile unsigned s_kernelInput = 1;
+
+#define CALC_FIB1 static_cast<int>(InlineTree_t<1, 0, InlineNMedium>::Run(s_kernelInput))
+#define CALC_FIB2 static_cast<int>(InlineTree_t<2, 0, InlineNMedium>::Run(s_kernelInput))
+#define CALC_FIB3 static_cast<int>(InlineTree_t<3, 0, InlineNMedium>::Run(s_kernelInput))
+#define CALC_FIB4 static_cast<int>(InlineTree_t<4, 0, InlineNMedium>::Run(s_kernelInput))
+#define CALC_FIB5 static_cast<int>(InlineTree_t<5, 0, InlineNMedium>::Run(s_kernelInput))
+#define CALC_FIB6 static_cast<int>(InlineTree_t<6, 0, InlineNMedium>::Run(s_kernelInput))
+
+#else
+
+#include "fib.h"
+
+#endif
+
+#endif
@@ -4,11 +4,23 @@
 
 #if _MSC_FULL_VER >= 180021114
 #pragma message("Compiling with VS 2013 November CTP or higher with constexpr support.")
-#else
+#elif defined(_MSC_VER)
 #pragma message("Compiling with VS 2013 without constexpr support.")
 #endif
 
-#ifdef USE_CONST_EXPR
+#if defined(USE_KERNEL_PACK)
+#pragma message("Using wide variadic packs to make compiles slow.")
+#elif defined(USE_KERNEL_OVERLOAD)
+#pragma message("Using overload resolution to make compiles slow.")
+#elif defined(USE_KERNEL_SFINAE)
+#pragma message("Using SFINAE to make compiles slow.")
+#elif defined(USE_KERNEL_INCLUDES)
+#pragma message("Using deep includes to make compiles slow.")
+#elif defined(USE_KERNEL_CONSTEXPR_LOOP)
+#pragma message("Using constexpr loops to make compiles slow.")
+#elif defined(USE_KERNEL_INLINE)
+#pragma message("Using inlining to make compiles slow.")
+#elif defined(USE_CONST_EXPR)
 #pragma message("Using constexpr to make compiles slow.")
 #else
 #pragma message("Using templates to make compiles slow.")
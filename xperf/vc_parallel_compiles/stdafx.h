@@ -8,6 +8,9 @@
 // VS 2013 CTP -- includes support for constexpr
 #define USE_CONST_EXPR
 #endif
+// gcc and clang support both methods, so CMakeLists.txt defines
+// USE_CONST_EXPR when COMPILE_PARALLEL_CONSTEXPR is on.
+// kernels.h uses fib.h unless a USE_KERNEL_ macro picks another kernel.
 
 #include <stdio.h>
-#include "fib.h"
+#include "kernels.h"
@@ -0,0 +1,489 @@
+// Generates a synthetic code base for build scaling experiments: any number
+// of translation units whose compile costs follow a chosen distribution,
+// sharing headers through a random include graph, with a CMakeLists.txt that
+// builds them all.
+//
+// A file's cost is made of the slow compile kernels of fib.h. A template
+// kernel FibSlow_t<TreePos, N> creates about fib(N) types, and a constexpr
+// kernel const_fib(N) makes about as many calls, so each N costs about phi
+// times the one below it. A unit of cost is one kernel at -template-n or
+// -constexpr-n, and a file's cost is split into kernels largest first. The
+// defaults make a unit about 0.07 s with gcc 12 at -O2. Each file uses one
+// kind of kernel, chosen at random with the -constexpr fraction.
+//
+// Costs are drawn from the distribution and then scaled so that their mean
+// is -mean units. -dist lognormal takes -skew as sigma, so 0 gives every file
+// the same cost and 2 puts over a third of the cost in the slowest 1% of files,
+// the long tail of a large real code base. -dist pareto takes -skew as alpha,
+// where smaller is heavier tailed.
+//
+// Headers form a random DAG: each includes -fanout of the headers before it.
+// A file includes -includes headers, picked with a Zipf distribution so that
+// a few headers are included nearly everywhere. Headers have no kernels, just
+// -header-lines lines of declarations, so they cost what parsing them costs.
+//
+// The output directory gets src/, include/ (with a copy of fib.h), main.cpp,
+// CMakeLists.txt and costs.tsv, which lists the nominal cost, kernels and
+// header count of each file. The same options and seed give the same files.
+//
+
+#include <errno.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#ifndef FIB_H_PATH
+#define FIB_H_PATH "../fib.h"
+#endif
+
+namespace
+{
+
+const double kPhi = 1.6180339887498949;
+// FibSlow_t kernels in the same file are kept apart by TreePos, which has six
+// bits above the 25 that a kernel uses, so a file can have 64 of them.
+const size_t kMaxKernels = 64;
+const int kMaxTemplateN = 24;
+const int kMaxConstexprN = 40;
+
+enum CostDistribution
+{
+	kDistEqual,
+	kDistLognormal,
+	kDistPareto,
+};
+
+struct Options
+{
+	Options();
+
+	unsigned files;
+	unsigned headers;
+	unsigned includes;
+	unsigned fanout;
+	unsigned headerLines;
+	CostDistribution dist;
+	double skew;
+	double mean;
+	double constexprFraction;
+	int templateN;
+	int constexprN;
+	unsigned seed;
+	const char* fibPath;
+	const char* outDir;
+};
+
+Options::Options()
+	: files(100)
+	, headers(0)
+	, includes(8)
+	, fanout(3)
+	, headerLines(200)
+	, dist(kDistLognormal)
+	, skew(1.0)
+	, mean(10.0)
+	, constexprFraction(0.0)
+	, templateN(16)
+	, constexprN(23)
+	, seed(1)
+	, fibPath(FIB_H_PATH)
+	, outDir(nullptr)
+{
+}
+
+struct SourceFile
+{
+	bool useConstexpr;
+	// The N of each kernel, largest first.
+	std::vector<int> kernels;
+	std::vector<unsigned> includes;
+	double units;
+	unsigned headerCount;
+};
+
+bool MakeDirectory(const std::string& path)
+{
+#ifdef _WIN32
+	int result = _mkdir(path.c_str());
+#else
+	int result = mkdir(path.c_str(), 0777);
+#endif
+	return result == 0 || errno == EEXIST;
+}
+
+bool ReadFile(const char* path, std::string* pText)
+{
+	FILE* fp = fopen(path, "rb");
+	if (!fp)
+		return false;
+	char buffer[4096];
+	size_t count;
+	while ((count = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+		pText->append(buffer, count);
+	fclose(fp);
+	return true;
+}
+
+bool WriteFile(const std::string& path, const std::string& text)
+{
+	FILE* fp = fopen(path.c_str(), "wb");
+	if (!fp)
+		return false;
+	bool ok = fwrite(text.data(), 1, text.size(), fp) == text.size();
+	return fclose(fp) == 0 && ok;
+}
+
+void AppendFormat(std::string* pText, const char* format, ...)
+{
+	char line[512];
+	va_list args;
+	va_start(args, format);
+	vsprintf(line, format, args);
+	va_end(args);
+	*pText += line;
+}
+
+std::vector<double> DrawCosts(const Options& options, std::mt19937* pRandom)
+{
+	std::vector<double> costs(options.files, 1.0);
+	if (options.dist == kDistLognormal && options.skew > 0)
+	{
+		std::lognormal_distribution<double> lognormal(0.0, options.skew);
+		for (size_t i = 0; i < costs.size(); ++i)
+			costs[i] = lognormal(*pRandom);
+	}
+	else if (options.dist == kDistPareto)
+	{
+		// Inverse transform: u^(-1/alpha) for u uniform in (0, 1].
+		std::uniform_real_distribution<double> uniform(0.0, 1.0);
+		for (size_t i = 0; i < costs.size(); ++i)
+			costs[i] = pow(1.0 - uniform(*pRandom), -1.0 / options.skew);
+	}
+	double sum = 0;
+	for (size_t i = 0; i < costs.size(); ++i)
+		sum += costs[i];
+	for (size_t i = 0; i < costs.size(); ++i)
+		costs[i] *= options.mean * costs.size() / sum;
+	return costs;
+}
+
+// Split a cost into kernels, largest first, and return the cost that they
+// add up to. A remainder under half a unit is dropped.
+double SplitCost(double units, int baseN, int maxN, std::vector<int>* pKernels)
+{
+	double total = 0;
+	double remaining = units;
+	while (remaining >= 0.5 && pKernels->size() < kMaxKernels)
+	{
+		int n = baseN;
+		while (n < maxN && pow(kPhi, n + 1 - baseN) <= remaining)
+			++n;
+		double cost = pow(kPhi, n - baseN);
+		pKernels->push_back(n);
+		total += cost;
+		remaining -= cost;
+	}
+	return total;
+}
+
+// Pick count distinct headers, the lower numbered ones more often.
+void PickIncludes(unsigned count, const std::vector<double>& weights, std::mt19937* pRandom,
+                  std::vector<unsigned>* pIncludes)
+{
+	if (count >= weights.size())
+	{
+		for (unsigned i = 0; i < weights.size(); ++i)
+			pIncludes->push_back(i);
+		return;
+	}
+	std::discrete_distribution<unsigned> pick(weights.begin(), weights.end());
+	std::vector<char> chosen(weights.size(), 0);
+	while (pIncludes->size() < count)
+	{
+		unsigned header = pick(*pRandom);
+		if (chosen[header])
+			continue;
+		chosen[header] = 1;
+		pIncludes->push_back(header);
+	}
+	std::sort(pIncludes->begin(), pIncludes->end());
+}
+
+unsigned CountHeaders(const std::vector<unsigned>& includes, const std::vector<std::vector<unsigned> >& headerIncludes,
+                      std::vector<unsigned>* pVisited, unsigned mark)
+{
+	unsigned count = 0;
+	std::vector<unsigned> stack(includes);
+	while (!stack.empty())
+	{
+		unsigned header = stack.back();
+		stack.pop_back();
+		if ((*pVisited)[header] == mark)
+			continue;
+		(*pVisited)[header] = mark;
+		++count;
+		stack.insert(stack.end(), headerIncludes[header].begin(), headerIncludes[header].end());
+	}
+	return count;
+}
+
+std::string HeaderName(unsigned header)
+{
+	char name[32];
+	sprintf(name, "h%05u.h", header);
+	return name;
+}
+
+std::string SourceName(unsigned file)
+{
+	char name[32];
+	sprintf(name, "tu%05u.cpp", file);
+	return name;
+}
+
+std::string HeaderText(unsigned header, const std::vector<unsigned>& includes, unsigned lines)
+{
+	std::string text = "// Generated by gencodebase.\n#pragma once\n";
+	for (size_t i = 0; i < includes.size(); ++i)
+		AppendFormat(&text, "#include \"%s\"\n", HeaderName(includes[i]).c_str());
+	text += "\n";
+	for (unsigned i = 0; i < lines / 2; ++i)
+	{
+		AppendFormat(&text, "struct h%05u_t%u { int a; int b; int Sum() const { return a * %u + b; } };\n", header, i,
+		             i + 1);
+		AppendFormat(&text, "inline int h%05u_f%u(int x) { return h%05u_t%u{ x, %u }.Sum(); }\n", header, i, header,
+		             i, i);
+	}
+	return text;
+}
+
+std::string SourceText(unsigned file, const SourceFile& source)
+{
+	std::string text;
+	AppendFormat(&text, "// Generated by gencodebase: %.1f units of %s kernels.\n", source.units,
+	             source.useConstexpr ? "constexpr" : "template");
+	for (size_t i = 0; i < source.includes.size(); ++i)
+		AppendFormat(&text, "#include \"%s\"\n", HeaderName(source.includes[i]).c_str());
+	if (source.useConstexpr)
+		text += "#define USE_CONST_EXPR\n";
+	text += "#include \"fib.h\"\n\n";
+	AppendFormat(&text, "int tu%05u_values[] = {\n", file);
+	for (size_t i = 0; i < source.kernels.size(); ++i)
+	{
+		if (source.useConstexpr)
+			AppendFormat(&text, "\tconst_fib(%d),\n", source.kernels[i]);
+		else
+			AppendFormat(&text, "\tFibSlow_t<(%u << 25), %d>::value,\n", static_cast<unsigned>(i), source.kernels[i]);
+	}
+	if (source.kernels.empty())
+		text += "\t0,\n";
+	text += "};\n";
+	return text;
+}
+
+std::string CMakeText(const Options& options)
+{
+	static const char* const distNames[] = { "equal", "lognormal", "pareto" };
+	std::string text;
+	AppendFormat(&text, "# Generated by gencodebase: %u files and %u headers, %s costs with skew %g and a mean of %g "
+	             "units.\n", options.files, options.headers, distNames[options.dist], options.skew, options.mean);
+	text += "cmake_minimum_required(VERSION 3.16)\n"
+	        "project(Synthetic CXX)\n"
+	        "\n"
+	        "set(CMAKE_CXX_STANDARD 11)\n"
+	        "set(CMAKE_CXX_STANDARD_REQUIRED ON)\n"
+	        "if(NOT CMAKE_BUILD_TYPE)\n"
+	        "  set(CMAKE_BUILD_TYPE Release)\n"
+	        "endif()\n"
+	        "if(CMAKE_CXX_COMPILER_ID MATCHES \"Clang\")\n"
+	        "  # clang doesn't cache constexpr calls, so const_fib takes millions of steps.\n"
+	        "  add_compile_options(-fconstexpr-steps=1000000000)\n"
+	        "endif()\n"
+	        "\n"
+	        "add_executable(synthetic main.cpp\n";
+	for (unsigned file = 0; file < options.files; ++file)
+		AppendFormat(&text, "  src/%s\n", SourceName(file).c_str());
+	text += ")\n"
+	        "target_include_directories(synthetic PRIVATE include)\n";
+	return text;
+}
+
+bool ParseOptions(int argc, char* argv[], Options* pOptions)
+{
+	int arg = 1;
+	for (; arg < argc && argv[arg][0] == '-'; ++arg)
+	{
+		const char* option = argv[arg];
+		if (arg + 1 >= argc)
+			return false;
+		const char* value = argv[++arg];
+		if (strcmp(option, "-files") == 0)
+			pOptions->files = static_cast<unsigned>(atoi(value));
+		else if (strcmp(option, "-headers") == 0)
+			pOptions->headers = static_cast<unsigned>(atoi(value));
+		else if (strcmp(option, "-includes") == 0)
+			pOptions->includes = static_cast<unsigned>(atoi(value));
+		else if (strcmp(option, "-fanout") == 0)
+			pOptions->fanout = static_cast<unsigned>(atoi(value));
+		else if (strcmp(option, "-header-lines") == 0)
+			pOptions->headerLines = static_cast<unsigned>(atoi(value));
+		else if (strcmp(option, "-dist") == 0)
+		{
+			if (strcmp(value, "equal") == 0)
+				pOptions->dist = kDistEqual;
+			else if (strcmp(value, "lognormal") == 0)
+				pOptions->dist = kDistLognormal;
+			else if (strcmp(value, "pareto") == 0)
+				pOptions->dist = kDistPareto;
+			else
+				return false;
+		}
+		else if (strcmp(option, "-skew") == 0)
+			pOptions->skew = atof(value);
+		else if (strcmp(option, "-mean") == 0)
+			pOptions->mean = atof(value);
+		else if (strcmp(option, "-constexpr") == 0)
+			pOptions->constexprFraction = atof(value);
+		else if (strcmp(option, "-template-n") == 0)
+			pOptions->templateN = atoi(value);
+		else if (strcmp(option, "-constexpr-n") == 0)
+			pOptions->constexprN = atoi(value);
+		else if (strcmp(option, "-seed") == 0)
+			pOptions->seed = static_cast<unsigned>(atoi(value));
+		else if (strcmp(option, "-fib") == 0)
+			pOptions->fibPath = value;
+		else
+			return false;
+	}
+	if (argc - arg != 1)
+		return false;
+	pOptions->outDir = argv[arg];
+	if (!pOptions->headers)
+		pOptions->headers = std::max(1u, pOptions->files / 10);
+	return pOptions->files > 0 && pOptions->mean >= 0 && pOptions->constexprFraction >= 0 &&
+	       pOptions->constexprFraction <= 1 && pOptions->templateN >= 3 && pOptions->templateN <= kMaxTemplateN &&
+	       pOptions->constexprN >= 3 && pOptions->constexprN <= kMaxConstexprN &&
+	       (pOptions->dist != kDistPareto || pOptions->skew > 0) && pOptions->skew >= 0;
+}
+
+void PrintUsage()
+{
+	printf("usage: gencodebase [-files n] [-headers n] [-includes n] [-fanout n] [-header-lines n]\n");
+	printf("                   [-dist equal|lognormal|pareto] [-skew s] [-mean units] [-constexpr fraction]\n");
+	printf("                   [-template-n n] [-constexpr-n n] [-seed n] [-fib fib.h] <outdir>\n");
+	printf("  Writes a code base of n translation units whose compile costs follow the\n");
+	printf("  distribution, made of the kernels of fib.h. -skew is sigma for lognormal\n");
+	printf("  (default 1) and alpha for pareto. A unit is a FibSlow_t kernel of\n");
+	printf("  -template-n (default 16) or a const_fib kernel of -constexpr-n (default 23).\n");
+	printf("  There are n / 10 headers by default, and each file includes 8 of them.\n");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	if (!ParseOptions(argc, argv, &options))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::string fib;
+	if (!ReadFile(options.fibPath, &fib))
+	{
+		printf("Couldn't read %s. Use -fib to say where fib.h is.\n", options.fibPath);
+		return 1;
+	}
+	std::string out = options.outDir;
+	if (!MakeDirectory(out) || !MakeDirectory(out + "/src") || !MakeDirectory(out + "/include"))
+	{
+		printf("Couldn't create %s\n", options.outDir);
+		return 1;
+	}
+
+	std::mt19937 random(options.seed);
+	std::vector<std::vector<unsigned> > headerIncludes(options.headers);
+	for (unsigned header = 1; header < options.headers; ++header)
+	{
+		std::vector<double> earlier(header, 1.0);
+		PickIncludes(options.fanout, earlier, &random, &headerIncludes[header]);
+	}
+	std::vector<double> popularity(options.headers);
+	for (size_t i = 0; i < popularity.size(); ++i)
+		popularity[i] = 1.0 / (i + 1);
+
+	std::vector<double> costs = DrawCosts(options, &random);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+	std::vector<SourceFile> sources(options.files);
+	std::vector<unsigned> visited(options.headers, 0);
+	unsigned truncated = 0;
+	for (unsigned file = 0; file < options.files; ++file)
+	{
+		SourceFile& source = sources[file];
+		source.useConstexpr = uniform(random) < options.constexprFraction;
+		if (source.useConstexpr)
+			source.units = SplitCost(costs[file], options.constexprN, kMaxConstexprN, &source.kernels);
+		else
+			source.units = SplitCost(costs[file], options.templateN, kMaxTemplateN, &source.kernels);
+		if (source.units + 0.5 < costs[file])
+			++truncated;
+		PickIncludes(options.includes, popularity, &random, &source.includes);
+		source.headerCount = CountHeaders(source.includes, headerIncludes, &visited, file + 1);
+	}
+
+	bool ok = WriteFile(out + "/include/fib.h", fib);
+	for (unsigned header = 0; header < options.headers && ok; ++header)
+		ok = WriteFile(out + "/include/" + HeaderName(header), HeaderText(header, headerIncludes[header], options.headerLines));
+	for (unsigned file = 0; file < options.files && ok; ++file)
+		ok = WriteFile(out + "/src/" + SourceName(file), SourceText(file, sources[file]));
+	ok = ok && WriteFile(out + "/main.cpp", "int main()\n{\n\treturn 0;\n}\n");
+	ok = ok && WriteFile(out + "/CMakeLists.txt", CMakeText(options));
+
+	std::string manifest = "file\tkind\tunits\tkernels\theaders\n";
+	for (unsigned file = 0; file < options.files; ++file)
+	{
+		const SourceFile& source = sources[file];
+		AppendFormat(&manifest, "src/%s\t%s\t%.2f\t%u\t%u\n", SourceName(file).c_str(),
+		             source.useConstexpr ? "constexpr" : "template", source.units,
+		             static_cast<unsigned>(source.kernels.size()), source.headerCount);
+	}
+	ok = ok && WriteFile(out + "/costs.tsv", manifest);
+	if (!ok)
+	{
+		printf("Couldn't write the files in %s\n", options.outDir);
+		return 1;
+	}
+
+	std::vector<double> units(options.files);
+	double total = 0;
+	for (unsigned file = 0; file < options.files; ++file)
+	{
+		units[file] = sources[file].units;
+		total += units[file];
+	}
+	std::sort(units.begin(), units.end(), [](double lhs, double rhs) { return lhs > rhs; });
+	size_t topCount = std::max<size_t>(1, units.size() / 100);
+	double top = 0;
+	for (size_t i = 0; i < topCount; ++i)
+		top += units[i];
+	printf("Wrote %u files and %u headers to %s: %.0f units, the slowest file %.1f units,\n", options.files,
+	       options.headers, options.outDir, total, units[0]);
+	printf("the slowest %u files %.0f%% of the cost.\n", static_cast<unsigned>(topCount),
+	       total > 0 ? 100 * top / total : 0.0);
+	if (truncated)
+		printf("%u files were cut to %u kernels.\n", truncated, static_cast<unsigned>(kMaxKernels));
+	return 0;
+}
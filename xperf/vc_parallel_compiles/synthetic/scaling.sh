@@ -0,0 +1,88 @@
+#!/bin/bash
+# Scaling curves of build time against the number of translation units, the
+# -j level and the skew of the compile costs. For each file count and skew,
+# gencodebase writes a code base, which is then built at each -j level under
+# buildwatch (devenvwrapper/buildwatch.cpp).
+#
+# The results go to the output directory:
+#   curves.csv    files, skew, -j, nominal units, wall seconds, compile
+#                 seconds, the average number of compiles running, the
+#                 slowest compile, the bound and bound / wall
+#   <run>.tsv     the buildwatch process log of each build, for
+#                 buildtimes -analyze -format procs
+#   <run>.log     its output
+#   tree-*        the generated code bases, with costs.tsv
+#
+# The bound is the shortest wall time any schedule of the measured compiles
+# could have on that many cores: the larger of the compile time divided by -j
+# and the slowest compile. bound / wall near 1 means the build scaled as well
+# as its compiles allowed, and a slowest compile near the bound means that
+# the tail, not the core count, limits it.
+
+usage()
+{
+	echo "Usage: $0 [-files \"100 400 1600\"] [-j \"1 2 4 8\"] [-skew \"0 1 2\"] [-gen \"gencodebase options\"] [outdir]"
+	exit 1
+}
+
+here=$(cd "$(dirname "$0")" && pwd)
+files="100 400 1600"
+jobs="1 2 4 8"
+skews="0 1 2"
+gen="-mean 2"
+out=
+while [ $# -gt 0 ]; do
+	case "$1" in
+	-files) [ $# -ge 2 ] || usage; files=$2; shift 2 ;;
+	-j) [ $# -ge 2 ] || usage; jobs=$2; shift 2 ;;
+	-skew) [ $# -ge 2 ] || usage; skews=$2; shift 2 ;;
+	-gen) [ $# -ge 2 ] || usage; gen=$2; shift 2 ;;
+	-*) usage ;;
+	*) [ -z "$out" ] || usage; out=$1; shift ;;
+	esac
+done
+out=$(mkdir -p "${out:-scaling-results}" && cd "${out:-scaling-results}" && pwd) || exit 1
+
+generator="Unix Makefiles"
+if command -v ninja > /dev/null; then
+	generator=Ninja
+fi
+
+# The generator and the timing tools.
+tools=$out/tools
+cmake -S "$here" -B "$tools/gencodebase" -G "$generator" > /dev/null && cmake --build "$tools/gencodebase" > /dev/null || exit 1
+cmake -S "$here/../devenvwrapper" -B "$tools/devenvwrapper" -G "$generator" > /dev/null &&
+	cmake --build "$tools/devenvwrapper" --target buildwatch > /dev/null || exit 1
+gencodebase=$tools/gencodebase/gencodebase
+buildwatch=$tools/devenvwrapper/buildwatch
+
+echo "files,skew,jobs,units,wall,compile,parallelism,slowest,bound,efficiency" > "$out/curves.csv"
+for count in $files; do
+	for skew in $skews; do
+		tree=$out/tree-f$count-s$skew
+		$gencodebase -files $count -skew $skew $gen "$tree" > /dev/null || exit 1
+		units=$(awk -F'\t' 'NR > 1 { total += $3 } END { printf "%.0f", total }' "$tree/costs.tsv")
+		cmake -S "$tree" -B "$tree/build" -G "$generator" > /dev/null || exit 1
+		for j in $jobs; do
+			run=f$count-s$skew-j$j
+			cmake --build "$tree/build" --target clean > /dev/null
+			"$buildwatch" -log "$out/$run.tsv" -top 1 cmake --build "$tree/build" -j $j > "$out/$run.log" 2>&1
+			# "N processes in W s, of which C were compilers, running for T s (U s of CPU)."
+			summary=$(grep ' processes in ' "$out/$run.log" | tail -1)
+			wall=$(echo "$summary" | sed -n 's/.* processes in \([0-9.]*\) s.*/\1/p')
+			compile=$(echo "$summary" | sed -n 's/.* running for \([0-9.]*\) s.*/\1/p')
+			slowest=$(grep -A2 '^Longest compiles:' "$out/$run.log" | awk 'NR == 3 { print $1 }')
+			if [ -z "$wall" ] || [ -z "$compile" ] || [ -z "$slowest" ]; then
+				echo "$run failed."
+				continue
+			fi
+			read parallelism bound efficiency <<< $(awk "BEGIN {
+				bound = $compile / $j; if ($slowest > bound) bound = $slowest
+				printf \"%.2f %.3f %.2f\", $compile / $wall, bound, bound / $wall }")
+			echo "$count,$skew,$j,$units,$wall,$compile,$parallelism,$slowest,$bound,$efficiency" >> "$out/curves.csv"
+			printf "%-20s %8.2f s wall %8.2f s compiling %6.2f running, bound %8.2f s\n" $run $wall $compile \
+				$parallelism $bound
+		done
+	done
+done
+echo "Results are in $out/curves.csv."